@@ -13,17 +13,45 @@
 # License for the specific language governing permissions and limitations
 # under the License.
 
+from time import sleep
+
 TOPOLOGY = """
 #
-# +-------+
-# |  sw1  |
-# +-------+
+# +-------+     +-------+     +-------+
+# |  hs1  <----->  sw1  <----->  hs2  |
+# +-------+     +-------+     +-------+
 #
 
 # Nodes
 [type=openswitch name="Switch 1"] sw1
+[type=host name="Host 1" image="openswitch/ubuntuscapy:latest"] hs1
+[type=host name="Host 2" image="openswitch/ubuntuscapy:latest"] hs2
+
+# Links
+hs1:if01 -- sw1:if01
+sw1:if02 -- hs2:if01
 """
 
+# Option 82 of a relay agent ahead of the switch: circuit id "abcd"
+DOWNSTREAM_OPTION_82 = "\\x01\\x04abcd"
+
+# Request of a client, broadcast on the client side of the switch
+SEND_REQUEST = (
+    "python -c \"from scapy.all import *; "
+    "sendp(Ether(src='{mac}', dst='ff:ff:ff:ff:ff:ff') / "
+    "IP(src='0.0.0.0', dst='255.255.255.255') / "
+    "UDP(sport=68, dport=67) / "
+    "BOOTP(chaddr=mac2str('{mac}'), giaddr='{giaddr}', xid=0x1234) / "
+    "DHCP(options=[('message-type', 'request'){agent}, 'end']), "
+    "iface='{iface}')\"")
+
+# Option 82 of each request relayed to the server
+READ_RELAYED = (
+    "python -c \"import sys; from scapy.all import *; "
+    "[sys.stdout.write('relayed %r\\n' % [o[1] for o in p[DHCP].options "
+    "if o[0] == 'relay_agent_Information']) "
+    "for p in rdpcap('/tmp/relayed.pcap')]\"")
+
 
 def dhcp_relay_enable(sw1):
     sw1("configure terminal")
@@ -573,6 +601,86 @@ def delete_helper_addresses(sw1):
     assert 'No servers are configured on this interface :23' in output
 
 
+def relay_request(sw1, hs1, hs2, policy, agent):
+    sw1("configure terminal")
+    sw1("dhcp-relay option 82 " + policy)
+    sw1("end")
+
+    # Capture the request relayed to the server
+    hs2("rm -f /tmp/relayed.pcap")
+    hs2("tcpdump -i {} -w /tmp/relayed.pcap udp dst port 67 "
+        "> /dev/null 2>&1 &".format(hs2.ports['if01']))
+    sleep(2)
+
+    giaddr = '0.0.0.0'
+    option = ''
+    if agent:
+        # A request relayed once already carries a gateway address
+        giaddr = '10.0.10.9'
+        option = ", ('relay_agent_Information', '{}')".format(
+            DOWNSTREAM_OPTION_82)
+    hs1(SEND_REQUEST.format(mac='00:50:56:11:22:33', giaddr=giaddr,
+                            agent=option, iface=hs1.ports['if01']))
+    sleep(3)
+
+    hs2("pkill tcpdump")
+    sleep(1)
+    output = hs2(READ_RELAYED)
+    return [line for line in output.split('\n')
+            if line.startswith('relayed ')]
+
+
+def dhcp_relay_option_82_relayed(sw1, hs1, hs2):
+    print("Test option 82 of the requests relayed to the server")
+    hs1.libs.ip.interface('if01', addr='10.0.10.2/24', up=True)
+    hs2.libs.ip.interface('if01', addr='10.0.20.2/24', up=True)
+
+    sw1("configure terminal")
+    sw1("dhcp-relay")
+    sw1("interface {}".format(sw1.ports['if01']))
+    sw1("no shutdown")
+    sw1("ip address 10.0.10.1/24")
+    sw1("ip helper-address 10.0.20.2")
+    sw1("interface {}".format(sw1.ports['if02']))
+    sw1("no shutdown")
+    sw1("ip address 10.0.20.1/24")
+    sw1("end")
+    sleep(2)
+
+    # Replace: our option is added, or takes the place of the received one
+    relayed = relay_request(sw1, hs1, hs2, "replace", False)
+    assert len(relayed) == 1
+    assert "[]" not in relayed[0]
+
+    relayed = relay_request(sw1, hs1, hs2, "replace", True)
+    assert len(relayed) == 1
+    assert "[]" not in relayed[0]
+    assert "abcd" not in relayed[0]
+
+    # Keep: the received option is sent as is
+    relayed = relay_request(sw1, hs1, hs2, "keep", True)
+    assert len(relayed) == 1
+    assert "abcd" in relayed[0]
+
+    # Drop: a request with an option 82 is not relayed
+    relayed = relay_request(sw1, hs1, hs2, "drop", True)
+    assert len(relayed) == 0
+
+    output = sw1("ovs-appctl -t ops-relay udpfwd/dump interface {}".format(
+                 sw1.ports['if01']), shell="bash")
+    assert 'client request dropped packets with option 82 = 1' in output
+
+    # Remove configuration
+    sw1("configure terminal")
+    sw1("no dhcp-relay option 82")
+    sw1("interface {}".format(sw1.ports['if01']))
+    sw1("no ip helper-address 10.0.20.2")
+    sw1("no ip address 10.0.10.1/24")
+    sw1("interface {}".format(sw1.ports['if02']))
+    sw1("no ip address 10.0.20.1/24")
+    sw1("end")
+
+
 def test_ipapps_dhcp_relay_configuration(topology, step):
     sw1 = topology.get('sw1')
 
@@ -617,3 +725,15 @@ def test_ipapps_dhcp_relay_configuration(topology, step):
     add_helper_addresses(sw1)
 
     delete_helper_addresses(sw1)
+
+
+def test_ipapps_dhcp_relay_option_82_relayed(topology, step):
+    sw1 = topology.get('sw1')
+    hs1 = topology.get('hs1')
+    hs2 = topology.get('hs2')
+
+    assert sw1 is not None
+    assert hs1 is not None
+    assert hs2 is not None
+
+    dhcp_relay_option_82_relayed(sw1, hs1, hs2)
@@ -336,6 +336,113 @@ def udp_forward_protocol_reboot(sw1):
     return True
 
 
+# Servers of a UDP port on an interface, in the order udpfwd/dump lists
+# them, which is the order requests are forwarded in
+def udp_forward_dump_servers(sw1, intf, port):
+    out = "ovs-appctl -t ops-relay udpfwd/dump interface {}".format(intf)
+    output = sw1(out, shell="bash")
+    prefix = "Port {} - ".format(port)
+    servers = []
+    for line in output.split('\n'):
+        if line.startswith(prefix):
+            servers.append(line[len(prefix):].split(',')[0])
+    return servers
+
+
+# Write the servers of a UDP port on an interface to the database, the CLI
+# allows 8 of them only
+def udp_forward_set_servers(sw1, intf, port, servers):
+    cmd = "ovs-vsctl --bare --columns=_uuid find " \
+          "UDP_Bcast_Forwarder_Server udp_dport={} " \
+          "src_port=$(ovs-vsctl get port {} _uuid)".format(port, intf)
+    uuid = sw1(cmd, shell="bash").strip()
+    assert uuid
+
+    addresses = ','.join('"{}"'.format(server) for server in servers)
+    cmd = "ovs-vsctl set UDP_Bcast_Forwarder_Server {} " \
+          "ipv4_ucast_server='{}'".format(uuid, addresses)
+    sw1(cmd, shell="bash")
+    sleep(2)
+
+
+# Restart the daemon in its network namespace with other options
+def udp_forward_restart_daemon(sw1, options):
+    pid = sw1("pidof ops-relay", shell="bash").strip()
+    netns = sw1("ip netns identify {}".format(pid), shell="bash").strip()
+    cmd = "tr '\\0' ' ' < /proc/{}/cmdline".format(pid)
+    args = [arg for arg in sw1(cmd, shell="bash").split()
+            if not arg.startswith("--intf-servers-max")]
+
+    sw1("kill {}".format(pid), shell="bash")
+    sleep(2)
+    if netns:
+        args = ["ip", "netns", "exec", netns] + args
+    sw1(" ".join(args + options) + " > /dev/null 2>&1 &", shell="bash")
+    sleep(5)
+
+
+# Verify more than 16 UDP forward-protocol servers on an interface
+def udp_forward_protocol_servers_above_16(sw1):
+    sw1("configure terminal")
+    sw1("interface 25")
+    cmd = "ip forward-protocol udp 30.0.0.101 123"
+    sw1(cmd)
+    sw1("end")
+
+    # Addresses of 3 digits, listed by the database in numeric order
+    servers = ["30.0.0.{}".format(host) for host in range(101, 121)]
+    udp_forward_set_servers(sw1, 25, 123, servers)
+
+    out = "ovs-appctl -t ops-relay udpfwd/dump interface 25"
+    output = sw1(out, shell="bash")
+    assert 'Interface 25: 20' in output
+    assert udp_forward_dump_servers(sw1, 25, 123) == servers
+    return True
+
+
+# Verify the servers kept by an update stay in place and the servers
+# added again come after them
+def udp_forward_protocol_servers_order(sw1):
+    servers = ["30.0.0.{}".format(host) for host in range(101, 121)]
+    removed = ["30.0.0.105", "30.0.0.110"]
+    kept = [server for server in servers if server not in removed]
+
+    udp_forward_set_servers(sw1, 25, 123, kept)
+    assert udp_forward_dump_servers(sw1, 25, 123) == kept
+
+    udp_forward_set_servers(sw1, 25, 123, servers)
+    assert udp_forward_dump_servers(sw1, 25, 123) == kept + removed
+    return True
+
+
+# Verify the servers of an interface stop at --intf-servers-max
+def udp_forward_protocol_servers_limit(sw1):
+    udp_forward_restart_daemon(sw1, ["--intf-servers-max=24"])
+
+    # The 20 servers read back from the database, then 4 of the new ones
+    servers = ["30.0.0.{}".format(host) for host in range(101, 131)]
+    udp_forward_set_servers(sw1, 25, 123, servers)
+
+    out = "ovs-appctl -t ops-relay udpfwd/dump interface 25"
+    output = sw1(out, shell="bash")
+    assert 'Interface 25: 24' in output
+    assert udp_forward_dump_servers(sw1, 25, 123) == servers[:24]
+
+    # Remove configuration
+    udp_forward_restart_daemon(sw1, [])
+    udp_forward_set_servers(sw1, 25, 123, ["30.0.0.101"])
+    sw1("configure terminal")
+    sw1("interface 25")
+    cmd = "no ip forward-protocol udp 30.0.0.101 123"
+    sw1(cmd)
+    sw1("end")
+
+    out = "ovs-appctl -t ops-relay udpfwd/dump interface 25"
+    output = sw1(out, shell="bash")
+    assert '30.0.0.101' not in output
+    return True
+
+
 def test_ipapps_udp_bcast_forwarder_configuration(topology, step):
     sw1 = topology.get('sw1')
 
@@ -383,3 +490,12 @@ def test_ipapps_udp_bcast_forwarder_configuration(topology, step):
     step("Verify the configuration of dhcp-relay helper address and")
     step("UDP forward-protocol server addresses together")
     udp_forward_protocol_server_entry03(sw1)
+
+    step("Verify more than 16 UDP forward-protocol servers on an interface")
+    udp_forward_protocol_servers_above_16(sw1)
+
+    step("Verify the order of the servers removed and added again")
+    udp_forward_protocol_servers_order(sw1)
+
+    step("Verify the servers of an interface stop at --intf-servers-max")
+    udp_forward_protocol_servers_limit(sw1)
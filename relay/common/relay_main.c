@@ -61,7 +61,10 @@
 #include "svec.h"
 
 #include "udpfwd.h"
+#include "udpfwd_xsk.h"
+#include "udpfwd_fastpath.h"
 #include "dhcpv6_relay.h"
+#include "relay_pool.h"
 
 /*
  * Global variable declarations.
@@ -92,6 +95,21 @@ static void usage(void)
     vlog_usage();
     printf("\nOther options:\n"
             "  --unixctl=SOCKET        override default control socket name\n"
+            "  --rx-batch-size=N       receive up to N packets per syscall\n"
+            "  --rx-workers=N          receive with N worker threads\n"
+            "  --intf-servers-max=N    allow N servers per interface\n"
+            "  --rx-backend=TYPE       receive with TYPE socket (recvmmsg,\n"
+            "                          default), tpacket (mapped ring) or\n"
+            "                          xdp (AF_XDP sockets)\n"
+            "  --xdp-interfaces=LIST   attach the XDP program to the comma\n"
+            "                          separated interfaces of LIST\n"
+            "  --xdp-generic           attach the XDP program in SKB mode\n"
+            "  --dhcp-l2-replies       send DHCP client replies as Ethernet\n"
+            "                          frames on the client interface\n"
+#ifdef FTR_UDP_BCAST_FWD
+            "  --bcast-fastpath        forward UDP broadcasts in the kernel\n"
+            "                          with a TC program, socket backend\n"
+#endif /* FTR_UDP_BCAST_FWD */
             "  -h, --help              display this help message\n"
             "  -V, --version           display version information\n");
     exit(EXIT_SUCCESS);
@@ -108,6 +126,14 @@ static char *parse_options(int argc, char *argv[], char **unixctl_pathp)
 {
     enum {
         OPT_UNIXCTL = UCHAR_MAX + 1,
+        OPT_RX_BATCH_SIZE,
+        OPT_RX_WORKERS,
+        OPT_INTF_SERVERS_MAX,
+        OPT_RX_BACKEND,
+        OPT_DHCP_L2_REPLIES,
+        OPT_XDP_INTERFACES,
+        OPT_XDP_GENERIC,
+        OPT_BCAST_FASTPATH,
         VLOG_OPTION_ENUMS,
         DAEMON_OPTION_ENUMS,
     };
@@ -116,6 +142,17 @@ static char *parse_options(int argc, char *argv[], char **unixctl_pathp)
             {"help",        no_argument, NULL, 'h'},
             {"version",     no_argument, NULL, 'V'},
             {"unixctl",     required_argument, NULL, OPT_UNIXCTL},
+            {"rx-batch-size", required_argument, NULL, OPT_RX_BATCH_SIZE},
+            {"rx-workers", required_argument, NULL, OPT_RX_WORKERS},
+            {"intf-servers-max", required_argument, NULL,
+             OPT_INTF_SERVERS_MAX},
+            {"rx-backend", required_argument, NULL, OPT_RX_BACKEND},
+            {"dhcp-l2-replies", no_argument, NULL, OPT_DHCP_L2_REPLIES},
+            {"xdp-interfaces", required_argument, NULL, OPT_XDP_INTERFACES},
+            {"xdp-generic", no_argument, NULL, OPT_XDP_GENERIC},
+#ifdef FTR_UDP_BCAST_FWD
+            {"bcast-fastpath", no_argument, NULL, OPT_BCAST_FASTPATH},
+#endif /* FTR_UDP_BCAST_FWD */
             DAEMON_LONG_OPTIONS,
             VLOG_LONG_OPTIONS,
             {NULL, 0, NULL, 0},
@@ -144,6 +181,45 @@ static char *parse_options(int argc, char *argv[], char **unixctl_pathp)
             *unixctl_pathp = optarg;
             break;
 
+        case OPT_RX_BATCH_SIZE:
+            udpfwd_set_rx_batch_size(atoi(optarg));
+            break;
+
+        case OPT_RX_WORKERS:
+            udpfwd_set_rx_workers(atoi(optarg));
+            break;
+
+        case OPT_INTF_SERVERS_MAX:
+            udpfwd_set_intf_servers_max(atoi(optarg));
+            break;
+
+        case OPT_RX_BACKEND:
+            if (true != udpfwd_set_rx_backend(optarg)) {
+                VLOG_FATAL("--rx-backend must be socket, tpacket or xdp");
+            }
+            break;
+
+        case OPT_DHCP_L2_REPLIES:
+            udpfwd_set_l2_replies(true);
+            break;
+
+        case OPT_XDP_INTERFACES:
+            if (true != udpfwd_xsk_set_interfaces(optarg)) {
+                VLOG_FATAL("--xdp-interfaces must list 1 to %d interfaces",
+                           UDPFWD_XSK_INTF_MAX);
+            }
+            break;
+
+        case OPT_XDP_GENERIC:
+            udpfwd_xsk_set_generic(true);
+            break;
+
+#ifdef FTR_UDP_BCAST_FWD
+        case OPT_BCAST_FASTPATH:
+            udpfwd_fastpath_set_enabled(true);
+            break;
+#endif /* FTR_UDP_BCAST_FWD */
+
             VLOG_OPTION_HANDLERS
             DAEMON_OPTION_HANDLERS
 
@@ -182,9 +258,11 @@ static void relay_unixctl_run_and_wait(struct unixctl_server *unixctl,
                                         bool exiting)
 {
     unixctl_server_run(unixctl);
+    udpfwd_run();
 
     ovsdb_idl_wait(idl);
     poll_timer_wait(IDL_POLL_INTERVAL * 1000);
+    udpfwd_wait();
 
     unixctl_server_wait(unixctl);
     if (exiting) {
@@ -316,6 +394,9 @@ void relay_run(void)
     dhcpv6r_reconfigure();
 #endif /* FTR_DHCPV6_RELAY */
 
+    /* The tracked record changes have been processed */
+    ovsdb_idl_track_clear(idl);
+
     /* Cache the lated idl sequence number */
     idl_seqno = new_idl_seqno;
 
@@ -347,6 +428,8 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
     unixctl_command_register("exit", "", 0, 0, relay_exit_cb, &exiting);
+    unixctl_command_register("relay/pools", "", 0, 0,
+                             relay_pool_unixctl_dump, NULL);
 
     idl_init(remote);
 
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_pool.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Hand out and take back the objects of a pool, growing it by a slab.
+ * - Keep the strings of the configuration in fixed size slots.
+ * - Dump the usage counters of every pool through relay/pools.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unixctl.h"
+#include "openvswitch/vlog.h"
+#include "relay_pool.h"
+
+VLOG_DEFINE_THIS_MODULE(relay_pool);
+
+/* Strings of the configuration: interface names, IPv6 server addresses */
+RELAY_POOL relay_name_pool =
+    RELAY_POOL_INITIALIZER("relay-names", RELAY_POOL_NAME_SIZE, 16);
+
+/* Pools which allocated a slab, shown by relay/pools */
+static RELAY_POOL *relay_pools = NULL;
+static pthread_mutex_t relay_pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Function      : relay_pool_grow
+ * Responsiblity : Add a slab to a pool and put its objects on the free
+ *                 list. Called with the pool mutex held.
+ * Parameters    : pool - object pool
+ * Return        : true - if the pool grew
+ *                 false - otherwise
+ */
+static bool relay_pool_grow(RELAY_POOL *pool)
+{
+    RELAY_POOL_SLAB *slab;
+    size_t header, bytes, count, iter;
+    char *obj;
+
+    header = RELAY_POOL_ROUND(sizeof(RELAY_POOL_SLAB), pool->align);
+    bytes = RELAY_POOL_SLAB_SIZE;
+    if (bytes < (header + pool->size))
+        bytes = header + pool->size;
+    count = (bytes - header) / pool->size;
+
+    if (posix_memalign((void **) &slab, RELAY_POOL_CACHE_LINE, bytes)) {
+        VLOG_ERR("Failed to allocate a slab of pool : %s", pool->name);
+        return false;
+    }
+
+    /* Objects are handed out in address order */
+    obj = (char *) slab + header + (count - 1) * pool->size;
+    for (iter = 0; iter < count; iter++, obj -= pool->size) {
+        *(void **) obj = pool->freeList;
+        pool->freeList = obj;
+    }
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->slabCount++;
+    pool->objects += count;
+
+    return true;
+}
+
+/*
+ * Function      : relay_pool_register
+ * Responsiblity : Link a pool in the list shown by relay/pools. Called
+ *                 without the pool mutex, which relay_pool_dump() takes
+ *                 under the list mutex.
+ * Parameters    : pool - object pool
+ * Return        : none
+ */
+static void relay_pool_register(RELAY_POOL *pool)
+{
+    pthread_mutex_lock(&relay_pools_mutex);
+    if (!pool->registered) {
+        pool->next = relay_pools;
+        relay_pools = pool;
+        pool->registered = true;
+    }
+    pthread_mutex_unlock(&relay_pools_mutex);
+}
+
+/*
+ * Function      : relay_pool_alloc
+ * Responsiblity : Take a zeroed object from a pool
+ * Parameters    : pool - object pool
+ * Return        : void* - object
+ *                 NULL - if no memory is left
+ */
+void *relay_pool_alloc(RELAY_POOL *pool)
+{
+    void *obj = NULL;
+    bool grew = false;
+
+    pthread_mutex_lock(&pool->mutex);
+    if ((NULL != pool->freeList)
+        || (grew = relay_pool_grow(pool))) {
+        obj = pool->freeList;
+        pool->freeList = *(void **) obj;
+        pool->allocs++;
+        pool->inUse++;
+        if (pool->inUse > pool->highWater)
+            pool->highWater = pool->inUse;
+    } else {
+        pool->failures++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (grew)
+        relay_pool_register(pool);
+
+    if (NULL != obj)
+        memset(obj, 0, pool->size);
+
+    return obj;
+}
+
+/*
+ * Function      : relay_pool_free
+ * Responsiblity : Give an object back to its pool
+ * Parameters    : pool - object pool
+ *                 obj - object taken from pool, or NULL
+ * Return        : none
+ */
+void relay_pool_free(RELAY_POOL *pool, void *obj)
+{
+    if (NULL == obj)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    *(void **) obj = pool->freeList;
+    pool->freeList = obj;
+    pool->frees++;
+    pool->inUse--;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/*
+ * Function      : relay_pool_strdup
+ * Responsiblity : Copy a string in a slot of a name pool, or on the heap
+ *                 when it does not fit
+ * Parameters    : pool - name pool
+ *                 str - string
+ * Return        : char* - copy, freed with relay_pool_strfree()
+ *                 NULL - if no memory is left
+ */
+char *relay_pool_strdup(RELAY_POOL *pool, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy;
+
+    if (len > pool->size) {
+        copy = (char *) malloc(len);
+        if (NULL != copy) {
+            pthread_mutex_lock(&pool->mutex);
+            pool->heapInUse++;
+            pthread_mutex_unlock(&pool->mutex);
+        }
+    } else {
+        copy = (char *) relay_pool_alloc(pool);
+    }
+
+    if (NULL != copy)
+        memcpy(copy, str, len);
+
+    return copy;
+}
+
+/*
+ * Function      : relay_pool_strfree
+ * Responsiblity : Free a string copied by relay_pool_strdup(). Its length
+ *                 tells where it was copied.
+ * Parameters    : pool - name pool
+ *                 str - string, or NULL
+ * Return        : none
+ */
+void relay_pool_strfree(RELAY_POOL *pool, char *str)
+{
+    if (NULL == str)
+        return;
+
+    if ((strlen(str) + 1) > pool->size) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->heapInUse--;
+        pthread_mutex_unlock(&pool->mutex);
+        free(str);
+    } else {
+        relay_pool_free(pool, str);
+    }
+}
+
+/*
+ * Function      : relay_pool_dump
+ * Responsiblity : Dump the usage counters of the pools
+ * Parameters    : ds - output buffer
+ * Return        : none
+ */
+void relay_pool_dump(struct ds *ds)
+{
+    RELAY_POOL *pool;
+
+    ds_put_format(ds, "%-28s %6s %6s %8s %8s %8s %10s %10s %6s %6s\n",
+                  "Pool", "Size", "Slabs", "Objects", "In use", "Peak",
+                  "Allocs", "Frees", "Fails", "Heap");
+
+    pthread_mutex_lock(&relay_pools_mutex);
+    for (pool = relay_pools; NULL != pool; pool = pool->next) {
+        pthread_mutex_lock(&pool->mutex);
+        ds_put_format(ds, "%-28s %6zu %6"PRIu64" %8"PRIu64
+                      " %8"PRIu64" %8"PRIu64" %10"PRIu64" %10"PRIu64
+                      " %6"PRIu64" %6"PRIu64"\n", pool->name, pool->size,
+                      pool->slabCount, pool->objects, pool->inUse,
+                      pool->highWater, pool->allocs, pool->frees,
+                      pool->failures, pool->heapInUse);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    pthread_mutex_unlock(&relay_pools_mutex);
+}
+
+/*
+ * Function      : relay_pool_unixctl_dump
+ * Responsiblity : Dump the usage counters of the pools
+ * Parameters    : conn - unixctl socket connection
+ *                 argc, argv - function parameters
+ *                 aux - aux connection data
+ * Return        : none
+ */
+void relay_pool_unixctl_dump(struct unixctl_conn *conn,
+                   int argc OVS_UNUSED, const char *argv[] OVS_UNUSED,
+                   void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    relay_pool_dump(&ds);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
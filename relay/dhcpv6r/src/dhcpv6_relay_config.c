@@ -25,12 +25,26 @@
 
 #include "dhcpv6_relay.h"
 #include "hash.h"
+#include "relay_pool.h"
 #include <string.h>
 
 VLOG_DEFINE_THIS_MODULE(dhcpv6_relay_config);
 
 #ifdef FTR_DHCPV6_RELAY
 
+/* Object pools of the configuration */
+static RELAY_POOL dhcpv6r_server_pool =
+    RELAY_POOL_INITIALIZER("dhcpv6r-servers", sizeof(DHCPV6_RELAY_SERVER_T),
+                           16);
+static RELAY_POOL dhcpv6r_intf_pool =
+    RELAY_POOL_INITIALIZER("dhcpv6r-interfaces",
+                           sizeof(DHCPV6_RELAY_INTERFACE_NODE_T), 16);
+static RELAY_POOL dhcpv6r_array_pool =
+    RELAY_POOL_INITIALIZER("dhcpv6r-server-arrays",
+                           MAX_SERVERS_PER_INTERFACE *
+                           sizeof(DHCPV6_RELAY_SERVER_T *),
+                           RELAY_POOL_CACHE_LINE);
+
 #define GENERATE_KEY(HASH_IP, HASH_EGRESSNAME, HASH_KEY) \
     if (HASH_EGRESSNAME) \
         HASH_KEY = hash_2words(hash_string(HASH_IP, 0), \
@@ -99,18 +113,30 @@ DHCPV6_RELAY_SERVER_T* dhcpv6r_add_server_entry(char* ipv6_address,
     DHCPV6_RELAY_SERVER_T *serverIP;
     uint32_t hash_key;
 
-    serverIP = (DHCPV6_RELAY_SERVER_T *) malloc(sizeof(DHCPV6_RELAY_SERVER_T));
+    serverIP = (DHCPV6_RELAY_SERVER_T *)
+               relay_pool_alloc(&dhcpv6r_server_pool);
     if (NULL == serverIP) {
         VLOG_ERR("Failed to allocate memory for the server entry for "
                  "ipv6: %s", ipv6_address);
         return NULL;
     }
 
-    serverIP->ipv6_address = xstrdup(ipv6_address);
+    serverIP->ipv6_address = relay_pool_strdup(&relay_name_pool,
+                                               ipv6_address);
     if (egressIfName)
-        serverIP->egressIfName = xstrdup(egressIfName);
+        serverIP->egressIfName = relay_pool_strdup(&relay_name_pool,
+                                                   egressIfName);
     else
         serverIP->egressIfName = NULL;
+    if ((NULL == serverIP->ipv6_address) ||
+        (egressIfName && (NULL == serverIP->egressIfName))) {
+        VLOG_ERR("Failed to allocate memory for the server entry for "
+                 "ipv6: %s", ipv6_address);
+        relay_pool_strfree(&relay_name_pool, serverIP->ipv6_address);
+        relay_pool_strfree(&relay_name_pool, serverIP->egressIfName);
+        relay_pool_free(&dhcpv6r_server_pool, serverIP);
+        return NULL;
+    }
     serverIP->ref_count  = 1; /*Reference count starts with 1*/
 
     GENERATE_KEY(ipv6_address, egressIfName, hash_key);
@@ -159,8 +185,7 @@ bool dhcpv6r_store_address(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
     {
         intfNode->addrCount = 0;
         intfNode->serverArray = (DHCPV6_RELAY_SERVER_T **)
-                                    malloc(MAX_SERVERS_PER_INTERFACE
-                                    * sizeof(DHCPV6_RELAY_SERVER_T *));
+                                    relay_pool_alloc(&dhcpv6r_array_pool);
         if (NULL == intfNode->serverArray) {
             VLOG_ERR("Failed to allocate server array for interface : %s",
                     intfNode->portName);
@@ -269,11 +294,9 @@ bool dhcpv6r_remove_server_ref_entry(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
                 cmap_remove(&dhcpv6_relay_ctrl_cb_p->serverHashMap,
                             (struct cmap_node *)server, hash_key);
                 /* assign outgoing interface to NULL */
-                if (NULL != server->egressIfName)
-                    free(server->egressIfName);
-                if (NULL != server->ipv6_address)
-                    free(server->ipv6_address);
-                free(server);
+                relay_pool_strfree(&relay_name_pool, server->egressIfName);
+                relay_pool_strfree(&relay_name_pool, server->ipv6_address);
+                relay_pool_free(&dhcpv6r_server_pool, server);
             }
 
             *deleted_index = index;
@@ -345,7 +368,7 @@ bool dhcpv6r_remove_address(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
                   " Freeing interface entry", intfNode->portName);
 
         /* Delete the entire IP reference table */
-        free(serverArray);
+        relay_pool_free(&dhcpv6r_array_pool, serverArray);
         /* Make interface table entry NULL, as no helper IP is configured */
         intfNode->serverArray = NULL;
         node = shash_find(&dhcpv6_relay_ctrl_cb_p->intfHashTable,
@@ -359,10 +382,8 @@ bool dhcpv6r_remove_address(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
             VLOG_ERR("Interface node not found in hash table : %s",
                  intfNode->portName);
         }
-        if (NULL != intfNode->portName)
-            free(intfNode->portName);
-
-        free(intfNode);
+        relay_pool_strfree(&relay_name_pool, intfNode->portName);
+        relay_pool_free(&dhcpv6r_intf_pool, intfNode);
     }
     sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
     return true;
@@ -381,18 +402,18 @@ DHCPV6_RELAY_INTERFACE_NODE_T *dhcpv6r_create_intferface_node(char *pname)
 
     /* There is no server configuration available create one */
     intfNode = (DHCPV6_RELAY_INTERFACE_NODE_T *)
-                    calloc(1, sizeof(DHCPV6_RELAY_INTERFACE_NODE_T));
+                    relay_pool_alloc(&dhcpv6r_intf_pool);
     if (NULL == intfNode)
     {
         VLOG_ERR("Failed to allocate interface node for : %s", pname);
         return NULL;
     }
 
-    intfNode->portName = xstrdup(pname);
+    intfNode->portName = relay_pool_strdup(&relay_name_pool, pname);
     if (NULL == intfNode->portName)
     {
        VLOG_ERR("Failed to allocate memory for portName : %s", pname);
-       free(intfNode);
+       relay_pool_free(&dhcpv6r_intf_pool, intfNode);
        return NULL;
     }
 
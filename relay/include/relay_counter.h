@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_counter.h
+ */
+
+/*
+ * This file has the definitions of the statistics counters of the packet
+ * path. Counters come in blocks, one block per writer thread, and a block
+ * is only ever written by its thread. The writer adds with a relaxed load
+ * and store, no locked instruction nor lock, and a reader on another
+ * thread loads each counter relaxed, so that it never sees a torn value.
+ * A reader sums a counter over the blocks of all the writers when it needs
+ * the value. Counters are 64 bits wide and do not wrap.
+ */
+
+#ifndef RELAY_COUNTER_H
+#define RELAY_COUNTER_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ovs-atomic.h"
+
+/* Counter of a block, written by the thread which owns the block */
+typedef ATOMIC(uint64_t) RELAY_COUNTER;
+
+/*
+ * Function      : relay_counter_add
+ * Responsiblity : Add to a counter of the block of the calling thread
+ * Parameters    : counter - counter
+ *                 count - value to add
+ * Return        : none
+ */
+static inline void relay_counter_add(RELAY_COUNTER *counter, uint64_t count)
+{
+    uint64_t value;
+
+    /* Only the calling thread writes the counter */
+    atomic_read_relaxed(counter, &value);
+    atomic_store_relaxed(counter, value + count);
+}
+
+/*
+ * Function      : relay_counter_max
+ * Responsiblity : Raise a counter of the block of the calling thread to a
+ *                 value, if the value is larger
+ * Parameters    : counter - counter
+ *                 value - value to keep if larger
+ * Return        : none
+ */
+static inline void relay_counter_max(RELAY_COUNTER *counter, uint64_t value)
+{
+    uint64_t current;
+
+    /* Only the calling thread writes the counter */
+    atomic_read_relaxed(counter, &current);
+    if (value > current)
+        atomic_store_relaxed(counter, value);
+}
+
+/*
+ * Function      : relay_counter_read
+ * Responsiblity : Read a counter of the block of any thread
+ * Parameters    : counter - counter
+ * Return        : value of the counter
+ */
+static inline uint64_t relay_counter_read(RELAY_COUNTER *counter)
+{
+    uint64_t value;
+
+    atomic_read_relaxed(counter, &value);
+    return value;
+}
+
+/*
+ * Function      : relay_counter_sum
+ * Responsiblity : Sum a counter over the blocks of all the writers
+ * Parameters    : counter - counter in the first block
+ *                 stride - bytes from a block to the next one
+ *                 n_blocks - number of blocks
+ * Return        : sum of the counter
+ */
+static inline uint64_t relay_counter_sum(RELAY_COUNTER *counter,
+                                         size_t stride, uint32_t n_blocks)
+{
+    uint64_t sum = 0;
+    uint32_t iter;
+
+    for (iter = 0; iter < n_blocks; iter++) {
+        sum += relay_counter_read(counter);
+        counter = (RELAY_COUNTER *) ((char *) counter + stride);
+    }
+
+    return sum;
+}
+
+#endif /* relay_counter.h */
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_pool.h
+ */
+
+/*
+ * This file has the definitions of the object pools of the configuration.
+ * A pool hands out objects of one type carved from slabs of
+ * RELAY_POOL_SLAB_SIZE bytes. Freed objects go back to the pool, and the
+ * slabs are kept until exit, so configuration churn reuses the same
+ * memory instead of fragmenting the heap. The objects of a type that the
+ * packet path reads together, like the interface nodes, share a few
+ * slabs instead of being scattered over the heap.
+ */
+
+#ifndef RELAY_POOL_H
+#define RELAY_POOL_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "dynamic-string.h"
+
+struct unixctl_conn;
+
+/* Bytes of a slab, one object per slab when it does not fit */
+#define RELAY_POOL_SLAB_SIZE  4096
+
+/* Cache line, alignment of the objects written by the packet path */
+#define RELAY_POOL_CACHE_LINE 64
+
+/* Slots of the name pool, longer strings come from the heap */
+#define RELAY_POOL_NAME_SIZE  48
+
+/* Size of an object of SIZE bytes aligned on ALIGN */
+#define RELAY_POOL_ROUND(SIZE, ALIGN) \
+            ((((SIZE) + (ALIGN) - 1) / (ALIGN)) * (ALIGN))
+
+/* Pool of objects of SIZE bytes aligned on ALIGN, a power of 2 at least
+ * the size of a pointer */
+#define RELAY_POOL_INITIALIZER(NAME, SIZE, ALIGN) \
+            { .name = (NAME), .size = RELAY_POOL_ROUND(SIZE, ALIGN), \
+              .align = (ALIGN), .mutex = PTHREAD_MUTEX_INITIALIZER }
+
+/* Slab of a pool, the objects follow the header */
+typedef struct RELAY_POOL_SLAB
+{
+    struct RELAY_POOL_SLAB *next; /* Next slab of the pool */
+} RELAY_POOL_SLAB;
+
+/* Pool of fixed size objects. Safe from any thread, RCU callbacks free
+ * objects from their own thread */
+typedef struct RELAY_POOL
+{
+    const char *name;           /* Shown by relay/pools */
+    size_t size;                /* Object size, multiple of align */
+    size_t align;               /* Object alignment */
+    pthread_mutex_t mutex;      /* Protects the fields below */
+    void *freeList;             /* Free objects, linked through their first
+                                   word */
+    RELAY_POOL_SLAB *slabs;     /* Slabs of the pool */
+    struct RELAY_POOL *next;    /* Next pool shown by relay/pools */
+    bool registered;            /* Linked in the list of pools, under
+                                   the list mutex */
+    uint64_t slabCount;         /* Slabs allocated */
+    uint64_t objects;           /* Objects in the slabs */
+    uint64_t inUse;             /* Objects handed out */
+    uint64_t highWater;         /* Most objects handed out at once */
+    uint64_t allocs;            /* Objects allocated */
+    uint64_t frees;             /* Objects freed */
+    uint64_t failures;          /* Allocations which found no memory */
+    uint64_t heapInUse;         /* Strings too long for a slot, name pools */
+} RELAY_POOL;
+
+/* Strings of the configuration: interface names, IPv6 server addresses */
+extern RELAY_POOL relay_name_pool;
+
+/*
+ * Function prototypes from relay_pool.c
+ */
+void *relay_pool_alloc(RELAY_POOL *pool);
+void relay_pool_free(RELAY_POOL *pool, void *obj);
+char *relay_pool_strdup(RELAY_POOL *pool, const char *str);
+void relay_pool_strfree(RELAY_POOL *pool, char *str);
+void relay_pool_dump(struct ds *ds);
+void relay_pool_unixctl_dump(struct unixctl_conn *conn, int argc,
+                             const char *argv[], void *aux);
+
+#endif /* relay_pool.h */
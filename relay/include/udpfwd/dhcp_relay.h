@@ -25,6 +25,7 @@
 #ifndef DHCP_RELAY_H
 #define DHCP_RELAY_H 1
 
+#include <stddef.h>
 #include "udpfwd.h"
 
 #ifdef FTR_DHCP_RELAY
@@ -84,46 +85,68 @@ typedef struct DHCP_OPTION_82_OPTIONS
 {
    CIRCUIT_ID_t  circuit_id;
    REMOTE_ID_IP_ADDR_t ip_addr;
+   const DHCP_OPTION82_TEMPLATE *option82; /* Our options of the interface,
+                                              by remote-id type */
+   const DHCP_OPTION82_TEMPLATE *bootpGwOption82; /* Our IP remote id option
+                                              with a bootp gateway, or NULL */
 } DHCP_OPTION_82_OPTIONS;
 
-/* Macros for dhcp-relay statistics counters */
-#define INC_UDPF_DHCPR_CLIENT_DROPS(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.client_drops++
-#define INC_UDPF_DHCPR_CLIENT_SENT(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.client_valids++
-#define INC_UDPF_DHCPR_SERVER_DROPS(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.serv_drops++
-#define INC_UDPF_DHCPR_SERVER_SENT(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.serv_valids++
+/* Macros for dhcp-relay statistics counters. Receive workers update their
+ * own slot of the counters of an interface, taken from its forwarding
+ * snapshot. Readers merge the slots of all workers */
+#define UDPF_DHCPR_COUNTERS(pktCounters)  \
+            (pktCounters)[udpfwd_worker_id].counters
+#define ADD_UDPF_DHCPR_COUNTER(pktCounters, counter, count)  \
+            relay_counter_add(&UDPF_DHCPR_COUNTERS(pktCounters).counter, \
+                              (count))
+#define UDPF_DHCPR_COUNTER_SUM(intfNode, counter)  \
+            relay_counter_sum(&(intfNode)->pktCounters[0].counters.counter, \
+                              sizeof(DHCP_RELAY_PKT_COUNTER_SLOT), \
+                              udpfwd_ctrl_cb_p->n_workers)
+
+#define INC_UDPF_DHCPR_CLIENT_DROPS(pktCounters)  \
+            ADD_UDPF_DHCPR_COUNTER(pktCounters, client_drops, 1)
+#define INC_UDPF_DHCPR_CLIENT_SENT(pktCounters)  \
+            ADD_UDPF_DHCPR_COUNTER(pktCounters, client_valids, 1)
+#define INC_UDPF_DHCPR_SERVER_DROPS(pktCounters)  \
+            ADD_UDPF_DHCPR_COUNTER(pktCounters, serv_drops, 1)
+#define INC_UDPF_DHCPR_SERVER_SENT(pktCounters)  \
+            ADD_UDPF_DHCPR_COUNTER(pktCounters, serv_valids, 1)
+
+/* Macros to account a fan-out of count client requests */
+#define ADD_UDPF_DHCPR_CLIENT_DROPS(pktCounters, count)  \
+            ADD_UDPF_DHCPR_COUNTER(pktCounters, client_drops, count)
+#define ADD_UDPF_DHCPR_CLIENT_SENT(pktCounters, count)  \
+            ADD_UDPF_DHCPR_COUNTER(pktCounters, client_valids, count)
 
 /* Macros for Option 82 statistics counters */
-#define INC_UDPF_DHCPR_OPT82_CLIENT_DROPS(intfNode) \
-        intfNode->dhcp_relay_pkt_counters.client_drops_with_option82++
-#define INC_UDPF_DHCPR_OPT82_CLIENT_SENT(intfNode) \
-        intfNode->dhcp_relay_pkt_counters.client_valids_with_option82++
-#define INC_UDPF_DHCPR_OPT82_SERVER_DROPS(intfNode) \
-        intfNode->dhcp_relay_pkt_counters.serv_drops_with_option82++
-#define INC_UDPF_DHCPR_OPT82_SERVER_SENT(intfNode) \
-        intfNode->dhcp_relay_pkt_counters.serv_valids_with_option82++
+#define INC_UDPF_DHCPR_OPT82_CLIENT_DROPS(pktCounters) \
+        ADD_UDPF_DHCPR_COUNTER(pktCounters, client_drops_with_option82, 1)
+#define INC_UDPF_DHCPR_OPT82_CLIENT_SENT(pktCounters) \
+        ADD_UDPF_DHCPR_COUNTER(pktCounters, client_valids_with_option82, 1)
+#define INC_UDPF_DHCPR_OPT82_SERVER_DROPS(pktCounters) \
+        ADD_UDPF_DHCPR_COUNTER(pktCounters, serv_drops_with_option82, 1)
+#define INC_UDPF_DHCPR_OPT82_SERVER_SENT(pktCounters) \
+        ADD_UDPF_DHCPR_COUNTER(pktCounters, serv_valids_with_option82, 1)
 
 /* The following macros will return pkt counters values  */
 #define UDPF_DHCPR_CLIENT_DROPS(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.client_drops
+            UDPF_DHCPR_COUNTER_SUM(intfNode, client_drops)
 #define UDPF_DHCPR_CLIENT_SENT(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.client_valids
+            UDPF_DHCPR_COUNTER_SUM(intfNode, client_valids)
 #define UDPF_DHCPR_SERVER_DROPS(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.serv_drops
+            UDPF_DHCPR_COUNTER_SUM(intfNode, serv_drops)
 #define UDPF_DHCPR_SERVER_SENT(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.serv_valids
+            UDPF_DHCPR_COUNTER_SUM(intfNode, serv_valids)
 
 #define UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.client_drops_with_option82
+            UDPF_DHCPR_COUNTER_SUM(intfNode, client_drops_with_option82)
 #define UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.client_valids_with_option82
+            UDPF_DHCPR_COUNTER_SUM(intfNode, client_valids_with_option82)
 #define UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.serv_drops_with_option82
+            UDPF_DHCPR_COUNTER_SUM(intfNode, serv_drops_with_option82)
 #define UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.serv_valids_with_option82
+            UDPF_DHCPR_COUNTER_SUM(intfNode, serv_valids_with_option82)
 
 /* invalid message type or options */
 #define DHCPR_INVALID_PKT -1
@@ -133,6 +156,10 @@ typedef struct DHCP_OPTION_82_OPTIONS
 
 #define DHCP_OPTION_HEADER_LENGTH 2
 
+/* Offset of the remote id value in our relay agent information option */
+#define DHCP_OPTION82_REMOTE_ID_VALUE ((3 * DHCP_OPTION_HEADER_LENGTH) + \
+                                       sizeof(CIRCUIT_ID_t))
+
 /* DHCP Relay Agent Information Sub Option Tag Values */
 
 /* Dhcp Relay Agent Circuit ID field */
@@ -180,6 +207,96 @@ struct dhcp_packet {
   uint8_t   options[DFLTOPTLEN];  /* Optional parameters field. */
 };
 
+/* Options the relay reads on the packet path. They are indexed by the
+ * stage that parses the options field, other options are looked up when
+ * asked for */
+typedef enum DHCP_OPTION_INDEX_SLOT {
+   DHCP_OPTION_INDEX_UNTRACKED,
+   DHCP_OPTION_INDEX_MSGTYPE,
+   DHCP_OPTION_INDEX_MAXMSGSIZE,
+   DHCP_OPTION_INDEX_AGENT,
+   DHCP_OPTION_INDEX_SLOTS
+} DHCP_OPTION_INDEX_SLOT;
+
+/* Index of the options field of a DHCP message. The offsets are from the
+ * DHCP header, an option is never at offset 0 */
+typedef struct DHCP_OPTION_INDEX {
+  uint16_t offset[DHCP_OPTION_INDEX_SLOTS]; /* First option of each tracked
+                           tag in the options field, 0 if absent or not
+                           parsed yet */
+  uint16_t end;         /* END option of the options field, or the end of
+                           its last complete option. The end of the
+                           message until the options field is parsed */
+  uint16_t lastPad;     /* Last PAD before END, 0 if another option
+                           follows it */
+  bool     cookie;      /* Magic cookie found, not a BOOTP message */
+  bool     irregular;   /* Repeated tracked tags or an option running past
+                           the end of the options field */
+} DHCP_OPTION_INDEX;
+
+/* Slot of a tag in the index, DHCP_OPTION_INDEX_UNTRACKED if none */
+static inline DHCP_OPTION_INDEX_SLOT dhcp_option_index_slot(uint8_t tag)
+{
+    switch (tag) {
+    case DHCP_MSGTYPE:
+        return DHCP_OPTION_INDEX_MSGTYPE;
+    case DHCP_MAXMSGSIZE:
+        return DHCP_OPTION_INDEX_MAXMSGSIZE;
+    case DHCP_AGENT_OPTIONS:
+        return DHCP_OPTION_INDEX_AGENT;
+    default:
+        return DHCP_OPTION_INDEX_UNTRACKED;
+    }
+}
+
+/* Start the index of a DHCP message, without parsing its options. Options
+ * not indexed yet are looked up */
+static inline void dhcp_option_index_init(const struct dhcp_packet *dhcp,
+                                          uint32_t len,
+                                          DHCP_OPTION_INDEX *index)
+{
+    static const uint8_t cookie[MAGIC_LEN] = RFC1048_MAGIC;
+
+    memset(index, 0, sizeof *index);
+
+    /* If there's no cookie, it's a bootp packet without options */
+    if ((len < offsetof(struct dhcp_packet, options) + MAGIC_LEN) ||
+        (memcmp(dhcp->options, cookie, MAGIC_LEN) != 0))
+        return;
+
+    index->cookie = true;
+    index->end = len;
+}
+
+uint8_t *dhcp_option_index_lookup(struct dhcp_packet *dhcp,
+                                  const DHCP_OPTION_INDEX *index,
+                                  uint8_t tag);
+
+/* Option of a tag in the message, NULL if absent. The options field comes
+ * first, then the file and the sname fields if overloaded (RFC 2131) */
+static inline uint8_t *dhcp_option_index_find(struct dhcp_packet *dhcp,
+                                              const DHCP_OPTION_INDEX *index,
+                                              uint8_t tag)
+{
+    uint16_t offset = index->offset[dhcp_option_index_slot(tag)];
+
+    return offset ? (uint8_t *) dhcp + offset :
+                    dhcp_option_index_lookup(dhcp, index, tag);
+}
+
+/* Segments of the UDP payload of a request */
+#define DHCP_OPTION82_GATHER_IOV 4
+
+/* A request re-encoded with our relay agent information without moving
+ * any byte of the received options. The segments are the options ahead of
+ * a stripped agent option, the options behind it, the template of our
+ * option with END and the padding up to MINBOOTPLEN */
+typedef struct DHCP_OPTION82_GATHER {
+  struct iovec iov[DHCP_OPTION82_GATHER_IOV]; /* UDP payload segments */
+  uint32_t iovcnt;      /* Number of segments */
+  uint32_t length;      /* UDP payload length */
+} DHCP_OPTION82_GATHER;
+
 /* pseudo udp header for checksum computation */
 struct ps_udph {
   struct in_addr srcip;
@@ -190,26 +307,48 @@ struct ps_udph {
 };
 
 /* Function prototypes from dhcp_options.c */
-uint8_t * dhcpScanOpt(uint8_t *opt, uint8_t *optend,
-                      uint8_t tag, uint8_t *ovld_opt);
-uint8_t * dhcpPickupOpt(struct dhcp_packet *dhcp, int32_t len, uint8_t tag);
+void dhcp_option_index_build(const struct dhcp_packet *dhcp, uint32_t len,
+                             DHCP_OPTION_INDEX *index);
 int32_t dhcp_relay_get_option82_len(DHCP_RELAY_OPTION82_REMOTE_ID remote_id);
+void dhcp_relay_option82_template(DHCP_OPTION82_TEMPLATE *tmpl,
+                                  uint32_t ifIndex,
+                                  DHCP_RELAY_OPTION82_REMOTE_ID remote_id,
+                                  const void *remote);
 
 int32_t dhcp_relay_validate_agent_option(const uint8_t *buf, int32_t buflen,
-                               char* ifName, DHCP_OPTION_82_OPTIONS *pkt_info,
+                               uint32_t ifIndex, DHCP_OPTION_82_OPTIONS *pkt_info,
                                DHCP_RELAY_OPTION82_REMOTE_ID remote_id);
 
-OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt,
-                        DHCP_OPTION_82_OPTIONS *pkt_info, uint32_t ifIndex,
-                        char *ifName, IP_ADDRESS bootp_gw);
+/* Option 82 processing of one policy, remote-id and validation setting */
+typedef OPTION82_RESULT_t (*DHCP_RELAY_OPTION82_HANDLER)(void *pkt,
+                        DHCP_OPTION_INDEX *index,
+                        DHCP_OPTION_82_OPTIONS *pkt_info, uint32_t ifIndex);
+
+DHCP_RELAY_OPTION82_HANDLER
+dhcp_relay_option82_handler(const FEATURE_CONFIG *config);
+
+/* Option 82 encoding of a request into segments, of one policy and
+ * remote-id setting */
+typedef OPTION82_RESULT_t (*DHCP_RELAY_OPTION82_GATHER_HANDLER)(void *pkt,
+                        DHCP_OPTION_INDEX *index,
+                        const DHCP_OPTION_82_OPTIONS *pkt_info,
+                        DHCP_OPTION82_GATHER *gather);
+
+DHCP_RELAY_OPTION82_GATHER_HANDLER
+dhcp_relay_option82_gather_handler(const FEATURE_CONFIG *config);
+void dhcp_relay_option82_gather_all(void *pkt, DHCP_OPTION82_GATHER *gather);
 
 /*
  * Function prototypes from udpfwd_xmit.c
  */
-void udpfwd_relay_to_dhcp_server(void* pkt, int32_t size,
-                   struct in_pktinfo *pktInfo);
-void udpfwd_relay_to_dhcp_client(void* pkt, int32_t size,
-                                   struct in_pktinfo *pktInfo);
+struct UDPFWD_HANDLERS;
+void udpfwd_relay_to_dhcp_server(const struct UDPFWD_HANDLERS *handlers,
+                   void* pkt, int32_t size, struct in_pktinfo *pktInfo);
+void udpfwd_relay_to_dhcp_server_no_hops(
+                   const struct UDPFWD_HANDLERS *handlers,
+                   void* pkt, int32_t size, struct in_pktinfo *pktInfo);
+void udpfwd_relay_to_dhcp_client(const struct UDPFWD_HANDLERS *handlers,
+                   void* pkt, int32_t size, struct in_pktinfo *pktInfo);
 
 #endif /* FTR_DHCP_RELAY */
 
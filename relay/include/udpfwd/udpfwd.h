@@ -27,7 +27,10 @@
 #define UDPFWD_H 1
 
 #include "shash.h"
+#include "hmap.h"
+#include "uuid.h"
 #include "cmap.h"
+#include "ovs-rcu.h"
 #include "semaphore.h"
 #include "openvswitch/types.h"
 #include "openvswitch/vlog.h"
@@ -50,6 +53,8 @@
 #include <net/if.h>
 #include <assert.h>
 #include "udpfwd_common.h"
+#include "relay_pool.h"
+#include "relay_counter.h"
 
 typedef uint32_t IP_ADDRESS;     /* IP Address. */
 
@@ -60,6 +65,29 @@ typedef uint8_t MAC_ADDRESS[6];
 
 #define RECV_BUFFER_SIZE 9228 /* Jumbo frame size */
 
+/* Number of datagrams pulled from the socket per recvmmsg() call */
+#define UDPFWD_RX_BATCH_DEFAULT  32
+#define UDPFWD_RX_BATCH_MAX      256
+
+/* Buckets of the receive batch fill histogram (1, 2-3, 4-7 ... 256) */
+#define UDPFWD_RX_BATCH_HIST_SIZE 9
+
+/* Number of receive worker threads, each owns a shard of the traffic */
+#define UDPFWD_RX_WORKERS_DEFAULT 1
+#define UDPFWD_RX_WORKERS_MAX     16
+
+/* Servers configured on one interface, over all of its UDP ports */
+#define UDPFWD_INTF_SERVERS_DEFAULT 1024
+#define UDPFWD_INTF_SERVERS_MAX     65535
+
+/* TPACKET_V3 receive ring of a worker. A block holds 14 jumbo frames or a
+ * few hundred DHCP packets and is handed over to user space when full or
+ * after UDPFWD_TPACKET_RETIRE_MS */
+#define UDPFWD_TPACKET_BLOCK_SIZE  (1 << 17)
+#define UDPFWD_TPACKET_BLOCK_COUNT 32
+#define UDPFWD_TPACKET_FRAME_SIZE  2048
+#define UDPFWD_TPACKET_RETIRE_MS   2
+
 #define IDL_POLL_INTERVAL 5
 
 #define IP_ADDRESS_NULL   ((IP_ADDRESS)0L)
@@ -81,22 +109,44 @@ typedef uint8_t MAC_ADDRESS[6];
 #define STATS_UPDATE_DEFAULT_INTERVAL    5000
 
 #ifdef FTR_DHCP_RELAY
-/* structure needed for statistics counters */
+/* structure needed for statistics counters. A block of counters of one
+ * receive worker, see relay_counter.h */
 typedef struct DHCP_RELAY_PKT_COUNTER
 {
-    uint32_t    client_drops; /* number of dropped client requests */
-    uint32_t    client_valids; /* number of valid client requests */
-    uint32_t    serv_drops; /* number of dropped server responses */
-    uint32_t    serv_valids; /* number of valid server responses */
-    uint32_t    client_drops_with_option82; /* number of dropped client
-                                               requests with option 82 */
-    uint32_t    client_valids_with_option82; /* number of valid client
-                                                requests with option 82 */
-    uint32_t    serv_drops_with_option82; /* number of dropped server
-                                             responses with option 82 */
-    uint32_t    serv_valids_with_option82; /* number of valid server
-                                              responses with option 82 */
+    RELAY_COUNTER client_drops; /* number of dropped client requests */
+    RELAY_COUNTER client_valids; /* number of valid client requests */
+    RELAY_COUNTER serv_drops; /* number of dropped server responses */
+    RELAY_COUNTER serv_valids; /* number of valid server responses */
+    RELAY_COUNTER client_drops_with_option82; /* number of dropped client
+                                                 requests with option 82 */
+    RELAY_COUNTER client_valids_with_option82; /* number of valid client
+                                                  requests with option 82 */
+    RELAY_COUNTER serv_drops_with_option82; /* number of dropped server
+                                               responses with option 82 */
+    RELAY_COUNTER serv_valids_with_option82; /* number of valid server
+                                                responses with option 82 */
 } DHCP_RELAY_PKT_COUNTER;
+
+/* Statistics counters of an interface written by one receive worker, alone
+ * on its cache line so that workers never write the same line */
+typedef union DHCP_RELAY_PKT_COUNTER_SLOT
+{
+    DHCP_RELAY_PKT_COUNTER counters;
+    uint8_t pad[RELAY_POOL_CACHE_LINE];
+} DHCP_RELAY_PKT_COUNTER_SLOT;
+
+/* Relay agent information option with a circuit id and a MAC address
+ * remote id, the longest we add, followed by END */
+#define DHCP_OPTION82_TEMPLATE_LEN 17
+
+/* Relay agent information option we add to the requests of an interface,
+ * encoded when the interface or its configuration changes */
+typedef struct DHCP_OPTION82_TEMPLATE
+{
+    uint8_t len;    /* Length of the option, END excluded. 0 when there is
+                       no address to name */
+    uint8_t option[DHCP_OPTION82_TEMPLATE_LEN]; /* Option followed by END */
+} DHCP_OPTION82_TEMPLATE;
 #endif /* FTR_DHCP_RELAY */
 
 /* Pseudo header for udp checksum computation */
@@ -108,24 +158,91 @@ struct pseudoheader {
     u_int16_t length;
 };
 
-/* UDP checksum construct */
-struct csum_construct {
-    struct pseudoheader pshd;
-    struct udphdr udph;
-    char payload[RECV_BUFFER_SIZE];
+/* union to store socket ancillary data */
+union control_u {
+    struct cmsghdr align; /* this ensures alignment */
+    char control[CMSG_SPACE(sizeof(struct in_pktinfo))];
 };
 
+/* Receive ring. Each slot holds one datagram pulled by recvmmsg() */
+typedef struct UDPFWD_RX_RING
+{
+    uint32_t size;              /* Number of slots in the ring */
+    uint32_t filled;            /* Slots filled by the last batch, rearmed
+                                   before the next one */
+    struct mmsghdr *msgs;       /* recvmmsg() message vector */
+    struct iovec *iovs;         /* Per slot packet buffer descriptor */
+    union control_u *ctrls;     /* Per slot IP_PKTINFO control area */
+    struct sockaddr_in *addrs;  /* Per slot source address */
+    char *buffers;              /* size * RECV_BUFFER_SIZE packet buffers */
+} UDPFWD_RX_RING;
+
+/* Receive backends of the workers */
+typedef enum UDPFWD_RX_BACKEND
+{
+    UDPFWD_RX_BACKEND_SOCKET = 0, /* recvmmsg() on the raw UDP socket */
+    UDPFWD_RX_BACKEND_TPACKET,    /* TPACKET_V3 ring of a packet socket */
+    UDPFWD_RX_BACKEND_XDP,        /* AF_XDP sockets and the raw socket */
+} UDPFWD_RX_BACKEND;
+
+/* TPACKET_V3 receive ring. Packets are handled in place in the mapped
+ * blocks, a block goes back to the kernel once all of its packets are
+ * handled and the replies which point into it are sent */
+typedef struct UDPFWD_RX_TPACKET
+{
+    int32_t sockFd;             /* Packet socket, -1 when not used */
+    uint8_t *map;               /* Mapped ring */
+    size_t mapLen;              /* Length of the mapping */
+    uint32_t block;             /* Next block handed over to user space */
+} UDPFWD_RX_TPACKET;
+
+/* Receive batch fill statistics. Written by the receive worker only, read
+ * by the main thread */
+typedef struct UDPFWD_RX_BATCH_STATS
+{
+    RELAY_COUNTER batches;      /* recvmmsg() calls which returned packets */
+    RELAY_COUNTER packets;      /* Datagrams received */
+    RELAY_COUNTER full_batches; /* Batches which filled the whole ring */
+    RELAY_COUNTER max_fill;     /* Largest batch received */
+    RELAY_COUNTER fill_hist[UDPFWD_RX_BATCH_HIST_SIZE]; /* Fill histogram,
+                                           bucket n counts 2^n..2^(n+1)-1 */
+} UDPFWD_RX_BATCH_STATS;
+
+/* Receive worker. Every worker has its own raw socket whose BPF filter
+ * accepts one shard of the traffic, and its own receive buffers */
+typedef struct UDPFWD_RX_WORKER
+{
+    pthread_t thread;       /* Receiver thread handle */
+    uint32_t id;            /* Worker index, also the shard it accepts */
+    int32_t sockFd;         /* Socket to send/receive UDP packets */
+    int32_t rxFd;           /* Socket carrying the receive filter, sockFd
+                               or the packet socket of the TPACKET ring */
+    int32_t l2SockFd;       /* Packet socket for L2 client replies, -1 if
+                               L2 replies are disabled */
+    UDPFWD_RX_RING rx_ring; /* Buffers which are used to store udp packets,
+                               a single slot with TPACKET */
+    UDPFWD_RX_TPACKET tpacket; /* TPACKET_V3 receive ring */
+    UDPFWD_RX_BATCH_STATS rx_stats; /* Receive batch fill statistics */
+} UDPFWD_RX_WORKER;
+
 /* UDP Forwarder Control Block. */
 typedef struct UDPF_CTRL_CB
 {
-    int32_t udpSockFd;    /* Socket to send/receive UDP packets */
-    sem_t waitSem;        /* Semaphore for concurrent access protection */
     struct shash intfHashTable; /* interface hash table handle */
+    struct cmap fwdMap;   /* Forwarding snapshots keyed on ifindex */
+    OVSRCU_TYPE(struct UDPFWD_PORT_BITMAP *) portBitmap;
+                          /* Ports of interest */
+    OVSRCU_TYPE(struct UDPFWD_HANDLERS *) handlers;
+                          /* Packet handlers of the configuration */
     struct cmap serverHashMap;  /* server hash map handle */
+    struct hmap rowRefs;  /* Configuration rows keyed on their uuid */
     FEATURE_CONFIG feature_config;
-    char *rcvbuff; /* Buffer which is used to store udp packet */
+    uint32_t n_workers;   /* Number of receive workers */
+    UDPFWD_RX_BACKEND rx_backend; /* How the workers receive */
+    UDPFWD_RX_WORKER workers[UDPFWD_RX_WORKERS_MAX]; /* Receive workers */
+    bool l2_replies;      /* Send client replies as Ethernet frames */
+    uint32_t intf_servers_max; /* Servers allowed on an interface */
     int32_t stats_interval;    /* statistics refresh interval */
-    struct csum_construct udp_csum_construct; /* UDP checksum construct */
 } UDPFWD_CTRL_CB;
 
 /* Server Address structure. */
@@ -137,19 +254,87 @@ typedef struct UDPFWD_SERVER_T {
                             This field helps in deleting a server entry */
 } UDPFWD_SERVER_T;
 
-/* Interface Table Structure. */
+/* Server arrays of 4, 8 and 16 servers, the CLI limits, come from a pool
+ * with their index, larger ones from the heap */
+#define UDPFWD_ARRAY_POOLS     3
+#define UDPFWD_ARRAY_POOL_MIN  4
+
+/* Server array of N servers followed by its index, N a power of 2 */
+#define UDPFWD_SERVER_BLOCK(N) \
+            ((N) * sizeof(UDPFWD_SERVER_T *) + 2 * (N) * sizeof(uint32_t))
+
+/* Interface Table Structure. Owned by the main thread, the packet path
+ * only sees the forwarding snapshot and the statistics counters */
 typedef struct UDPFWD_INTERFACE_NODE_T
 {
   char  *portName; /* Name of the Interface */
-  uint8_t addrCount; /* Counts of configured servers */
-  UDPFWD_SERVER_T **serverArray; /* Pointer to the array server configs */
+  uint32_t addrCount; /* Counts of configured servers */
+  uint32_t addrMax; /* Allocated entries of serverArray */
+  UDPFWD_SERVER_T **serverArray; /* Configured servers, in configuration
+                                    order */
+  uint32_t *serverIndex; /* Open addressing index of serverArray on address
+                            and port, a slot holds the array position plus
+                            1, 0 when free. Allocated after serverArray */
+  uint32_t indexMask; /* Slots of serverIndex minus 1 */
   IP_ADDRESS bootp_gw; /* store bootp gateway IP address */
+  uint32_t ifIndex; /* Kernel interface index, 0 while unresolved */
+  struct UDPFWD_FWD_SNAPSHOT *fwdSnapshot; /* Published forwarding state */
+  bool dirty; /* Configuration changed since the last publish */
 #ifdef FTR_DHCP_RELAY
-  DHCP_RELAY_PKT_COUNTER dhcp_relay_pkt_counters; /* Counts of dhcp-relay
-                                                     statistics */
+  DHCP_RELAY_PKT_COUNTER_SLOT *pktCounters; /* Counts of dhcp-relay
+                            statistics, one slot per receive worker.
+                            Allocated apart so that the packet path never
+                            writes this node */
 #endif /* FTR_DHCP_RELAY */
 } UDPFWD_INTERFACE_NODE_T;
 
+/* Interface and UDP port configured by a DHCP-Relay or UDP-Bcast-Forwarder
+ * row. The columns of a deleted row are gone by the time it is reported,
+ * its configuration is withdrawn from this record */
+typedef struct UDPFWD_ROW_REF {
+  struct hmap_node hmap_node; /* hmap Node, hashed on uuid */
+  struct uuid uuid; /* OVSDB row */
+  char *portName; /* Name of the Interface */
+  uint16_t udp_port; /* UDP Port Number, DHCPS_PORT for DHCP-Relay rows */
+} UDPFWD_ROW_REF;
+
+/* Destinations of one UDP port in a forwarding snapshot */
+typedef struct UDPFWD_FWD_PORT {
+  uint16_t udp_port; /* UDP Port Number */
+  uint16_t count;    /* Number of servers of the port */
+  uint32_t first;    /* Index of the first server of the port */
+} UDPFWD_FWD_PORT;
+
+/* Forwarding snapshot of an interface. A snapshot is never modified once
+ * published in fwdMap. A configuration change publishes a new version and
+ * the old one is freed after an RCU grace period. The servers are grouped
+ * by UDP port, so that the destinations of a port are contiguous.
+ * The packet path only reads a snapshot. The fields it reads for every
+ * packet come first, in the snapshot's first cache line. The servers
+ * follow inline. */
+typedef struct UDPFWD_FWD_SNAPSHOT {
+  struct cmap_node cmap_node; /* cmap Node, hashed on ifIndex */
+  uint32_t ifIndex; /* Kernel interface index */
+  uint32_t portCount; /* Counts of distinct UDP ports */
+  UDPFWD_FWD_PORT *ports; /* Ports of the servers, sorted, allocated with
+                             the snapshot right after servers */
+  IP_ADDRESS bootp_gw; /* bootp gateway IP address */
+  uint32_t serverCount; /* Counts of configured servers */
+#ifdef FTR_DHCP_RELAY
+  DHCP_RELAY_PKT_COUNTER_SLOT *pktCounters; /* Statistics counters of the
+                                               interface */
+  DHCP_OPTION82_TEMPLATE bootpGwOption82; /* IP remote id option naming
+                                             bootp_gw, len 0 without one */
+#endif /* FTR_DHCP_RELAY */
+  IP_ADDRESS servers[]; /* Configured server addresses */
+} UDPFWD_FWD_SNAPSHOT;
+
+/* UDP ports with a consumer on any interface, one bit per port. Replaced
+ * as a whole when the configuration changes */
+typedef struct UDPFWD_PORT_BITMAP {
+  uint8_t bits[65536 / 8];
+} UDPFWD_PORT_BITMAP;
+
 typedef enum DB_OP_TYPE_t {
     TABLE_OP_INSERT = 1,
     TABLE_OP_DELETE,
@@ -157,12 +342,6 @@ typedef enum DB_OP_TYPE_t {
     TABLE_OP_MAX
 } TABLE_OP_TYPE_t;
 
-/* union to store socket ancillary data */
-union control_u {
-    struct cmsghdr align; /* this ensures alignment */
-    char control[CMSG_SPACE(sizeof(struct in_pktinfo))];
-};
-
 /* union to store pktinfo meta data */
 union packet_info {
     unsigned char *c;
@@ -174,28 +353,67 @@ union packet_info {
  */
 extern UDPFWD_CTRL_CB *udpfwd_ctrl_cb_p;
 
+/* Index of the receive worker running the calling thread, 0 elsewhere */
+extern __thread uint32_t udpfwd_worker_id;
+
+/* Socket of the calling receive worker */
+#define UDPFWD_WORKER_SOCK_FD \
+            (udpfwd_ctrl_cb_p->workers[udpfwd_worker_id].sockFd)
+
+/* Packet socket of the calling receive worker */
+#define UDPFWD_WORKER_L2_SOCK_FD \
+            (udpfwd_ctrl_cb_p->workers[udpfwd_worker_id].l2SockFd)
+
 /*
  * Function prototypes from udpfwd.c
  */
 extern bool udpfwd_init(void);
 extern void udpfwd_reconfigure(void);
+extern void udpfwd_run(void);
+extern void udpfwd_wait(void);
 extern void udpfwd_exit(void);
+extern void udpfwd_set_rx_batch_size(uint32_t batch_size);
+extern void udpfwd_set_rx_workers(uint32_t n_workers);
+extern void udpfwd_set_intf_servers_max(uint32_t max);
+extern void udpfwd_set_l2_replies(bool enable);
+extern bool udpfwd_set_rx_backend(const char *name);
+
+/*
+ * Function prototypes from udpfwd_recv.c
+ */
+bool udpfwd_rx_ring_init(UDPFWD_RX_RING *ring, uint32_t size);
+void udpfwd_rx_ring_destroy(UDPFWD_RX_RING *ring);
+bool udpfwd_rx_tpacket_init(UDPFWD_RX_TPACKET *tpacket, uint32_t shard,
+                            uint32_t n_shards);
+void udpfwd_rx_tpacket_destroy(UDPFWD_RX_TPACKET *tpacket);
+void udpfwd_rx_ip_packet(struct ip *iph, uint32_t caplen, uint32_t ifIndex,
+                         bool unicast);
+uint32_t udpfwd_rx_socket_batch(UDPFWD_RX_WORKER *worker, bool wait);
+void udpfwd_rx_batch_stats_update(UDPFWD_RX_BATCH_STATS *stats,
+                                  uint32_t count, bool full);
+void *udp_packet_recv(void *args);
 
 /*
  * Function prototypes from udpfwd_xmit.c
  */
 void udpfwd_forward_packet (void *pkt, uint16_t udp_dport, int32_t size,
                                  struct in_pktinfo *pktInfo);
+void udpfwd_xmit_flush(void);
 
 /*
  * Function prototypes form udpfwd_config.c
  */
+void udpfwd_handle_row_delete(const struct uuid *uuid);
 void udpfwd_handle_dhcp_relay_config_change(
-              const struct ovsrec_dhcp_relay *rec, uint32_t idl_seqno);
-void udpfwd_handle_dhcp_relay_row_delete(struct ovsdb_idl *idl);
-void udpfwd_handle_udp_bcast_forwarder_row_delete(struct ovsdb_idl *idl);
+              const struct ovsrec_dhcp_relay *rec);
 void udpfwd_handle_udp_bcast_forwarder_config_change(
               const struct ovsrec_udp_bcast_forwarder_server *rec);
 void refresh_dhcp_relay_stats(void);
+const UDPFWD_FWD_SNAPSHOT *udpfwd_get_fwd_snapshot(uint32_t ifIndex);
+const UDPFWD_FWD_PORT *udpfwd_get_fwd_port(
+              const UDPFWD_FWD_SNAPSHOT *snapshot, uint16_t udp_port);
+bool udpfwd_port_of_interest(uint16_t udp_port);
+void udpfwd_publish_interfaces(void);
+void udpfwd_resolve_interfaces(void);
 
 #endif /* udpfwd.h */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_fastpath.h
+ */
+
+/*
+ * This file has the definitions of the in-kernel UDP broadcast forwarding
+ * fast path. A TC ingress program on every interface with forward-protocol
+ * servers sends a copy of each limited broadcast datagram of a configured
+ * port to the servers of that port, then marks the datagram so that the
+ * raw sockets of the workers do not forward it a second time. Datagrams
+ * the program cannot handle are left unmarked and go to user space.
+ */
+
+#ifndef UDPFWD_FASTPATH_H
+#define UDPFWD_FASTPATH_H 1
+
+#ifdef FTR_UDP_BCAST_FWD
+#include "dynamic-string.h"
+#include "udpfwd.h"
+
+/* Bit of the packet mark set on the datagrams forwarded in the kernel */
+#define UDPFWD_FASTPATH_MARK          0x00100000
+
+/* Servers of one port on one interface, the program is unrolled for each.
+ * A port with more servers is left to user space */
+#define UDPFWD_FASTPATH_SERVERS_MAX   16
+
+/* Ports of one interface in the forwarding map, the others are left to
+ * user space */
+#define UDPFWD_FASTPATH_PORTS_MAX     16
+
+/* Interface and port pairs in the forwarding map */
+#define UDPFWD_FASTPATH_ENTRIES_MAX   4096
+
+/* Forwarding map key */
+typedef struct UDPFWD_FASTPATH_KEY
+{
+    uint32_t ifIndex;           /* Input interface */
+    uint16_t port;              /* UDP destination port, host order */
+    uint16_t pad;               /* Always 0 */
+} UDPFWD_FASTPATH_KEY;
+
+/* Forwarding map value. The counters are updated by the program */
+typedef struct UDPFWD_FASTPATH_ENTRY
+{
+    uint64_t packets;           /* Datagrams forwarded in the kernel */
+    uint64_t copies;            /* Copies sent to the servers */
+    uint64_t punts;             /* Datagrams left to user space */
+    uint32_t serverCount;       /* Number of servers */
+    IP_ADDRESS servers[UDPFWD_FASTPATH_SERVERS_MAX]; /* Server addresses */
+} UDPFWD_FASTPATH_ENTRY;
+
+/* Port installed in the forwarding map */
+typedef struct UDPFWD_FASTPATH_PORT
+{
+    uint16_t port;              /* UDP destination port */
+    uint32_t serverCount;       /* Number of servers */
+    IP_ADDRESS servers[UDPFWD_FASTPATH_SERVERS_MAX]; /* Server addresses */
+} UDPFWD_FASTPATH_PORT;
+
+/* Interface with the program attached */
+typedef struct UDPFWD_FASTPATH_INTF
+{
+    uint32_t ifIndex;           /* Interface index */
+    int32_t linkFd;             /* Link attaching the program */
+    bool seen;                  /* Still configured, during a sync */
+    uint32_t portCount;         /* Ports in the forwarding map */
+    UDPFWD_FASTPATH_PORT ports[UDPFWD_FASTPATH_PORTS_MAX]; /* Ports */
+} UDPFWD_FASTPATH_INTF;
+
+/* Fast path control block */
+typedef struct UDPFWD_FASTPATH
+{
+    bool enabled;               /* Requested on the command line */
+    int32_t progFd;             /* TC program */
+    int32_t mapFd;              /* Forwarding map */
+    uint32_t intfCount;         /* Interfaces with the program */
+    uint32_t intfMax;           /* Allocated interfaces */
+    UDPFWD_FASTPATH_INTF *intfs; /* Interfaces */
+    uint64_t addrSeq;           /* Address index of the last sync */
+    uint64_t attachFailures;    /* Interfaces the program did not attach to */
+} UDPFWD_FASTPATH;
+
+/* Main thread only */
+void udpfwd_fastpath_set_enabled(bool enable);
+bool udpfwd_fastpath_init(void);
+void udpfwd_fastpath_update(void);
+void udpfwd_fastpath_run(void);
+void udpfwd_fastpath_exit(void);
+void udpfwd_fastpath_dump(struct ds *ds, uint32_t ifIndex, uint16_t port);
+#endif /* FTR_UDP_BCAST_FWD */
+
+#endif /* udpfwd_fastpath.h */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_filter.h
+ */
+
+/*
+ * This file has the definitions of the receive socket filter. Every worker
+ * socket carries a kernel filter which only accepts the DHCP ports and the
+ * UDP ports of the configured servers, and of those only the shard owned
+ * by the worker. The filter is an eBPF program when the kernel allows it,
+ * which also counts the rejected datagrams, and a classic BPF program
+ * without the counter otherwise.
+ */
+
+#ifndef UDPFWD_FILTER_H
+#define UDPFWD_FILTER_H 1
+
+#include <linux/bpf.h>
+#include "dynamic-string.h"
+#include "udpfwd.h"
+
+/* Maximum number of distinct forwarded ports matched by the filter. Beyond
+ * that every UDP port is accepted and user space drops the extra ones */
+#define UDPFWD_FILTER_PORTS_MAX   64
+
+/* Receive filter control block */
+typedef struct UDPFWD_FILTER
+{
+    bool ebpf;                  /* eBPF programs are attached */
+    int32_t mapFd;              /* Rejected datagram counter map */
+    uint32_t skipMark;          /* Mark bits of datagrams to reject */
+    bool acceptAll;             /* Too many ports, accept every UDP port */
+    uint32_t portCount;         /* Number of forwarded ports */
+    uint16_t ports[UDPFWD_FILTER_PORTS_MAX]; /* Forwarded ports, sorted */
+    uint64_t updates;           /* Number of filter regenerations */
+} UDPFWD_FILTER;
+
+/* eBPF program generation, shared with the XDP program */
+int32_t udpfwd_bpf_sys(int32_t cmd, union bpf_attr *attr);
+void udpfwd_ebpf_emit(struct bpf_insn *insns, uint32_t *len, uint8_t code,
+                      uint8_t dst, uint8_t src, int16_t off, int32_t imm);
+
+bool udpfwd_filter_init(void);
+void udpfwd_filter_exit(void);
+bool udpfwd_filter_attach(int32_t sock, uint32_t shard, uint32_t n_shards);
+bool udpfwd_filter_attach_reject(int32_t sock);
+void udpfwd_filter_set_skip_mark(uint32_t mark);
+void udpfwd_filter_update(void);
+void udpfwd_filter_dump(struct ds *ds);
+
+#endif /* udpfwd_filter.h */
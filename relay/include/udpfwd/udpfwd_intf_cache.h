@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_intf_cache.h
+ */
+
+/*
+ * This file has the definitions of the interface address cache. The cache
+ * holds the IPv4 addresses, lowest IP address, MAC address and name of
+ * every kernel interface keyed by ifindex, with the relay agent
+ * information options naming them. It is kept current from
+ * RTNLGRP_LINK and RTNLGRP_IPV4_IFADDR netlink notifications by the main
+ * thread and read by the packet receiver thread without any syscall.
+ */
+
+#ifndef UDPFWD_INTF_CACHE_H
+#define UDPFWD_INTF_CACHE_H 1
+
+#include "cmap.h"
+#include "dynamic-string.h"
+#include "udpfwd.h"
+
+/* Interface cache entry. Entries are immutable once published, an update
+ * replaces the entry and the old one is freed after an RCU grace period */
+typedef struct UDPFWD_INTF_ENTRY
+{
+    struct cmap_node cmap_node; /* cmap Node, hashed on ifIndex */
+    struct cmap_node name_node; /* cmap Node, hashed on ifName */
+    uint32_t ifIndex;           /* Kernel interface index */
+    char ifName[IF_NAMESIZE];   /* Name of the interface */
+    MAC_ADDRESS mac;            /* MAC address of the interface */
+    IP_ADDRESS lowest_ip;       /* Lowest IPv4 address, 0 if none */
+#ifdef FTR_DHCP_RELAY
+    DHCP_OPTION82_TEMPLATE option82[REMOTE_ID_INVALID]; /* Our option 82
+                                   naming the interface, by remote-id type */
+#endif /* FTR_DHCP_RELAY */
+    uint32_t addrCount;         /* Number of IPv4 addresses */
+    IP_ADDRESS addrs[];         /* IPv4 addresses of the interface */
+} UDPFWD_INTF_ENTRY;
+
+/* Address index entry, maps a local IPv4 address to its interface */
+typedef struct UDPFWD_ADDR_ENTRY
+{
+    struct cmap_node cmap_node; /* cmap Node, hashed on ip */
+    IP_ADDRESS ip;              /* Local IPv4 address */
+    uint32_t ifIndex;           /* Interface owning the address */
+} UDPFWD_ADDR_ENTRY;
+
+/* Address index lookup counters, updated by the receiver thread only */
+typedef struct UDPFWD_ADDR_INDEX_STATS
+{
+    uint64_t hits;              /* Lookups which found an interface */
+    uint64_t misses;            /* Lookups for a non local address */
+} UDPFWD_ADDR_INDEX_STATS;
+
+/* Interface cache control block */
+typedef struct UDPFWD_INTF_CACHE
+{
+    int32_t nlSockFd;           /* Netlink socket for link/addr events */
+    struct cmap intfMap;        /* Interface entries keyed on ifIndex */
+    struct cmap nameMap;        /* Interface entries keyed on ifName */
+    bool linksChanged;          /* Interfaces added, removed or renamed */
+    struct cmap addrMap;        /* Address index keyed on IPv4 address */
+    uint64_t addrSeq;           /* Bumped on every address index change */
+    UDPFWD_ADDR_INDEX_STATS addrStats; /* Address index counters */
+} UDPFWD_INTF_CACHE;
+
+/* Cache maintenance, main thread only */
+bool udpfwd_intf_cache_init(void);
+bool udpfwd_intf_cache_run(void);
+void udpfwd_intf_cache_wait(void);
+void udpfwd_intf_cache_exit(void);
+uint64_t udpfwd_intf_cache_addr_seq(void);
+uint32_t udpfwd_intf_cache_addrs(IP_ADDRESS *addrs, uint32_t max);
+
+/* Lookups, safe from any RCU reader */
+const UDPFWD_INTF_ENTRY *udpfwd_intf_cache_lookup(uint32_t ifIndex);
+IP_ADDRESS udpfwd_intf_cache_lowest_ip(uint32_t ifIndex);
+bool udpfwd_intf_cache_ip_exists(uint32_t ifIndex, IP_ADDRESS ip);
+uint32_t udpfwd_intf_cache_ifindex_by_ip(IP_ADDRESS ip);
+uint32_t udpfwd_intf_cache_ifindex_by_name(const char *ifName);
+
+/* Address index dump for unixctl */
+void udpfwd_intf_cache_addr_index_dump(struct ds *ds);
+
+#endif /* udpfwd_intf_cache.h */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_neigh.h
+ */
+
+/*
+ * This file has the definitions of the client neighbor programming. Unicast
+ * DHCP replies need the client MAC address in the kernel neighbor table.
+ * Every receive worker keeps a cache of the entries it already programmed
+ * and sends the new ones with RTM_NEWNEIGH, in one netlink datagram per
+ * receive batch.
+ */
+
+#ifndef UDPFWD_NEIGH_H
+#define UDPFWD_NEIGH_H 1
+
+#include "dynamic-string.h"
+#include "udpfwd.h"
+
+/* Slots of the per worker neighbor cache, must be a power of 2 */
+#define UDPFWD_NEIGH_CACHE_SIZE   4096
+
+/* Neighbors programmed per netlink datagram */
+#define UDPFWD_NEIGH_BATCH_MAX    64
+
+/* Longest link layer address, size of the DHCP chaddr field */
+#define UDPFWD_NEIGH_LLADDR_MAX   16
+
+/* Neighbor cache entry. A slot holds the last neighbor hashed to it */
+typedef struct UDPFWD_NEIGH_ENTRY
+{
+    uint32_t ifIndex;           /* Interface of the neighbor, 0 if unused */
+    IP_ADDRESS ip;              /* Neighbor IPv4 address */
+    long long int expires;      /* time_msec() when the entry is rewritten */
+    uint8_t hlen;               /* Link layer address length */
+    uint8_t lladdr[UDPFWD_NEIGH_LLADDR_MAX]; /* Link layer address */
+} UDPFWD_NEIGH_ENTRY;
+
+/* Neighbor programming counters. Written by the receive worker only, read
+ * by the main thread */
+typedef struct UDPFWD_NEIGH_STATS
+{
+    RELAY_COUNTER skipped;      /* Updates already current in the kernel */
+    RELAY_COUNTER programmed;   /* RTM_NEWNEIGH messages sent */
+    RELAY_COUNTER datagrams;    /* Netlink datagrams sent */
+    RELAY_COUNTER errors;       /* Messages refused by the kernel */
+} UDPFWD_NEIGH_STATS;
+
+/* Neighbor programming state of a receive worker */
+typedef struct UDPFWD_NEIGH_WORKER
+{
+    int32_t nlSockFd;           /* Netlink socket of the worker */
+    uint32_t seq;               /* Sequence number of the next datagram */
+    uint32_t pendingCount;      /* Messages in the pending datagram */
+    uint32_t pendingLen;        /* Bytes in the pending datagram */
+    uint32_t pendingSlots[UDPFWD_NEIGH_BATCH_MAX]; /* Cache slot of each
+                                                      pending message */
+    UDPFWD_NEIGH_STATS stats;   /* Counters */
+    uint32_t buffer[UDPFWD_NEIGH_BATCH_MAX * 16]; /* Pending datagram */
+    UDPFWD_NEIGH_ENTRY cache[UDPFWD_NEIGH_CACHE_SIZE]; /* Programmed entries */
+} UDPFWD_NEIGH_WORKER;
+
+/* Setup, main thread only */
+bool udpfwd_neigh_init(uint32_t n_workers);
+void udpfwd_neigh_run(void);
+void udpfwd_neigh_exit(void);
+void udpfwd_neigh_dump(struct ds *ds);
+
+/* Neighbor programming, receive workers only */
+void udpfwd_neigh_update(uint32_t ifIndex, IP_ADDRESS ip,
+                         const uint8_t *lladdr, uint8_t hlen);
+void udpfwd_neigh_flush(void);
+
+#endif /* udpfwd_neigh.h */
@@ -19,8 +19,7 @@
 
 /*
  * This file has all the utility functions
- * related to DHCP relay functionality and also functions
- * to get ifIndex from IP address, get IpAddress from ifName.
+ * related to DHCP relay functionality.
  */
 
 #ifndef UDPFWD_UTIL_H
@@ -34,17 +33,39 @@
 
 #define MAX_UINT32 4294967295U /*255.255.255.255.255 */
 
-/* Function to retrieve lowest IP address from interface name. */
-IP_ADDRESS getLowestIpOnInterface(char *ifName);
+/* Inline a packet path template in each of its specializations */
+#define UDPFWD_ALWAYS_INLINE __attribute__((always_inline))
 
-/* Function to check if ip address exists on an interface. */
-bool ipExistsOnInterface(char *ifName, IP_ADDRESS ip);
+struct UDPFWD_HANDLERS;
 
-/* Function to retrieve interface index from IP address. */
-uint32_t getIfIndexfromIpAddress(IP_ADDRESS ip);
+/* Handler of DHCP messages */
+typedef void (*UDPFWD_RELAY_HANDLER)(const struct UDPFWD_HANDLERS *handlers,
+                                     void *pkt, int32_t size,
+                                     struct in_pktinfo *pktInfo);
 
-/* Function to retrieve mac address. */
-void getMacfromIfname(MAC_ADDRESS mac, char*ifName);
+/* Handler of the other UDP broadcasts */
+typedef void (*UDPFWD_FORWARD_HANDLER)(void *pkt, uint16_t udp_dport,
+                                       int32_t size,
+                                       struct in_pktinfo *pktInfo);
+
+/* Packet handlers of the global configuration. A new chain is selected on
+ * every global configuration change, so that the packet path runs the
+ * handlers without testing the feature configuration */
+typedef struct UDPFWD_HANDLERS
+{
+#ifdef FTR_DHCP_RELAY
+    UDPFWD_RELAY_HANDLER request; /* BOOTREQUEST from a client */
+    UDPFWD_RELAY_HANDLER reply;   /* BOOTREPLY from a server */
+    DHCP_RELAY_OPTION82_HANDLER option82; /* Option 82 processing */
+    DHCP_RELAY_OPTION82_GATHER_HANDLER option82Gather; /* Option 82
+                                                   encoding of requests */
+#endif /* FTR_DHCP_RELAY */
+#ifdef FTR_UDP_BCAST_FWD
+    UDPFWD_FORWARD_HANDLER forward; /* Forward-protocol datagrams */
+#endif /* FTR_UDP_BCAST_FWD */
+} UDPFWD_HANDLERS;
+
+void udpfwd_select_handlers(void);
 
 /* Set get routines for feature configuration */
 FEATURE_STATUS get_feature_status(uint16_t value, UDPFWD_FEATURE feature);
@@ -53,4 +74,72 @@ void set_feature_status(uint16_t *value, UDPFWD_FEATURE feature,
 /* Checksum computation function */
 uint16_t in_cksum(const uint16_t *addr, register int32_t len, uint16_t csum);
 
+/* UDP checksum engine, udpfwd_csum.c */
+void udpfwd_csum_init(void);
+bool udpfwd_csum_select(const char *name);
+uint32_t udpfwd_csum_partial(const void *buf, size_t len, uint32_t sum);
+uint32_t udpfwd_csum_partial_iov(const struct iovec *iov, size_t iovcnt,
+                                 uint32_t sum);
+uint16_t udpfwd_csum_fold(uint32_t sum);
+uint16_t udpfwd_udp_cksum_finish(const struct ip *iph,
+                                 const struct udphdr *udph,
+                                 uint32_t payload_sum);
+uint16_t udpfwd_udp_cksum(const struct ip *iph, size_t len);
+
+/*
+ * Incremental checksum update, RFC 1624 eqn. 3 : HC' = ~(~HC + ~m + m').
+ * Checksum and fields are taken as stored in the packet, the one's
+ * complement sum does not depend on the byte order.
+ */
+static inline uint16_t
+in_cksum_update16(uint16_t csum, uint16_t old, uint16_t new)
+{
+    uint32_t sum = (uint16_t) ~csum + (uint16_t) ~old + new;
+
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return ~sum;
+}
+
+static inline uint16_t
+in_cksum_update32(uint16_t csum, uint32_t old, uint32_t new)
+{
+    uint32_t sum = (uint16_t) ~csum + (uint16_t) ~(old >> 16) +
+                   (uint16_t) ~old + (new >> 16) + (new & 0xffff);
+
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return ~sum;
+}
+
+/* IP header field updates keeping ip_sum valid */
+static inline void udpfwd_ip_set_dst(struct ip *iph, IP_ADDRESS dst)
+{
+    iph->ip_sum = in_cksum_update32(iph->ip_sum, iph->ip_dst.s_addr, dst);
+    iph->ip_dst.s_addr = dst;
+}
+
+static inline void udpfwd_ip_set_src(struct ip *iph, IP_ADDRESS src)
+{
+    iph->ip_sum = in_cksum_update32(iph->ip_sum, iph->ip_src.s_addr, src);
+    iph->ip_src.s_addr = src;
+}
+
+/* len - total length in network byte order */
+static inline void udpfwd_ip_set_len(struct ip *iph, uint16_t len)
+{
+    iph->ip_sum = in_cksum_update16(iph->ip_sum, iph->ip_len, len);
+    iph->ip_len = len;
+}
+
+/* TTL shares its checksum word with the protocol */
+static inline void udpfwd_ip_dec_ttl(struct ip *iph)
+{
+    uint16_t old = htons((iph->ip_ttl << 8) | iph->ip_p);
+
+    iph->ip_ttl--;
+    iph->ip_sum = in_cksum_update16(iph->ip_sum, old,
+                                    htons((iph->ip_ttl << 8) | iph->ip_p));
+}
+
 #endif /* udpfwd_util.h */
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_xsk.h
+ */
+
+/*
+ * This file has the definitions of the AF_XDP receive backend. An XDP
+ * program on each listed interface redirects the forwarded UDP datagrams
+ * addressed to this host, or broadcast, to an AF_XDP socket of the queue
+ * they arrived on. The sockets of a worker share one UMEM, the packets are
+ * handled in place in its frames and DHCP client replies leave from the
+ * same frames on the TX ring. Everything else goes up the IP stack and
+ * reaches the raw socket of the worker as with the socket backend.
+ */
+
+#ifndef UDPFWD_XSK_H
+#define UDPFWD_XSK_H 1
+
+#include <linux/if_xdp.h>
+#include "dynamic-string.h"
+#include "udpfwd.h"
+
+/* UMEM of a worker. A frame holds a 1500 byte MTU packet with the XDP
+ * headroom, jumbo frames are not redirected */
+#define UDPFWD_XSK_FRAME_SIZE     2048
+#define UDPFWD_XSK_FRAME_COUNT    4096
+
+/* Ring sizes, must be powers of 2 */
+#define UDPFWD_XSK_RX_SIZE        512
+#define UDPFWD_XSK_TX_SIZE        512
+#define UDPFWD_XSK_FILL_SIZE      256
+#define UDPFWD_XSK_COMP_SIZE      512
+
+/* Descriptors handled per socket per receive batch */
+#define UDPFWD_XSK_BATCH          64
+
+/* Interfaces with an XDP program, and sockets of a worker */
+#define UDPFWD_XSK_INTF_MAX       8
+#define UDPFWD_XSK_SOCKETS_MAX    8
+
+/* Local addresses matched by the XDP program */
+#define UDPFWD_XSK_ADDRS_MAX      1024
+
+/* Mapped AF_XDP ring, producer and consumer are shared with the kernel */
+typedef struct UDPFWD_XSK_RING
+{
+    uint32_t *producer;         /* Producer index */
+    uint32_t *consumer;         /* Consumer index */
+    uint32_t *flags;            /* XDP_RING_NEED_WAKEUP */
+    void *descs;                /* struct xdp_desc or UMEM addresses */
+    uint32_t mask;              /* Ring size - 1 */
+    uint32_t cached;            /* Local copy of our index */
+    void *map;                  /* Mapped area */
+    size_t mapLen;              /* Mapped length */
+} UDPFWD_XSK_RING;
+
+/* AF_XDP socket bound to one queue of an interface */
+typedef struct UDPFWD_XSK_SOCKET
+{
+    int32_t fd;                 /* AF_XDP socket */
+    uint32_t ifIndex;           /* Interface of the queue */
+    uint32_t queue;             /* Queue index */
+    UDPFWD_XSK_RING rx;         /* Received frames */
+    UDPFWD_XSK_RING tx;         /* Frames to send */
+    UDPFWD_XSK_RING fill;       /* Free frames given to the kernel */
+    UDPFWD_XSK_RING comp;       /* Sent frames given back */
+    uint32_t txPending;         /* Descriptors not yet published */
+} UDPFWD_XSK_SOCKET;
+
+/* AF_XDP counters of a worker */
+typedef struct UDPFWD_XSK_STATS
+{
+    uint64_t rxPackets;         /* Frames received */
+    uint64_t txPackets;         /* Frames sent from the TX ring */
+    uint64_t txCopies;          /* Frames copied into the UMEM to be sent */
+    uint64_t txRingFull;        /* Replies left to the packet socket */
+    uint64_t noFrames;          /* Fill ring left short of free frames */
+} UDPFWD_XSK_STATS;
+
+/* AF_XDP state of a receive worker, only touched by that worker */
+typedef struct UDPFWD_XSK_WORKER
+{
+    uint8_t *umem;              /* Frame area shared by the sockets */
+    size_t umemLen;             /* Length of the frame area */
+    uint32_t sockCount;         /* Number of sockets */
+    UDPFWD_XSK_SOCKET socks[UDPFWD_XSK_SOCKETS_MAX]; /* Sockets */
+    uint32_t freeCount;         /* Frames owned by user space and free */
+    uint64_t freeFrames[UDPFWD_XSK_FRAME_COUNT]; /* Free frame addresses */
+    uint32_t rxCount;           /* Frames of the current receive batch */
+    uint64_t rxFrames[UDPFWD_XSK_SOCKETS_MAX * UDPFWD_XSK_BATCH];
+                                /* Addresses of those frames */
+    bool txHeld[UDPFWD_XSK_FRAME_COUNT]; /* Frame is on a TX ring */
+    uint32_t txInFlight;        /* Frames on TX rings */
+    UDPFWD_XSK_STATS stats;     /* Counters */
+} UDPFWD_XSK_WORKER;
+
+/* Interface with the XDP program attached */
+typedef struct UDPFWD_XSK_INTF
+{
+    char ifName[IF_NAMESIZE];   /* Interface name */
+    uint32_t ifIndex;           /* Interface index */
+    uint32_t queues;            /* Number of receive queues */
+    int32_t xskMapFd;           /* Sockets by queue index */
+    int32_t progFd;             /* XDP program */
+    int32_t linkFd;             /* Link attaching the program */
+} UDPFWD_XSK_INTF;
+
+/* AF_XDP control block */
+typedef struct UDPFWD_XSK
+{
+    bool generic;               /* Attach in generic (SKB) mode */
+    uint32_t intfCount;         /* Number of interfaces */
+    UDPFWD_XSK_INTF intfs[UDPFWD_XSK_INTF_MAX]; /* Interfaces */
+    int32_t portMapFd;          /* Redirected UDP ports, by port number */
+    int32_t addrMapFd;          /* Local IPv4 addresses */
+    uint8_t ports[65536 / 8];   /* Ports set in the port map */
+    uint64_t addrSeq;           /* Address index loaded in the map */
+    uint32_t addrCount;         /* Addresses in the map */
+} UDPFWD_XSK;
+
+/* Setup, main thread only */
+bool udpfwd_xsk_set_interfaces(const char *list);
+void udpfwd_xsk_set_generic(bool enable);
+bool udpfwd_xsk_init(uint32_t n_workers);
+void udpfwd_xsk_update(void);
+void udpfwd_xsk_run(void);
+void udpfwd_xsk_exit(void);
+void udpfwd_xsk_dump(struct ds *ds);
+
+/* Receive workers only */
+void udpfwd_xsk_rx_loop(UDPFWD_RX_WORKER *worker);
+bool udpfwd_xsk_xmit(uint32_t ifIndex, void *pkt, int32_t size,
+                     const uint8_t *srcMac, const uint8_t *dstMac);
+void udpfwd_xsk_flush(void);
+
+#endif /* udpfwd_xsk.h */
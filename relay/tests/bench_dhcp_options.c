@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: bench_dhcp_options.c
+ *
+ */
+
+/*
+ * Times the DHCP option handling of a relayed message, in the order
+ * udpfwd_xmit.c runs it, on the option sets of common clients and
+ * servers:
+ * - DISCOVER and REQUEST from a client: option 82 encoding of the request
+ *   into segments, policy replace with a MAC remote-id.
+ * - ACK from a server carrying our option 82: option 82 validation and
+ *   strip, and the NAK check of the message type.
+ * The received message is restored before each run, as a new one would
+ * be received. Prints the best of BENCH_ROUNDS rounds in ns per message.
+ *
+ * Usage: bench_dhcp_options [iterations]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "udpfwd.h"
+#include "dhcp_relay.h"
+#include "udpfwd_intf_cache.h"
+#include "udpfwd_util.h"
+
+#define BENCH_ITERATIONS  200000  /* Messages per round, by default */
+#define BENCH_ROUNDS      25      /* Rounds, the fastest one is kept */
+#define BENCH_IFINDEX     7       /* Circuit id of our option 82 */
+
+/* Relayed message, as received */
+typedef struct BENCH_MSG {
+    const char *name;
+    uint8_t op;                   /* BOOTREQUEST or BOOTREPLY */
+    uint32_t len;                 /* IP datagram length */
+    uint8_t pkt[RECV_BUFFER_SIZE] __attribute__((aligned(64)));
+} BENCH_MSG;
+
+static const uint8_t bench_mac[MAC_HEADER_LENGTH] =
+                                    { 0x00, 0x50, 0x56, 0x11, 0x22, 0x33 };
+static DHCP_OPTION82_TEMPLATE bench_option82[REMOTE_ID_INVALID];
+
+/*
+ * Function      : udpfwd_intf_cache_ip_exists
+ * Responsiblity : Stand-in for the interface cache, every address is ours
+ * Parameters    : ifIndex - interface index
+ *                 ip - IP address
+ * Return        : true
+ */
+bool udpfwd_intf_cache_ip_exists(uint32_t ifIndex OVS_UNUSED,
+                                 IP_ADDRESS ip OVS_UNUSED)
+{
+    return true;
+}
+
+/*
+ * Function      : bench_msg_build
+ * Responsiblity : Build an IP/UDP/DHCP message with a set of options
+ * Parameters    : msg - message, filled
+ *                 name - name of the message
+ *                 op - BOOTREQUEST or BOOTREPLY
+ *                 options - options after the magic cookie, END included
+ *                 len - length of the options
+ * Return        : none
+ */
+static void bench_msg_build(BENCH_MSG *msg, const char *name, uint8_t op,
+                            const uint8_t *options, uint32_t len)
+{
+    static const uint8_t cookie[] = RFC1048_MAGIC;
+    struct ip *iph = (struct ip *) msg->pkt;
+    struct udphdr *udph = (struct udphdr *) (iph + 1);
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) (udph + 1);
+    uint32_t dhcp_len;
+
+    memset(msg, 0, sizeof *msg);
+    msg->name = name;
+    msg->op = op;
+
+    dhcp->op = op;
+    dhcp->htype = 1;
+    dhcp->hlen = MAC_HEADER_LENGTH;
+    dhcp->xid = htonl(0x3903f326);
+    memcpy(dhcp->chaddr, bench_mac, MAC_HEADER_LENGTH);
+    if (op == BOOTREPLY) {
+        dhcp->yiaddr.s_addr = htonl(0x0a000a64);
+        dhcp->giaddr.s_addr = htonl(0x0a000a01);
+    }
+    memcpy(dhcp->options, cookie, MAGIC_LEN);
+    memcpy(dhcp->options + MAGIC_LEN, options, len);
+
+    dhcp_len = offsetof(struct dhcp_packet, options) + MAGIC_LEN + len;
+    if (dhcp_len < MINBOOTPLEN)
+        dhcp_len = MINBOOTPLEN;
+
+    iph->ip_hl = 5;
+    iph->ip_v = 4;
+    iph->ip_ttl = 64;
+    iph->ip_p = IPPROTO_UDP;
+    msg->len = sizeof *iph + UDPHDR_LENGTH + dhcp_len;
+    iph->ip_len = htons(msg->len);
+    udph->uh_sport = htons(op == BOOTREQUEST ? DHCPC_PORT : DHCPS_PORT);
+    udph->uh_dport = htons(DHCPS_PORT);
+    udph->uh_ulen = htons(UDPHDR_LENGTH + dhcp_len);
+}
+
+/*
+ * Function      : bench_now
+ * Responsiblity : Read the monotonic clock
+ * Parameters    : none
+ * Return        : time in ns
+ */
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Function      : bench_relay
+ * Responsiblity : Run the option handling of a message, as udpfwd_xmit.c
+ * Parameters    : pkt - message, modified
+ *                 handler - option 82 handler
+ *                 gather_handler - option 82 encoder of requests
+ *                 option82_info - templates of our option 82
+ * Return        : option 82 result, plus one for a NAK
+ */
+static inline uint32_t
+bench_relay(uint8_t *pkt, DHCP_RELAY_OPTION82_HANDLER handler,
+            DHCP_RELAY_OPTION82_GATHER_HANDLER gather_handler,
+            DHCP_OPTION_82_OPTIONS *option82_info)
+{
+    struct ip *iph = (struct ip *) pkt;
+    struct udphdr *udph = (struct udphdr *) (iph + 1);
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) (udph + 1);
+    DHCP_OPTION_INDEX option_index;
+    DHCP_OPTION82_GATHER gather;
+    OPTION82_RESULT_t result;
+    uint8_t *option;
+
+    dhcp_option_index_init(dhcp, DHCP_PKTLEN(udph), &option_index);
+    if (dhcp->op == BOOTREQUEST) {
+        result = gather_handler(pkt, &option_index, option82_info, &gather);
+        if (option_index.irregular) {
+            result = handler(pkt, &option_index, option82_info,
+                             BENCH_IFINDEX);
+            dhcp_relay_option82_gather_all(pkt, &gather);
+        }
+        return result;
+    }
+
+    result = handler(pkt, &option_index, option82_info, BENCH_IFINDEX);
+    option = dhcp_option_index_find(dhcp, &option_index, DHCP_MSGTYPE);
+    return result + ((option != NULL) && (*OPTBODY(option) == DHCPNAK));
+}
+
+/*
+ * Function      : bench_run
+ * Responsiblity : Time the option handling of a message
+ * Parameters    : msg - message, as received
+ *                 config - option 82 configuration
+ *                 iterations - messages per round
+ * Return        : best time of a round, in ns per message
+ */
+static double bench_run(const BENCH_MSG *msg, const FEATURE_CONFIG *config,
+                        uint32_t iterations)
+{
+    DHCP_RELAY_OPTION82_HANDLER handler;
+    DHCP_RELAY_OPTION82_GATHER_HANDLER gather_handler;
+    DHCP_OPTION_82_OPTIONS option82_info;
+    static uint8_t pkt[RECV_BUFFER_SIZE] __attribute__((aligned(64)));
+    uint64_t start, best = UINT64_MAX, sink = 0;
+    uint32_t round, iter;
+
+    handler = dhcp_relay_option82_handler(config);
+    gather_handler = dhcp_relay_option82_gather_handler(config);
+
+    /* A message the relay would not edit times nothing */
+    memcpy(pkt, msg->pkt, msg->len);
+    memset(&option82_info, 0, sizeof(option82_info));
+    option82_info.option82 = bench_option82;
+    if (bench_relay(pkt, handler, gather_handler, &option82_info) != VALID) {
+        fprintf(stderr, "%s: not relayed with option 82\n", msg->name);
+        exit(EXIT_FAILURE);
+    }
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        start = bench_now();
+        for (iter = 0; iter < iterations; iter++) {
+            memcpy(pkt, msg->pkt, msg->len);
+            memset(&option82_info, 0, sizeof(option82_info));
+            option82_info.option82 = bench_option82;
+            sink += bench_relay(pkt, handler, gather_handler,
+                                &option82_info);
+        }
+        start = bench_now() - start;
+        if (start < best)
+            best = start;
+    }
+
+    /* Keep the results alive */
+    if (sink == UINT64_MAX)
+        printf("%"PRIu64"\n", sink);
+
+    return (double) best / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    /* Windows 10 client */
+    static const uint8_t discover[] = {
+        53, 1, DHCPDISCOVER,
+        61, 7, 1, 0x00, 0x50, 0x56, 0x11, 0x22, 0x33,
+        50, 4, 10, 0, 10, 100,
+        12, 8, 'D', 'E', 'S', 'K', 'T', 'O', 'P', '1',
+        60, 8, 'M', 'S', 'F', 'T', ' ', '5', '.', '0',
+        55, 14, 1, 3, 6, 15, 31, 33, 43, 44, 46, 47, 119, 121, 249, 252,
+        END
+    };
+    static const uint8_t request[] = {
+        53, 1, DHCPREQUEST,
+        57, 2, 0x05, 0xdc,
+        61, 7, 1, 0x00, 0x50, 0x56, 0x11, 0x22, 0x33,
+        50, 4, 10, 0, 10, 100,
+        54, 4, 10, 0, 20, 2,
+        12, 8, 'D', 'E', 'S', 'K', 'T', 'O', 'P', '1',
+        81, 19, 0, 0, 0, 'D', 'E', 'S', 'K', 'T', 'O', 'P', '1', '.',
+                'e', 'x', 'a', 'm', 'p', 'l', 'e',
+        60, 8, 'M', 'S', 'F', 'T', ' ', '5', '.', '0',
+        55, 14, 1, 3, 6, 15, 31, 33, 43, 44, 46, 47, 119, 121, 249, 252,
+        END
+    };
+    /* ISC server, our option 82 is appended at run time */
+    static const uint8_t ack[] = {
+        53, 1, DHCPACK,
+        54, 4, 10, 0, 20, 2,
+        51, 4, 0, 0, 0x0e, 0x10,
+        58, 4, 0, 0, 0x07, 0x08,
+        59, 4, 0, 0, 0x0c, 0x4e,
+        1, 4, 255, 255, 255, 0,
+        3, 4, 10, 0, 10, 1,
+        6, 8, 10, 0, 20, 53, 10, 0, 20, 54,
+        15, 11, 'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c', 'o', 'm',
+    };
+    static BENCH_MSG msgs[3];
+    uint8_t ack_options[sizeof(ack) + DHCP_OPTION82_TEMPLATE_LEN];
+    FEATURE_CONFIG config;
+    uint32_t iterations = BENCH_ITERATIONS, iter;
+    IP_ADDRESS ip = htonl(0x0a000a01);
+
+    if (argc > 1)
+        iterations = strtoul(argv[1], NULL, 0);
+
+    dhcp_relay_option82_template(&bench_option82[REMOTE_ID_MAC],
+                                 BENCH_IFINDEX, REMOTE_ID_MAC, bench_mac);
+    dhcp_relay_option82_template(&bench_option82[REMOTE_ID_IP],
+                                 BENCH_IFINDEX, REMOTE_ID_IP, &ip);
+
+    /* The server echoes our option 82 */
+    memcpy(ack_options, ack, sizeof(ack));
+    memcpy(ack_options + sizeof(ack), bench_option82[REMOTE_ID_MAC].option,
+           bench_option82[REMOTE_ID_MAC].len + 1);
+
+    bench_msg_build(&msgs[0], "DISCOVER", BOOTREQUEST, discover,
+                    sizeof(discover));
+    bench_msg_build(&msgs[1], "REQUEST", BOOTREQUEST, request,
+                    sizeof(request));
+    bench_msg_build(&msgs[2], "ACK", BOOTREPLY, ack_options,
+                    sizeof(ack) + bench_option82[REMOTE_ID_MAC].len + 1);
+
+    memset(&config, 0, sizeof(config));
+    set_feature_status(&config.config, DHCP_RELAY_OPTION82, ENABLE);
+    config.policy = REPLACE;
+    config.r_id = REMOTE_ID_MAC;
+
+    for (iter = 0; iter < ARRAY_SIZE(msgs); iter++) {
+        printf("%-8s : %6.1f ns/msg\n", msgs[iter].name,
+               bench_run(&msgs[iter], &config, iterations));
+    }
+
+    return EXIT_SUCCESS;
+}
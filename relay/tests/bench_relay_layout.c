@@ -0,0 +1,718 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: bench_relay_layout.c
+ *
+ */
+
+/*
+ * Compares the layouts of the per-interface state of the DHCP relay
+ * packet path:
+ * - old: the 32-bit counters of each receive worker are a set inline in
+ *   the interface node, next to the fields the main thread writes on a
+ *   reconfigure. The snapshot reaches them through its owner node.
+ * - new: the snapshot points to one DHCP_RELAY_PKT_COUNTER_SLOT per
+ *   worker, each on its own cache line, and the fields read for every
+ *   packet come first.
+ * Each worker thread relays client requests to random interfaces the way
+ * dhcp_relay_to_server() reads them: snapshot, port, bootp gateway,
+ * servers, then its own counters. Prints per layout the ns per request
+ * and the cache misses per request, counted with perf_event_open() when
+ * the host has a hardware PMU. Without one it prints the cache lines a
+ * request touches, the worker pairs which write a common counter line and
+ * the workers which write a line the main thread writes.
+ * The gain is the removal of line transfers between cores, so run it with
+ * one worker per core on a multi-core host.
+ *
+ * Usage: bench_relay_layout [workers] [interfaces] [iterations]
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "udpfwd.h"
+
+#define BENCH_ITERATIONS  1000000 /* Requests per worker and round */
+#define BENCH_INTERFACES  16      /* Interfaces relaying, by default */
+#define BENCH_ROUNDS      5       /* Rounds, the fastest one is kept */
+#define BENCH_SERVERS     2       /* DHCP servers of an interface */
+#define BENCH_LINES_MAX   64      /* Cache lines recorded for a count */
+
+/* Counters of a worker before the split, 32 bits wide */
+typedef struct BENCH_OLD_PKT_COUNTER
+{
+  uint32_t client_drops;
+  uint32_t client_valids;
+  uint32_t serv_drops;
+  uint32_t serv_valids;
+  uint32_t client_drops_with_option82;
+  uint32_t client_valids_with_option82;
+  uint32_t serv_drops_with_option82;
+  uint32_t serv_valids_with_option82;
+} BENCH_OLD_PKT_COUNTER;
+
+/* Interface node before the split, counters inline */
+typedef struct BENCH_OLD_INTERFACE_NODE
+{
+  char  *portName;
+  uint32_t addrCount;
+  uint32_t addrMax;
+  UDPFWD_SERVER_T **serverArray;
+  uint32_t *serverIndex;
+  uint32_t indexMask;
+  IP_ADDRESS bootp_gw;
+  uint32_t ifIndex;
+  struct BENCH_OLD_SNAPSHOT *fwdSnapshot;
+  bool dirty;
+  BENCH_OLD_PKT_COUNTER dhcp_relay_pkt_counters[UDPFWD_RX_WORKERS_MAX];
+} BENCH_OLD_INTERFACE_NODE;
+
+/* Forwarding snapshot before the split, in its old field order */
+typedef struct BENCH_OLD_SNAPSHOT
+{
+  struct cmap_node cmap_node;
+  uint32_t ifIndex;
+  BENCH_OLD_INTERFACE_NODE *intfNode;
+  IP_ADDRESS bootp_gw;
+  DHCP_OPTION82_TEMPLATE bootpGwOption82;
+  uint32_t serverCount;
+  uint32_t portCount;
+  UDPFWD_FWD_PORT *ports;
+  IP_ADDRESS servers[];
+} BENCH_OLD_SNAPSHOT;
+
+/* Cache lines touched by a set of fields */
+typedef struct BENCH_LINES
+{
+  uintptr_t line[BENCH_LINES_MAX];
+  uint32_t count;
+} BENCH_LINES;
+
+/* Layout under test */
+typedef struct BENCH_LAYOUT
+{
+  const char *name;
+  /* Allocate the state of interfaces relaying for workers */
+  void (*build)(uint32_t interfaces, uint32_t workers);
+  /* Relay a client request, as worker */
+  uint64_t (*request)(uint32_t intf, uint32_t worker);
+  /* Lines read or written by a request of worker on interface 0 */
+  void (*request_lines)(uint32_t worker, BENCH_LINES *lines);
+  /* Lines of the counters of worker on interface 0 */
+  void (*counter_lines)(uint32_t worker, BENCH_LINES *lines);
+  /* Lines of interface 0 written by the main thread on a reconfigure */
+  void (*main_lines)(BENCH_LINES *lines);
+} BENCH_LAYOUT;
+
+/* Receive worker of a round */
+typedef struct BENCH_WORKER
+{
+  pthread_t thread;
+  const BENCH_LAYOUT *layout;
+  uint32_t id;
+  uint64_t best;          /* Fastest round, in ns */
+  int64_t misses;         /* Cache misses of all rounds, -1 if not counted */
+  uint64_t sink;          /* Keeps the reads alive */
+} __attribute__((aligned(RELAY_POOL_CACHE_LINE))) BENCH_WORKER;
+
+static uint32_t bench_interfaces = BENCH_INTERFACES;
+static uint32_t bench_iterations = BENCH_ITERATIONS;
+static pthread_barrier_t bench_barrier;
+
+static BENCH_OLD_INTERFACE_NODE *bench_old_nodes;
+static BENCH_OLD_SNAPSHOT **bench_old_snapshots;
+static UDPFWD_INTERFACE_NODE_T *bench_new_nodes;
+static UDPFWD_FWD_SNAPSHOT **bench_new_snapshots;
+
+/*
+ * Function      : bench_now
+ * Responsiblity : Read the monotonic clock
+ * Parameters    : none
+ * Return        : time in ns
+ */
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Function      : bench_alloc
+ * Responsiblity : Allocate zeroed memory or exit
+ * Parameters    : align - alignment, 0 for the one of malloc()
+ *                 size - bytes
+ * Return        : memory
+ */
+static void *bench_alloc(size_t align, size_t size)
+{
+    void *mem = NULL;
+
+    if (align ? posix_memalign(&mem, align, size) : !(mem = malloc(size))) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(mem, 0, size);
+    return mem;
+}
+
+/*
+ * Function      : bench_perf_open
+ * Responsiblity : Count the cache misses of the calling thread
+ * Parameters    : none
+ * Return        : counter, disabled
+ *                 -1 - if the host counts no cache misses, errno is set
+ */
+static int bench_perf_open(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * Function      : bench_lines_add
+ * Responsiblity : Record the cache lines of a field
+ * Parameters    : lines - lines recorded
+ *                 field - start of the field
+ *                 len - length of the field
+ * Return        : none
+ */
+static void bench_lines_add(BENCH_LINES *lines, const void *field, size_t len)
+{
+    uintptr_t line = (uintptr_t) field / RELAY_POOL_CACHE_LINE;
+    uintptr_t last = ((uintptr_t) field + len - 1) / RELAY_POOL_CACHE_LINE;
+    uint32_t iter;
+
+    for (; line <= last; line++) {
+        for (iter = 0; iter < lines->count; iter++) {
+            if (lines->line[iter] == line)
+                break;
+        }
+        if ((iter == lines->count) && (lines->count < BENCH_LINES_MAX))
+            lines->line[lines->count++] = line;
+    }
+}
+
+/*
+ * Function      : bench_lines_shared
+ * Responsiblity : Check whether two sets of fields share a cache line
+ * Parameters    : a, b - lines recorded
+ * Return        : true - if a line is in both
+ *                 false - otherwise
+ */
+static bool bench_lines_shared(const BENCH_LINES *a, const BENCH_LINES *b)
+{
+    uint32_t iter, pos;
+
+    for (iter = 0; iter < a->count; iter++) {
+        for (pos = 0; pos < b->count; pos++) {
+            if (a->line[iter] == b->line[pos])
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Function      : bench_port_find
+ * Responsiblity : Lookup the DHCP servers of a snapshot, as
+ *                 udpfwd_get_fwd_port()
+ * Parameters    : ports - ports of the snapshot, sorted
+ *                 portCount - number of ports
+ * Return        : UDPFWD_FWD_PORT* - servers of the DHCP server port
+ */
+static inline const UDPFWD_FWD_PORT *
+bench_port_find(const UDPFWD_FWD_PORT *ports, uint32_t portCount)
+{
+    uint32_t low = 0, high = portCount, mid;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (ports[mid].udp_port == DHCPS_PORT)
+            return &ports[mid];
+        if (ports[mid].udp_port < DHCPS_PORT)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return &ports[0];
+}
+
+/*
+ * Function      : bench_ports_fill
+ * Responsiblity : Fill the servers and the port table of a snapshot
+ * Parameters    : servers - servers of the snapshot, filled
+ *                 ports - port table, filled
+ *                 intf - interface number
+ * Return        : none
+ */
+static void bench_ports_fill(IP_ADDRESS *servers, UDPFWD_FWD_PORT *ports,
+                             uint32_t intf)
+{
+    uint32_t iter;
+
+    for (iter = 0; iter < BENCH_SERVERS; iter++)
+        servers[iter] = htonl(0x0a140000 + (intf << 8) + iter + 1);
+
+    ports[0].udp_port = DHCPS_PORT;
+    ports[0].count = BENCH_SERVERS;
+    ports[0].first = 0;
+}
+
+/*
+ * Function      : bench_old_build
+ * Responsiblity : Allocate the interfaces with the old layout. The nodes
+ *                 come from a cache line aligned pool, the snapshots from
+ *                 malloc()
+ * Parameters    : interfaces - number of interfaces
+ *                 workers - number of receive workers
+ * Return        : none
+ */
+static void bench_old_build(uint32_t interfaces, uint32_t workers OVS_UNUSED)
+{
+    BENCH_OLD_SNAPSHOT *snapshot;
+    uint32_t intf;
+
+    bench_old_nodes = bench_alloc(RELAY_POOL_CACHE_LINE,
+                          interfaces * sizeof(BENCH_OLD_INTERFACE_NODE));
+    bench_old_snapshots = bench_alloc(0, interfaces * sizeof(snapshot));
+
+    for (intf = 0; intf < interfaces; intf++) {
+        snapshot = bench_alloc(0, sizeof(BENCH_OLD_SNAPSHOT) +
+                               BENCH_SERVERS * sizeof(IP_ADDRESS) +
+                               sizeof(UDPFWD_FWD_PORT));
+        snapshot->ifIndex = intf + 1;
+        snapshot->intfNode = &bench_old_nodes[intf];
+        snapshot->serverCount = BENCH_SERVERS;
+        snapshot->portCount = 1;
+        snapshot->ports = (UDPFWD_FWD_PORT *)
+                          &snapshot->servers[BENCH_SERVERS];
+        bench_ports_fill(snapshot->servers, snapshot->ports, intf);
+
+        bench_old_nodes[intf].ifIndex = intf + 1;
+        bench_old_nodes[intf].fwdSnapshot = snapshot;
+        bench_old_snapshots[intf] = snapshot;
+    }
+}
+
+/*
+ * Function      : bench_old_request
+ * Responsiblity : Relay a client request with the old layout
+ * Parameters    : intf - interface number
+ *                 worker - receive worker
+ * Return        : sum of the fields read
+ */
+static uint64_t bench_old_request(uint32_t intf, uint32_t worker)
+{
+    const BENCH_OLD_SNAPSHOT *snapshot = bench_old_snapshots[intf];
+    const UDPFWD_FWD_PORT *port;
+    uint64_t sum;
+    uint32_t iter;
+
+    port = bench_port_find(snapshot->ports, snapshot->portCount);
+    sum = snapshot->ifIndex + snapshot->bootpGwOption82.len +
+          snapshot->bootp_gw;
+    for (iter = 0; iter < port->count; iter++)
+        sum += snapshot->servers[port->first + iter];
+
+    snapshot->intfNode->dhcp_relay_pkt_counters[worker].client_valids +=
+                                                                port->count;
+    return sum;
+}
+
+/*
+ * Function      : bench_old_request_lines
+ * Responsiblity : Record the lines of an old layout request
+ * Parameters    : worker - receive worker
+ *                 lines - lines recorded
+ * Return        : none
+ */
+static void bench_old_request_lines(uint32_t worker, BENCH_LINES *lines)
+{
+    const BENCH_OLD_SNAPSHOT *snapshot = bench_old_snapshots[0];
+
+    bench_lines_add(lines, &snapshot->ifIndex, sizeof(snapshot->ifIndex));
+    bench_lines_add(lines, &snapshot->intfNode, sizeof(snapshot->intfNode));
+    bench_lines_add(lines, &snapshot->bootp_gw, sizeof(snapshot->bootp_gw));
+    bench_lines_add(lines, &snapshot->bootpGwOption82.len, 1);
+    bench_lines_add(lines, &snapshot->portCount,
+                    sizeof(snapshot->portCount));
+    bench_lines_add(lines, &snapshot->ports, sizeof(snapshot->ports));
+    bench_lines_add(lines, snapshot->ports, sizeof(UDPFWD_FWD_PORT));
+    bench_lines_add(lines, snapshot->servers,
+                    BENCH_SERVERS * sizeof(IP_ADDRESS));
+    bench_lines_add(lines,
+                    &snapshot->intfNode->dhcp_relay_pkt_counters[worker],
+                    sizeof(BENCH_OLD_PKT_COUNTER));
+}
+
+/*
+ * Function      : bench_old_counter_lines
+ * Responsiblity : Record the lines of the old layout counters of a worker
+ * Parameters    : worker - receive worker
+ *                 lines - lines recorded
+ * Return        : none
+ */
+static void bench_old_counter_lines(uint32_t worker, BENCH_LINES *lines)
+{
+    bench_lines_add(lines, &bench_old_nodes[0].dhcp_relay_pkt_counters[worker],
+                    sizeof(BENCH_OLD_PKT_COUNTER));
+}
+
+/*
+ * Function      : bench_old_main_lines
+ * Responsiblity : Record the lines of an old layout node written by the
+ *                 main thread
+ * Parameters    : lines - lines recorded
+ * Return        : none
+ */
+static void bench_old_main_lines(BENCH_LINES *lines)
+{
+    bench_lines_add(lines, &bench_old_nodes[0].fwdSnapshot,
+                    sizeof(bench_old_nodes[0].fwdSnapshot));
+    bench_lines_add(lines, &bench_old_nodes[0].dirty,
+                    sizeof(bench_old_nodes[0].dirty));
+}
+
+/*
+ * Function      : bench_new_build
+ * Responsiblity : Allocate the interfaces with the layout of
+ *                 udpfwd_config.c. The nodes come from a pool, the
+ *                 counters and the snapshots start on a cache line
+ * Parameters    : interfaces - number of interfaces
+ *                 workers - number of receive workers
+ * Return        : none
+ */
+static void bench_new_build(uint32_t interfaces, uint32_t workers)
+{
+    UDPFWD_FWD_SNAPSHOT *snapshot;
+    uint32_t intf;
+
+    bench_new_nodes = bench_alloc(16,
+                          interfaces * sizeof(UDPFWD_INTERFACE_NODE_T));
+    bench_new_snapshots = bench_alloc(0, interfaces * sizeof(snapshot));
+
+    for (intf = 0; intf < interfaces; intf++) {
+        bench_new_nodes[intf].pktCounters = bench_alloc(
+                          RELAY_POOL_CACHE_LINE,
+                          workers * sizeof(DHCP_RELAY_PKT_COUNTER_SLOT));
+
+        snapshot = bench_alloc(RELAY_POOL_CACHE_LINE,
+                               sizeof(UDPFWD_FWD_SNAPSHOT) +
+                               BENCH_SERVERS * sizeof(IP_ADDRESS) +
+                               sizeof(UDPFWD_FWD_PORT));
+        snapshot->ifIndex = intf + 1;
+        snapshot->pktCounters = bench_new_nodes[intf].pktCounters;
+        snapshot->serverCount = BENCH_SERVERS;
+        snapshot->portCount = 1;
+        snapshot->ports = (UDPFWD_FWD_PORT *)
+                          &snapshot->servers[BENCH_SERVERS];
+        bench_ports_fill(snapshot->servers, snapshot->ports, intf);
+
+        bench_new_nodes[intf].ifIndex = intf + 1;
+        bench_new_nodes[intf].fwdSnapshot = snapshot;
+        bench_new_snapshots[intf] = snapshot;
+    }
+}
+
+/*
+ * Function      : bench_new_request
+ * Responsiblity : Relay a client request with the new layout
+ * Parameters    : intf - interface number
+ *                 worker - receive worker
+ * Return        : sum of the fields read
+ */
+static uint64_t bench_new_request(uint32_t intf, uint32_t worker)
+{
+    const UDPFWD_FWD_SNAPSHOT *snapshot = bench_new_snapshots[intf];
+    const UDPFWD_FWD_PORT *port;
+    uint64_t sum;
+    uint32_t iter;
+
+    port = bench_port_find(snapshot->ports, snapshot->portCount);
+    sum = snapshot->ifIndex + snapshot->bootpGwOption82.len +
+          snapshot->bootp_gw;
+    for (iter = 0; iter < port->count; iter++)
+        sum += snapshot->servers[port->first + iter];
+
+    relay_counter_add(&snapshot->pktCounters[worker].counters.client_valids,
+                      port->count);
+    return sum;
+}
+
+/*
+ * Function      : bench_new_request_lines
+ * Responsiblity : Record the lines of a new layout request
+ * Parameters    : worker - receive worker
+ *                 lines - lines recorded
+ * Return        : none
+ */
+static void bench_new_request_lines(uint32_t worker, BENCH_LINES *lines)
+{
+    const UDPFWD_FWD_SNAPSHOT *snapshot = bench_new_snapshots[0];
+
+    bench_lines_add(lines, &snapshot->ifIndex, sizeof(snapshot->ifIndex));
+    bench_lines_add(lines, &snapshot->pktCounters,
+                    sizeof(snapshot->pktCounters));
+    bench_lines_add(lines, &snapshot->bootp_gw, sizeof(snapshot->bootp_gw));
+    bench_lines_add(lines, &snapshot->bootpGwOption82.len, 1);
+    bench_lines_add(lines, &snapshot->portCount,
+                    sizeof(snapshot->portCount));
+    bench_lines_add(lines, &snapshot->ports, sizeof(snapshot->ports));
+    bench_lines_add(lines, snapshot->ports, sizeof(UDPFWD_FWD_PORT));
+    bench_lines_add(lines, snapshot->servers,
+                    BENCH_SERVERS * sizeof(IP_ADDRESS));
+    bench_lines_add(lines, &snapshot->pktCounters[worker].counters,
+                    sizeof(DHCP_RELAY_PKT_COUNTER));
+}
+
+/*
+ * Function      : bench_new_counter_lines
+ * Responsiblity : Record the lines of the new layout counters of a worker
+ * Parameters    : worker - receive worker
+ *                 lines - lines recorded
+ * Return        : none
+ */
+static void bench_new_counter_lines(uint32_t worker, BENCH_LINES *lines)
+{
+    bench_lines_add(lines, &bench_new_nodes[0].pktCounters[worker].counters,
+                    sizeof(DHCP_RELAY_PKT_COUNTER));
+}
+
+/*
+ * Function      : bench_new_main_lines
+ * Responsiblity : Record the lines of a new layout node written by the
+ *                 main thread
+ * Parameters    : lines - lines recorded
+ * Return        : none
+ */
+static void bench_new_main_lines(BENCH_LINES *lines)
+{
+    bench_lines_add(lines, &bench_new_nodes[0].fwdSnapshot,
+                    sizeof(bench_new_nodes[0].fwdSnapshot));
+    bench_lines_add(lines, &bench_new_nodes[0].dirty,
+                    sizeof(bench_new_nodes[0].dirty));
+}
+
+static const BENCH_LAYOUT bench_layouts[] = {
+    { "old", bench_old_build, bench_old_request, bench_old_request_lines,
+      bench_old_counter_lines, bench_old_main_lines },
+    { "new", bench_new_build, bench_new_request, bench_new_request_lines,
+      bench_new_counter_lines, bench_new_main_lines },
+};
+
+/*
+ * Function      : bench_worker_run
+ * Responsiblity : Relay requests to random interfaces for BENCH_ROUNDS
+ *                 rounds, started together with the other workers
+ * Parameters    : arg - receive worker
+ * Return        : NULL
+ */
+static void *bench_worker_run(void *arg)
+{
+    BENCH_WORKER *worker = arg;
+    const BENCH_LAYOUT *layout = worker->layout;
+    uint32_t seed = 2463534242u + worker->id, round, iter;
+    uint64_t start, count;
+    int fd = bench_perf_open();
+
+    worker->best = UINT64_MAX;
+    worker->misses = (fd < 0) ? -1 : 0;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        pthread_barrier_wait(&bench_barrier);
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+
+        start = bench_now();
+        for (iter = 0; iter < bench_iterations; iter++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            worker->sink += layout->request(seed % bench_interfaces,
+                                            worker->id);
+        }
+        start = bench_now() - start;
+
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) == sizeof(count))
+                worker->misses += count;
+        }
+        if (start < worker->best)
+            worker->best = start;
+    }
+
+    if (fd >= 0)
+        close(fd);
+    return NULL;
+}
+
+/*
+ * Function      : bench_layout_run
+ * Responsiblity : Time a layout with workers relaying at once
+ * Parameters    : layout - layout under test
+ *                 workers - receive workers
+ *                 count - number of receive workers
+ * Return        : none
+ */
+static void bench_layout_run(const BENCH_LAYOUT *layout,
+                             BENCH_WORKER *workers, uint32_t count)
+{
+    uint64_t ns = 0, sink = 0;
+    int64_t misses = 0;
+    uint32_t iter;
+
+    layout->build(bench_interfaces, count);
+    pthread_barrier_init(&bench_barrier, NULL, count);
+
+    for (iter = 0; iter < count; iter++) {
+        memset(&workers[iter], 0, sizeof(workers[iter]));
+        workers[iter].layout = layout;
+        workers[iter].id = iter;
+        if (pthread_create(&workers[iter].thread, NULL, bench_worker_run,
+                           &workers[iter])) {
+            fprintf(stderr, "failed to start worker %u\n", iter);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (iter = 0; iter < count; iter++) {
+        pthread_join(workers[iter].thread, NULL);
+        ns += workers[iter].best;
+        sink += workers[iter].sink;
+        if ((misses < 0) || (workers[iter].misses < 0))
+            misses = -1;
+        else
+            misses += workers[iter].misses;
+    }
+    pthread_barrier_destroy(&bench_barrier);
+
+    printf("%s : %6.2f ns/request", layout->name,
+           (double) ns / count / bench_iterations);
+    if (misses >= 0)
+        printf(" %6.3f cache misses/request",
+               (double) misses / count / bench_iterations / BENCH_ROUNDS);
+    printf("\n");
+
+    /* Keep the results alive */
+    if (sink == UINT64_MAX)
+        printf("%"PRIu64"\n", sink);
+}
+
+/*
+ * Function      : bench_layout_lines
+ * Responsiblity : Print the cache lines of a layout shared by the workers
+ *                 and the main thread
+ * Parameters    : layout - layout under test, built
+ *                 count - number of receive workers
+ * Return        : none
+ */
+static void bench_layout_lines(const BENCH_LAYOUT *layout, uint32_t count)
+{
+    BENCH_LINES lines, other, mainLines;
+    uint32_t iter, pos, pairs = 0, shared = 0, withMain = 0;
+
+    memset(&mainLines, 0, sizeof(mainLines));
+    layout->main_lines(&mainLines);
+
+    for (iter = 0; iter < count; iter++) {
+        memset(&lines, 0, sizeof(lines));
+        layout->counter_lines(iter, &lines);
+        if (bench_lines_shared(&lines, &mainLines))
+            withMain++;
+
+        for (pos = iter + 1; pos < count; pos++) {
+            memset(&other, 0, sizeof(other));
+            layout->counter_lines(pos, &other);
+            pairs++;
+            shared += bench_lines_shared(&lines, &other);
+        }
+    }
+
+    memset(&lines, 0, sizeof(lines));
+    layout->request_lines(0, &lines);
+    printf("%s : %u lines/request, %u of %u worker pairs share a counter "
+           "line, %u workers share a line with the main thread\n",
+           layout->name, lines.count, shared, pairs, withMain);
+}
+
+int main(int argc, char *argv[])
+{
+    static BENCH_WORKER workers[UDPFWD_RX_WORKERS_MAX];
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t count = (cpus > 0) ? cpus : 1;
+    size_t iter;
+    int fd;
+
+    if (argc > 1)
+        count = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        bench_interfaces = strtoul(argv[2], NULL, 0);
+    if (argc > 3)
+        bench_iterations = strtoul(argv[3], NULL, 0);
+
+    if (count > UDPFWD_RX_WORKERS_MAX)
+        count = UDPFWD_RX_WORKERS_MAX;
+    if ((0 == count) || (0 == bench_interfaces) || (0 == bench_iterations)) {
+        fprintf(stderr, "usage: %s [workers] [interfaces] [iterations]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%u workers on %ld cpus, %u interfaces, %u requests per worker\n",
+           count, cpus, bench_interfaces, bench_iterations);
+
+    for (iter = 0; iter < ARRAY_SIZE(bench_layouts); iter++)
+        bench_layout_run(&bench_layouts[iter], workers, count);
+
+    /* Without a hardware PMU, show the line transfers the layouts cause */
+    fd = bench_perf_open();
+    if (fd >= 0) {
+        close(fd);
+        return EXIT_SUCCESS;
+    }
+
+    printf("cache misses not counted, perf_event_open: %s\n",
+           strerror(errno));
+    for (iter = 0; iter < ARRAY_SIZE(bench_layouts); iter++)
+        bench_layout_lines(&bench_layouts[iter], count);
+
+    return EXIT_SUCCESS;
+}
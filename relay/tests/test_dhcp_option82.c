@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: test_dhcp_option82.c
+ *
+ */
+
+/*
+ * Checks the option 82 encoding of requests into segments against the
+ * option 82 walk moving the options in place. The segments of every
+ * regular request must carry the message the walk builds, byte for byte,
+ * with the same result and the same IP and UDP lengths:
+ * - random requests with and without message type, maximum message size
+ *   and agent options, PADs, other options, with and without END and
+ *   with bytes past END.
+ * - every policy, remote-id and validation setting, with and without a
+ *   giaddr and a bootp gateway.
+ * Irregular requests, left to the walk by the encoder, are counted only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "udpfwd.h"
+#include "dhcp_relay.h"
+#include "udpfwd_intf_cache.h"
+#include "udpfwd_util.h"
+
+#define OPT82_TEST_ROUNDS     20000 /* Random requests */
+#define OPT82_TEST_OPTS_MAX   12    /* Options of a random request */
+#define OPT82_TEST_OPT_MAX    40    /* Length of a random option */
+#define OPT82_TEST_TAIL_MAX   8     /* Bytes past END */
+#define OPT82_TEST_IFINDEX    7     /* Circuit id of our option 82 */
+
+static const uint8_t opt82_test_mac[MAC_HEADER_LENGTH] =
+                                    { 0x00, 0x50, 0x56, 0x11, 0x22, 0x33 };
+static const uint16_t opt82_test_sizes[] = { 0, 300, 576, 1500, 0xffff };
+static DHCP_OPTION82_TEMPLATE opt82_test_option82[REMOTE_ID_INVALID];
+static DHCP_OPTION82_TEMPLATE opt82_test_bootp_gw;
+
+static uint8_t opt82_test_received[RECV_BUFFER_SIZE];
+static uint8_t opt82_test_walked[RECV_BUFFER_SIZE];
+static uint8_t opt82_test_gathered[RECV_BUFFER_SIZE];
+static uint8_t opt82_test_sent[RECV_BUFFER_SIZE];
+static uint32_t opt82_test_failures, opt82_test_irregular;
+
+/*
+ * Function      : udpfwd_intf_cache_ip_exists
+ * Responsiblity : Stand-in for the interface cache, every address is ours
+ * Parameters    : ifIndex - interface index
+ *                 ip - IP address
+ * Return        : true
+ */
+bool udpfwd_intf_cache_ip_exists(uint32_t ifIndex OVS_UNUSED,
+                                 IP_ADDRESS ip OVS_UNUSED)
+{
+    return true;
+}
+
+/*
+ * Function      : opt82_test_option
+ * Responsiblity : Append a random option to a request
+ * Parameters    : opt - where to append
+ *                 tag - option tag
+ *                 len - option length
+ * Return        : bytes appended
+ */
+static uint32_t opt82_test_option(uint8_t *opt, uint8_t tag, uint8_t len)
+{
+    uint32_t iter;
+
+    opt[0] = tag;
+    opt[1] = len;
+    for (iter = 0; iter < len; iter++)
+        opt[2 + iter] = random();
+
+    return 2 + len;
+}
+
+/*
+ * Function      : opt82_test_request
+ * Responsiblity : Build a random request in the received buffer
+ * Parameters    : none
+ * Return        : none
+ */
+static void opt82_test_request(void)
+{
+    static const uint8_t cookie[] = RFC1048_MAGIC;
+    struct ip *iph = (struct ip *) opt82_test_received;
+    struct udphdr *udph = (struct udphdr *) (iph + 1);
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) (udph + 1);
+    uint8_t *opt = dhcp->options + MAGIC_LEN;
+    uint32_t iter, count, len, kind;
+    uint8_t tracked = 0, tag;
+    uint16_t size;
+
+    memset(opt82_test_received, 0, sizeof(opt82_test_received));
+    dhcp->op = BOOTREQUEST;
+    dhcp->htype = 1;
+    dhcp->hlen = MAC_HEADER_LENGTH;
+    if (random() % 4)
+        dhcp->giaddr.s_addr = htonl(0x0a000a01);
+    memcpy(dhcp->chaddr, opt82_test_mac, MAC_HEADER_LENGTH);
+    memcpy(dhcp->options, cookie, MAGIC_LEN);
+
+    count = random() % (OPT82_TEST_OPTS_MAX + 1);
+    for (iter = 0; iter < count; iter++) {
+        /* Tracked options are seldom repeated, that request is irregular */
+        kind = random() % 8;
+        if (kind == 2)
+            kind = 1;
+        if ((kind >= 1) && (kind <= 4) && (tracked & (1 << kind)) &&
+            (random() % 16))
+            kind = 0;
+        tracked |= 1 << kind;
+
+        switch (kind) {
+        case 0:
+            len = 1 + random() % 3;
+            memset(opt, PAD, len);
+            opt += len;
+            break;
+        case 1:
+            opt += opt82_test_option(opt, DHCP_MSGTYPE, 1);
+            opt[-1] = 1 + random() % DHCPINFORM;
+            break;
+        case 3:
+            size = opt82_test_sizes[random() % ARRAY_SIZE(opt82_test_sizes)];
+            opt += opt82_test_option(opt, DHCP_MAXMSGSIZE,
+                                     (random() % 8) ? 2 : 1);
+            if (opt[-2] == DHCP_MAXMSGSIZE) {
+                opt[-2] = size >> 8;
+                opt[-1] = size;
+            }
+            break;
+        case 4:
+            opt += opt82_test_option(opt, DHCP_AGENT_OPTIONS,
+                                     random() % OPT82_TEST_OPT_MAX);
+            break;
+        default:
+            /* Any other tag, the overload option included */
+            tag = 1 + random() % 250;
+            if ((tag == DHCP_MSGTYPE) || (tag == DHCP_MAXMSGSIZE) ||
+                (tag == DHCP_AGENT_OPTIONS))
+                tag = OPT_OVERLOAD;
+            opt += opt82_test_option(opt, tag,
+                                     random() % OPT82_TEST_OPT_MAX);
+            break;
+        }
+    }
+
+    if (random() % 8) {
+        *opt++ = END;
+        len = random() % (OPT82_TEST_TAIL_MAX + 1);
+        for (iter = 0; iter < len; iter++)
+            *opt++ = (random() % 2) ? random() : PAD;
+    }
+
+    /* Some requests are cut short */
+    len = opt - (uint8_t *) dhcp;
+    if (!(random() % 16))
+        len -= random() % (len - offsetof(struct dhcp_packet, options));
+
+    iph->ip_hl = 5;
+    iph->ip_v = 4;
+    iph->ip_ttl = 64;
+    iph->ip_p = IPPROTO_UDP;
+    iph->ip_len = htons(sizeof *iph + UDPHDR_LENGTH + len);
+    udph->uh_sport = htons(DHCPC_PORT);
+    udph->uh_dport = htons(DHCPS_PORT);
+    udph->uh_ulen = htons(UDPHDR_LENGTH + len);
+}
+
+/*
+ * Function      : opt82_test_check
+ * Responsiblity : Encode the received request both ways and compare
+ * Parameters    : config - option 82 configuration
+ *                 pkt_info - templates of our option
+ * Return        : none
+ */
+static void opt82_test_check(const FEATURE_CONFIG *config,
+                             const DHCP_OPTION_82_OPTIONS *pkt_info)
+{
+    DHCP_RELAY_OPTION82_GATHER_HANDLER gather_handler;
+    DHCP_RELAY_OPTION82_HANDLER handler;
+    DHCP_OPTION_82_OPTIONS walk_info = *pkt_info;
+    OPTION82_RESULT_t walked, gathered;
+    DHCP_OPTION82_GATHER gather;
+    DHCP_OPTION_INDEX index;
+    struct ip *iph, *walk_iph;
+    struct udphdr *udph, *walk_udph;
+    uint32_t iter, len;
+    uint8_t *sent;
+
+    handler = dhcp_relay_option82_handler(config);
+    gather_handler = dhcp_relay_option82_gather_handler(config);
+
+    memcpy(opt82_test_gathered, opt82_test_received, RECV_BUFFER_SIZE);
+    iph = (struct ip *) opt82_test_gathered;
+    udph = (struct udphdr *) (iph + 1);
+    dhcp_option_index_init((struct dhcp_packet *) (udph + 1),
+                           DHCP_PKTLEN(udph), &index);
+    gathered = gather_handler(opt82_test_gathered, &index, pkt_info,
+                              &gather);
+    if (index.irregular) {
+        opt82_test_irregular++;
+        return;
+    }
+
+    memcpy(opt82_test_walked, opt82_test_received, RECV_BUFFER_SIZE);
+    walk_iph = (struct ip *) opt82_test_walked;
+    walk_udph = (struct udphdr *) (walk_iph + 1);
+    dhcp_option_index_init((struct dhcp_packet *) (walk_udph + 1),
+                           DHCP_PKTLEN(walk_udph), &index);
+    walked = handler(opt82_test_walked, &index, &walk_info,
+                     OPT82_TEST_IFINDEX);
+
+    if (walked != gathered) {
+        if (opt82_test_failures++ < 10)
+            fprintf(stderr, "policy %d remote-id %d: result %d, walk %d\n",
+                    config->policy, config->r_id, gathered, walked);
+        return;
+    }
+    if (walked == DROPPED)
+        return;
+
+    sent = opt82_test_sent;
+    for (iter = 0; iter < gather.iovcnt; iter++) {
+        memcpy(sent, gather.iov[iter].iov_base, gather.iov[iter].iov_len);
+        sent += gather.iov[iter].iov_len;
+    }
+    len = sent - opt82_test_sent;
+
+    if ((len != gather.length) ||
+        (iph->ip_len != walk_iph->ip_len) ||
+        (udph->uh_ulen != walk_udph->uh_ulen) ||
+        (len != DHCP_PKTLEN(walk_udph)) ||
+        memcmp(opt82_test_sent, walk_udph + 1, len)) {
+        if (opt82_test_failures++ < 10)
+            fprintf(stderr, "policy %d remote-id %d: %u bytes sent, "
+                    "walk %u\n", config->policy, config->r_id, len,
+                    DHCP_PKTLEN(walk_udph));
+    }
+}
+
+int main(void)
+{
+    static const DHCP_RELAY_OPTION82_POLICY policies[] = {
+        KEEP, DROP, REPLACE
+    };
+    DHCP_OPTION_82_OPTIONS pkt_info;
+    FEATURE_CONFIG config;
+    IP_ADDRESS ip = htonl(0x0a000a01), gw = htonl(0x0a001401);
+    uint32_t round, policy, remote_id, validate;
+
+    dhcp_relay_option82_template(&opt82_test_option82[REMOTE_ID_MAC],
+                                 OPT82_TEST_IFINDEX, REMOTE_ID_MAC,
+                                 opt82_test_mac);
+    dhcp_relay_option82_template(&opt82_test_option82[REMOTE_ID_IP],
+                                 OPT82_TEST_IFINDEX, REMOTE_ID_IP, &ip);
+    dhcp_relay_option82_template(&opt82_test_bootp_gw, OPT82_TEST_IFINDEX,
+                                 REMOTE_ID_IP, &gw);
+
+    srandom(1);
+    for (round = 0; round < OPT82_TEST_ROUNDS; round++) {
+        opt82_test_request();
+
+        memset(&pkt_info, 0, sizeof(pkt_info));
+        pkt_info.option82 = opt82_test_option82;
+        if (random() % 2)
+            pkt_info.bootpGwOption82 = &opt82_test_bootp_gw;
+
+        for (policy = 0; policy < ARRAY_SIZE(policies); policy++) {
+            for (remote_id = REMOTE_ID_IP; remote_id < REMOTE_ID_INVALID;
+                 remote_id++) {
+                for (validate = 0; validate < 2; validate++) {
+                    memset(&config, 0, sizeof(config));
+                    set_feature_status(&config.config, DHCP_RELAY_OPTION82,
+                                       ENABLE);
+                    if (validate)
+                        set_feature_status(&config.config,
+                                           DHCP_RELAY_OPTION82_VALIDATE,
+                                           ENABLE);
+                    config.policy = policies[policy];
+                    config.r_id = remote_id;
+                    opt82_test_check(&config, &pkt_info);
+                }
+            }
+        }
+    }
+
+    printf("option 82: %u requests, %u irregular left to the walk\n",
+           OPT82_TEST_ROUNDS, opt82_test_irregular / 12);
+
+    if (opt82_test_failures) {
+        fprintf(stderr, "%u option 82 mismatches\n", opt82_test_failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: test_dhcp_option_index.c
+ *
+ */
+
+/*
+ * Checks the DHCP option index of dhcp_options.c:
+ * - the scan of the options field: repeated and truncated options, the
+ *   trailing PADs and a missing END.
+ * - the lookup of the options not indexed, in the RFC 2131 order of the
+ *   options, file and sname fields of an overloaded message.
+ * - the index kept by the option 82 walk while it compacts the options,
+ *   including a move by less than the length of the option moved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "udpfwd.h"
+#include "dhcp_relay.h"
+#include "udpfwd_intf_cache.h"
+#include "udpfwd_util.h"
+
+#define INDEX_TEST_IFINDEX  7   /* Circuit id of our option 82 */
+
+/* Check a condition, counting and reporting a failure */
+#define INDEX_TEST_CHECK(COND) index_test_check((COND), #COND, __LINE__)
+
+static const uint8_t index_test_mac[MAC_HEADER_LENGTH] =
+                                    { 0x00, 0x50, 0x56, 0x11, 0x22, 0x33 };
+static DHCP_OPTION82_TEMPLATE index_test_option82[REMOTE_ID_INVALID];
+static uint8_t index_test_pkt[RECV_BUFFER_SIZE];
+static uint32_t index_test_failures;
+
+/*
+ * Function      : udpfwd_intf_cache_ip_exists
+ * Responsiblity : Stand-in for the interface cache, every address is ours
+ * Parameters    : ifIndex - interface index
+ *                 ip - IP address
+ * Return        : true
+ */
+bool udpfwd_intf_cache_ip_exists(uint32_t ifIndex OVS_UNUSED,
+                                 IP_ADDRESS ip OVS_UNUSED)
+{
+    return true;
+}
+
+/*
+ * Function      : index_test_check
+ * Responsiblity : Count and report a failed check
+ * Parameters    : ok - result of the check
+ *                 what - condition checked
+ *                 line - line of the check
+ * Return        : none
+ */
+static void index_test_check(bool ok, const char *what, int line)
+{
+    if (ok)
+        return;
+
+    index_test_failures++;
+    fprintf(stderr, "line %d: %s\n", line, what);
+}
+
+/*
+ * Function      : index_test_msg
+ * Responsiblity : Build an IP/UDP/DHCP message in the test buffer, without
+ *                 padding it to the minimum BOOTP length
+ * Parameters    : op - BOOTREQUEST or BOOTREPLY
+ *                 options - options after the magic cookie
+ *                 len - length of the options
+ *                 file - content of the file field, NULL if empty
+ *                 sname - content of the sname field, NULL if empty
+ * Return        : DHCP header of the message
+ */
+static struct dhcp_packet *index_test_msg(uint8_t op, const uint8_t *options,
+                                          uint32_t len, const uint8_t *file,
+                                          const uint8_t *sname)
+{
+    static const uint8_t cookie[] = RFC1048_MAGIC;
+    struct ip *iph = (struct ip *) index_test_pkt;
+    struct udphdr *udph = (struct udphdr *) (iph + 1);
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) (udph + 1);
+    uint32_t dhcp_len = offsetof(struct dhcp_packet, options) + MAGIC_LEN +
+                        len;
+
+    memset(index_test_pkt, 0, sizeof(index_test_pkt));
+    dhcp->op = op;
+    dhcp->htype = 1;
+    dhcp->hlen = MAC_HEADER_LENGTH;
+    dhcp->giaddr.s_addr = htonl(0x0a000a01);
+    memcpy(dhcp->chaddr, index_test_mac, MAC_HEADER_LENGTH);
+    if (file)
+        memcpy(dhcp->file, file, DHCP_BOOT_FILENAME_LEN);
+    if (sname)
+        memcpy(dhcp->sname, sname, DHCP_SERVER_HOSTNAME_LEN);
+    memcpy(dhcp->options, cookie, MAGIC_LEN);
+    memcpy(dhcp->options + MAGIC_LEN, options, len);
+
+    iph->ip_hl = 5;
+    iph->ip_v = 4;
+    iph->ip_ttl = 64;
+    iph->ip_p = IPPROTO_UDP;
+    iph->ip_len = htons(sizeof *iph + UDPHDR_LENGTH + dhcp_len);
+    udph->uh_sport = htons(op == BOOTREQUEST ? DHCPC_PORT : DHCPS_PORT);
+    udph->uh_dport = htons(DHCPS_PORT);
+    udph->uh_ulen = htons(UDPHDR_LENGTH + dhcp_len);
+
+    return dhcp;
+}
+
+/*
+ * Function      : index_test_offset
+ * Responsiblity : Offset from the DHCP header of a byte of the options
+ *                 field, after the magic cookie
+ * Parameters    : at - position in the options after the magic cookie
+ * Return        : offset
+ */
+static uint16_t index_test_offset(uint32_t at)
+{
+    return offsetof(struct dhcp_packet, options) + MAGIC_LEN + at;
+}
+
+/*
+ * Function      : index_test_init
+ * Responsiblity : Start the index of the message of the test buffer, the
+ *                 options not parsed yet
+ * Parameters    : dhcp - DHCP header of the message
+ *                 index - initialized option index
+ * Return        : none
+ */
+static void index_test_init(struct dhcp_packet *dhcp,
+                            DHCP_OPTION_INDEX *index)
+{
+    struct udphdr *udph = (struct udphdr *) dhcp - 1;
+
+    dhcp_option_index_init(dhcp, DHCP_PKTLEN(udph), index);
+}
+
+/*
+ * Function      : index_test_build
+ * Responsiblity : Index the message of the test buffer
+ * Parameters    : dhcp - DHCP header of the message
+ *                 index - filled with the option index
+ * Return        : none
+ */
+static void index_test_build(struct dhcp_packet *dhcp,
+                             DHCP_OPTION_INDEX *index)
+{
+    struct udphdr *udph = (struct udphdr *) dhcp - 1;
+
+    dhcp_option_index_build(dhcp, DHCP_PKTLEN(udph), index);
+}
+
+/*
+ * Function      : index_test_scan
+ * Responsiblity : Check the scan of the options field
+ * Parameters    : none
+ * Return        : none
+ */
+static void index_test_scan(void)
+{
+    static const uint8_t regular[] = {
+        53, 1, DHCPREQUEST,
+        12, 1, 'a',
+        57, 2, 0x05, 0xdc,
+        12, 1, 'b',                   /* Repeats of others do not matter */
+        END
+    };
+    static const uint8_t msgtypes[] = {
+        53, 1, DHCPREQUEST, 12, 1, 'a', 53, 1, DHCPREQUEST, END
+    };
+    static const uint8_t agents[] = {
+        53, 1, DHCPREQUEST, 82, 0, 12, 1, 'a', 82, 0, END
+    };
+    static const uint8_t sizes[] = {
+        57, 2, 0x05, 0xdc, 53, 1, DHCPREQUEST, 57, 2, 0x02, 0x40, END
+    };
+    static const uint8_t truncated[] = {
+        53, 1, DHCPREQUEST, 12, 10, 'a', 'b'
+    };
+    static const uint8_t tag_only[] = {
+        53, 1, DHCPREQUEST, 12
+    };
+    static const uint8_t pads[] = {
+        53, 1, DHCPREQUEST, PAD, 12, 1, 'a', PAD, PAD, END, 12, 1, 'b'
+    };
+    static const uint8_t inner_pad[] = {
+        53, 1, DHCPREQUEST, PAD, 12, 1, 'a', END
+    };
+    static const uint8_t no_end[] = {
+        53, 1, DHCPREQUEST, 12, 1, 'a'
+    };
+    static const uint8_t bootp[] = { 12, 1, 'a', END };
+    DHCP_OPTION_INDEX index;
+    struct dhcp_packet *dhcp;
+
+    dhcp = index_test_msg(BOOTREQUEST, regular, sizeof(regular), NULL, NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(index.cookie && !index.irregular);
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_MSGTYPE] ==
+                     index_test_offset(0));
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_MAXMSGSIZE] ==
+                     index_test_offset(6));
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_AGENT] == 0);
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_UNTRACKED] == 0);
+    INDEX_TEST_CHECK(index.end == index_test_offset(sizeof(regular) - 1));
+    INDEX_TEST_CHECK(index.lastPad == 0);
+
+    /* Repeated tracked tags are left to the walk */
+    dhcp = index_test_msg(BOOTREQUEST, msgtypes, sizeof(msgtypes), NULL,
+                          NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(index.irregular);
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_MSGTYPE] ==
+                     index_test_offset(0));
+
+    dhcp = index_test_msg(BOOTREQUEST, agents, sizeof(agents), NULL, NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(index.irregular);
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_AGENT] ==
+                     index_test_offset(3));
+
+    dhcp = index_test_msg(BOOTREQUEST, sizes, sizeof(sizes), NULL, NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(index.irregular);
+
+    /* The scan ends ahead of an option running past the message */
+    dhcp = index_test_msg(BOOTREQUEST, truncated, sizeof(truncated), NULL,
+                          NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(index.irregular);
+    INDEX_TEST_CHECK(index.end == index_test_offset(3));
+
+    dhcp = index_test_msg(BOOTREQUEST, tag_only, sizeof(tag_only), NULL,
+                          NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(index.irregular);
+    INDEX_TEST_CHECK(index.end == index_test_offset(3));
+
+    /* The last PAD before END, nothing after END is read */
+    dhcp = index_test_msg(BOOTREQUEST, pads, sizeof(pads), NULL, NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(!index.irregular);
+    INDEX_TEST_CHECK(index.lastPad == index_test_offset(8));
+    INDEX_TEST_CHECK(index.end == index_test_offset(9));
+
+    dhcp = index_test_msg(BOOTREQUEST, inner_pad, sizeof(inner_pad), NULL,
+                          NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(index.lastPad == 0);
+
+    /* Without END, the options field ends with the message */
+    dhcp = index_test_msg(BOOTREQUEST, no_end, sizeof(no_end), NULL, NULL);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(!index.irregular);
+    INDEX_TEST_CHECK(index.end == index_test_offset(sizeof(no_end)));
+
+    /* A BOOTP message has no options */
+    dhcp = index_test_msg(BOOTREQUEST, bootp, sizeof(bootp), NULL, NULL);
+    memset(dhcp->options, 0, MAGIC_LEN);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(!index.cookie);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, 12) == NULL);
+}
+
+/*
+ * Function      : index_test_lookup
+ * Responsiblity : Check the lookup of the options, overloaded or not
+ * Parameters    : none
+ * Return        : none
+ */
+static void index_test_lookup(void)
+{
+    static const uint8_t both[] = {
+        52, 1, BOTH_AREOPT, 54, 4, 10, 0, 20, 2, END
+    };
+    static const uint8_t sname_only[] = {
+        52, 1, SNAME_ISOPT, END
+    };
+    static const uint8_t none[] = {
+        54, 4, 10, 0, 20, 2, END
+    };
+    static const uint8_t ack[] = {
+        53, 1, DHCPACK, 52, 1, BOTH_AREOPT, END
+    };
+    static const uint8_t truncated[] = {
+        52, 1, BOTH_AREOPT, 12, 10, 'a'
+    };
+    uint8_t file[DHCP_BOOT_FILENAME_LEN] = {
+        PAD, 53, 1, DHCPNAK, 15, 3, 'a', '.', 'b', END, 12, 1, 'x'
+    };
+    uint8_t sname[DHCP_SERVER_HOSTNAME_LEN] = {
+        53, 1, DHCPOFFER, 12, 1, 's'
+    };
+    DHCP_OPTION_INDEX index;
+    struct dhcp_packet *dhcp;
+    uint8_t *opt;
+
+    /* An option running past the sname field */
+    sname[DHCP_SERVER_HOSTNAME_LEN - 2] = 61;
+    sname[DHCP_SERVER_HOSTNAME_LEN - 1] = 7;
+
+    /* The message type of an overloaded message: file, then sname */
+    dhcp = index_test_msg(BOOTREPLY, both, sizeof(both), file, sname);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(!index.irregular);
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_MSGTYPE] == 0);
+    opt = dhcp_option_index_find(dhcp, &index, DHCP_MSGTYPE);
+    INDEX_TEST_CHECK(opt == &dhcp->file[1]);
+    INDEX_TEST_CHECK((opt != NULL) && (*OPTBODY(opt) == DHCPNAK));
+
+    /* Options field first, then past END of the file field */
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, DHCP_SERVER_ID) ==
+                     &dhcp->options[MAGIC_LEN + 3]);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, 15) ==
+                     &dhcp->file[4]);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, 12) ==
+                     &dhcp->sname[3]);
+
+    /* An option running past the sname field is not found */
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, 61) == NULL);
+
+    /* Only the overloaded fields are looked at */
+    dhcp = index_test_msg(BOOTREPLY, sname_only, sizeof(sname_only), file,
+                          sname);
+    index_test_build(dhcp, &index);
+    opt = dhcp_option_index_find(dhcp, &index, DHCP_MSGTYPE);
+    INDEX_TEST_CHECK(opt == &dhcp->sname[0]);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, 15) == NULL);
+
+    dhcp = index_test_msg(BOOTREPLY, none, sizeof(none), file, sname);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, DHCP_MSGTYPE) ==
+                     NULL);
+
+    /* The options field comes first */
+    dhcp = index_test_msg(BOOTREPLY, ack, sizeof(ack), file, sname);
+    index_test_build(dhcp, &index);
+    opt = dhcp_option_index_find(dhcp, &index, DHCP_MSGTYPE);
+    INDEX_TEST_CHECK(opt == &dhcp->options[MAGIC_LEN]);
+    INDEX_TEST_CHECK((opt != NULL) && (*OPTBODY(opt) == DHCPACK));
+
+    /* Options not parsed yet are looked up the same */
+    index_test_init(dhcp, &index);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, DHCP_MSGTYPE) ==
+                     &dhcp->options[MAGIC_LEN]);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, 15) ==
+                     &dhcp->file[4]);
+
+    dhcp = index_test_msg(BOOTREPLY, both, sizeof(both), file, sname);
+    index_test_init(dhcp, &index);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, DHCP_MSGTYPE) ==
+                     &dhcp->file[1]);
+
+    /* The overload option is read ahead of a truncated option */
+    dhcp = index_test_msg(BOOTREPLY, truncated, sizeof(truncated), file,
+                          sname);
+    index_test_build(dhcp, &index);
+    INDEX_TEST_CHECK(dhcp_option_index_find(dhcp, &index, 12) ==
+                     &dhcp->sname[3]);
+}
+
+/*
+ * Function      : index_test_walk
+ * Responsiblity : Check the index kept by the option 82 walk
+ * Parameters    : none
+ * Return        : none
+ */
+static void index_test_walk(void)
+{
+    /* Our option 82 from the server, options moved up behind it */
+    uint8_t reply[3 + DHCP_OPTION82_TEMPLATE_LEN + 12] = {
+        53, 1, DHCPNAK
+    };
+    /* A short agent option, the option behind it moves by less than its
+     * own length */
+    static const uint8_t request[] = {
+        53, 1, DHCPREQUEST, 82, 0, 60, 8, 'M', 'S', 'F', 'T', ' ', '5', '.',
+        '0', END
+    };
+    static const uint8_t behind[] = {
+        57, 2, 0x05, 0xdc, 51, 4, 0, 0, 0x0e, 0x10, END
+    };
+    const DHCP_OPTION82_TEMPLATE *ours = &index_test_option82[REMOTE_ID_MAC];
+    DHCP_RELAY_OPTION82_HANDLER handler;
+    DHCP_OPTION_82_OPTIONS option82_info;
+    DHCP_OPTION_INDEX index;
+    struct dhcp_packet *dhcp;
+    FEATURE_CONFIG config;
+    uint8_t *opt;
+    uint32_t len;
+
+    memset(&config, 0, sizeof(config));
+    set_feature_status(&config.config, DHCP_RELAY_OPTION82, ENABLE);
+    config.policy = REPLACE;
+    config.r_id = REMOTE_ID_MAC;
+    handler = dhcp_relay_option82_handler(&config);
+
+    memset(&option82_info, 0, sizeof(option82_info));
+    option82_info.option82 = index_test_option82;
+
+    len = 3;
+    memcpy(reply + len, ours->option, ours->len);
+    len += ours->len;
+    memcpy(reply + len, behind, sizeof(behind));
+    len += sizeof(behind);
+
+    dhcp = index_test_msg(BOOTREPLY, reply, len, NULL, NULL);
+    index_test_init(dhcp, &index);
+    INDEX_TEST_CHECK(handler(index_test_pkt, &index, &option82_info,
+                             INDEX_TEST_IFINDEX) == VALID);
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_MSGTYPE] ==
+                     index_test_offset(0));
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_MAXMSGSIZE] ==
+                     index_test_offset(3));
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_AGENT] == 0);
+    INDEX_TEST_CHECK(index.end == index_test_offset(sizeof(behind) + 2));
+    INDEX_TEST_CHECK(!memcmp(&dhcp->options[MAGIC_LEN + 3], behind,
+                             sizeof(behind)));
+    opt = dhcp_option_index_find(dhcp, &index, 51);
+    INDEX_TEST_CHECK(opt == &dhcp->options[MAGIC_LEN + 7]);
+    opt = dhcp_option_index_find(dhcp, &index, DHCP_MSGTYPE);
+    INDEX_TEST_CHECK((opt != NULL) && (*OPTBODY(opt) == DHCPNAK));
+
+    /* The length of a moved option is read before it is overwritten */
+    dhcp = index_test_msg(BOOTREQUEST, request, sizeof(request), NULL, NULL);
+    index_test_init(dhcp, &index);
+    INDEX_TEST_CHECK(handler(index_test_pkt, &index, &option82_info,
+                             INDEX_TEST_IFINDEX) == VALID);
+    INDEX_TEST_CHECK(!memcmp(&dhcp->options[MAGIC_LEN], request, 3));
+    INDEX_TEST_CHECK(!memcmp(&dhcp->options[MAGIC_LEN + 3], &request[5],
+                             10));
+    INDEX_TEST_CHECK(!memcmp(&dhcp->options[MAGIC_LEN + 13], ours->option,
+                             ours->len + 1));
+    INDEX_TEST_CHECK(index.offset[DHCP_OPTION_INDEX_AGENT] ==
+                     index_test_offset(13));
+    INDEX_TEST_CHECK(index.end == index_test_offset(13 + ours->len));
+}
+
+int main(void)
+{
+    IP_ADDRESS ip = htonl(0x0a000a01);
+
+    dhcp_relay_option82_template(&index_test_option82[REMOTE_ID_MAC],
+                                 INDEX_TEST_IFINDEX, REMOTE_ID_MAC,
+                                 index_test_mac);
+    dhcp_relay_option82_template(&index_test_option82[REMOTE_ID_IP],
+                                 INDEX_TEST_IFINDEX, REMOTE_ID_IP, &ip);
+
+    index_test_scan();
+    index_test_lookup();
+    index_test_walk();
+
+    if (index_test_failures) {
+        fprintf(stderr, "%u option index checks failed\n",
+                index_test_failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("option index: checked\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,406 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: test_relay_pool.c
+ *
+ */
+
+/*
+ * Checks the object pools of relay_pool.c:
+ * - a freed object is handed out again, zeroed and aligned.
+ * - a pool grows by one RELAY_POOL_SLAB_SIZE slab once the objects of the
+ *   first are handed out, and an object larger than a slab gets its own.
+ * - the counters shown by relay/pools, for objects and name strings.
+ * - the slots of each UDPFWD_SERVER_BLOCK(N) size class, filled the way
+ *   udpfwd_config.c fills a server array and its index, do not overlap.
+ * - POOL_TEST_THREADS threads allocating and freeing at once leave the
+ *   pool consistent.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "udpfwd.h"
+#include "relay_pool.h"
+
+#define POOL_TEST_SLABS      3       /* Slabs filled per size class */
+#define POOL_TEST_THREADS    4       /* Threads sharing a pool */
+#define POOL_TEST_CYCLES     100000  /* Allocations per thread */
+#define POOL_TEST_HELD       8       /* Objects a thread holds at once */
+
+static uint32_t pool_test_failures;
+
+/*
+ * Function      : pool_test_check
+ * Responsiblity : Count and report a failed check
+ * Parameters    : ok - result of the check
+ *                 pool - pool checked
+ *                 what - check
+ * Return        : none
+ */
+static void pool_test_check(bool ok, const RELAY_POOL *pool,
+                            const char *what)
+{
+    if (ok)
+        return;
+
+    if (pool_test_failures++ < 10)
+        fprintf(stderr, "%s: %s\n", pool->name, what);
+}
+
+/*
+ * Function      : pool_test_per_slab
+ * Responsiblity : Compute the objects of a slab, as relay_pool_grow()
+ * Parameters    : pool - object pool
+ * Return        : objects of a slab
+ */
+static size_t pool_test_per_slab(const RELAY_POOL *pool)
+{
+    size_t header = RELAY_POOL_ROUND(sizeof(RELAY_POOL_SLAB), pool->align);
+
+    if (RELAY_POOL_SLAB_SIZE < (header + pool->size))
+        return 1;
+
+    return (RELAY_POOL_SLAB_SIZE - header) / pool->size;
+}
+
+/*
+ * Function      : pool_test_reuse
+ * Responsiblity : Check that a freed object is handed out again, zeroed
+ * Parameters    : none
+ * Return        : none
+ */
+static void pool_test_reuse(void)
+{
+    static RELAY_POOL pool = RELAY_POOL_INITIALIZER("test-reuse", 40, 16);
+    uint8_t *obj, *other;
+    size_t iter;
+
+    pool_test_check(pool.size == 48, &pool, "size not rounded to align");
+
+    obj = relay_pool_alloc(&pool);
+    pool_test_check(NULL != obj, &pool, "no object");
+    if (NULL == obj)
+        return;
+    pool_test_check(0 == ((uintptr_t) obj % pool.align), &pool,
+                    "object not aligned");
+
+    memset(obj, 0xa5, pool.size);
+    relay_pool_free(&pool, obj);
+
+    other = relay_pool_alloc(&pool);
+    pool_test_check(other == obj, &pool, "freed object not reused");
+    for (iter = 0; iter < pool.size; iter++) {
+        if (0 != other[iter]) {
+            pool_test_check(false, &pool, "reused object not zeroed");
+            break;
+        }
+    }
+
+    /* The last freed object comes back first */
+    obj = relay_pool_alloc(&pool);
+    relay_pool_free(&pool, other);
+    relay_pool_free(&pool, obj);
+    pool_test_check(relay_pool_alloc(&pool) == obj, &pool,
+                    "free list not last in first out");
+    pool_test_check(relay_pool_alloc(&pool) == other, &pool,
+                    "free list lost an object");
+    pool_test_check(1 == pool.slabCount, &pool, "reuse grew the pool");
+}
+
+/*
+ * Function      : pool_test_growth
+ * Responsiblity : Check that a pool grows by a slab when its free list is
+ *                 empty, and only then
+ * Parameters    : none
+ * Return        : none
+ */
+static void pool_test_growth(void)
+{
+    static RELAY_POOL pool =
+        RELAY_POOL_INITIALIZER("test-growth", 64, RELAY_POOL_CACHE_LINE);
+    static RELAY_POOL large =
+        RELAY_POOL_INITIALIZER("test-large", RELAY_POOL_SLAB_SIZE + 1, 16);
+    size_t perSlab = pool_test_per_slab(&pool), iter;
+    void *obj;
+
+    pool_test_check(63 == perSlab, &pool, "unexpected objects per slab");
+
+    for (iter = 0; iter < perSlab; iter++) {
+        obj = relay_pool_alloc(&pool);
+        pool_test_check(NULL != obj, &pool, "no object");
+        pool_test_check(0 == ((uintptr_t) obj % RELAY_POOL_CACHE_LINE),
+                        &pool, "object not on a cache line");
+    }
+    pool_test_check(1 == pool.slabCount, &pool, "first slab not filled");
+    pool_test_check(perSlab == pool.objects, &pool, "objects of a slab");
+    pool_test_check(NULL == pool.freeList, &pool, "first slab not empty");
+
+    obj = relay_pool_alloc(&pool);
+    pool_test_check(NULL != obj, &pool, "no object past the first slab");
+    pool_test_check(2 == pool.slabCount, &pool, "pool did not grow");
+    pool_test_check((2 * perSlab) == pool.objects, &pool,
+                    "objects of two slabs");
+    pool_test_check(NULL != pool.slabs->next, &pool,
+                    "slab list lost a slab");
+
+    /* One object per slab when it does not fit */
+    pool_test_check(1 == pool_test_per_slab(&large), &large,
+                    "objects of a large slab");
+    for (iter = 0; iter < 2; iter++) {
+        obj = relay_pool_alloc(&large);
+        pool_test_check(NULL != obj, &large, "no large object");
+        if (NULL != obj)
+            memset(obj, 0x5a, large.size);
+    }
+    pool_test_check(2 == large.slabCount, &large, "large slabs");
+    pool_test_check(2 == large.objects, &large, "large objects");
+}
+
+/*
+ * Function      : pool_test_stats
+ * Responsiblity : Check the counters of a pool and of a name pool, and
+ *                 that relay/pools lists the pools which grew
+ * Parameters    : none
+ * Return        : none
+ */
+static void pool_test_stats(void)
+{
+    static RELAY_POOL pool = RELAY_POOL_INITIALIZER("test-stats", 24, 8);
+    static RELAY_POOL unused = RELAY_POOL_INITIALIZER("test-unused", 24, 8);
+    char longName[RELAY_POOL_NAME_SIZE + 8];
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    void *objs[5];
+    char *name, *heapName;
+    size_t iter;
+
+    for (iter = 0; iter < ARRAY_SIZE(objs); iter++)
+        objs[iter] = relay_pool_alloc(&pool);
+    relay_pool_free(&pool, objs[0]);
+    relay_pool_free(&pool, objs[1]);
+    objs[0] = relay_pool_alloc(&pool);
+    relay_pool_free(&pool, NULL);
+
+    pool_test_check(6 == pool.allocs, &pool, "allocs");
+    pool_test_check(2 == pool.frees, &pool, "frees");
+    pool_test_check(4 == pool.inUse, &pool, "in use");
+    pool_test_check(5 == pool.highWater, &pool, "high water");
+    pool_test_check(0 == pool.failures, &pool, "failures");
+    pool_test_check(1 == pool.slabCount, &pool, "slabs");
+    pool_test_check(pool_test_per_slab(&pool) == pool.objects, &pool,
+                    "objects");
+
+    /* Short strings take a slot, long ones come from the heap */
+    memset(longName, 'x', sizeof(longName) - 1);
+    longName[sizeof(longName) - 1] = '\0';
+    name = relay_pool_strdup(&relay_name_pool, "1/1/1");
+    heapName = relay_pool_strdup(&relay_name_pool, longName);
+    pool_test_check((NULL != name) && !strcmp(name, "1/1/1"),
+                    &relay_name_pool, "short string copy");
+    pool_test_check((NULL != heapName) && !strcmp(heapName, longName),
+                    &relay_name_pool, "long string copy");
+    pool_test_check(1 == relay_name_pool.inUse, &relay_name_pool,
+                    "string slots in use");
+    pool_test_check(1 == relay_name_pool.heapInUse, &relay_name_pool,
+                    "strings on the heap");
+    relay_pool_strfree(&relay_name_pool, name);
+    relay_pool_strfree(&relay_name_pool, heapName);
+    pool_test_check(0 == relay_name_pool.inUse, &relay_name_pool,
+                    "string slots in use after free");
+    pool_test_check(0 == relay_name_pool.heapInUse, &relay_name_pool,
+                    "strings on the heap after free");
+
+    relay_pool_dump(&ds);
+    pool_test_check(NULL != strstr(ds_cstr(&ds), "test-stats "), &pool,
+                    "not listed by relay/pools");
+    pool_test_check(NULL != strstr(ds_cstr(&ds), "relay-names "),
+                    &relay_name_pool, "not listed by relay/pools");
+    pool_test_check(NULL == strstr(ds_cstr(&ds), "test-unused "), &unused,
+                    "listed by relay/pools before it grew");
+    ds_destroy(&ds);
+}
+
+/*
+ * Function      : pool_test_server_block
+ * Responsiblity : Fill the slots of a server array size class over
+ *                 POOL_TEST_SLABS slabs, then check that no slot was
+ *                 written by another
+ * Parameters    : pool - pool of the size class
+ *                 addrMax - servers of an array
+ * Return        : none
+ */
+static void pool_test_server_block(RELAY_POOL *pool, uint32_t addrMax)
+{
+    size_t count = POOL_TEST_SLABS * pool_test_per_slab(pool), iter, pos;
+    UDPFWD_SERVER_T ***arrays;
+    uint32_t *serverIndex;
+    bool intact;
+
+    pool_test_check(pool->size >= UDPFWD_SERVER_BLOCK(addrMax), pool,
+                    "slot smaller than a server block");
+
+    arrays = calloc(count, sizeof(*arrays));
+    if (NULL == arrays) {
+        pool_test_check(false, pool, "out of memory");
+        return;
+    }
+
+    /* A server array, then its index of 2 * addrMax slots */
+    for (iter = 0; iter < count; iter++) {
+        arrays[iter] = relay_pool_alloc(pool);
+        pool_test_check(NULL != arrays[iter], pool, "no server array");
+        if (NULL == arrays[iter])
+            break;
+        pool_test_check(0 == ((uintptr_t) arrays[iter] %
+                              RELAY_POOL_CACHE_LINE), pool,
+                        "server array not on a cache line");
+
+        serverIndex = (uint32_t *) &arrays[iter][addrMax];
+        for (pos = 0; pos < addrMax; pos++)
+            arrays[iter][pos] = (UDPFWD_SERVER_T *) (iter * addrMax + pos);
+        for (pos = 0; pos < (2 * addrMax); pos++)
+            serverIndex[pos] = iter ^ pos;
+    }
+    count = iter;
+
+    for (iter = 0; iter < count; iter++) {
+        serverIndex = (uint32_t *) &arrays[iter][addrMax];
+        intact = true;
+        for (pos = 0; pos < addrMax; pos++)
+            intact &= (arrays[iter][pos] ==
+                       (UDPFWD_SERVER_T *) (iter * addrMax + pos));
+        for (pos = 0; pos < (2 * addrMax); pos++)
+            intact &= (serverIndex[pos] == (iter ^ pos));
+        pool_test_check(intact, pool, "server block overwritten");
+    }
+
+    pool_test_check(POOL_TEST_SLABS == pool->slabCount, pool,
+                    "slabs of the size class");
+
+    for (iter = 0; iter < count; iter++)
+        relay_pool_free(pool, arrays[iter]);
+    pool_test_check(0 == pool->inUse, pool, "server arrays in use");
+    free(arrays);
+}
+
+/*
+ * Function      : pool_test_server_blocks
+ * Responsiblity : Check the size classes of the server arrays of
+ *                 udpfwd_config.c
+ * Parameters    : none
+ * Return        : none
+ */
+static void pool_test_server_blocks(void)
+{
+    static RELAY_POOL pools[UDPFWD_ARRAY_POOLS] = {
+        RELAY_POOL_INITIALIZER("test-server-arrays-4",
+                               UDPFWD_SERVER_BLOCK(4), RELAY_POOL_CACHE_LINE),
+        RELAY_POOL_INITIALIZER("test-server-arrays-8",
+                               UDPFWD_SERVER_BLOCK(8), RELAY_POOL_CACHE_LINE),
+        RELAY_POOL_INITIALIZER("test-server-arrays-16",
+                               UDPFWD_SERVER_BLOCK(16),
+                               RELAY_POOL_CACHE_LINE),
+    };
+    uint32_t iter;
+
+    for (iter = 0; iter < UDPFWD_ARRAY_POOLS; iter++)
+        pool_test_server_block(&pools[iter], UDPFWD_ARRAY_POOL_MIN << iter);
+}
+
+/*
+ * Function      : pool_test_thread
+ * Responsiblity : Allocate and free objects of a shared pool, each one
+ *                 marked with the thread while held
+ * Parameters    : arg - shared pool
+ * Return        : NULL if no object was shared with another thread
+ */
+static void *pool_test_thread(void *arg)
+{
+    RELAY_POOL *pool = arg;
+    uintptr_t self = (uintptr_t) pthread_self(), *held[POOL_TEST_HELD];
+    void *result = NULL;
+    uint32_t iter, slot;
+
+    memset(held, 0, sizeof(held));
+    for (iter = 0; iter < POOL_TEST_CYCLES; iter++) {
+        slot = iter % POOL_TEST_HELD;
+        if (NULL != held[slot]) {
+            if (held[slot][1] != self)
+                result = pool;
+            relay_pool_free(pool, held[slot]);
+        }
+        held[slot] = relay_pool_alloc(pool);
+        if (NULL != held[slot])
+            held[slot][1] = self;
+    }
+
+    for (slot = 0; slot < POOL_TEST_HELD; slot++)
+        relay_pool_free(pool, held[slot]);
+
+    return result;
+}
+
+/*
+ * Function      : pool_test_threads
+ * Responsiblity : Check a pool shared by POOL_TEST_THREADS threads
+ * Parameters    : none
+ * Return        : none
+ */
+static void pool_test_threads(void)
+{
+    static RELAY_POOL pool = RELAY_POOL_INITIALIZER("test-threads", 32, 16);
+    pthread_t threads[POOL_TEST_THREADS];
+    void *result;
+    uint32_t iter;
+
+    for (iter = 0; iter < POOL_TEST_THREADS; iter++) {
+        if (pthread_create(&threads[iter], NULL, pool_test_thread, &pool)) {
+            pool_test_check(false, &pool, "failed to start a thread");
+            return;
+        }
+    }
+
+    for (iter = 0; iter < POOL_TEST_THREADS; iter++) {
+        pthread_join(threads[iter], &result);
+        pool_test_check(NULL == result, &pool,
+                        "object handed to two threads");
+    }
+
+    pool_test_check(0 == pool.inUse, &pool, "objects in use");
+    pool_test_check(pool.allocs == pool.frees, &pool, "allocs and frees");
+    pool_test_check((POOL_TEST_THREADS * POOL_TEST_CYCLES) == pool.allocs,
+                    &pool, "allocations lost");
+    pool_test_check(pool.highWater <= (POOL_TEST_THREADS * POOL_TEST_HELD),
+                    &pool, "high water");
+}
+
+int main(void)
+{
+    pool_test_reuse();
+    pool_test_growth();
+    pool_test_stats();
+    pool_test_server_blocks();
+    pool_test_threads();
+
+    if (pool_test_failures) {
+        fprintf(stderr, "%u pool checks failed\n", pool_test_failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("Object pools: all checks passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: test_udpfwd_csum.c
+ *
+ */
+
+/*
+ * Checks every partial sum implementation of udpfwd_csum.c the CPU
+ * supports against the scalar one and against a byte by byte reference:
+ * - buffers of every length up to CSUM_TEST_LEN_MAX, at every alignment
+ *   of a cache line, with and without a previous partial sum.
+ * - gathered buffers split at random points into segments of odd and even
+ *   lengths, each segment at a random alignment of its own.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "udpfwd_util.h"
+
+#define CSUM_TEST_LEN_MAX     1600  /* Longer than a relayed datagram */
+#define CSUM_TEST_ALIGN_MAX   64    /* Alignments checked, a cache line */
+#define CSUM_TEST_IOV_MAX     8     /* Segments of a gathered buffer */
+#define CSUM_TEST_IOV_ROUNDS  20000 /* Gathered buffers per implementation */
+
+static const char *const csum_test_impls[] = { "scalar", "sse2", "avx2" };
+
+static uint8_t csum_test_buf[CSUM_TEST_LEN_MAX + CSUM_TEST_ALIGN_MAX];
+static uint8_t csum_test_segs[CSUM_TEST_IOV_MAX]
+                             [CSUM_TEST_LEN_MAX + CSUM_TEST_ALIGN_MAX];
+static uint32_t csum_test_failures;
+
+/*
+ * Function      : csum_test_reference
+ * Responsiblity : Checksum of a buffer, byte by byte in network order
+ * Parameters    : buf - data pointer
+ *                 len - data length
+ * Return        : checksum value, in the byte order of the buffer
+ */
+static uint16_t csum_test_reference(const uint8_t *buf, size_t len)
+{
+    uint64_t sum = 0;
+    size_t iter;
+
+    for (iter = 0; iter < len; iter++)
+        sum += (iter & 1) ? buf[iter] : (uint32_t) buf[iter] << 8;
+
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return htons((uint16_t) ~sum);
+}
+
+/*
+ * Function      : csum_test_check
+ * Responsiblity : Count and report a mismatch
+ * Parameters    : impl - implementation under test
+ *                 what - kind of check
+ *                 len - length of the buffer checked
+ *                 shape - alignment, or number of segments if gathered
+ *                 got, expected - checksums
+ * Return        : none
+ */
+static void csum_test_check(const char *impl, const char *what, size_t len,
+                            size_t shape, uint16_t got, uint16_t expected)
+{
+    if (got == expected)
+        return;
+
+    if (csum_test_failures++ < 10)
+        fprintf(stderr, "%s %s: len %zu shape %zu got 0x%04x "
+                "expected 0x%04x\n", impl, what, len, shape, got, expected);
+}
+
+/*
+ * Function      : csum_test_linear
+ * Responsiblity : Check the selected implementation over every length and
+ *                 alignment
+ * Parameters    : impl - implementation under test
+ * Return        : none
+ */
+static void csum_test_linear(const char *impl)
+{
+    const uint8_t *buf;
+    uint32_t scalar, sum;
+    size_t len, align;
+
+    for (align = 0; align < CSUM_TEST_ALIGN_MAX; align++) {
+        buf = csum_test_buf + align;
+        for (len = 0; len <= CSUM_TEST_LEN_MAX; len++) {
+            udpfwd_csum_select("scalar");
+            scalar = udpfwd_csum_partial(buf, len, 0xfffe0001);
+            udpfwd_csum_select(impl);
+
+            sum = udpfwd_csum_partial(buf, len, 0);
+            csum_test_check(impl, "reference", len, align,
+                            udpfwd_csum_fold(sum),
+                            csum_test_reference(buf, len));
+
+            /* A previous sum near the top of the accumulator carries */
+            sum = udpfwd_csum_partial(buf, len, 0xfffe0001);
+            csum_test_check(impl, "scalar", len, align,
+                            udpfwd_csum_fold(sum), udpfwd_csum_fold(scalar));
+        }
+    }
+}
+
+/*
+ * Function      : csum_test_cmp
+ * Responsiblity : Order cut points of a buffer
+ * Parameters    : a, b - cut points
+ * Return        : negative, zero or positive as a is before, at or after b
+ */
+static int csum_test_cmp(const void *a, const void *b)
+{
+    size_t x = *(const size_t *) a, y = *(const size_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Function      : csum_test_gather
+ * Responsiblity : Check the selected implementation over buffers split
+ *                 into segments, each segment copied at its own alignment
+ * Parameters    : impl - implementation under test
+ * Return        : none
+ */
+static void csum_test_gather(const char *impl)
+{
+    struct iovec iov[CSUM_TEST_IOV_MAX];
+    size_t cuts[CSUM_TEST_IOV_MAX + 1];
+    size_t len, iovcnt, iter, align;
+    uint32_t round, scalar, sum;
+
+    for (round = 0; round < CSUM_TEST_IOV_ROUNDS; round++) {
+        len = random() % (CSUM_TEST_LEN_MAX + 1);
+        iovcnt = 1 + random() % CSUM_TEST_IOV_MAX;
+
+        /* Sorted cut points, segments may be empty */
+        cuts[0] = 0;
+        for (iter = 1; iter < iovcnt; iter++)
+            cuts[iter] = random() % (len + 1);
+        qsort(&cuts[1], iovcnt - 1, sizeof(cuts[0]), csum_test_cmp);
+        cuts[iovcnt] = len;
+
+        for (iter = 0; iter < iovcnt; iter++) {
+            align = random() % CSUM_TEST_ALIGN_MAX;
+            iov[iter].iov_base = &csum_test_segs[iter][align];
+            iov[iter].iov_len = cuts[iter + 1] - cuts[iter];
+            memcpy(iov[iter].iov_base, csum_test_buf + cuts[iter],
+                   iov[iter].iov_len);
+        }
+
+        udpfwd_csum_select("scalar");
+        scalar = udpfwd_csum_partial(csum_test_buf, len, 0);
+        udpfwd_csum_select(impl);
+
+        sum = udpfwd_csum_partial_iov(iov, iovcnt, 0);
+        csum_test_check(impl, "gather", len, iovcnt, udpfwd_csum_fold(sum),
+                        udpfwd_csum_fold(scalar));
+    }
+}
+
+int main(void)
+{
+    size_t iter;
+
+    srandom(1);
+    for (iter = 0; iter < sizeof(csum_test_buf); iter++)
+        csum_test_buf[iter] = random();
+
+    for (iter = 0; iter < ARRAY_SIZE(csum_test_impls); iter++) {
+        if (!udpfwd_csum_select(csum_test_impls[iter])) {
+            printf("%s: not supported by the CPU, skipped\n",
+                   csum_test_impls[iter]);
+            continue;
+        }
+
+        csum_test_linear(csum_test_impls[iter]);
+        csum_test_gather(csum_test_impls[iter]);
+        printf("%s: checked\n", csum_test_impls[iter]);
+    }
+
+    if (csum_test_failures) {
+        fprintf(stderr, "%u checksum mismatches\n", csum_test_failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
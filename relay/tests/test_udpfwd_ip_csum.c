@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: test_udpfwd_ip_csum.c
+ *
+ */
+
+/*
+ * Checks the IP header setters of udpfwd_util.h, which keep ip_sum valid
+ * with incremental updates, against a full recompute with in_cksum():
+ * - IP_CSUM_TEST_UPDATES random destination, source, length and TTL
+ *   updates, chained on headers of every header length.
+ * - the edge values of each field: all zeros, all ones and a TTL that
+ *   wraps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "udpfwd_util.h"
+
+#define IP_CSUM_TEST_UPDATES  10000000 /* Random updates */
+#define IP_CSUM_TEST_CHAIN    64       /* Updates before a new header */
+
+/* Longest IP header, 15 words */
+static uint16_t ip_csum_test_hdr[30];
+static uint32_t ip_csum_test_failures;
+
+/*
+ * Function      : ip_csum_test_full
+ * Responsiblity : Recompute the checksum of a header with in_cksum()
+ * Parameters    : iph - IP header
+ * Return        : checksum, as stored in ip_sum
+ */
+static uint16_t ip_csum_test_full(const struct ip *iph)
+{
+    uint16_t hdr[ARRAY_SIZE(ip_csum_test_hdr)];
+    struct ip *copy = (struct ip *) hdr;
+
+    memcpy(hdr, iph, iph->ip_hl * 4);
+    copy->ip_sum = 0;
+    return in_cksum(hdr, iph->ip_hl * 4, 0);
+}
+
+/*
+ * Function      : ip_csum_test_check
+ * Responsiblity : Count and report a checksum that differs from a full
+ *                 recompute, or a header that does not verify
+ * Parameters    : iph - IP header after the update
+ *                 what - field updated
+ * Return        : none
+ */
+static void ip_csum_test_check(const struct ip *iph, const char *what)
+{
+    uint16_t expected = ip_csum_test_full(iph);
+
+    if ((iph->ip_sum == expected) &&
+        (in_cksum((const uint16_t *) iph, iph->ip_hl * 4, 0) == 0))
+        return;
+
+    if (ip_csum_test_failures++ < 10)
+        fprintf(stderr, "%s: hl %u got 0x%04x expected 0x%04x\n", what,
+                iph->ip_hl, iph->ip_sum, expected);
+}
+
+/*
+ * Function      : ip_csum_test_header
+ * Responsiblity : Fill the test header with random fields and a valid
+ *                 checksum
+ * Parameters    : none
+ * Return        : IP header
+ */
+static struct ip *ip_csum_test_header(void)
+{
+    struct ip *iph = (struct ip *) ip_csum_test_hdr;
+    size_t iter;
+
+    for (iter = 0; iter < ARRAY_SIZE(ip_csum_test_hdr); iter++)
+        ip_csum_test_hdr[iter] = random();
+
+    iph->ip_v = 4;
+    iph->ip_hl = 5 + random() % 11;
+    iph->ip_sum = ip_csum_test_full(iph);
+    return iph;
+}
+
+/*
+ * Function      : ip_csum_test_random
+ * Responsiblity : Chain random updates of random fields on random headers
+ * Parameters    : none
+ * Return        : none
+ */
+static void ip_csum_test_random(void)
+{
+    struct ip *iph = NULL;
+    uint32_t iter;
+
+    for (iter = 0; iter < IP_CSUM_TEST_UPDATES; iter++) {
+        if (0 == (iter % IP_CSUM_TEST_CHAIN))
+            iph = ip_csum_test_header();
+
+        switch (random() % 4) {
+        case 0:
+            udpfwd_ip_set_dst(iph, random());
+            ip_csum_test_check(iph, "dst");
+            break;
+        case 1:
+            udpfwd_ip_set_src(iph, random());
+            ip_csum_test_check(iph, "src");
+            break;
+        case 2:
+            udpfwd_ip_set_len(iph, random());
+            ip_csum_test_check(iph, "len");
+            break;
+        default:
+            udpfwd_ip_dec_ttl(iph);
+            ip_csum_test_check(iph, "ttl");
+            break;
+        }
+    }
+}
+
+/*
+ * Function      : ip_csum_test_edges
+ * Responsiblity : Update each field to and from all zeros and all ones
+ * Parameters    : none
+ * Return        : none
+ */
+static void ip_csum_test_edges(void)
+{
+    static const uint32_t values[] = { 0, 0xffffffff, 0x0000ffff,
+                                       0xffff0000, 0x00000001 };
+    struct ip *iph;
+    size_t from, to;
+
+    for (from = 0; from < ARRAY_SIZE(values); from++) {
+        for (to = 0; to < ARRAY_SIZE(values); to++) {
+            iph = ip_csum_test_header();
+            iph->ip_dst.s_addr = values[from];
+            iph->ip_src.s_addr = values[from];
+            iph->ip_len = values[from];
+            iph->ip_ttl = values[from];
+            iph->ip_sum = ip_csum_test_full(iph);
+
+            udpfwd_ip_set_dst(iph, values[to]);
+            ip_csum_test_check(iph, "dst edge");
+            udpfwd_ip_set_src(iph, values[to]);
+            ip_csum_test_check(iph, "src edge");
+            udpfwd_ip_set_len(iph, values[to]);
+            ip_csum_test_check(iph, "len edge");
+
+            /* A TTL of 0 wraps to 255 */
+            udpfwd_ip_dec_ttl(iph);
+            ip_csum_test_check(iph, "ttl edge");
+        }
+    }
+}
+
+int main(void)
+{
+    srandom(1);
+
+    ip_csum_test_edges();
+    ip_csum_test_random();
+
+    if (ip_csum_test_failures) {
+        fprintf(stderr, "%u IP checksum mismatches\n",
+                ip_csum_test_failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("IP header setters: %u updates checked\n", IP_CSUM_TEST_UPDATES);
+    return EXIT_SUCCESS;
+}
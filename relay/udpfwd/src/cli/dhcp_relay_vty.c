@@ -36,6 +36,7 @@
 #include "vtysh/memory.h"
 #include <stdbool.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include "vtysh/vtysh.h"
 #include "vswitch-idl.h"
 #include "ovsdb-idl.h"
@@ -233,9 +234,20 @@ print_relay_statistics(void)
     const struct ovsrec_dhcp_relay *row = NULL;
     const struct ovsdb_datum *datum = NULL;
     union ovsdb_atom atom;
-    uint32_t index;
-    DHCP_RELAY_PKT_COUNTER dhcp_relay_pkt_counters;
-    memset(&dhcp_relay_pkt_counters, 0, sizeof(DHCP_RELAY_PKT_COUNTER));
+    uint32_t index, iter;
+    int64_t stats[MAX_STATISTICS_TYPE] = {0};
+
+    /* DHCP-Relay statistics keys */
+    static char *keys[MAX_STATISTICS_TYPE] = {
+        PORT_DHCP_RELAY_STATISTICS_MAP_VALID_V4CLIENT_REQUESTS,
+        PORT_DHCP_RELAY_STATISTICS_MAP_DROPPED_V4CLIENT_REQUESTS,
+        PORT_DHCP_RELAY_STATISTICS_MAP_VALID_V4SERVER_RESPONSES,
+        PORT_DHCP_RELAY_STATISTICS_MAP_DROPPED_V4SERVER_RESPONSES,
+        PORT_DHCP_RELAY_STATISTICS_MAP_VALID_V4CLIENT_REQUESTS_WITH_OPTION82,
+        PORT_DHCP_RELAY_STATISTICS_MAP_DROPPED_V4CLIENT_REQUESTS_WITH_OPTION82,
+        PORT_DHCP_RELAY_STATISTICS_MAP_VALID_V4SERVER_RESPONSES_WITH_OPTION82,
+        PORT_DHCP_RELAY_STATISTICS_MAP_DROPPED_V4SERVER_RESPONSES_WITH_OPTION82
+    };
 
     row = ovsrec_dhcp_relay_first(idl);
 
@@ -246,53 +258,13 @@ print_relay_statistics(void)
         if (NULL == datum)
             continue;
 
-        atom.string =
-            PORT_DHCP_RELAY_STATISTICS_MAP_VALID_V4CLIENT_REQUESTS;
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        dhcp_relay_pkt_counters.client_valids +=
-            ((index == UINT_MAX)? 0 : datum->values[index].integer);
-
-        atom.string =
-            PORT_DHCP_RELAY_STATISTICS_MAP_DROPPED_V4CLIENT_REQUESTS;
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        dhcp_relay_pkt_counters.client_drops +=
-            ((index == UINT_MAX)? 0 : datum->values[index].integer);
-
-        atom.string =
-            PORT_DHCP_RELAY_STATISTICS_MAP_VALID_V4SERVER_RESPONSES;
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        dhcp_relay_pkt_counters.serv_valids +=
-            ((index == UINT_MAX)? 0 : datum->values[index].integer);
-
-        atom.string =
-            PORT_DHCP_RELAY_STATISTICS_MAP_DROPPED_V4SERVER_RESPONSES;
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        dhcp_relay_pkt_counters.serv_drops +=
-            ((index == UINT_MAX)? 0 : datum->values[index].integer);
-
-        atom.string =
-            PORT_DHCP_RELAY_STATISTICS_MAP_VALID_V4CLIENT_REQUESTS_WITH_OPTION82;
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        dhcp_relay_pkt_counters.client_valids_with_option82 +=
-            ((index == UINT_MAX)? 0 : datum->values[index].integer);
-
-        atom.string =
-            PORT_DHCP_RELAY_STATISTICS_MAP_DROPPED_V4CLIENT_REQUESTS_WITH_OPTION82;
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        dhcp_relay_pkt_counters.client_drops_with_option82 +=
-            ((index == UINT_MAX)? 0 : datum->values[index].integer);
-
-        atom.string =
-            PORT_DHCP_RELAY_STATISTICS_MAP_VALID_V4SERVER_RESPONSES_WITH_OPTION82;
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        dhcp_relay_pkt_counters.serv_valids_with_option82 +=
-            ((index == UINT_MAX)? 0 : datum->values[index].integer);
-
-        atom.string =
-            PORT_DHCP_RELAY_STATISTICS_MAP_DROPPED_V4SERVER_RESPONSES_WITH_OPTION82;
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        dhcp_relay_pkt_counters.serv_drops_with_option82 +=
-            ((index == UINT_MAX)? 0 : datum->values[index].integer);
+        for (iter = 0; iter < MAX_STATISTICS_TYPE; iter++)
+        {
+            atom.string = keys[iter];
+            index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
+            stats[iter] +=
+                ((index == UINT_MAX)? 0 : datum->values[index].integer);
+        }
     }
 
     vty_out(vty, "%s DHCP Relay Statistics:%s",
@@ -303,11 +275,11 @@ print_relay_statistics(void)
                 VTY_NEWLINE, VTY_NEWLINE);
     vty_out(vty, "  ---------- ---------- ---------- ----------%s",
             VTY_NEWLINE);
-    vty_out(vty, "  %-10d %-10d %-10d %-10d%s",
-            dhcp_relay_pkt_counters.client_valids,
-            dhcp_relay_pkt_counters.client_drops,
-            dhcp_relay_pkt_counters.serv_valids,
-            dhcp_relay_pkt_counters.serv_drops, VTY_NEWLINE);
+    vty_out(vty, "  %-10"PRId64" %-10"PRId64" %-10"PRId64" %-10"PRId64"%s",
+            stats[VALID_V4CLIENT_REQUESTS],
+            stats[DROPPED_V4CLIENT_REQUESTS],
+            stats[VALID_V4SERVER_RESPONSES],
+            stats[DROPPED_V4SERVER_RESPONSES], VTY_NEWLINE);
 
     vty_out(vty, "%s DHCP Relay Option 82 Statistics:%s",
                 VTY_NEWLINE, VTY_NEWLINE);
@@ -317,11 +289,11 @@ print_relay_statistics(void)
                 VTY_NEWLINE, VTY_NEWLINE);
     vty_out(vty, "  ---------- ---------- ---------- ----------%s",
             VTY_NEWLINE);
-    vty_out(vty, "  %-10d %-10d %-10d %-10d%s",
-            dhcp_relay_pkt_counters.client_valids_with_option82,
-            dhcp_relay_pkt_counters.client_drops_with_option82,
-            dhcp_relay_pkt_counters.serv_valids_with_option82,
-            dhcp_relay_pkt_counters.serv_drops_with_option82, VTY_NEWLINE);
+    vty_out(vty, "  %-10"PRId64" %-10"PRId64" %-10"PRId64" %-10"PRId64"%s",
+            stats[VALID_V4CLIENT_REQUESTS_WITH_OPTION82],
+            stats[DROPPED_V4CLIENT_REQUESTS_WITH_OPTION82],
+            stats[VALID_V4SERVER_RESPONSES_WITH_OPTION82],
+            stats[DROPPED_V4SERVER_RESPONSES_WITH_OPTION82], VTY_NEWLINE);
 
     return CMD_SUCCESS;
 }
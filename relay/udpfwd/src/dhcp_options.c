@@ -25,123 +25,221 @@
 
 #include "udpfwd_util.h"
 #include "udpfwd.h"
+#include "udpfwd_intf_cache.h"
 #include <stdlib.h>
 
 VLOG_DEFINE_THIS_MODULE(dhcp_options);
 
 #ifdef FTR_DHCP_RELAY
 
-unsigned char dhcpCookie[] = RFC1048_MAGIC;
+/*
+ * Function      : dhcp_option_index_scan
+ * Responsiblity : Index the tracked options of the options field, up to
+ *                 its END option. An option running past the field ends
+ *                 the scan.
+ *                 Always inlined in the stage that reads the options.
+ * Parameters    : dhcp - dhcp packet
+ *                 index - option index, initialized, updated
+ * Return        : none
+ */
+static inline UDPFWD_ALWAYS_INLINE void
+dhcp_option_index_scan(const struct dhcp_packet *dhcp,
+                       DHCP_OPTION_INDEX *index)
+{
+    const uint8_t *base = (const uint8_t *) dhcp;
+    const uint8_t *opt = &dhcp->options[MAGIC_LEN];
+    const uint8_t *optend = base + index->end;
+    DHCP_OPTION_INDEX_SLOT slot;
+    uint16_t lastPad = 0;
+    bool irregular = false;
+
+    if (!index->cookie)
+        return;
+
+    while (opt < optend) {
+        if (opt[0] == END) {
+            break;
+        }
+        if (opt[0] == PAD) {
+            lastPad = opt - base;
+            opt++;
+            continue;
+        }
 
+        /* + 2 for tag and length */
+        if ((optend - opt < 2) || (optend - opt - 2 < opt[1])) {
+            irregular = true;
+            break;
+        }
 
+        lastPad = 0;
+        slot = dhcp_option_index_slot(opt[0]);
+        if (slot != DHCP_OPTION_INDEX_UNTRACKED) {
+            if (index->offset[slot])
+                irregular = true;
+            else
+                index->offset[slot] = opt - base;
+        }
+        opt += 2 + opt[1];
+    }
+
+    index->end = opt - base;
+    index->lastPad = lastPad;
+    index->irregular = irregular;
+}
 
 /*
- * Function      : dhcpScanOpt
- * Responsiblity : This function is used to search for a specified option tag
- *                 in the options field that starts at opt and ends at optend.
- *                 If the ovld_opt argument is non-null, and an overload
- *                 option is encountered, its value
- *                 will be returned in *opt_ovld.
- * Parameters    : opt - option field starting point
- *                 optend - option field ending point
+ * Function      : dhcp_option_index_build
+ * Responsiblity : Index a DHCP message in one pass over its options field.
+ * Parameters    : dhcp - dhcp packet
+ *                 len - length of dhcp packet
+ *                 index - filled with the option index
+ * Return        : none
+ */
+void dhcp_option_index_build(const struct dhcp_packet *dhcp, uint32_t len,
+                             DHCP_OPTION_INDEX *index)
+{
+    dhcp_option_index_init(dhcp, len, index);
+    dhcp_option_index_scan(dhcp, index);
+}
+
+/*
+ * Function      : dhcp_option_index_area
+ * Responsiblity : Search an option tag in one area of a DHCP message, up
+ *                 to its END option. An option running past the area ends
+ *                 the search.
+ * Parameters    : opt - area starting point
+ *                 optend - area ending point
  *                 tag - option tag to search
- *                 ovld_opt - overload option
- * Return        : If the option tag is found, a pointer to it is returned.
- *                 Otherwise, this function returns NULL.
+ *                 overload - set to the value of the first overload
+ *                 option of the area met, if not NULL
+ * Return        : option, NULL if not found
  */
-uint8_t * dhcpScanOpt(uint8_t *opt, uint8_t *optend,
-                            uint8_t tag, uint8_t *ovld_opt)
+static uint8_t *dhcp_option_index_area(uint8_t *opt, const uint8_t *optend,
+                                       uint8_t tag, uint8_t *overload)
 {
     while (opt < optend) {
-        if (*opt == tag) {
-            return(opt);
-        }
-        else if (*opt == END) {
+        if (opt[0] == END) {
             break;
         }
-        else if (*opt == PAD) {
+        if (opt[0] == PAD) {
             opt++;
+            continue;
         }
-        else {
-            if (*opt == OPT_OVERLOAD) {
-                if (ovld_opt != NULL) {
-                    *ovld_opt = *OPTBODY(opt);
-                }
-            }
-            opt += 2 + DHCPOPTLEN(opt);  /* + 2 for tag and length.*/
+
+        /* + 2 for tag and length */
+        if ((optend - opt < 2) || (optend - opt - 2 < opt[1])) {
+            break;
         }
+        if (opt[0] == tag) {
+            return opt;
+        }
+        if ((opt[0] == OPT_OVERLOAD) && overload && !*overload &&
+            (opt[1] >= 1)) {
+            *overload = *OPTBODY(opt);
+        }
+        opt += 2 + opt[1];
     }
+
     return NULL;
 }
 
 /*
- * Function      : dhcpPickupOpt
- * Responsiblity : This function is used to search for a specified option tag in the
- *                 dhcp packet pointed to by dhcp of length len. It first searches the
- *                 options field. If an overload option is encountered in the options field,
- *                 it will also search the sname and/or file fields, as indicated by the
- *                 value of the overload option.
+ * Function      : dhcp_option_index_lookup
+ * Responsiblity : Search an option the index does not hold. The options
+ *                 field is searched first, then the file and the sname
+ *                 fields if its overload option says they carry options.
  * Parameters    : dhcp - dhcp packet
- *                 len - length of dhcp packet
+ *                 index - option index
  *                 tag - option tag
- * Return        : If the option tag is found, a pointer to it is returned.
- *                 Otherwise, this function returns NULL.
+ * Return        : first option of the tag, NULL if absent
  */
-uint8_t * dhcpPickupOpt(struct dhcp_packet *dhcp, int32_t len, uint8_t tag)
+uint8_t *dhcp_option_index_lookup(struct dhcp_packet *dhcp,
+                                  const DHCP_OPTION_INDEX *index,
+                                  uint8_t tag)
 {
-    bool useSname = false;
-    bool useFile = false;
-    uint8_t *opt;
-    uint8_t *optend;
-    uint8_t *retval;
     uint8_t overload = 0;
+    uint8_t *opt;
 
-    /* First, try searching the options field. */
-    opt = (uint8_t *)&(dhcp->options[MAGIC_LEN]);
-    optend = (uint8_t *)&(dhcp->options[len - DFLTDHCPLEN + DFLTOPTLEN]);
-    if ((retval = dhcpScanOpt(opt, optend, tag, &overload)) != NULL) {
-        if (overload == 0)
-            return retval;
-    }
+    if (!index->cookie)
+        return NULL;
 
-    /*
-     * If we encountered an overload option in the options field, decode
-     * its value to determine if we should look at the file/sname fields.
-     */
-    switch (overload) {
-    case FILE_ISOPT:
-        useFile = true;
-        break;
-    case SNAME_ISOPT:
-        useSname = true;
-        break;
-    case BOTH_AREOPT:
-        useFile = useSname = true;
-        break;
-    default:
-        break;
+    opt = dhcp_option_index_area(&dhcp->options[MAGIC_LEN],
+                                 (uint8_t *) dhcp + index->end, tag,
+                                 &overload);
+    if ((NULL == opt) && (overload & FILE_ISOPT)) {
+        opt = dhcp_option_index_area(dhcp->file,
+                                     &dhcp->file[DHCP_BOOT_FILENAME_LEN],
+                                     tag, NULL);
     }
-
-    /* Search the file field if the overload option said we should. */
-    if (useFile) {
-        opt = (uint8_t *)(dhcp->file);
-        optend = (uint8_t *)&(dhcp->file[DHCP_BOOT_FILENAME_LEN]);
-        if ((retval = dhcpScanOpt(opt, optend, tag, NULL)) != NULL) {
-            return retval;
-        }
+    if ((NULL == opt) && (overload & SNAME_ISOPT)) {
+        opt = dhcp_option_index_area(dhcp->sname,
+                                     &dhcp->sname[DHCP_SERVER_HOSTNAME_LEN],
+                                     tag, NULL);
     }
-    /* Search the sname field if the overload option said we should. */
-    else if (useSname) {
-        opt = (uint8_t *)(dhcp->sname);
-        optend = (uint8_t *)&(dhcp->sname[DHCP_SERVER_HOSTNAME_LEN]);
-        if ((retval = dhcpScanOpt(opt, optend, tag, NULL)) != NULL) {
-            return retval;
-        }
+
+    return opt;
+}
+
+/*
+ * Function      : dhcp_option_index_record
+ * Responsiblity : Index a tracked option met by the walk of the options
+ *                 field, at its place once compacted. The first option of
+ *                 a tag is kept.
+ * Parameters    : dhcp - dhcp packet
+ *                 index - option index, updated
+ *                 slot - slot of the option tag
+ *                 opt - place of the option once compacted
+ * Return        : none
+ */
+static inline void dhcp_option_index_record(const struct dhcp_packet *dhcp,
+                                            DHCP_OPTION_INDEX *index,
+                                            DHCP_OPTION_INDEX_SLOT slot,
+                                            const uint8_t *opt)
+{
+    if (!index->offset[slot])
+        index->offset[slot] = opt - (const uint8_t *) dhcp;
+}
+
+/*
+ * Function      : dhcp_option_index_field
+ * Responsiblity : Lookup a tracked option of the options field, the
+ *                 overloaded file and sname fields are not looked at.
+ * Parameters    : dhcp - dhcp packet
+ *                 index - option index
+ *                 tag - option tag
+ * Return        : option, NULL if not in the options field
+ */
+static inline uint8_t *dhcp_option_index_field(struct dhcp_packet *dhcp,
+                                               const DHCP_OPTION_INDEX *index,
+                                               uint8_t tag)
+{
+    uint16_t offset = index->offset[dhcp_option_index_slot(tag)];
+
+    return offset ? (uint8_t *) dhcp + offset : NULL;
+}
+
+/*
+ * Function      : dhcp_option_max_msg_size
+ * Responsiblity : Read the maximum message size option of a request.
+ * Parameters    : opt - maximum message size option
+ *                 max_msg_size - set to the size, 0 if below the minimum
+ * Return        : false if the option is malformed
+ */
+static bool dhcp_option_max_msg_size(const uint8_t *opt,
+                                     uint16_t *max_msg_size)
+{
+    if (opt[1] != 2)
+    {
+        VLOG_ERR("Pkt dropped. dhcp_maxmsgsize option with invalid length");
+        return false;
     }
 
-    /* Didn't find the tag, return NULL. */
-    return (NULL);
- }
+    *max_msg_size = (opt[2] << 8) + opt[3];
+    if (*max_msg_size < MAX_DHCP_MESSAGE_SIZE)
+        *max_msg_size = 0;
+    return true;
+}
 
 /*
  * Function: dhcp_relay_get_option82_len
@@ -193,12 +291,15 @@ int32_t dhcp_relay_get_option82_len(DHCP_RELAY_OPTION82_REMOTE_ID remote_id)
  * Responsibility: Find an interface that matches the circuit ID specified in the
  *                 Relay Agent Information option and also validate the remote id
  *                 specified in the relay agent option with the switch mac or ip address.
+ *                 Our own option comes back as we encoded it and is
+ *                 compared with the template of the interface as a whole.
  * Parameters: buf - buffer which has Relay agent infortion
  *             len - length of the buffer
- *             pkt_info - stores the interface info only if the received packet
- *             contains valid Relay info.
+ *             pkt_info - templates of our option of the interface, stores
+ *             the interface info only if the received packet contains
+ *             valid Relay info.
  *             remote_id - remote_id
- *             ifName - interface name
+ *             ifIndex - interface index
  * Returns: status of the validation
  *          DHCP_RELAY_OPTION_82_OK - If it matches the option choosen in the switch.
  *          DHCP_RELAY_INVALID_OPTION_82 - If the option is corrupted, or
@@ -206,17 +307,34 @@ int32_t dhcp_relay_get_option82_len(DHCP_RELAY_OPTION82_REMOTE_ID remote_id)
  *                                    doesn't match with the switch option.
  */
 int32_t dhcp_relay_validate_agent_option(const uint8_t *buf, int32_t buflen,
-                            char *ifName, DHCP_OPTION_82_OPTIONS *pkt_info,
+                            uint32_t ifIndex, DHCP_OPTION_82_OPTIONS *pkt_info,
                             DHCP_RELAY_OPTION82_REMOTE_ID remote_id)
 {
     int32_t iter, circuit_id_len = 0, remote_id_len = 0, opttype = 0, optlen =0;
     const uint8_t *circuit_id_ptr = NULL, *remote_id_ptr = NULL, *optvalue;
+    const DHCP_OPTION82_TEMPLATE *tmpl;
     CIRCUIT_ID_t circuit_id = 0;
     struct in_addr intf_ip_address;
-    MAC_ADDRESS mac;
 
     assert(buf);
 
+    /* Our own option usually comes back unchanged */
+    if (remote_id < REMOTE_ID_INVALID)
+    {
+        tmpl = &pkt_info->option82[remote_id];
+        if (tmpl->len &&
+            (buflen == tmpl->len - DHCP_OPTION_HEADER_LENGTH) &&
+            !memcmp(buf, tmpl->option + DHCP_OPTION_HEADER_LENGTH, buflen))
+        {
+            if (remote_id == REMOTE_ID_IP)
+                memcpy(&pkt_info->ip_addr,
+                       tmpl->option + DHCP_OPTION82_REMOTE_ID_VALUE,
+                       sizeof pkt_info->ip_addr);
+            pkt_info->circuit_id = ifIndex;
+            return DHCP_RELAY_OPTION_82_OK;
+        }
+    }
+
     /* Each sub-option has a one octet type, one octet length, and variable body */
     for (iter = 0;  iter < buflen - 1; )
     {
@@ -269,8 +387,8 @@ int32_t dhcp_relay_validate_agent_option(const uint8_t *buf, int32_t buflen,
         if (remote_id_len != MAC_HEADER_LENGTH )
             return DHCP_RELAY_OPTION_82_MISMATCH;
 
-        getMacfromIfname(mac, ifName);
-        if (memcmp(remote_id_ptr, mac, MAC_HEADER_LENGTH ) != 0)
+        if (memcmp(remote_id_ptr, pkt_info->option82[REMOTE_ID_MAC].option +
+                   DHCP_OPTION82_REMOTE_ID_VALUE, MAC_HEADER_LENGTH) != 0)
             return DHCP_RELAY_OPTION_82_MISMATCH;
         break;
 
@@ -280,7 +398,7 @@ int32_t dhcp_relay_validate_agent_option(const uint8_t *buf, int32_t buflen,
             return DHCP_RELAY_OPTION_82_MISMATCH;
         memcpy(&intf_ip_address.s_addr, remote_id_ptr, sizeof intf_ip_address.s_addr);
         /* check interface with this ip exists or not */
-        if (!ipExistsOnInterface(ifName, intf_ip_address.s_addr))
+        if (!udpfwd_intf_cache_ip_exists(ifIndex, intf_ip_address.s_addr))
             return DHCP_RELAY_OPTION_82_MISMATCH;
         pkt_info->ip_addr = intf_ip_address.s_addr;
         break;
@@ -295,7 +413,84 @@ int32_t dhcp_relay_validate_agent_option(const uint8_t *buf, int32_t buflen,
 }
 
 /*
- * Function: process_dhcp_relay_option82_message
+ * Function: dhcp_relay_option82_template
+ * Responsibility: Encode the relay agent information option we add to the
+ *                 requests of an interface, followed by END. Called when
+ *                 the interface or its configuration changes, so that a
+ *                 request only copies the template.
+ * Parameters: tmpl - encoded option
+ *             ifIndex - interface index, the circuit id
+ *             remote_id - option 82 remote-id type
+ *             remote - remote id, a MAC address or an IP address in network
+ *             byte order. NULL when there is none, tmpl->len is then 0.
+ * Returns:    void
+ */
+void dhcp_relay_option82_template(DHCP_OPTION82_TEMPLATE *tmpl,
+                                  uint32_t ifIndex,
+                                  DHCP_RELAY_OPTION82_REMOTE_ID remote_id,
+                                  const void *remote)
+{
+    CIRCUIT_ID_t circuit_id = ifIndex;
+    uint8_t *sp = tmpl->option;
+
+    memset(tmpl, 0, sizeof *tmpl);
+    if (!remote)
+        return;
+
+    *sp++ = DHCP_AGENT_OPTIONS;
+    *sp++ = dhcp_relay_get_option82_len(remote_id) - DHCP_OPTION_HEADER_LENGTH;
+
+    /* Copy in the circuit id */
+    *sp++ = DHCP_RAI_CIRCUIT_ID;
+    *sp++ = sizeof circuit_id;
+
+    *sp++ = (circuit_id >> 24);
+    *sp++ = ((circuit_id >> 16) & 0xff);
+    *sp++ = ((circuit_id >> 8)& 0xff);
+    *sp++ = (circuit_id & 0xff);
+
+    /* Copy in the remote ID */
+    *sp++ = DHCP_RAI_REMOTE_ID;
+    if (remote_id == REMOTE_ID_MAC)
+    {
+        *sp++ = MAC_HEADER_LENGTH;
+        memcpy(sp, remote, MAC_HEADER_LENGTH);
+        sp += MAC_HEADER_LENGTH;
+    }
+    else
+    {
+        *sp++ = sizeof(IP_ADDRESS);
+        memcpy(sp, remote, sizeof(IP_ADDRESS));
+        sp += sizeof(IP_ADDRESS);
+    }
+
+    tmpl->len = sp - tmpl->option;
+    *sp = END;
+}
+
+/*
+ * Function: dhcp_relay_option82_ours
+ * Responsibility: Pick the template of the relay agent information option
+ *                 we add to a request.
+ *                 Always inlined with a constant remote-id type.
+ * Parameters: pkt_info - interface info
+ *             remote_id - option 82 remote-id type
+ * Returns:    template, the option followed by END
+ */
+static inline UDPFWD_ALWAYS_INLINE const DHCP_OPTION82_TEMPLATE *
+dhcp_relay_option82_ours(const DHCP_OPTION_82_OPTIONS *pkt_info,
+                         const DHCP_RELAY_OPTION82_REMOTE_ID remote_id)
+{
+    /* If a BOOTP gateway is configured, use that address. Otherwise use
+     * the IP address of the interface where the packet was received */
+    if ((remote_id == REMOTE_ID_IP) && pkt_info->bootpGwOption82)
+        return pkt_info->bootpGwOption82;
+
+    return &pkt_info->option82[remote_id];
+}
+
+/*
+ * Function: dhcp_relay_option82_process
  * Responsibility: Process the DHCP packet based on the relay_type param.
  *                 If the relay_type = DHCPR_HANDLE_RESPONSE then strip any
  *                 relay agent information present in the packet.
@@ -305,42 +500,39 @@ int32_t dhcp_relay_validate_agent_option(const uint8_t *buf, int32_t buflen,
  *  ------------------------------------------------------------------
  * |ETHERNET HDR | IP HDR | DHCP HDR | MAGIC COOKIE |OPT1|OPT2|....|FF|
  *  ------------------------------------------------------------------
+ *                 Always inlined with constant configuration parameters,
+ *                 see OPTION82_HANDLER.
  * Parameters: pkt - received DHCP packet
+ *             index - option index of the packet, initialized. The
+ *             walk indexes the options as it compacts them.
  *             pkt_info - stores the interface info,
  *             if relay agent info option is valid.
  *             ifIndex - interface index
- *             ifName - interface name
- *             bootp_gw - bootp_gw address
+ *             policy - option 82 policy
+ *             remote_id - option 82 remote-id type
+ *             validate - drop replies without our agent information
  *
  * Returns:    NOOP - if the packet is not processed
  *             VALID - if the packet is valid
  *             DROPPED - if any failures
  */
-OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_OPTIONS *pkt_info,
-                               uint32_t ifIndex, char *ifName, IP_ADDRESS bootp_gw)
+static inline UDPFWD_ALWAYS_INLINE OPTION82_RESULT_t
+dhcp_relay_option82_process(void *pkt, DHCP_OPTION_INDEX *index,
+                            DHCP_OPTION_82_OPTIONS *pkt_info,
+                            uint32_t ifIndex,
+                            const DHCP_RELAY_OPTION82_POLICY policy,
+                            const DHCP_RELAY_OPTION82_REMOTE_ID remote_id,
+                            const bool validate)
 {
     struct ip *iph = NULL;       /* pointer to IP header */
     struct udphdr *udph = NULL;  /* pointer to UDP header */
     struct dhcp_packet* dhcp = NULL;    /* pointer to DHCP header */
-    bool is_dhcp = false, opt82 = false;
+    const DHCP_OPTION82_TEMPLATE *tmpl = NULL;
+    bool is_dhcp = false, opt82 = false, end_found = false;
     uint8_t *option_parser_ptr = NULL, *sp = NULL, *max = NULL, *end_pad = NULL;
     int32_t good_agent_option = 0, status =0, len = 0;
     uint32_t length = 0, packlen = 0;
     uint16_t max_msg_size = 0;
-    DHCP_RELAY_OPTION82_REMOTE_ID remote_id;
-    DHCP_RELAY_OPTION82_POLICY    policy;
-    CIRCUIT_ID_t circuit_id = ifIndex;
-
-    /* Don't process the packet if the admin status is not enabled */
-    if (ENABLE != get_feature_status(udpfwd_ctrl_cb_p->feature_config.config,
-                          DHCP_RELAY_OPTION82)) {
-        VLOG_INFO("DHCP relay option 82 is disabled. dont process the packet");
-        return NOOP;
-    }
-
-    /* fill values of remote-id and policy from global config */
-    policy = udpfwd_ctrl_cb_p->feature_config.policy;
-    remote_id = udpfwd_ctrl_cb_p->feature_config.r_id;
 
     iph  = (struct ip *) pkt;
     udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
@@ -351,12 +543,13 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
     length = DHCP_PKTLEN(udph);
 
     /* If there's no cookie, it's a bootp packet and we forward it unchanged */
-    if (memcmp((char *)dhcp->options, (char *)dhcpCookie, MAGIC_LEN) != 0)
+    if (!index->cookie)
         return NOOP;
 
     max = ((uint8_t *)dhcp) + length;
     option_parser_ptr = (uint8_t *)(dhcp->options + MAGIC_LEN);
     sp = option_parser_ptr;
+
     while (option_parser_ptr < max)
     {
         switch (*option_parser_ptr)
@@ -370,9 +563,13 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
         /* If we see a message type, it's a DHCP packet. */
         case DHCP_MSGTYPE:
             is_dhcp = 1;
+            dhcp_option_index_record(dhcp, index, DHCP_OPTION_INDEX_MSGTYPE,
+                                     sp);
         break;
 
         case DHCP_MAXMSGSIZE:
+            dhcp_option_index_record(dhcp, index,
+                                     DHCP_OPTION_INDEX_MAXMSGSIZE, sp);
             if (dhcp->op == BOOTREQUEST)
             {
                 len = option_parser_ptr[1];
@@ -392,6 +589,8 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
 
         /* Quit immediately if we hit an End option. */
         case END:
+            index->end = sp - (uint8_t *)dhcp;
+            end_found = true;
             if (sp != option_parser_ptr)
             {
                *sp++ = *option_parser_ptr;
@@ -405,6 +604,8 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
              * the DHCP packet type, but if we do, we have to leave it alone.  */
             if (!is_dhcp)
             {
+               dhcp_option_index_record(dhcp, index,
+                                        DHCP_OPTION_INDEX_AGENT, sp);
                break;
             }
             if (dhcp->giaddr.s_addr == 0)
@@ -420,7 +621,7 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
                 * information.  */
                 status = dhcp_relay_validate_agent_option(option_parser_ptr + 2,
                                                    option_parser_ptr[1],
-                                                   ifName,
+                                                   ifIndex,
                                                    pkt_info,
                                                    remote_id);
                 if (status == DHCP_RELAY_INVALID_OPTION_82)
@@ -462,6 +663,7 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
                     continue;
                 }
             }
+            dhcp_option_index_record(dhcp, index, DHCP_OPTION_INDEX_AGENT, sp);
             break;
 
             /* Ignore all other options */
@@ -469,26 +671,32 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
             break;
       } /* End of switch */
 
-        end_pad = 0;
-        if (sp != option_parser_ptr)
-        {
-            memmove(sp, option_parser_ptr,
-                 (unsigned)(option_parser_ptr[1] + DHCP_OPTION_HEADER_LENGTH));
-        }
-
        /* Here,
         * option_parser_ptr [0] = Option Code (Type).
         * option_parser_ptr [1] = Option Length (Length).
         * option_parser_ptr [2] = Value.
         * So adding option_parser_ptr [1] and DHCPR_DHCP_OPT_AND_LEN_FIELD_BYTES
         * to option_parser_ptr, places it to the beginning of the next DHCP option
-        * or the end of the packet.
+        * or the end of the packet. The length is read before the option is
+        * moved, a move by less than its length overwrites it.
         */
-        sp += option_parser_ptr[1] + DHCP_OPTION_HEADER_LENGTH;
-        option_parser_ptr += option_parser_ptr[1] + DHCP_OPTION_HEADER_LENGTH;
+        len = option_parser_ptr[1] + DHCP_OPTION_HEADER_LENGTH;
+
+        end_pad = 0;
+        if (sp != option_parser_ptr)
+        {
+            memmove(sp, option_parser_ptr, (unsigned)len);
+        }
+
+        sp += len;
+        option_parser_ptr += len;
 
     } /* while more options to process */
 
+    /* Without END, the options field ends with its last option */
+    if (!end_found)
+        index->end = ((sp < max) ? sp : max) - (uint8_t *)dhcp;
+
     /* If it's not a DHCP packet, we don't modify it */
     if (!is_dhcp)
         return NOOP;
@@ -500,9 +708,7 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
         * options, and if we're relying on agent options to determine the
         * outgoing interface, drop the packet.
         */
-        if ((good_agent_option == false) &&
-            (ENABLE == get_feature_status
-            (udpfwd_ctrl_cb_p->feature_config.config, DHCP_RELAY_OPTION82_VALIDATE)))
+        if ((good_agent_option == false) && validate)
         {
             VLOG_ERR("DHCP relay option 82 validate is enabled. drop the packet");
             return DROPPED;
@@ -538,51 +744,20 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
         if (opt82)
         {
             /* We have space to add the option 82 field in the message.  If the sp
-            * points past the END option, back up and overwrite it.  */
+            * points past the END option, back up and overwrite it. The byte
+            * before a pad or a missing END may be option data.  */
 
-            if (sp[-1] == END)
+            if (!end_pad && end_found)
                 sp--;
 
             /* Add the option 82 header */
-            *sp++ = DHCP_AGENT_OPTIONS;
-            *sp++ = dhcp_relay_get_option82_len(remote_id) - DHCP_OPTION_HEADER_LENGTH;
-
-            /* Copy in the circuit id */
-            *sp++ = DHCP_RAI_CIRCUIT_ID;
-            *sp++ = sizeof circuit_id;
-
-            *sp++ = (circuit_id >> 24);
-            *sp++ = ((circuit_id >> 16) & 0xff);
-            *sp++ = ((circuit_id >> 8)& 0xff);
-            *sp++ = (circuit_id & 0xff);
-
-            /* Copy in the remote ID */
-            if (remote_id == REMOTE_ID_MAC)
-            {
-                *sp++ = DHCP_RAI_REMOTE_ID;
-                *sp++ = MAC_HEADER_LENGTH ;
-
-                getMacfromIfname(sp, ifName);
-                sp += MAC_HEADER_LENGTH ;
-            }
-            else if (remote_id == REMOTE_ID_IP)
-            {
-                struct in_addr addr;
-
-                /* If a BOOTP gateway is configured, use that address */
-                if (bootp_gw)
-                    addr.s_addr = bootp_gw;
-                else
-                    /* Use IP address of the interface where the packet was received */
-                    addr.s_addr = pkt_info->ip_addr;
-
-                *sp++ = DHCP_RAI_REMOTE_ID;
-                *sp++ = sizeof(addr.s_addr);
-                memcpy(sp, &addr.s_addr, sizeof(addr.s_addr));
-                sp += sizeof(addr.s_addr);
-            }
+            index->offset[DHCP_OPTION_INDEX_AGENT] = sp - (uint8_t *)dhcp;
+            tmpl = dhcp_relay_option82_ours(pkt_info, remote_id);
+            memcpy(sp, tmpl->option, tmpl->len);
+            sp += tmpl->len;
 
             /* Add END option to packet */
+            index->end = sp - (uint8_t *)dhcp;
             *sp++ = END;
         }
     }
@@ -602,9 +777,373 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
    udph->uh_sum = 0;
 
    /* Update IP header.  The only parameter changed is length.  */
-   iph->ip_len = htons(length + UDPHDR_LENGTH + (iph->ip_hl * 4));
-   iph->ip_sum = 0;  /* actual checksum calculated before sending the packet */
+   udpfwd_ip_set_len(iph, htons(length + UDPHDR_LENGTH + (iph->ip_hl * 4)));
 
    return VALID;
 }
+
+/* Zero padding of short requests, see dhcp_relay_option82_gather */
+static const uint8_t dhcp_option82_pad[MINBOOTPLEN];
+
+/*
+ * Function: dhcp_option82_gather_add
+ * Responsibility: Append a segment to a gathered request.
+ * Parameters: gather - gathered request
+ *             base - segment
+ *             len - segment length, nothing is appended for 0
+ * Returns:    void
+ */
+static inline void dhcp_option82_gather_add(DHCP_OPTION82_GATHER *gather,
+                                            const void *base, uint32_t len)
+{
+    if (len)
+    {
+        gather->iov[gather->iovcnt].iov_base = (void *) base;
+        gather->iov[gather->iovcnt].iov_len = len;
+        gather->iovcnt++;
+    }
+}
+
+/*
+ * Function: dhcp_relay_option82_gather_all
+ * Responsibility: Describe a request sent as received, its UDP payload as
+ *                 a single segment.
+ * Parameters: pkt - DHCP request
+ *             gather - filled with the UDP payload
+ * Returns:    void
+ */
+void dhcp_relay_option82_gather_all(void *pkt, DHCP_OPTION82_GATHER *gather)
+{
+    struct ip *iph = (struct ip *) pkt;
+    struct udphdr *udph;
+    int32_t length;
+
+    udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
+
+    /* Bound by both the IP and the UDP length */
+    length = ntohs(iph->ip_len) - (iph->ip_hl * 4) - UDPHDR_LENGTH;
+    if (length > (int32_t) DHCP_PKTLEN(udph))
+        length = DHCP_PKTLEN(udph);
+    if (length < 0)
+        length = 0;
+
+    gather->iovcnt = 0;
+    gather->length = length;
+    dhcp_option82_gather_add(gather, udph + 1, length);
+}
+
+/*
+ * Function: dhcp_relay_option82_gather
+ * Responsibility: Encode a DHCP request with our relay agent information
+ *                 as segments of the received buffer, instead of moving
+ *                 the options in place. The segments carry the message
+ *                 dhcp_relay_option82_process builds for a regular request,
+ *                 irregular ones are left to it untouched. The options
+ *                 field is parsed once, into the index. Only the IP and UDP
+ *                 lengths of the received buffer are written, the UDP
+ *                 checksum is computed on transmit.
+ *                 Always inlined with constant configuration parameters,
+ *                 see OPTION82_GATHER_HANDLER.
+ * Parameters: pkt - received DHCP request
+ *             index - option index of the request, initialized, filled
+ *             with the options field. Irregular if left to the walk.
+ *             pkt_info - templates of our option of the interface
+ *             gather - filled with the segments of the UDP payload
+ *             policy - option 82 policy
+ *             remote_id - option 82 remote-id type
+ *
+ * Returns:    NOOP - if the packet is not processed
+ *             VALID - if the packet is valid
+ *             DROPPED - if any failures
+ */
+static inline UDPFWD_ALWAYS_INLINE OPTION82_RESULT_t
+dhcp_relay_option82_gather(void *pkt, DHCP_OPTION_INDEX *index,
+                           const DHCP_OPTION_82_OPTIONS *pkt_info,
+                           DHCP_OPTION82_GATHER *gather,
+                           const DHCP_RELAY_OPTION82_POLICY policy,
+                           const DHCP_RELAY_OPTION82_REMOTE_ID remote_id)
+{
+    struct ip *iph;
+    struct udphdr *udph;
+    struct dhcp_packet *dhcp;
+    const DHCP_OPTION82_TEMPLATE *tmpl;
+    uint8_t *msg_type, *agent, *max_size, *sp, *max;
+    uint32_t length, strip = 0;
+    uint16_t max_msg_size = 0;
+    bool opt82, end_found;
+
+    iph  = (struct ip *) pkt;
+    udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
+    dhcp = (struct dhcp_packet *) ((char *)udph + UDPHDR_LENGTH);
+
+    /* If there's no cookie, it's a bootp packet and we forward it unchanged */
+    if (!index->cookie)
+    {
+        dhcp_relay_option82_gather_all(pkt, gather);
+        return NOOP;
+    }
+
+    /* Repeated or truncated options are left to the walk */
+    dhcp_option_index_scan(dhcp, index);
+    if (index->irregular)
+        return NOOP;
+
+    max = ((uint8_t *)dhcp) + DHCP_PKTLEN(udph);
+    msg_type = dhcp_option_index_field(dhcp, index, DHCP_MSGTYPE);
+    agent = dhcp_option_index_field(dhcp, index, DHCP_AGENT_OPTIONS);
+    max_size = dhcp_option_index_field(dhcp, index, DHCP_MAXMSGSIZE);
+
+    /* An agent option ahead of the message type is left alone */
+    if ((NULL != agent) && ((NULL == msg_type) || (agent < msg_type)))
+        agent = NULL;
+
+    /* Past END, or past the last option without END */
+    sp = (uint8_t *)dhcp + index->end;
+    end_found = (sp < max);
+    if (end_found)
+        sp++;
+
+    /* Options are checked in the order of the message */
+    if ((NULL != max_size) && ((NULL == agent) || (max_size < agent)))
+    {
+        if (!dhcp_option_max_msg_size(max_size, &max_msg_size))
+            return DROPPED;
+        max_size = NULL;
+    }
+
+    /* If it's not a DHCP packet, we don't modify it */
+    if (NULL == msg_type)
+    {
+        dhcp_relay_option82_gather_all(pkt, gather);
+        return NOOP;
+    }
+
+    if (NULL != agent)
+    {
+        if (dhcp->giaddr.s_addr == 0)
+        {
+            /* drop packets with giaddr field set to NULL and option 82 !=NULL */
+            return DROPPED;
+        }
+
+        switch (policy)
+        {
+        case KEEP:
+            dhcp_relay_option82_gather_all(pkt, gather);
+            return VALID;
+        case DROP:
+            return DROPPED;
+        case REPLACE:
+        default:
+            break;
+        }
+
+        if ((NULL != max_size) &&
+            !dhcp_option_max_msg_size(max_size, &max_msg_size))
+            return DROPPED;
+
+        /* Skip over the agent option */
+        strip = agent[1] + DHCP_OPTION_HEADER_LENGTH;
+    }
+
+    /* If the packet had padding, we can store the agent option at the
+     * beginning of the pad.  */
+    if (index->lastPad)
+        sp = (uint8_t *)dhcp + index->lastPad;
+
+    length = (sp - (uint8_t *)dhcp) - strip;
+
+    /* Check if there enough space to add new option */
+    opt82 = (RECV_BUFFER_SIZE > length + dhcp_relay_get_option82_len(remote_id));
+
+    /* If there is max dhcp size option in the pkt, check if we will exceed
+     * this size.  If so, do not add option82.  */
+    if (opt82 && max_msg_size)
+    {
+        opt82 = (max_msg_size >= length +
+                                 dhcp_relay_get_option82_len(remote_id));
+        if (!opt82)
+            VLOG_ERR("Option 82 not added. Pkt size > max msg size in pkt");
+    }
+
+    /* The new option takes the place of END */
+    if (opt82 && !index->lastPad && end_found)
+    {
+        sp--;
+        length--;
+    }
+
+    gather->iovcnt = 0;
+    if (NULL != agent)
+    {
+        dhcp_option82_gather_add(gather, dhcp, agent - (uint8_t *)dhcp);
+        dhcp_option82_gather_add(gather, agent + strip, sp - (agent + strip));
+    }
+    else
+        dhcp_option82_gather_add(gather, dhcp, sp - (uint8_t *)dhcp);
+
+    if (opt82)
+    {
+        /* The template outlives the send of the request */
+        tmpl = dhcp_relay_option82_ours(pkt_info, remote_id);
+        dhcp_option82_gather_add(gather, tmpl->option, tmpl->len + 1);
+        length += tmpl->len + 1;
+    }
+
+    /* If length is less than minimum, add padding */
+    if (length < MINBOOTPLEN)
+    {
+        dhcp_option82_gather_add(gather, dhcp_option82_pad,
+                                 MINBOOTPLEN - length);
+        length = MINBOOTPLEN;
+    }
+    gather->length = length;
+
+    /* The packet is modified, fill the UDP length parameters */
+    udph->uh_ulen = htons(length + UDPHDR_LENGTH);
+    udph->uh_sum = 0;
+
+    /* Update IP header.  The only parameter changed is length.  */
+    udpfwd_ip_set_len(iph, htons(length + UDPHDR_LENGTH + (iph->ip_hl * 4)));
+
+    return VALID;
+}
+
+/*
+ * Function: dhcp_relay_option82_disabled
+ * Responsibility: Option 82 handler used while option 82 is disabled.
+ * Parameters: see dhcp_relay_option82_process
+ * Returns:    NOOP
+ */
+static OPTION82_RESULT_t dhcp_relay_option82_disabled(void *pkt OVS_UNUSED,
+                               DHCP_OPTION_INDEX *index OVS_UNUSED,
+                               DHCP_OPTION_82_OPTIONS *pkt_info OVS_UNUSED,
+                               uint32_t ifIndex OVS_UNUSED)
+{
+    return NOOP;
+}
+
+/* Generate the option 82 handler of one configuration */
+#define OPTION82_HANDLER(POLICY, REMOTE_ID, VALIDATE)                       \
+static OPTION82_RESULT_t                                                    \
+dhcp_relay_option82_##POLICY##_##REMOTE_ID##_##VALIDATE(void *pkt,          \
+                           DHCP_OPTION_INDEX *index,                        \
+                           DHCP_OPTION_82_OPTIONS *pkt_info,                \
+                           uint32_t ifIndex)                                \
+{                                                                           \
+    return dhcp_relay_option82_process(pkt, index, pkt_info, ifIndex,       \
+                                       POLICY, REMOTE_ID, VALIDATE);        \
+}
+
+#define OPTION82_HANDLERS(POLICY)                                           \
+    OPTION82_HANDLER(POLICY, REMOTE_ID_IP, 0)                               \
+    OPTION82_HANDLER(POLICY, REMOTE_ID_IP, 1)                               \
+    OPTION82_HANDLER(POLICY, REMOTE_ID_MAC, 0)                              \
+    OPTION82_HANDLER(POLICY, REMOTE_ID_MAC, 1)
+
+OPTION82_HANDLERS(KEEP)
+OPTION82_HANDLERS(DROP)
+OPTION82_HANDLERS(REPLACE)
+
+#define OPTION82_HANDLER_ROW(POLICY)                                        \
+    [POLICY] = {                                                            \
+        [REMOTE_ID_IP] = { dhcp_relay_option82_##POLICY##_REMOTE_ID_IP_0,   \
+                           dhcp_relay_option82_##POLICY##_REMOTE_ID_IP_1 }, \
+        [REMOTE_ID_MAC] = { dhcp_relay_option82_##POLICY##_REMOTE_ID_MAC_0, \
+                            dhcp_relay_option82_##POLICY##_REMOTE_ID_MAC_1 } \
+    }
+
+/* Option 82 handlers, by policy, remote-id and validation */
+static const DHCP_RELAY_OPTION82_HANDLER
+option82_handlers[INVALID][REMOTE_ID_INVALID][2] = {
+    OPTION82_HANDLER_ROW(KEEP),
+    OPTION82_HANDLER_ROW(DROP),
+    OPTION82_HANDLER_ROW(REPLACE)
+};
+
+/*
+ * Function: dhcp_relay_option82_handler
+ * Responsibility: Select the option 82 handler of a configuration.
+ * Parameters: config - feature configuration
+ * Returns:    option 82 handler
+ */
+DHCP_RELAY_OPTION82_HANDLER
+dhcp_relay_option82_handler(const FEATURE_CONFIG *config)
+{
+    bool validate;
+
+    if (ENABLE != get_feature_status(config->config, DHCP_RELAY_OPTION82))
+        return dhcp_relay_option82_disabled;
+
+    validate = (ENABLE == get_feature_status(config->config,
+                                         DHCP_RELAY_OPTION82_VALIDATE));
+
+    return option82_handlers[config->policy][config->r_id][validate];
+}
+
+/*
+ * Function: dhcp_relay_option82_gather_disabled
+ * Responsibility: Option 82 encoder used while option 82 is disabled, the
+ *                 request is sent as received.
+ * Parameters: see dhcp_relay_option82_gather
+ * Returns:    NOOP
+ */
+static OPTION82_RESULT_t dhcp_relay_option82_gather_disabled(void *pkt,
+                               DHCP_OPTION_INDEX *index OVS_UNUSED,
+                               const DHCP_OPTION_82_OPTIONS *pkt_info OVS_UNUSED,
+                               DHCP_OPTION82_GATHER *gather)
+{
+    dhcp_relay_option82_gather_all(pkt, gather);
+    return NOOP;
+}
+
+/* Generate the option 82 encoder of one configuration */
+#define OPTION82_GATHER_HANDLER(POLICY, REMOTE_ID)                          \
+static OPTION82_RESULT_t                                                    \
+dhcp_relay_option82_gather_##POLICY##_##REMOTE_ID(void *pkt,                \
+                           DHCP_OPTION_INDEX *index,                        \
+                           const DHCP_OPTION_82_OPTIONS *pkt_info,          \
+                           DHCP_OPTION82_GATHER *gather)                    \
+{                                                                           \
+    return dhcp_relay_option82_gather(pkt, index, pkt_info, gather,         \
+                                      POLICY, REMOTE_ID);                   \
+}
+
+#define OPTION82_GATHER_HANDLERS(POLICY)                                    \
+    OPTION82_GATHER_HANDLER(POLICY, REMOTE_ID_IP)                           \
+    OPTION82_GATHER_HANDLER(POLICY, REMOTE_ID_MAC)
+
+OPTION82_GATHER_HANDLERS(KEEP)
+OPTION82_GATHER_HANDLERS(DROP)
+OPTION82_GATHER_HANDLERS(REPLACE)
+
+#define OPTION82_GATHER_HANDLER_ROW(POLICY)                                 \
+    [POLICY] = {                                                            \
+        [REMOTE_ID_IP] = dhcp_relay_option82_gather_##POLICY##_REMOTE_ID_IP,\
+        [REMOTE_ID_MAC] = dhcp_relay_option82_gather_##POLICY##_REMOTE_ID_MAC \
+    }
+
+/* Option 82 encoders, by policy and remote-id */
+static const DHCP_RELAY_OPTION82_GATHER_HANDLER
+option82_gather_handlers[INVALID][REMOTE_ID_INVALID] = {
+    OPTION82_GATHER_HANDLER_ROW(KEEP),
+    OPTION82_GATHER_HANDLER_ROW(DROP),
+    OPTION82_GATHER_HANDLER_ROW(REPLACE)
+};
+
+/*
+ * Function: dhcp_relay_option82_gather_handler
+ * Responsibility: Select the option 82 encoder of requests of a
+ *                 configuration.
+ * Parameters: config - feature configuration
+ * Returns:    option 82 encoder
+ */
+DHCP_RELAY_OPTION82_GATHER_HANDLER
+dhcp_relay_option82_gather_handler(const FEATURE_CONFIG *config)
+{
+    if (ENABLE != get_feature_status(config->config, DHCP_RELAY_OPTION82))
+        return dhcp_relay_option82_gather_disabled;
+
+    return option82_gather_handlers[config->policy][config->r_id];
+}
 #endif /* FTR_DHCP_RELAY */
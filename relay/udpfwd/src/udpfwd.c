@@ -41,6 +41,7 @@
 #include <sys/ioctl.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <inttypes.h>
 
 /* Dynamic string */
 #include <dynamic-string.h>
@@ -63,14 +64,16 @@
 #include "relay_common.h"
 #include "udpfwd_util.h"
 #include "udpfwd.h"
+#include "udpfwd_intf_cache.h"
+#include "udpfwd_filter.h"
+#include "udpfwd_neigh.h"
+#include "udpfwd_xsk.h"
+#include "udpfwd_fastpath.h"
 
 /*
  * Global variable declarations.
  */
 
-/* udp socket receiver thread handle */
-pthread_t udpBcastRecv_thread;
-
 /* Structure to store value of unixctl arguments */
 struct dump_params {
     char *ifName; /* Name of the Interface */
@@ -81,12 +84,25 @@ struct dump_params {
 UDPFWD_CTRL_CB udpfwd_ctrl_cb;
 UDPFWD_CTRL_CB *udpfwd_ctrl_cb_p = &udpfwd_ctrl_cb;
 
-VLOG_DEFINE_THIS_MODULE(udpfwd);
+/* Receive batch size requested on the command line */
+static uint32_t udpfwd_rx_batch_size = UDPFWD_RX_BATCH_DEFAULT;
 
-/**
- * External Function Declarations
- */
-extern void *udp_packet_recv(void *args);
+/* Number of receive workers requested on the command line */
+static uint32_t udpfwd_rx_workers = UDPFWD_RX_WORKERS_DEFAULT;
+
+/* Servers allowed on an interface, set on the command line */
+static uint32_t udpfwd_intf_servers_max = UDPFWD_INTF_SERVERS_DEFAULT;
+
+/* Receive backend requested on the command line */
+static UDPFWD_RX_BACKEND udpfwd_rx_backend = UDPFWD_RX_BACKEND_SOCKET;
+
+/* Receive backend names, by UDPFWD_RX_BACKEND */
+static const char *udpfwd_rx_backend_names[] = {"socket", "tpacket", "xdp"};
+
+/* DHCP client replies sent as Ethernet frames, set on the command line */
+static bool udpfwd_l2_replies = false;
+
+VLOG_DEFINE_THIS_MODULE(udpfwd);
 
 /*
  * Function      : udpfwd_module_init
@@ -186,6 +202,109 @@ void udpfwd_set_default_config(void)
     return;
 }
 
+/*
+ * Function      : udpfwd_rx_workers_destroy
+ * Responsiblity : Release the sockets and receive rings of the workers
+ * Parameters    : none
+ * Return        : none
+ */
+static void udpfwd_rx_workers_destroy(void)
+{
+    UDPFWD_RX_WORKER *worker;
+    uint32_t iter;
+
+    for (iter = 0; iter < udpfwd_ctrl_cb_p->n_workers; iter++) {
+        worker = &udpfwd_ctrl_cb_p->workers[iter];
+        if (0 < worker->sockFd)
+            close(worker->sockFd);
+        worker->sockFd = -1;
+
+        if (0 < worker->l2SockFd)
+            close(worker->l2SockFd);
+        worker->l2SockFd = -1;
+
+        worker->rxFd = -1;
+
+        /* free memory for packet receive ring */
+        udpfwd_rx_ring_destroy(&worker->rx_ring);
+        udpfwd_rx_tpacket_destroy(&worker->tpacket);
+    }
+}
+
+/*
+ * Function      : udpfwd_rx_worker_init
+ * Responsiblity : Create the socket and the receive ring of a worker. The
+ *                 socket only accepts the forwarded ports, in the shard of
+ *                 the traffic owned by the worker.
+ * Parameters    : worker - receive worker
+ *                 id - worker index
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool udpfwd_rx_worker_init(UDPFWD_RX_WORKER *worker, uint32_t id)
+{
+    char buf[1];
+
+    worker->id = id;
+
+    /* Create UDP socket */
+    if (-1 == (worker->sockFd = create_udp_socket()))
+    {
+        VLOG_ERR("Failed to create broadcast socket for worker %d", id);
+        return false;
+    }
+
+    if (UDPFWD_RX_BACKEND_TPACKET == udpfwd_ctrl_cb_p->rx_backend)
+    {
+        /* Receive on the packet socket, the raw socket only sends */
+        if ((true != udpfwd_filter_attach_reject(worker->sockFd)) ||
+            (true != udpfwd_rx_tpacket_init(&worker->tpacket, id,
+                                            udpfwd_ctrl_cb_p->n_workers)))
+        {
+            VLOG_ERR("Failed to create receive ring for worker %d", id);
+            return false;
+        }
+        worker->rxFd = worker->tpacket.sockFd;
+    }
+    else
+    {
+        if (true != udpfwd_filter_attach(worker->sockFd, id,
+                                         udpfwd_ctrl_cb_p->n_workers))
+        {
+            VLOG_ERR("Failed to attach receive filter for worker %d", id);
+            return false;
+        }
+        worker->rxFd = worker->sockFd;
+    }
+
+    /* Drop what was queued before the filter was in place */
+    while (recv(worker->sockFd, buf, sizeof(buf), MSG_DONTWAIT) >= 0);
+
+#ifdef FTR_DHCP_RELAY
+    /* Protocol 0 socket, it only sends and never gets a packet queued */
+    if (udpfwd_ctrl_cb_p->l2_replies &&
+        (-1 == (worker->l2SockFd = socket(AF_PACKET, SOCK_RAW, 0))))
+    {
+        VLOG_ERR("Failed to create packet socket for worker %d, errno = %d",
+                 id, errno);
+        return false;
+    }
+#endif /* FTR_DHCP_RELAY */
+
+    /* Allocate memory for packet recieve ring. The TPACKET backend handles
+     * its packets in the ring and keeps a single slot */
+    if (true != udpfwd_rx_ring_init(&worker->rx_ring,
+                    (UDPFWD_RX_BACKEND_TPACKET == udpfwd_ctrl_cb_p->rx_backend) ?
+                    1 : udpfwd_rx_batch_size))
+    {
+        VLOG_ERR("Memory allocation for receive ring of worker %d failed",
+                 id);
+        return false;
+    }
+
+    return true;
+}
+
 /*
  * Function      : udpfwd_module_init
  * Responsiblity : Initialization routine for udp broadcast forwarder module
@@ -196,37 +315,74 @@ void udpfwd_set_default_config(void)
 bool udpfwd_module_init(void)
 {
     int32_t retVal;
-    int32_t sock;
+    uint32_t iter;
 
     memset(udpfwd_ctrl_cb_p, 0, sizeof(UDPFWD_CTRL_CB));
 
     /* Set feature default configuration status */
     udpfwd_set_default_config();
+    udpfwd_select_handlers();
 
-    /* DB access semaphore initialization */
-    retVal = sem_init(&udpfwd_ctrl_cb_p->waitSem, 0, 1);
-    if (0 != retVal) {
-        VLOG_FATAL("Failed to initilize the semaphore, retval : %d (errno : %d)",
-                   retVal, errno);
-        return false;
+    /* Pick the UDP checksum implementation for this CPU */
+    udpfwd_csum_init();
+
+    /* Kernel receive filter of the worker sockets */
+    udpfwd_filter_init();
+
+    /* Create the sockets and buffers of the receive workers */
+    udpfwd_ctrl_cb_p->n_workers = udpfwd_rx_workers;
+    udpfwd_ctrl_cb_p->rx_backend = udpfwd_rx_backend;
+    /* AF_XDP sockets send client replies as Ethernet frames */
+    udpfwd_ctrl_cb_p->l2_replies = udpfwd_l2_replies ||
+                    (UDPFWD_RX_BACKEND_XDP == udpfwd_rx_backend);
+    udpfwd_ctrl_cb_p->intf_servers_max = udpfwd_intf_servers_max;
+
+#ifdef FTR_UDP_BCAST_FWD
+    /* In-kernel forwarding, before the filters learn to skip its mark */
+    udpfwd_fastpath_init();
+#endif /* FTR_UDP_BCAST_FWD */
+
+    for (iter = 0; iter < udpfwd_ctrl_cb_p->n_workers; iter++)
+    {
+        udpfwd_ctrl_cb_p->workers[iter].sockFd = -1;
+        udpfwd_ctrl_cb_p->workers[iter].rxFd = -1;
+        udpfwd_ctrl_cb_p->workers[iter].l2SockFd = -1;
+        udpfwd_ctrl_cb_p->workers[iter].tpacket.sockFd = -1;
     }
 
-    /* Create UDP socket */
-    if (-1 == (sock = create_udp_socket()))
+    for (iter = 0; iter < udpfwd_ctrl_cb_p->n_workers; iter++)
     {
-        VLOG_FATAL("Failed to create broadcast socket");
-        return false;
+        if (true != udpfwd_rx_worker_init(&udpfwd_ctrl_cb_p->workers[iter],
+                                          iter))
+        {
+            udpfwd_rx_workers_destroy();
+            VLOG_FATAL("Failed to initialize receive worker %d", iter);
+            return false;
+        }
     }
 
-    udpfwd_ctrl_cb_p->udpSockFd = sock;
+    /* Client neighbor caches of the workers */
+    if (true != udpfwd_neigh_init(udpfwd_ctrl_cb_p->n_workers))
+    {
+        udpfwd_rx_workers_destroy();
+        VLOG_FATAL("Failed to initialize the neighbor caches");
+        return false;
+    }
 
-    /* Allocate memory for packet recieve buffer */
-    udpfwd_ctrl_cb_p->rcvbuff = (char *) calloc(RECV_BUFFER_SIZE, sizeof(char));
+    /* Load the kernel interfaces before any packet is received */
+    if (true != udpfwd_intf_cache_init())
+    {
+        udpfwd_rx_workers_destroy();
+        VLOG_FATAL("Failed to initialize the interface cache");
+        return false;
+    }
 
-    if (NULL == udpfwd_ctrl_cb_p->rcvbuff)
+    /* AF_XDP sockets of the workers, steering the local addresses */
+    if ((UDPFWD_RX_BACKEND_XDP == udpfwd_ctrl_cb_p->rx_backend) &&
+        (true != udpfwd_xsk_init(udpfwd_ctrl_cb_p->n_workers)))
     {
-        close(udpfwd_ctrl_cb_p->udpSockFd);
-        VLOG_FATAL(" Memory allocation for receive buffer failed\n");
+        udpfwd_rx_workers_destroy();
+        VLOG_FATAL("Failed to initialize the AF_XDP sockets");
         return false;
     }
 
@@ -236,19 +392,32 @@ bool udpfwd_module_init(void)
     /* Initialize server hash map */
     cmap_init(&udpfwd_ctrl_cb_p->serverHashMap);
 
-    /* Create UDP broadcast receiver thread */
-    retVal = pthread_create(&udpBcastRecv_thread, (pthread_attr_t *)NULL,
-                            udp_packet_recv, NULL);
-    if (0 != retVal)
+    /* Initialize forwarding snapshot map */
+    cmap_init(&udpfwd_ctrl_cb_p->fwdMap);
+
+    /* Initialize configuration row map */
+    hmap_init(&udpfwd_ctrl_cb_p->rowRefs);
+
+    /* Publish the ports of interest before the workers start */
+    udpfwd_publish_interfaces();
+
+    /* Create UDP broadcast receiver threads */
+    for (iter = 0; iter < udpfwd_ctrl_cb_p->n_workers; iter++)
     {
-        free(udpfwd_ctrl_cb_p->rcvbuff);
-        close(udpfwd_ctrl_cb_p->udpSockFd);
-        cmap_destroy(&udpfwd_ctrl_cb_p->serverHashMap);
-        VLOG_FATAL("Failed to create UDP broadcast packet receiver thread : %d",
-                 retVal);
-        return false;
+        retVal = pthread_create(&udpfwd_ctrl_cb_p->workers[iter].thread,
+                                (pthread_attr_t *)NULL, udp_packet_recv,
+                                &udpfwd_ctrl_cb_p->workers[iter]);
+        if (0 != retVal)
+        {
+            /* Workers already started keep running on their sockets */
+            VLOG_FATAL("Failed to create UDP broadcast packet receiver "
+                       "thread %d : %d", iter, retVal);
+            return false;
+        }
     }
 
+    VLOG_INFO("Started %d UDP broadcast packet receiver thread(s)",
+              udpfwd_ctrl_cb_p->n_workers);
     return true;
 }
 
@@ -453,6 +622,9 @@ void udpfwd_process_globalconfig_update(void)
 #endif /* FTR_DHCP_RELAY */
     }
 
+    /* Specialize the packet path for the new configuration */
+    udpfwd_select_handlers();
+
     return;
 }
 
@@ -460,47 +632,30 @@ void udpfwd_process_globalconfig_update(void)
 /*
  * Function      : dhcp_relay_server_config_update
  * Responsiblity : Process dhcp_relay table update notifications from OVSDB for the
- *                 configuration changes.
+ *                 configuration changes. Only the records changed since the
+ *                 last run are visited.
  * Parameters    : none
  * Return        : none
  */
 void dhcp_relay_server_config_update(void)
 {
-    const struct ovsrec_dhcp_relay *rec_first = NULL;
     const struct ovsrec_dhcp_relay *rec = NULL;
 
-    /* Check for server configuration changes */
-    rec_first = ovsrec_dhcp_relay_first(idl);
-    if (NULL == rec_first) {
-        /* Check if last entry from the table is deleted */
-        udpfwd_handle_dhcp_relay_row_delete(idl);
-        return;
-    }
-
-    if (!OVSREC_IDL_ANY_TABLE_ROWS_INSERTED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_MODIFIED(rec_first, idl_seqno)) {
-        /* FIXME: Log to be removed after initial round of testing */
-        VLOG_DBG("No table changes updates");
-        return;
-    }
-
-    /* Process row delete notification */
-    if (OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)) {
-        udpfwd_handle_dhcp_relay_row_delete(idl);
+    /* Process row delete notifications first, a record deleted and
+     * inserted again in one run must end up configured */
+    OVSREC_DHCP_RELAY_FOR_EACH_TRACKED (rec, idl) {
+        if (ovsrec_dhcp_relay_is_deleted(rec)) {
+            udpfwd_handle_row_delete(&rec->header_.uuid);
+        }
     }
 
     /* Process row insert/modify notifications */
-    OVSREC_DHCP_RELAY_FOR_EACH (rec, idl) {
-        if (OVSREC_IDL_IS_ROW_INSERTED(rec, idl_seqno)
-            || OVSREC_IDL_IS_ROW_MODIFIED(rec, idl_seqno)) {
-            udpfwd_handle_dhcp_relay_config_change(rec, idl_seqno);
+    OVSREC_DHCP_RELAY_FOR_EACH_TRACKED (rec, idl) {
+        if (!ovsrec_dhcp_relay_is_deleted(rec)) {
+            udpfwd_handle_dhcp_relay_config_change(rec);
         }
     }
 
-    /* FIXME: Handle the case of NULL port column value. Currently
-     * "no interface" command doesn't seem to be working */
-
     return;
 }
 #endif /* FTR_DHCP_RELAY */
@@ -509,47 +664,30 @@ void dhcp_relay_server_config_update(void)
 /*
  * Function      : udp_bcast_forwarder_server_config_update
  * Responsiblity : Process udp_bcast_forwarder table update notifications from
- *                 OVSDB for the configuration changes.
+ *                 OVSDB for the configuration changes. Only the records
+ *                 changed since the last run are visited.
  * Parameters    : none
  * Return        : none
  */
 void udp_bcast_forwarder_server_config_update(void)
 {
     const struct ovsrec_udp_bcast_forwarder_server *rec = NULL;
-    const struct ovsrec_udp_bcast_forwarder_server *rec_first = NULL;
-
-    /* Check for server configuration changes */
-    rec_first = ovsrec_udp_bcast_forwarder_server_first(idl);
-    if (NULL == rec_first) {
-        /* Check if last entry from the table is deleted */
-        udpfwd_handle_udp_bcast_forwarder_row_delete(idl);
-        return;
-    }
 
-    if (!OVSREC_IDL_ANY_TABLE_ROWS_INSERTED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_MODIFIED(rec_first, idl_seqno)) {
-        /* FIXME: Log to be removed after initial round of testing */
-        VLOG_DBG("No table changes updates");
-        return;
-    }
-
-    /* Process row delete notification */
-    if (OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)) {
-        udpfwd_handle_udp_bcast_forwarder_row_delete(idl);
+    /* Process row delete notifications first, a record deleted and
+     * inserted again in one run must end up configured */
+    OVSREC_UDP_BCAST_FORWARDER_SERVER_FOR_EACH_TRACKED (rec, idl) {
+        if (ovsrec_udp_bcast_forwarder_server_is_deleted(rec)) {
+            udpfwd_handle_row_delete(&rec->header_.uuid);
+        }
     }
 
     /* Process row insert/modify notifications */
-    OVSREC_UDP_BCAST_FORWARDER_SERVER_FOR_EACH (rec, idl) {
-        if (OVSREC_IDL_IS_ROW_INSERTED(rec, idl_seqno)
-            || OVSREC_IDL_IS_ROW_MODIFIED(rec, idl_seqno)) {
+    OVSREC_UDP_BCAST_FORWARDER_SERVER_FOR_EACH_TRACKED (rec, idl) {
+        if (!ovsrec_udp_bcast_forwarder_server_is_deleted(rec)) {
             udpfwd_handle_udp_bcast_forwarder_config_change(rec);
         }
     }
 
-    /* FIXME: Handle the case of NULL port column value. Currently
-     * "no interface" command doesn't seem to be working */
-
     return;
 }
 #endif /* FTR_UDP_BCAST_FWD */
@@ -614,6 +752,20 @@ void udpfwd_reconfigure(void)
     udp_bcast_forwarder_server_config_update();
 #endif /* FTR_UDP_BCAST_FWD */
 
+    /* Make the configuration changes visible to the packet path */
+    udpfwd_publish_interfaces();
+
+    /* Let the forwarded ports through the receive filter */
+    udpfwd_filter_update();
+
+    /* Steer the forwarded ports to the AF_XDP sockets */
+    udpfwd_xsk_update();
+
+#ifdef FTR_UDP_BCAST_FWD
+    /* Load the forwarding snapshots in the kernel fast path */
+    udpfwd_fastpath_update();
+#endif /* FTR_UDP_BCAST_FWD */
+
     return;
 }
 
@@ -633,7 +785,7 @@ static void udpfwd_interface_dump(struct shash_node *node,
     UDPFWD_SERVER_T *server = NULL;
     UDPFWD_SERVER_T **serverArray = NULL;
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
-    int32_t iter = 0;
+    uint32_t iter = 0;
     bool found = false;
     struct in_addr ip_addr;
 
@@ -646,23 +798,23 @@ static void udpfwd_interface_dump(struct shash_node *node,
 
 #ifdef FTR_DHCP_RELAY
     /* Print dhcp-relay statistics */
-    ds_put_format(ds, "client request dropped packets = %d\n",
+    ds_put_format(ds, "client request dropped packets = %"PRIu64"\n",
                   UDPF_DHCPR_CLIENT_DROPS(intfNode));
-    ds_put_format(ds, "client request valid packets = %d\n",
+    ds_put_format(ds, "client request valid packets = %"PRIu64"\n",
                   UDPF_DHCPR_CLIENT_SENT(intfNode));
-    ds_put_format(ds, "server request dropped packets = %d\n",
+    ds_put_format(ds, "server request dropped packets = %"PRIu64"\n",
                   UDPF_DHCPR_SERVER_DROPS(intfNode));
-    ds_put_format(ds, "server request valid packets = %d\n",
+    ds_put_format(ds, "server request valid packets = %"PRIu64"\n",
                   UDPF_DHCPR_SERVER_SENT(intfNode));
 
-    ds_put_format(ds, "client request dropped packets with option 82 = %d\n",
-                  UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode));
-    ds_put_format(ds, "client request valid packets with option 82 = %d\n",
-                  UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode));
-    ds_put_format(ds, "server request dropped packets with option 82 = %d\n",
-                  UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode));
-    ds_put_format(ds, "server request valid packets with option 82 = %d\n",
-                  UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode));
+    ds_put_format(ds, "client request dropped packets with option 82 = %"
+                  PRIu64"\n", UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode));
+    ds_put_format(ds, "client request valid packets with option 82 = %"
+                  PRIu64"\n", UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode));
+    ds_put_format(ds, "server request dropped packets with option 82 = %"
+                  PRIu64"\n", UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode));
+    ds_put_format(ds, "server request valid packets with option 82 = %"
+                  PRIu64"\n", UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode));
 
     /* Print bootp gateway */
     ip_addr.s_addr = intfNode->bootp_gw;
@@ -684,6 +836,11 @@ static void udpfwd_interface_dump(struct shash_node *node,
         ds_put_format(ds, "No IP address associated with this port: %d\n",
                       udp_port);
 
+#ifdef FTR_UDP_BCAST_FWD
+    /* Counters of the kernel fast path */
+    udpfwd_fastpath_dump(ds, intfNode->ifIndex, udp_port);
+#endif /* FTR_UDP_BCAST_FWD */
+
     return;
 }
 
@@ -770,6 +927,88 @@ static void udpfwd_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
     ds_destroy(&ds);
 }
 
+/*
+ * Function      : udpfwd_unixctl_rx_stats
+ * Responsiblity : Dump receive batch fill, filter and neighbor statistics
+ * Parameters    : conn - unixctl socket connection
+ *                 argc, argv - function parameters
+ *                 aux - aux connection data
+ * Return        : none
+ */
+static void udpfwd_unixctl_rx_stats(struct unixctl_conn *conn,
+                   int argc OVS_UNUSED, const char *argv[] OVS_UNUSED,
+                   void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    UDPFWD_RX_BATCH_STATS *stats;
+    uint64_t batches = 0, packets = 0, full_batches = 0, max_fill = 0, fill;
+    uint64_t fill_hist[UDPFWD_RX_BATCH_HIST_SIZE];
+    uint32_t iter, worker;
+
+    memset(fill_hist, 0, sizeof(fill_hist));
+    for (worker = 0; worker < udpfwd_ctrl_cb_p->n_workers; worker++) {
+        stats = &udpfwd_ctrl_cb_p->workers[worker].rx_stats;
+        batches += relay_counter_read(&stats->batches);
+        packets += relay_counter_read(&stats->packets);
+        full_batches += relay_counter_read(&stats->full_batches);
+        fill = relay_counter_read(&stats->max_fill);
+        if (fill > max_fill)
+            max_fill = fill;
+        for (iter = 0; iter < UDPFWD_RX_BATCH_HIST_SIZE; iter++)
+            fill_hist[iter] += relay_counter_read(&stats->fill_hist[iter]);
+    }
+
+    ds_put_format(&ds, "Receive backend : %s\n",
+                  udpfwd_rx_backend_names[udpfwd_ctrl_cb_p->rx_backend]);
+    ds_put_format(&ds, "Receive workers : %d\n",
+                  udpfwd_ctrl_cb_p->n_workers);
+    for (worker = 0; worker < udpfwd_ctrl_cb_p->n_workers; worker++) {
+        stats = &udpfwd_ctrl_cb_p->workers[worker].rx_stats;
+        ds_put_format(&ds, "  Worker %d packets : %"PRIu64"\n", worker,
+                      relay_counter_read(&stats->packets));
+    }
+    ds_put_format(&ds, "Receive batch size : %d\n",
+                  udpfwd_ctrl_cb_p->workers[0].rx_ring.size);
+    ds_put_format(&ds, "Batches : %"PRIu64"\n", batches);
+    ds_put_format(&ds, "Packets : %"PRIu64"\n", packets);
+    ds_put_format(&ds, "Average fill : %.2f\n", batches ?
+                  (double) packets / batches : 0.0);
+    ds_put_format(&ds, "Max fill : %"PRIu64"\n", max_fill);
+    ds_put_format(&ds, "Full batches : %"PRIu64"\n", full_batches);
+
+    ds_put_format(&ds, "Fill histogram :\n");
+    for (iter = 0; iter < UDPFWD_RX_BATCH_HIST_SIZE; iter++) {
+        ds_put_format(&ds, "  %d-%d : %"PRIu64"\n", 1 << iter,
+                      (2 << iter) - 1, fill_hist[iter]);
+    }
+
+    udpfwd_filter_dump(&ds);
+    udpfwd_neigh_dump(&ds);
+    udpfwd_xsk_dump(&ds);
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+/*
+ * Function      : udpfwd_unixctl_addr_index
+ * Responsiblity : Dump the local address to interface index and the
+ *                 counters of the reply path lookups.
+ * Parameters    : conn - unixctl connection
+ * Return        : none
+ */
+static void udpfwd_unixctl_addr_index(struct unixctl_conn *conn,
+                   int argc OVS_UNUSED, const char *argv[] OVS_UNUSED,
+                   void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    udpfwd_intf_cache_addr_index_dump(&ds);
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
 /*
  * Function      : udpfwd_exit
  * Responsiblity : Daemon cleanup before exit
@@ -778,12 +1017,161 @@ static void udpfwd_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
  */
 void udpfwd_exit(void)
 {
-    /* free memory for packet receive buffer */
-    if (0 < udpfwd_ctrl_cb_p->udpSockFd)
-        close(udpfwd_ctrl_cb_p->udpSockFd);
+    /* Close the worker sockets and free their receive rings */
+    udpfwd_rx_workers_destroy();
+
+    /* Release the receive filter counter */
+    udpfwd_filter_exit();
+
+    /* Release the neighbor caches */
+    udpfwd_neigh_exit();
 
-    if (NULL != udpfwd_ctrl_cb_p->rcvbuff)
-        free(udpfwd_ctrl_cb_p->rcvbuff);
+    /* Detach the XDP programs and release the AF_XDP sockets */
+    udpfwd_xsk_exit();
+
+#ifdef FTR_UDP_BCAST_FWD
+    /* Detach the fast path program */
+    udpfwd_fastpath_exit();
+#endif /* FTR_UDP_BCAST_FWD */
+
+    /* Stop tracking kernel interfaces */
+    udpfwd_intf_cache_exit();
+}
+
+/*
+ * Function      : udpfwd_run
+ * Responsiblity : Process pending kernel interface notifications,
+ *                 rekey the forwarding snapshots of interfaces which moved
+ *                 refresh the neighbor cache lifetime and the local
+ *                 addresses of the XDP programs and of the fast path
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_run(void)
+{
+    /* Forwarding snapshots are keyed on ifindex, follow the links */
+    if (udpfwd_intf_cache_run()) {
+        udpfwd_resolve_interfaces();
+#ifdef FTR_UDP_BCAST_FWD
+        udpfwd_fastpath_update();
+#endif /* FTR_UDP_BCAST_FWD */
+    }
+
+    /* Follow the kernel neighbor reachable time */
+    udpfwd_neigh_run();
+
+    /* Follow the local addresses in the XDP programs */
+    udpfwd_xsk_run();
+
+#ifdef FTR_UDP_BCAST_FWD
+    /* Interfaces without address are left to user space */
+    udpfwd_fastpath_run();
+#endif /* FTR_UDP_BCAST_FWD */
+}
+
+/*
+ * Function      : udpfwd_wait
+ * Responsiblity : Register the module events with the poll loop
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_wait(void)
+{
+    udpfwd_intf_cache_wait();
+}
+
+/*
+ * Function      : udpfwd_set_rx_batch_size
+ * Responsiblity : Set the number of packets received per recvmmsg() call.
+ *                 Must be called before udpfwd_init().
+ * Parameters    : batch_size - receive batch size
+ * Return        : none
+ */
+void udpfwd_set_rx_batch_size(uint32_t batch_size)
+{
+    if ((0 == batch_size) || (UDPFWD_RX_BATCH_MAX < batch_size)) {
+        VLOG_ERR("Invalid receive batch size %d, using %d", batch_size,
+                 UDPFWD_RX_BATCH_DEFAULT);
+        batch_size = UDPFWD_RX_BATCH_DEFAULT;
+    }
+
+    udpfwd_rx_batch_size = batch_size;
+}
+
+/*
+ * Function      : udpfwd_set_rx_workers
+ * Responsiblity : Set the number of receive worker threads.
+ *                 Must be called before udpfwd_init().
+ * Parameters    : n_workers - number of receive workers
+ * Return        : none
+ */
+void udpfwd_set_rx_workers(uint32_t n_workers)
+{
+    if ((0 == n_workers) || (UDPFWD_RX_WORKERS_MAX < n_workers)) {
+        VLOG_ERR("Invalid number of receive workers %d, using %d", n_workers,
+                 UDPFWD_RX_WORKERS_DEFAULT);
+        n_workers = UDPFWD_RX_WORKERS_DEFAULT;
+    }
+
+    udpfwd_rx_workers = n_workers;
+}
+
+/*
+ * Function      : udpfwd_set_intf_servers_max
+ * Responsiblity : Set the number of servers allowed on an interface, over
+ *                 all of its UDP ports. Must be called before udpfwd_init().
+ * Parameters    : max - servers per interface
+ * Return        : none
+ */
+void udpfwd_set_intf_servers_max(uint32_t max)
+{
+    if ((0 == max) || (UDPFWD_INTF_SERVERS_MAX < max)) {
+        VLOG_ERR("Invalid number of servers per interface %d, using %d", max,
+                 UDPFWD_INTF_SERVERS_DEFAULT);
+        max = UDPFWD_INTF_SERVERS_DEFAULT;
+    }
+
+    udpfwd_intf_servers_max = max;
+}
+
+/*
+ * Function      : udpfwd_set_rx_backend
+ * Responsiblity : Select how the workers receive, "socket" for recvmmsg()
+ *                 on the raw UDP socket, "tpacket" for a TPACKET_V3 ring
+ *                 or "xdp" for AF_XDP sockets next to the raw socket.
+ *                 Must be called before udpfwd_init().
+ * Parameters    : name - backend name
+ * Return        : true, if the backend is known
+ *                 false, otherwise
+ */
+bool udpfwd_set_rx_backend(const char *name)
+{
+    if (!strcmp(name, "socket")) {
+        udpfwd_rx_backend = UDPFWD_RX_BACKEND_SOCKET;
+    } else if (!strcmp(name, "tpacket")) {
+        udpfwd_rx_backend = UDPFWD_RX_BACKEND_TPACKET;
+    } else if (!strcmp(name, "xdp")) {
+        udpfwd_rx_backend = UDPFWD_RX_BACKEND_XDP;
+    } else {
+        VLOG_ERR("Unknown receive backend %s", name);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_set_l2_replies
+ * Responsiblity : Send DHCP client replies as Ethernet frames addressed to
+ *                 the client hardware address, instead of through the IP
+ *                 stack and a neighbor entry. Must be called before
+ *                 udpfwd_init().
+ * Parameters    : enable - true to enable L2 replies
+ * Return        : none
+ */
+void udpfwd_set_l2_replies(bool enable)
+{
+    udpfwd_l2_replies = enable;
 }
 
 /*
@@ -810,6 +1198,12 @@ bool udpfwd_init(void)
 
     ovsdb_idl_add_column(idl,
                            &ovsrec_dhcp_relay_col_other_config);
+
+    /* Visit only the changed records on a configuration update */
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_port);
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_vrf);
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_ipv4_ucast_server);
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_other_config);
 #endif /* FTR_DHCP_RELAY */
 
     /* Register for UDP_Bcast_Forwarder table updates */
@@ -820,6 +1214,16 @@ bool udpfwd_init(void)
     ovsdb_idl_add_column(idl, &ovsrec_udp_bcast_forwarder_server_col_udp_dport);
     ovsdb_idl_add_column(idl,
                          &ovsrec_udp_bcast_forwarder_server_col_ipv4_ucast_server);
+
+    /* Visit only the changed records on a configuration update */
+    ovsdb_idl_track_add_column(idl,
+                         &ovsrec_udp_bcast_forwarder_server_col_src_port);
+    ovsdb_idl_track_add_column(idl,
+                         &ovsrec_udp_bcast_forwarder_server_col_dest_vrf);
+    ovsdb_idl_track_add_column(idl,
+                         &ovsrec_udp_bcast_forwarder_server_col_udp_dport);
+    ovsdb_idl_track_add_column(idl,
+                         &ovsrec_udp_bcast_forwarder_server_col_ipv4_ucast_server);
 #endif /* FTR_UDP_BCAST_FWD */
 
     /* Register for port table for dhcp_relay_statistics update */
@@ -838,6 +1242,10 @@ bool udpfwd_init(void)
 
     unixctl_command_register("udpfwd/dump", "", 0, 4,
                              udpfwd_unixctl_dump, NULL);
+    unixctl_command_register("udpfwd/rx-stats", "", 0, 0,
+                             udpfwd_unixctl_rx_stats, NULL);
+    unixctl_command_register("udpfwd/addr-index", "", 0, 0,
+                             udpfwd_unixctl_addr_index, NULL);
 
     return true;
 }
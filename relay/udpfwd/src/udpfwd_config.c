@@ -27,9 +27,32 @@
 #include "udpfwd_common.h"
 #include "hash.h"
 #include "udpfwd_util.h"
+#include "ovs-rcu.h"
+#include "udpfwd_intf_cache.h"
+#include "relay_pool.h"
 
 VLOG_DEFINE_THIS_MODULE(udpfwd_config);
 
+/* Object pools of the configuration */
+static RELAY_POOL udpfwd_server_pool =
+    RELAY_POOL_INITIALIZER("udpfwd-servers", sizeof(UDPFWD_SERVER_T), 16);
+static RELAY_POOL udpfwd_intf_pool =
+    RELAY_POOL_INITIALIZER("udpfwd-interfaces",
+                           sizeof(UDPFWD_INTERFACE_NODE_T), 16);
+static RELAY_POOL udpfwd_row_pool =
+    RELAY_POOL_INITIALIZER("udpfwd-rows", sizeof(UDPFWD_ROW_REF), 16);
+static RELAY_POOL udpfwd_array_pools[UDPFWD_ARRAY_POOLS] = {
+    RELAY_POOL_INITIALIZER("udpfwd-server-arrays-4", UDPFWD_SERVER_BLOCK(4),
+                           RELAY_POOL_CACHE_LINE),
+    RELAY_POOL_INITIALIZER("udpfwd-server-arrays-8", UDPFWD_SERVER_BLOCK(8),
+                           RELAY_POOL_CACHE_LINE),
+    RELAY_POOL_INITIALIZER("udpfwd-server-arrays-16",
+                           UDPFWD_SERVER_BLOCK(16), RELAY_POOL_CACHE_LINE),
+};
+
+/* A snapshot was published or withdrawn since the port bitmap was built */
+static bool udpfwd_ports_dirty = true;
+
 /*
  * Function      : udpfwd_get_server_entry
  * Responsiblity : Lookup the hash map for a specific server entry
@@ -68,7 +91,7 @@ UDPFWD_SERVER_T* udpfwd_add_server_entry(IP_ADDRESS ipaddress, uint16_t udpPort)
 
     /* FIXME: Add a check for global maximum server count */
 
-    serverIP = (UDPFWD_SERVER_T *) malloc (sizeof(UDPFWD_SERVER_T));
+    serverIP = (UDPFWD_SERVER_T *) relay_pool_alloc(&udpfwd_server_pool);
     if (NULL == serverIP) {
         VLOG_ERR("Failed to allocate memory for the server entry for "
                  "ip: %x, port: %d", ipaddress, udpPort);
@@ -86,135 +109,612 @@ UDPFWD_SERVER_T* udpfwd_add_server_entry(IP_ADDRESS ipaddress, uint16_t udpPort)
 }
 
 /*
- * Function      : udpfwd_push_deleted_server_ref_to_end
- * Responsiblity : Move the deleted entry from the server array to the end
+ * Function      : udpfwd_get_fwd_snapshot
+ * Responsiblity : Lookup the forwarding snapshot of an interface. Safe from
+ *                 the packet path, the snapshot stays valid until the
+ *                 calling thread quiesces.
+ * Parameters    : ifIndex - interface index
+ * Return        : UDPFWD_FWD_SNAPSHOT* - forwarding snapshot if found
+ *                 NULL - otherwise
+ */
+const UDPFWD_FWD_SNAPSHOT *udpfwd_get_fwd_snapshot(uint32_t ifIndex)
+{
+    const UDPFWD_FWD_SNAPSHOT *snapshot;
+
+    CMAP_FOR_EACH_WITH_HASH(snapshot, cmap_node, hash_int(ifIndex, 0),
+                            &udpfwd_ctrl_cb_p->fwdMap) {
+        if (snapshot->ifIndex == ifIndex) {
+            return snapshot;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : udpfwd_get_fwd_port
+ * Responsiblity : Lookup the destinations of a UDP port in a forwarding
+ *                 snapshot
+ * Parameters    : snapshot - forwarding snapshot
+ *                 udp_port - UDP destination port
+ * Return        : UDPFWD_FWD_PORT* - servers of the port, in
+ *                 snapshot->servers, if found
+ *                 NULL - otherwise
+ */
+const UDPFWD_FWD_PORT *udpfwd_get_fwd_port(
+              const UDPFWD_FWD_SNAPSHOT *snapshot, uint16_t udp_port)
+{
+    uint32_t low = 0, high = snapshot->portCount, mid;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (snapshot->ports[mid].udp_port == udp_port)
+            return &snapshot->ports[mid];
+        if (snapshot->ports[mid].udp_port < udp_port)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : udpfwd_port_of_interest
+ * Responsiblity : Check whether a UDP port has a consumer on any
+ *                 interface. Safe from the packet path.
+ * Parameters    : udp_port - UDP destination port
+ * Return        : true, if datagrams to the port are handled
+ *                 false, otherwise
+ */
+bool udpfwd_port_of_interest(uint16_t udp_port)
+{
+    const UDPFWD_PORT_BITMAP *bitmap;
+
+    bitmap = ovsrcu_get(UDPFWD_PORT_BITMAP *, &udpfwd_ctrl_cb_p->portBitmap);
+
+    return (NULL != bitmap) &&
+           (bitmap->bits[udp_port / 8] & (1 << (udp_port % 8)));
+}
+
+/*
+ * Function      : udpfwd_publish_port_bitmap
+ * Responsiblity : Build the bitmap of the ports of interest from the DHCP
+ *                 ports and the ports of the published snapshots, and
+ *                 replace the previous one
+ * Parameters    : none
+ * Return        : none
+ */
+static void udpfwd_publish_port_bitmap(void)
+{
+    UDPFWD_PORT_BITMAP *bitmap, *old;
+    const UDPFWD_FWD_SNAPSHOT *snapshot;
+    uint16_t udp_port;
+    uint32_t iter;
+
+    bitmap = (UDPFWD_PORT_BITMAP *) calloc(1, sizeof(UDPFWD_PORT_BITMAP));
+    if (NULL == bitmap) {
+        /* Keep the old bitmap, rebuilt on next reconfigure */
+        VLOG_ERR("Failed to allocate the port bitmap");
+        return;
+    }
+
+#ifdef FTR_DHCP_RELAY
+    bitmap->bits[DHCPS_PORT / 8] |= 1 << (DHCPS_PORT % 8);
+    bitmap->bits[DHCPC_PORT / 8] |= 1 << (DHCPC_PORT % 8);
+#endif /* FTR_DHCP_RELAY */
+
+    CMAP_FOR_EACH(snapshot, cmap_node, &udpfwd_ctrl_cb_p->fwdMap) {
+        for (iter = 0; iter < snapshot->portCount; iter++) {
+            udp_port = snapshot->ports[iter].udp_port;
+            bitmap->bits[udp_port / 8] |= 1 << (udp_port % 8);
+        }
+    }
+
+    old = ovsrcu_get_protected(UDPFWD_PORT_BITMAP *,
+                               &udpfwd_ctrl_cb_p->portBitmap);
+    ovsrcu_set(&udpfwd_ctrl_cb_p->portBitmap, bitmap);
+    if (NULL != old)
+        ovsrcu_postpone(free, old);
+
+    udpfwd_ports_dirty = false;
+}
+
+/*
+ * Function      : udpfwd_unpublish_interface
+ * Responsiblity : Withdraw the forwarding snapshot of an interface
  * Parameters    : intfNode - Interface entry
- *                 deleted_index - Index in the server array of the interface
  * Return        : none
  */
-void udpfwd_push_deleted_server_ref_to_end(UDPFWD_INTERFACE_NODE_T *intfNode,
-                int deleted_index)
+static void udpfwd_unpublish_interface(UDPFWD_INTERFACE_NODE_T *intfNode)
 {
+    UDPFWD_FWD_SNAPSHOT *snapshot = intfNode->fwdSnapshot;
 
-   uint8_t       currentAddrCount = 0;
-   UDPFWD_SERVER_T *server;
-   UDPFWD_SERVER_T **serverArray = intfNode->serverArray;
+    if (NULL == snapshot)
+        return;
+
+    cmap_remove(&udpfwd_ctrl_cb_p->fwdMap, &snapshot->cmap_node,
+                hash_int(snapshot->ifIndex, 0));
+    ovsrcu_postpone(free, snapshot);
+    intfNode->fwdSnapshot = NULL;
+    udpfwd_ports_dirty = true;
+}
 
-   currentAddrCount = intfNode->addrCount;
+/*
+ * Function      : udpfwd_fwd_port_bound
+ * Responsiblity : Find where a UDP port is, or would be inserted, in a
+ *                 sorted port table
+ * Parameters    : ports - port table
+ *                 portCount - number of ports
+ *                 udp_port - UDP destination port
+ * Return        : position of the first port not below udp_port
+ */
+static uint32_t udpfwd_fwd_port_bound(const UDPFWD_FWD_PORT *ports,
+                                      uint32_t portCount, uint16_t udp_port)
+{
+    uint32_t low = 0, high = portCount, mid;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (ports[mid].udp_port < udp_port)
+            low = mid + 1;
+        else
+            high = mid;
+    }
 
-   /* Move the NULL at the end of the list */
-   server = serverArray[currentAddrCount];
-   serverArray[currentAddrCount] = serverArray[deleted_index] = NULL;
-   serverArray[deleted_index] = server;
+    return low;
 }
 
 /*
- * Function      : udpfwd_remove_server_ref_entry
- * Responsiblity : Remove reference to a server entry from an interface entry
+ * Function      : udpfwd_publish_interface
+ * Responsiblity : Build a forwarding snapshot from the current configuration
+ *                 of an interface and make it visible to the packet path
+ *                 under the interface index. The servers are grouped by
+ *                 UDP port behind a sorted port table, so that a packet
+ *                 finds its destinations with one lookup. The previous
+ *                 snapshot is freed after a grace period.
  * Parameters    : intfNode - Interface entry
- *                 ipaddress - server IP address
- *                 udpPort - destination udp port
- *                 deleted_index - Index in the server array
- * Return        : true - if the entry is successfully dereferenced
- *                 false - entry not found
+ * Return        : none
  */
-bool udpfwd_remove_server_ref_entry(UDPFWD_INTERFACE_NODE_T *intfNode,
-                                     IP_ADDRESS ipaddress, uint16_t udpPort,
-                                     int *deleted_index)
+static void udpfwd_publish_interface(UDPFWD_INTERFACE_NODE_T *intfNode)
 {
-    uint8_t index = 0;
-    UDPFWD_SERVER_T **serverArray = NULL;
+    UDPFWD_FWD_SNAPSHOT *snapshot, *old = intfNode->fwdSnapshot;
+    UDPFWD_FWD_PORT *ports = NULL, *port;
     UDPFWD_SERVER_T *server;
+    uint32_t iter, pos, next, portCount = 0;
 
-    serverArray = intfNode->serverArray;
-    /* Find the entry in Server IP Table & free the memory (structFree) if
-     * ref_count is zero */
-    for ( ; index < intfNode->addrCount; index++)
-    {
-        if ((serverArray[index]->ip_address == ipaddress) &&
-            (serverArray[index]->udp_port == udpPort))
-        /* check if address & port exist in table */
-        {
-            VLOG_INFO("Address to be deleted found in interface : %s",
-                      intfNode->portName);
-            server = serverArray[index];
-            assert(server->ref_count);
-            /* Decrement server reference Count */
-            server->ref_count--;
-            /* If reference count becomes zero */
-            if(0 >= server->ref_count)
-            {
-                VLOG_INFO("server reference count reached 0. Freeing entry");
-                cmap_remove(&udpfwd_ctrl_cb_p->serverHashMap,
-                            (struct cmap_node *)server,
-                            hash_int(ipaddress, udpPort));
-                free(server);
-            }
+    /* Interface index moved or disappeared, withdraw the old version */
+    if ((NULL != old) && (old->ifIndex != intfNode->ifIndex)) {
+        udpfwd_unpublish_interface(intfNode);
+        old = NULL;
+    }
+
+    if (0 == intfNode->ifIndex) {
+        /* Not known by the kernel yet, published once the link shows up */
+        intfNode->dirty = false;
+        return;
+    }
 
-            *deleted_index = index;
-            /*Make the IP ref Table entry NULL*/
-            serverArray[index] = NULL;
-            return true;
+    /* Sorted table of the distinct ports with their server count */
+    if (0 != intfNode->addrCount) {
+        ports = (UDPFWD_FWD_PORT *) malloc(intfNode->addrCount *
+                                           sizeof(UDPFWD_FWD_PORT));
+        if (NULL == ports) {
+            /* Keep the interface dirty, retried on next reconfigure */
+            VLOG_ERR("Failed to allocate port table for interface : %s",
+                     intfNode->portName);
+            return;
+        }
+    }
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        server = intfNode->serverArray[iter];
+        pos = udpfwd_fwd_port_bound(ports, portCount, server->udp_port);
+        if ((pos == portCount) || (ports[pos].udp_port != server->udp_port)) {
+            memmove(&ports[pos + 1], &ports[pos],
+                    (portCount - pos) * sizeof(UDPFWD_FWD_PORT));
+            ports[pos].udp_port = server->udp_port;
+            ports[pos].count = 0;
+            portCount++;
+        }
+        ports[pos].count++;
+    }
+
+    /* The port table follows the servers in the same block, which starts
+     * on a cache line with the fields read for every packet */
+    if (posix_memalign((void **) &snapshot, RELAY_POOL_CACHE_LINE,
+                       sizeof(UDPFWD_FWD_SNAPSHOT) +
+                       intfNode->addrCount * sizeof(IP_ADDRESS) +
+                       portCount * sizeof(UDPFWD_FWD_PORT))) {
+        /* Keep the interface dirty, publish is retried on next reconfigure */
+        VLOG_ERR("Failed to allocate forwarding snapshot for interface : %s",
+                 intfNode->portName);
+        free(ports);
+        return;
+    }
+
+    snapshot->ifIndex = intfNode->ifIndex;
+    snapshot->bootp_gw = intfNode->bootp_gw;
+#ifdef FTR_DHCP_RELAY
+    snapshot->pktCounters = intfNode->pktCounters;
+    /* Republished on a bootp gateway change */
+    dhcp_relay_option82_template(&snapshot->bootpGwOption82,
+                                 snapshot->ifIndex, REMOTE_ID_IP,
+                                 snapshot->bootp_gw ? &snapshot->bootp_gw :
+                                                      NULL);
+#endif /* FTR_DHCP_RELAY */
+    snapshot->serverCount = intfNode->addrCount;
+    snapshot->portCount = portCount;
+    snapshot->ports = (UDPFWD_FWD_PORT *)
+                      &snapshot->servers[intfNode->addrCount];
+    if (0 != portCount)
+        memcpy(snapshot->ports, ports, portCount * sizeof(UDPFWD_FWD_PORT));
+    free(ports);
+
+    /* Servers of each port follow each other, in configuration order */
+    for (next = 0, pos = 0; pos < snapshot->portCount; pos++) {
+        snapshot->ports[pos].first = next;
+        next += snapshot->ports[pos].count;
+        snapshot->ports[pos].count = 0;
+    }
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        server = intfNode->serverArray[iter];
+        port = (UDPFWD_FWD_PORT *) udpfwd_get_fwd_port(snapshot,
+                                                       server->udp_port);
+        snapshot->servers[port->first + port->count++] = server->ip_address;
+    }
+
+    if (NULL != old) {
+        cmap_replace(&udpfwd_ctrl_cb_p->fwdMap, &old->cmap_node,
+                     &snapshot->cmap_node, hash_int(snapshot->ifIndex, 0));
+        ovsrcu_postpone(free, old);
+    } else {
+        cmap_insert(&udpfwd_ctrl_cb_p->fwdMap, &snapshot->cmap_node,
+                    hash_int(snapshot->ifIndex, 0));
+    }
+
+    intfNode->fwdSnapshot = snapshot;
+    intfNode->dirty = false;
+    udpfwd_ports_dirty = true;
+}
+
+/*
+ * Function      : udpfwd_publish_interfaces
+ * Responsiblity : Publish a new forwarding snapshot for every interface
+ *                 whose configuration changed. Called once per reconfigure
+ *                 so that a large config push creates one version per
+ *                 interface, and one version of the port bitmap.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_publish_interfaces(void)
+{
+    struct shash_node *node;
+    UDPFWD_INTERFACE_NODE_T *intfNode;
+
+    SHASH_FOR_EACH(node, &udpfwd_ctrl_cb_p->intfHashTable) {
+        intfNode = (UDPFWD_INTERFACE_NODE_T *) node->data;
+        if (intfNode->dirty)
+            udpfwd_publish_interface(intfNode);
+    }
+
+    if (udpfwd_ports_dirty)
+        udpfwd_publish_port_bitmap();
+}
+
+/*
+ * Function      : udpfwd_resolve_interfaces
+ * Responsiblity : Refresh the interface index of every configured interface
+ *                 after kernel interfaces were added, removed or renamed and
+ *                 republish the ones which moved.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_resolve_interfaces(void)
+{
+    struct shash_node *node;
+    UDPFWD_INTERFACE_NODE_T *intfNode;
+    uint32_t ifIndex;
+
+    SHASH_FOR_EACH(node, &udpfwd_ctrl_cb_p->intfHashTable) {
+        intfNode = (UDPFWD_INTERFACE_NODE_T *) node->data;
+        ifIndex = udpfwd_intf_cache_ifindex_by_name(intfNode->portName);
+        if (ifIndex != intfNode->ifIndex) {
+            VLOG_DBG("Interface %s moved from ifindex %d to %d",
+                     intfNode->portName, intfNode->ifIndex, ifIndex);
+            intfNode->ifIndex = ifIndex;
+            intfNode->dirty = true;
         }
     }
 
-    return false;
+    udpfwd_publish_interfaces();
+}
+
+/*
+ * Function      : udpfwd_find_server_ref
+ * Responsiblity : Lookup a server in the configuration of an interface
+ * Parameters    : intfNode - Interface entry
+ *                 ipaddress - server IP address
+ *                 udpPort - destination udp port
+ * Return        : position of the server in the server array
+ *                 -1 - if the server is not configured on the interface
+ */
+static int32_t udpfwd_find_server_ref(const UDPFWD_INTERFACE_NODE_T *intfNode,
+                                      IP_ADDRESS ipaddress, uint16_t udpPort)
+{
+    const UDPFWD_SERVER_T *server;
+    uint32_t slot, pos;
+
+    if (NULL == intfNode->serverIndex)
+        return -1;
+
+    /* A removed server leaves a NULL entry which continues the probe */
+    slot = hash_int(ipaddress, udpPort) & intfNode->indexMask;
+    while (0 != (pos = intfNode->serverIndex[slot])) {
+        server = intfNode->serverArray[pos - 1];
+        if ((NULL != server) && (server->ip_address == ipaddress) &&
+            (server->udp_port == udpPort))
+            return pos - 1;
+        slot = (slot + 1) & intfNode->indexMask;
+    }
+
+    return -1;
+}
+
+/*
+ * Function      : udpfwd_index_server_ref
+ * Responsiblity : Add an entry of the server array to the server index
+ * Parameters    : intfNode - Interface entry
+ *                 pos - position in the server array
+ * Return        : none
+ */
+static void udpfwd_index_server_ref(UDPFWD_INTERFACE_NODE_T *intfNode,
+                                    uint32_t pos)
+{
+    const UDPFWD_SERVER_T *server = intfNode->serverArray[pos];
+    uint32_t slot;
+
+    slot = hash_int(server->ip_address, server->udp_port) &
+           intfNode->indexMask;
+    while (0 != intfNode->serverIndex[slot])
+        slot = (slot + 1) & intfNode->indexMask;
+    intfNode->serverIndex[slot] = pos + 1;
+}
+
+/*
+ * Function      : udpfwd_server_array_pool
+ * Responsiblity : Find the pool of the server arrays of a size
+ * Parameters    : addrMax - servers of the array
+ * Return        : RELAY_POOL* - pool of the arrays
+ *                 NULL - if the arrays come from the heap
+ */
+static RELAY_POOL *udpfwd_server_array_pool(uint32_t addrMax)
+{
+    uint32_t iter;
+
+    for (iter = 0; iter < UDPFWD_ARRAY_POOLS; iter++) {
+        if (addrMax == (UDPFWD_ARRAY_POOL_MIN << iter))
+            return &udpfwd_array_pools[iter];
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : udpfwd_free_server_array
+ * Responsiblity : Free the server array of an interface with its index
+ * Parameters    : serverArray - server array, or NULL
+ *                 addrMax - servers of the array
+ * Return        : none
+ */
+static void udpfwd_free_server_array(UDPFWD_SERVER_T **serverArray,
+                                     uint32_t addrMax)
+{
+    RELAY_POOL *pool = udpfwd_server_array_pool(addrMax);
+
+    if (NULL != pool)
+        relay_pool_free(pool, serverArray);
+    else
+        free(serverArray);
+}
+
+/*
+ * Function      : udpfwd_grow_server_refs
+ * Responsiblity : Double the server array of an interface, up to the
+ *                 servers allowed on an interface, and rebuild the server
+ *                 index at less than half load. The index is allocated
+ *                 with the array, right after it.
+ * Parameters    : intfNode - Interface entry
+ * Return        : true - if there is room for one more server
+ *                 false - otherwise
+ */
+static bool udpfwd_grow_server_refs(UDPFWD_INTERFACE_NODE_T *intfNode)
+{
+    UDPFWD_SERVER_T **serverArray;
+    RELAY_POOL *pool;
+    uint32_t addrMax, slots, iter;
+
+    addrMax = intfNode->addrMax ? (2 * intfNode->addrMax) :
+                                  UDPFWD_ARRAY_POOL_MIN;
+    if (addrMax > udpfwd_ctrl_cb_p->intf_servers_max)
+        addrMax = udpfwd_ctrl_cb_p->intf_servers_max;
+    for (slots = 8; slots < (2 * addrMax); slots <<= 1);
+
+    pool = udpfwd_server_array_pool(addrMax);
+    if (NULL != pool)
+        serverArray = (UDPFWD_SERVER_T **) relay_pool_alloc(pool);
+    else
+        serverArray = (UDPFWD_SERVER_T **)
+                      malloc(addrMax * sizeof(UDPFWD_SERVER_T *) +
+                             slots * sizeof(uint32_t));
+    if (NULL == serverArray) {
+        VLOG_ERR("Failed to allocate server array for interface : %s",
+                 intfNode->portName);
+        return false;
+    }
+
+    if (0 != intfNode->addrCount)
+        memcpy(serverArray, intfNode->serverArray,
+               intfNode->addrCount * sizeof(UDPFWD_SERVER_T *));
+    udpfwd_free_server_array(intfNode->serverArray, intfNode->addrMax);
+
+    intfNode->serverArray = serverArray;
+    intfNode->serverIndex = (uint32_t *) &serverArray[addrMax];
+    intfNode->addrMax = addrMax;
+    intfNode->indexMask = slots - 1;
+    memset(intfNode->serverIndex, 0, slots * sizeof(uint32_t));
+
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        if (NULL != intfNode->serverArray[iter])
+            udpfwd_index_server_ref(intfNode, iter);
+    }
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_drop_server_ref
+ * Responsiblity : Remove a server from an interface and dereference the
+ *                 server entry. The array entry is left NULL until the
+ *                 next udpfwd_compact_server_refs().
+ * Parameters    : intfNode - Interface entry
+ *                 pos - position in the server array
+ * Return        : none
+ */
+static void udpfwd_drop_server_ref(UDPFWD_INTERFACE_NODE_T *intfNode,
+                                   uint32_t pos)
+{
+    UDPFWD_SERVER_T *server = intfNode->serverArray[pos];
+
+    VLOG_INFO("Deleting server : %d, udp_port : %d on interface : %s",
+              server->ip_address, server->udp_port, intfNode->portName);
+
+    assert(server->ref_count);
+    server->ref_count--;
+    if (0 == server->ref_count) {
+        VLOG_INFO("server reference count reached 0. Freeing entry");
+        cmap_remove(&udpfwd_ctrl_cb_p->serverHashMap,
+                    (struct cmap_node *)server,
+                    hash_int(server->ip_address, server->udp_port));
+        relay_pool_free(&udpfwd_server_pool, server);
+    }
+
+    intfNode->serverArray[pos] = NULL;
+    intfNode->dirty = true;
+}
+
+/*
+ * Function      : udpfwd_compact_server_refs
+ * Responsiblity : Close the gaps left by the removed servers of an
+ *                 interface, keeping the others in configuration order,
+ *                 and rebuild the server index. Both are freed with the
+ *                 last server.
+ * Parameters    : intfNode - Interface entry
+ * Return        : none
+ */
+static void udpfwd_compact_server_refs(UDPFWD_INTERFACE_NODE_T *intfNode)
+{
+    uint32_t iter, count = 0;
+
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        if (NULL != intfNode->serverArray[iter])
+            intfNode->serverArray[count++] = intfNode->serverArray[iter];
+    }
+    intfNode->addrCount = count;
+
+    VLOG_INFO("Interface server reference count after delete : %d",
+              intfNode->addrCount);
+
+    if (0 == count) {
+        udpfwd_free_server_array(intfNode->serverArray, intfNode->addrMax);
+        intfNode->serverArray = NULL;
+        intfNode->serverIndex = NULL;
+        intfNode->addrMax = 0;
+        intfNode->indexMask = 0;
+        return;
+    }
+
+    memset(intfNode->serverIndex, 0,
+           (intfNode->indexMask + 1) * sizeof(uint32_t));
+    for (iter = 0; iter < count; iter++)
+        udpfwd_index_server_ref(intfNode, iter);
+}
+
+/*
+ * Function      : udpfwd_free_interface_node
+ * Responsiblity : Free an interface entry with its name and its
+ *                 statistics counters
+ * Parameters    : intfNode - Interface entry
+ * Return        : none
+ */
+static void udpfwd_free_interface_node(UDPFWD_INTERFACE_NODE_T *intfNode)
+{
+#ifdef FTR_DHCP_RELAY
+    free(intfNode->pktCounters);
+#endif /* FTR_DHCP_RELAY */
+    relay_pool_strfree(&relay_name_pool, intfNode->portName);
+    relay_pool_free(&udpfwd_intf_pool, intfNode);
+}
+
+/*
+ * Function      : udpfwd_release_unused_interface
+ * Responsiblity : Free an interface entry left without server nor bootp
+ *                 gateway
+ * Parameters    : intfNode - Interface entry
+ * Return        : none
+ */
+static void udpfwd_release_unused_interface(UDPFWD_INTERFACE_NODE_T *intfNode)
+{
+    struct shash_node *node;
+
+    if ((0 != intfNode->addrCount) || (0 != intfNode->bootp_gw))
+        return;
+
+    VLOG_INFO("All configuration on the interface : %s are removed."
+              " Freeing interface entry", intfNode->portName);
+    udpfwd_unpublish_interface(intfNode);
+    node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, intfNode->portName);
+    if (NULL != node)
+    {
+        shash_delete(&udpfwd_ctrl_cb_p->intfHashTable, node);
+    }
+    else
+    {
+        VLOG_ERR("Interface node not found in hash table : %s",
+                 intfNode->portName);
+    }
+    /* The packet path may still use the statistics counters */
+    ovsrcu_postpone(udpfwd_free_interface_node, intfNode);
 }
 
 /*
  * Function      : udpfwd_store_address
- * Responsiblity : Add a server reference to an interface
+ * Responsiblity : Add a server reference to an interface, after its other
+ *                 servers
  * Parameters    : intfNode - Interface entry
  *                 ipaddress - server IP address
  *                 udpPort - destination udp port
- * Return        : true - if the entry is successfully added
+ * Return        : true - if the entry is added or already present
  *                 false - otherwise
  */
 bool udpfwd_store_address(UDPFWD_INTERFACE_NODE_T *intfNode,
                           IP_ADDRESS ipaddress, uint16_t udpPort)
 {
-   UDPFWD_SERVER_T  *server;
+    UDPFWD_SERVER_T  *server;
+
+    if (0 <= udpfwd_find_server_ref(intfNode, ipaddress, udpPort))
+        return true;
 
-   if(intfNode->addrCount >= MAX_UDP_BCAST_SERVER_PER_INTERFACE)
-   {
+    if (intfNode->addrCount >= udpfwd_ctrl_cb_p->intf_servers_max)
+    {
         VLOG_ERR("Maximum udp server configuration limit reached on interface"
                   " %s (count : %d)", intfNode->portName, intfNode->addrCount);
         return false;
-   }
-
-   sem_wait(&udpfwd_ctrl_cb_p->waitSem);
-
-   /* If address count is non zero but the addrses is NULL, return error */
-   if((0 != intfNode->addrCount) && (NULL == intfNode->serverArray))
-   {
-         VLOG_ERR("Address count is [%d], but server IP address ref array "
-                  "is NULL for Interface [%s] while storing a server ref",
-                  intfNode->addrCount, intfNode->portName);
-         sem_post(&udpfwd_ctrl_cb_p->waitSem);
-         return false;
-   }
-
-   /* There is no server table pointers for this interface, we will allocate
-    * memory for this array of server entry pointers */
-   else if(intfNode->serverArray == NULL)
-   {
-      intfNode->addrCount = 0;
-      /* FIXME: Static allocation needs to be avoided.
-       *     1. one proposal is to have 4 server arrays which
-       *        are allocated on need basis
-       *     2. Have statically allocated array of server pointer and maintain
-       *        free/allocated list */
-      intfNode->serverArray = (UDPFWD_SERVER_T **)
-                              malloc(MAX_UDP_BCAST_SERVER_PER_INTERFACE
-                                     * sizeof(UDPFWD_SERVER_T *));
-      if (NULL == intfNode->serverArray) {
-          VLOG_ERR("Failed to allocate server array for interface : %s",
-                   intfNode->portName);
-          sem_post(&udpfwd_ctrl_cb_p->waitSem);
-          return false;
-      }
     }
 
+    if ((intfNode->addrCount == intfNode->addrMax) &&
+        !udpfwd_grow_server_refs(intfNode))
+        return false;
+
     VLOG_INFO("Attempting to add server entry (ip: %d, udp_Port:%d), "
               "on interface : %s", ipaddress, udpPort, intfNode->portName);
     /* Checks whether Server IP entry exists or not */
@@ -234,111 +734,21 @@ bool udpfwd_store_address(UDPFWD_INTERFACE_NODE_T *intfNode,
                        ipaddress, udpPort)) == NULL)
         {
             VLOG_ERR("Error while adding a new server entry");
-            sem_post(&udpfwd_ctrl_cb_p->waitSem);
             return false;
         }
     }
 
     /* Update IP reference table (per interface) */
     intfNode->serverArray[intfNode->addrCount] = server;
+    udpfwd_index_server_ref(intfNode, intfNode->addrCount);
     /* Increment the address count in interface table */
     intfNode->addrCount++;
+    intfNode->dirty = true;
 
     VLOG_INFO("Server entry successfully updated for interface : %s, "
               " current address_count : %d", intfNode->portName,
               intfNode->addrCount);
 
-    sem_post(&udpfwd_ctrl_cb_p->waitSem);
-
-    return true;
-}
-
-/*
- * Function      : udpfwd_remove_address
- * Responsiblity : Remove a server reference from an interface
- * Parameters    : intfNode - Interface entry
- *                 ipaddress - server IP address
- *                 udpPort - destination udp port
- * Return        : true - if the server reference is removed
- *                 false - otherwise
- */
-bool udpfwd_remove_address(UDPFWD_INTERFACE_NODE_T *intfNode,
-                        IP_ADDRESS ipaddress, uint16_t udpPort)
-{
-    UDPFWD_SERVER_T **serverArray = NULL;
-    bool          retVal = false;
-    int           deleted_index;  /*IP ref table's deleted index*/
-    struct shash_node *node;
-
-    VLOG_INFO("Attempting to delete server : %d, udp_port : %d on "
-              "interface : %s", ipaddress, udpPort, intfNode->portName);
-
-    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
-
-    /* Server IP Reference table pointer */
-    serverArray = intfNode->serverArray;
-
-    retVal = udpfwd_remove_server_ref_entry(intfNode, ipaddress, udpPort,
-                                            (int*)&deleted_index);
-    if(false == retVal)
-    {
-        /* Release the semaphore & return */
-        sem_post(&udpfwd_ctrl_cb_p->waitSem);
-        VLOG_ERR("Server entry not found on the interface");
-        return false;
-    }
-
-    /* Decrement interface server reference count */
-    intfNode->addrCount --;
-
-    VLOG_INFO("Interface server reference count after decrement : %d",
-              intfNode->addrCount);
-
-    /* Push the NULL entry at the end of the list
-     * If address count is zero & deleted index is also zero, no need to swap
-     * the deleted entry, because the entire list is NULL now.*/
-    if(!((0 == deleted_index) && (0 == intfNode->addrCount)))
-    {
-        udpfwd_push_deleted_server_ref_to_end(intfNode, deleted_index);
-    }
-
-    /* Check whether this was the only configured server IP for the interface.
-     * In that case we must free the memory for entire server table
-     * for this interface. First entry NULL means, entire list is NULL.
-     * because NULL entries are
-     * always pushed to the end of the list */
-    if ((NULL == serverArray[0]) && (intfNode->addrCount ==0))
-    {
-        VLOG_INFO("All server configuration on the interface : %s are removed."
-                  " Freeing server array ", intfNode->portName);
-
-        /* Delete the entire IP reference table */
-        free(serverArray);
-        /* Make interface table entry NULL, as no helper IP is configured */
-        intfNode->serverArray = NULL;
-
-        if (intfNode->bootp_gw == 0)
-        {
-            VLOG_INFO("All configuration on the interface : %s are removed."
-                      " Freeing interface entry", intfNode->portName);
-            node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable,
-                          intfNode->portName);
-            if (NULL != node)
-            {
-                shash_delete(&udpfwd_ctrl_cb_p->intfHashTable, node);
-            }
-            else
-            {
-                VLOG_ERR("Interface node not found in hash table : %s",
-                     intfNode->portName);
-            }
-            if (NULL != intfNode->portName)
-                free(intfNode->portName);
-
-            free(intfNode);
-        }
-    }
-    sem_post(&udpfwd_ctrl_cb_p->waitSem);
     return true;
 }
 
@@ -355,23 +765,38 @@ UDPFWD_INTERFACE_NODE_T *udpfwd_create_intferface_node(char *pname)
     /* There is no server configuration available for the port,
     * create one */
     intfNode = (UDPFWD_INTERFACE_NODE_T *)
-                    calloc(1, sizeof(UDPFWD_INTERFACE_NODE_T));
+                    relay_pool_alloc(&udpfwd_intf_pool);
     if (NULL == intfNode)
     {
         VLOG_ERR("Failed to allocate interface node for : %s", pname);
         return NULL;
     }
 
-    intfNode->portName = (char *) calloc (1, strlen(pname) + 1);
+    intfNode->portName = relay_pool_strdup(&relay_name_pool, pname);
     if (NULL == intfNode->portName)
     {
        VLOG_ERR("Failed to allocate memory for portName : %s", pname);
+       relay_pool_free(&udpfwd_intf_pool, intfNode);
+       return NULL;
+    }
+
+#ifdef FTR_DHCP_RELAY
+    /* One slot per receive worker, each on its own cache line */
+    if (posix_memalign((void **) &intfNode->pktCounters,
+                       RELAY_POOL_CACHE_LINE, udpfwd_ctrl_cb_p->n_workers *
+                       sizeof(DHCP_RELAY_PKT_COUNTER_SLOT)))
+    {
+       VLOG_ERR("Failed to allocate statistics counters for : %s", pname);
+       intfNode->pktCounters = NULL;
+       udpfwd_free_interface_node(intfNode);
        return NULL;
     }
+    memset(intfNode->pktCounters, 0, udpfwd_ctrl_cb_p->n_workers *
+           sizeof(DHCP_RELAY_PKT_COUNTER_SLOT));
+#endif /* FTR_DHCP_RELAY */
 
-    strncpy(intfNode->portName, pname, strlen(pname));
-    intfNode->addrCount = 0;
-    intfNode->serverArray = NULL;
+    intfNode->ifIndex = udpfwd_intf_cache_ifindex_by_name(pname);
+    intfNode->dirty = true;
     shash_add(&udpfwd_ctrl_cb_p->intfHashTable, pname, intfNode);
     VLOG_INFO("Allocated interface table record for port : %s", pname);
 
@@ -380,95 +805,247 @@ UDPFWD_INTERFACE_NODE_T *udpfwd_create_intferface_node(char *pname)
     return intfNode;
 }
 
-#ifdef FTR_DHCP_RELAY
 /*
- * Function      : udpfwd_handle_dhcp_relay_row_delete
- * Responsiblity : Process delete event for one or more ports records from
- *                 DHCP-Relay table
- * Parameters    : idl - idl reference
+ * Function      : udpfwd_remove_port_servers
+ * Responsiblity : Remove the servers of a UDP port from an interface. The
+ *                 interface is freed with its last server unless a bootp
+ *                 gateway is configured on it.
+ * Parameters    : intfNode - interface node
+ *                 udpPort - destination udp port
  * Return        : none
  */
-void udpfwd_handle_dhcp_relay_row_delete(struct ovsdb_idl *idl)
+static void udpfwd_remove_port_servers(UDPFWD_INTERFACE_NODE_T *intfNode,
+                                       uint16_t udpPort)
 {
-    const struct ovsrec_dhcp_relay *rec = NULL;
-    UDPFWD_INTERFACE_NODE_T *intf = NULL;
-    struct shash_node *node = NULL, *next = NULL;
-    int iter = 0, addrCount = 0;
-    UDPFWD_SERVER_T servers[MAX_UDP_BCAST_SERVER_PER_INTERFACE];
-    UDPFWD_SERVER_T *arrayPtr = NULL;
-    bool found = false;
-
-    /* Walk the server configuration hash table per "port" to
-     * see if the corresponding record is deleted */
-    SHASH_FOR_EACH_SAFE(node, next, &udpfwd_ctrl_cb_p->intfHashTable) {
-        found = false;
-        /* Iterate through dhcp relay table to find a match */
-        OVSREC_DHCP_RELAY_FOR_EACH(rec, idl) {
-            if ((NULL != rec->port) &&
-                !strncmp(rec->port->name, node->name,
-                         strlen(rec->port->name))) {
-                found = true;
-                break;
-            }
+    uint32_t iter;
+
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        if (udpPort == intfNode->serverArray[iter]->udp_port)
+            udpfwd_drop_server_ref(intfNode, iter);
+    }
+
+    udpfwd_compact_server_refs(intfNode);
+    udpfwd_release_unused_interface(intfNode);
+}
+
+/*
+ * Function      : udpfwd_update_port_servers
+ * Responsiblity : Make the servers of a UDP port on an interface those of
+ *                 a configuration row. The servers kept stay in place, the
+ *                 new ones are added after them in row order, so that the
+ *                 forwarding order only depends on the configuration
+ *                 history. Linear in the number of servers.
+ *                 The interface is freed if this leaves it unused.
+ * Parameters    : intfNode - interface node
+ *                 udpPort - destination udp port
+ *                 addrs - server addresses of the row
+ *                 n_addrs - number of server addresses
+ * Return        : none
+ */
+static void udpfwd_update_port_servers(UDPFWD_INTERFACE_NODE_T *intfNode,
+                                       uint16_t udpPort, char **addrs,
+                                       size_t n_addrs)
+{
+    IP_ADDRESS *servers = NULL;
+    bool *keep = NULL, removed = false;
+    struct in_addr id;
+    uint32_t iter, count = 0;
+    int32_t pos;
+
+    /* Parsed addresses, then one keep flag per configured server */
+    if (n_addrs || intfNode->addrCount) {
+        servers = (IP_ADDRESS *) malloc(n_addrs * sizeof(IP_ADDRESS) +
+                                        intfNode->addrCount * sizeof(bool));
+        if (NULL == servers) {
+            VLOG_ERR("Failed to allocate server update for interface : %s",
+                     intfNode->portName);
+            return;
         }
+        keep = (bool *) &servers[n_addrs];
+        memset(keep, 0, intfNode->addrCount * sizeof(bool));
+    }
 
-        if (false == found) {
-            intf = (UDPFWD_INTERFACE_NODE_T *)node->data;
-            intf->bootp_gw = 0;
-            memset(servers, 0, sizeof(servers));
-            arrayPtr = (UDPFWD_SERVER_T *)servers;
-            addrCount = intf->addrCount;
-            /* Delete the interface entry from hash table */
-            for (iter = 0; iter < addrCount; iter++) {
-                /* Delete only non DHCP-Relay server entries from the intf */
-                if (DHCPS_PORT == intf->serverArray[iter]->udp_port)
-                {
-                    *arrayPtr = *(intf->serverArray[iter]);
-                    arrayPtr++;
-                }
-            }
+    for (iter = 0; iter < n_addrs; iter++) {
+        if (!inet_aton(addrs[iter], &id) || (id.s_addr == 0)) {
+            VLOG_ERR("Invalid IP seen during server update : %s",
+                     addrs[iter]);
+            continue;
+        }
+        servers[count++] = id.s_addr;
 
-            /* Delete the servers maked for removal */
-            for (iter = 0; (servers[iter].ip_address) != 0; iter++)
-            {
-                udpfwd_remove_address(intf, servers[iter].ip_address,
-                                      servers[iter].udp_port);
-            }
+        pos = udpfwd_find_server_ref(intfNode, id.s_addr, udpPort);
+        if (0 <= pos)
+            keep[pos] = true;
+    }
+
+    /* Delete the servers that were removed in the config update */
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        if ((udpPort == intfNode->serverArray[iter]->udp_port) &&
+            !keep[iter]) {
+            udpfwd_drop_server_ref(intfNode, iter);
+            removed = true;
         }
     }
+    if (removed)
+        udpfwd_compact_server_refs(intfNode);
 
-    return;
+    /* Create the newly added servers, the others are found and skipped */
+    for (iter = 0; iter < count; iter++)
+        udpfwd_store_address(intfNode, servers[iter], udpPort);
+
+    free(servers);
+    udpfwd_release_unused_interface(intfNode);
 }
 
+/*
+ * Function      : udpfwd_row_ref_find
+ * Responsiblity : Lookup the record of a configuration row
+ * Parameters    : uuid - row uuid
+ * Return        : UDPFWD_ROW_REF* - row record if found
+ *                 NULL - otherwise
+ */
+static UDPFWD_ROW_REF *udpfwd_row_ref_find(const struct uuid *uuid)
+{
+    UDPFWD_ROW_REF *ref;
+
+    HMAP_FOR_EACH_WITH_HASH(ref, hmap_node, uuid_hash(uuid),
+                            &udpfwd_ctrl_cb_p->rowRefs) {
+        if (uuid_equals(&ref->uuid, uuid))
+            return ref;
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : udpfwd_row_ref_withdraw
+ * Responsiblity : Remove the configuration of a row from its interface and
+ *                 forget the row
+ * Parameters    : ref - row record
+ * Return        : none
+ */
+static void udpfwd_row_ref_withdraw(UDPFWD_ROW_REF *ref)
+{
+    UDPFWD_INTERFACE_NODE_T *intfNode;
+    struct shash_node *node;
+
+    node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, ref->portName);
+    if (NULL != node) {
+        intfNode = (UDPFWD_INTERFACE_NODE_T *) node->data;
+#ifdef FTR_DHCP_RELAY
+        if (DHCPS_PORT == ref->udp_port) {
+            intfNode->bootp_gw = 0;
+            intfNode->dirty = true;
+        }
+#endif /* FTR_DHCP_RELAY */
+        udpfwd_remove_port_servers(intfNode, ref->udp_port);
+    }
+
+    hmap_remove(&udpfwd_ctrl_cb_p->rowRefs, &ref->hmap_node);
+    relay_pool_strfree(&relay_name_pool, ref->portName);
+    relay_pool_free(&udpfwd_row_pool, ref);
+}
+
+/*
+ * Function      : udpfwd_row_ref_bind
+ * Responsiblity : Record the interface and UDP port a row configures. A
+ *                 row moved to another interface or port first withdraws
+ *                 its configuration from the old one.
+ * Parameters    : uuid - row uuid
+ *                 portName - interface name
+ *                 udpPort - destination udp port
+ *                 fresh - set when the row is new to the interface, all of
+ *                 its columns must then be applied
+ * Return        : UDPFWD_ROW_REF* - row record
+ *                 NULL - on allocation failure
+ */
+static UDPFWD_ROW_REF *udpfwd_row_ref_bind(const struct uuid *uuid,
+                                           const char *portName,
+                                           uint16_t udpPort, bool *fresh)
+{
+    UDPFWD_ROW_REF *ref;
+
+    ref = udpfwd_row_ref_find(uuid);
+    if ((NULL != ref) && (ref->udp_port == udpPort) &&
+        !strcmp(ref->portName, portName)) {
+        *fresh = false;
+        return ref;
+    }
+
+    if (NULL != ref)
+        udpfwd_row_ref_withdraw(ref);
+
+    *fresh = true;
+    ref = (UDPFWD_ROW_REF *) relay_pool_alloc(&udpfwd_row_pool);
+    if (NULL == ref) {
+        VLOG_ERR("Failed to allocate row record for port : %s", portName);
+        return NULL;
+    }
+
+    ref->portName = relay_pool_strdup(&relay_name_pool, portName);
+    if (NULL == ref->portName) {
+        VLOG_ERR("Failed to allocate memory for portName : %s", portName);
+        relay_pool_free(&udpfwd_row_pool, ref);
+        return NULL;
+    }
+
+    ref->uuid = *uuid;
+    ref->udp_port = udpPort;
+    hmap_insert(&udpfwd_ctrl_cb_p->rowRefs, &ref->hmap_node, uuid_hash(uuid));
+
+    return ref;
+}
+
+/*
+ * Function      : udpfwd_handle_row_delete
+ * Responsiblity : Process the delete event of a DHCP-Relay or
+ *                 UDP-Bcast-Forwarder table record
+ * Parameters    : uuid - uuid of the deleted record
+ * Return        : none
+ */
+void udpfwd_handle_row_delete(const struct uuid *uuid)
+{
+    UDPFWD_ROW_REF *ref;
+
+    ref = udpfwd_row_ref_find(uuid);
+    if (NULL != ref)
+        udpfwd_row_ref_withdraw(ref);
+}
+
+#ifdef FTR_DHCP_RELAY
 /*
  * Function      : udpfwd_handle_dhcp_relay_config_change
- * Responsiblity : Handle a record change in DHCP-Relay table
+ * Responsiblity : Handle a record insert or change in DHCP-Relay table.
+ *                 Only the columns changed since the last run are applied.
  * Parameters    : rec - DHCP-Relay OVSDB table record
- *                 idl_seqno - idl change identifier
  * Return        : none
  */
 void udpfwd_handle_dhcp_relay_config_change(
-              const struct ovsrec_dhcp_relay *rec, uint32_t idl_seqno)
+              const struct ovsrec_dhcp_relay *rec)
 {
     struct in_addr id;
-    IP_ADDRESS ipaddress;
     char *portName = NULL, *bootp_gw = NULL;
-    int iter, iter1;
     struct shash_node *node;
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
-    uint32_t servers[MAX_UDP_BCAST_SERVER_PER_INTERFACE];
-    uint32_t *arrayPtr;
     int retVal;
-    bool found;
+    bool fresh;
 
     if ((NULL == rec) ||
         (NULL == rec->port) ||
         (NULL == rec->vrf)) {
+        /* A record without an interface configures nothing */
+        if (NULL != rec)
+            udpfwd_handle_row_delete(&rec->header_.uuid);
         return;
     }
 
     portName = rec->port->name;
 
+    if (NULL == udpfwd_row_ref_bind(&rec->header_.uuid, portName,
+                                    DHCPS_PORT, &fresh)) {
+        return;
+    }
+
     /* Do lookup for the interface entry in hash table */
     node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, portName);
     if (NULL == node) {
@@ -483,8 +1060,8 @@ void udpfwd_handle_dhcp_relay_config_change(
         intfNode = (UDPFWD_INTERFACE_NODE_T *) node->data;
     }
 
-    if (OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_other_config,
-                               idl_seqno)) {
+    if (fresh ||
+        ovsrec_dhcp_relay_is_updated(rec, OVSREC_DHCP_RELAY_COL_OTHER_CONFIG)) {
 
         /* Check for bootp gateway configuration */
         bootp_gw = (char *)smap_get(&rec->other_config,
@@ -493,87 +1070,30 @@ void udpfwd_handle_dhcp_relay_config_change(
         if (bootp_gw == NULL) {
             /* bootp gateway ip is deleted or not configured */
             intfNode->bootp_gw = 0;
+            intfNode->dirty = true;
         }
         else {
             retVal = inet_aton(bootp_gw, &id);
             if (!retVal || id.s_addr == 0)
                 VLOG_ERR("Invalid IP address received"
                         "set as bootp gateway address");
-            else
+            else {
                 intfNode->bootp_gw = id.s_addr;
+                intfNode->dirty = true;
+            }
 
         }
     }
 
-    if (!OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_ipv4_ucast_server,
-                               idl_seqno)) {
+    if (!fresh &&
+        !ovsrec_dhcp_relay_is_updated(rec,
+                                      OVSREC_DHCP_RELAY_COL_IPV4_UCAST_SERVER)) {
         /* if no change in server ip column */
         return;
     }
 
-    memset(servers, 0, sizeof(servers));
-
-    arrayPtr = (uint32_t*)servers;
-    /* Collect the servers that are removed from the list */
-    for (iter = 0; iter < intfNode->addrCount; iter++) {
-        found = false;
-        ipaddress = intfNode->serverArray[iter]->ip_address;
-
-        for (iter1 = 0; iter1 < rec->n_ipv4_ucast_server; iter1++) {
-            retVal = inet_aton (rec->ipv4_ucast_server[iter1], &id);
-            if (!retVal || (id.s_addr == 0)) {
-                VLOG_ERR("Invalid IP seen during server update : %s",
-                        rec->ipv4_ucast_server[iter1]);
-                continue;
-            }
-            if (ipaddress == (id.s_addr)) {
-                found = true;
-                break;
-            }
-        }
-
-        if (false == found) {
-            *arrayPtr = ipaddress;
-            arrayPtr++;
-        }
-    }
-
-    /* Delete the servers that were removed in the config update */
-    for (iter = 0; servers[iter] != 0; iter++) {
-        udpfwd_remove_address(intfNode, servers[iter], DHCPS_PORT);
-    }
-
-    memset(servers, 0, sizeof(servers));
-    /* Collect the servers that are newly added */
-    arrayPtr = (uint32_t*)servers;
-    for (iter = 0; iter < rec->n_ipv4_ucast_server; iter++) {
-        found = false;
-        retVal = inet_aton(rec->ipv4_ucast_server[iter], &id);
-        if (!retVal || (id.s_addr == 0)) {
-            VLOG_ERR("Invalid IP seen during server update : %s",
-                    rec->ipv4_ucast_server[iter]);
-            continue;
-        }
-
-        for (iter1 = 0; iter1 < intfNode->addrCount; iter1++) {
-            if (intfNode->serverArray[iter1]->ip_address ==
-                       id.s_addr) {
-                found = true;
-                break;
-            }
-        }
-
-        if (false == found) {
-            *arrayPtr = id.s_addr;
-            arrayPtr++;
-        }
-    }
-
-    /* Create the newly added servers */
-    for (iter = 0; servers[iter] != 0; iter++) {
-        udpfwd_store_address(intfNode, servers[iter], DHCPS_PORT);
-    }
-
+    udpfwd_update_port_servers(intfNode, DHCPS_PORT, rec->ipv4_ucast_server,
+                               rec->n_ipv4_ucast_server);
     return;
 }
 
@@ -589,7 +1109,7 @@ refresh_dhcp_relay_stats()
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
     int64_t count = 0;
     union ovsdb_atom atom;
-    uint32_t index;
+    uint32_t index, iter;
     bool stats_change = false;
 
     /* DHCP-Relay statistics keys */
@@ -623,77 +1143,31 @@ refresh_dhcp_relay_stats()
         if (NULL == datum)
             continue;
 
-        /* Set Statistics column. */
-        atom.string = keys[VALID_V4CLIENT_REQUESTS];
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
-        if (UDPF_DHCPR_CLIENT_SENT(intfNode) != count) {
-            int_values[VALID_V4CLIENT_REQUESTS] =
-                UDPF_DHCPR_CLIENT_SENT(intfNode);
-            stats_change = true;
-        }
-
-        atom.string = keys[DROPPED_V4CLIENT_REQUESTS];
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
-        if (UDPF_DHCPR_CLIENT_DROPS(intfNode) != count) {
-            int_values[DROPPED_V4CLIENT_REQUESTS] =
-                UDPF_DHCPR_CLIENT_DROPS(intfNode);
-            stats_change = true;
-        }
-
-        atom.string = keys[VALID_V4SERVER_RESPONSES];
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
-        if (UDPF_DHCPR_SERVER_SENT(intfNode) != count) {
-            int_values[VALID_V4SERVER_RESPONSES] =
-                UDPF_DHCPR_SERVER_SENT(intfNode);
-            stats_change = true;
-        }
-
-        atom.string = keys[DROPPED_V4SERVER_RESPONSES];
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
-        if (UDPF_DHCPR_SERVER_DROPS(intfNode) != count) {
-            int_values[DROPPED_V4SERVER_RESPONSES] =
-                UDPF_DHCPR_SERVER_DROPS(intfNode);
-            stats_change = true;
-        }
+        /* Read every counter once, the column is written as a whole */
+        int_values[VALID_V4CLIENT_REQUESTS] =
+            UDPF_DHCPR_CLIENT_SENT(intfNode);
+        int_values[DROPPED_V4CLIENT_REQUESTS] =
+            UDPF_DHCPR_CLIENT_DROPS(intfNode);
+        int_values[VALID_V4SERVER_RESPONSES] =
+            UDPF_DHCPR_SERVER_SENT(intfNode);
+        int_values[DROPPED_V4SERVER_RESPONSES] =
+            UDPF_DHCPR_SERVER_DROPS(intfNode);
+        int_values[VALID_V4CLIENT_REQUESTS_WITH_OPTION82] =
+            UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode);
+        int_values[DROPPED_V4CLIENT_REQUESTS_WITH_OPTION82] =
+            UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode);
+        int_values[VALID_V4SERVER_RESPONSES_WITH_OPTION82] =
+            UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode);
+        int_values[DROPPED_V4SERVER_RESPONSES_WITH_OPTION82] =
+            UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode);
 
-        atom.string = keys[VALID_V4CLIENT_REQUESTS_WITH_OPTION82];
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
-        if (UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode) != count) {
-            int_values[VALID_V4CLIENT_REQUESTS_WITH_OPTION82] =
-                UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode);
-            stats_change = true;
-        }
-
-        atom.string = keys[DROPPED_V4CLIENT_REQUESTS_WITH_OPTION82];
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
-        if (UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode) != count) {
-            int_values[DROPPED_V4CLIENT_REQUESTS_WITH_OPTION82] =
-                UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode);
-            stats_change = true;
-        }
-
-        atom.string = keys[VALID_V4SERVER_RESPONSES_WITH_OPTION82];
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
-        if (UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode) != count) {
-            int_values[VALID_V4SERVER_RESPONSES_WITH_OPTION82] =
-                UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode);
-            stats_change = true;
-        }
-
-        atom.string = keys[DROPPED_V4SERVER_RESPONSES_WITH_OPTION82];
-        index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
-        count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
-        if (UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode) != count) {
-            int_values[DROPPED_V4SERVER_RESPONSES_WITH_OPTION82] =
-                UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode);
-            stats_change = true;
+        /* Set Statistics column. */
+        for (iter = 0; iter < MAX_STATISTICS_TYPE; iter++) {
+            atom.string = keys[iter];
+            index = ovsdb_datum_find_key(datum, &atom, OVSDB_TYPE_STRING);
+            count = ((index == UINT_MAX)? 0 : datum->values[index].integer);
+            if (int_values[iter] != count)
+                stats_change = true;
         }
 
         if (stats_change)
@@ -715,142 +1189,44 @@ refresh_dhcp_relay_stats()
 #endif /* FTR_DHCP_RELAY */
 
 #ifdef FTR_UDP_BCAST_FWD
-/*
- * Function      : server_ip_exists
- * Responsiblity : Check if a server ip exists in a server array
- * Parameters    : server_ip - IP address of the server
- *                 servers - List of servers
- *                 server_count - Number of servers in the list
- * Return        : true - If the server ip exists in the list
- *                 false - otherwise
- */
-bool server_ip_exists(IP_ADDRESS server_ip, char **servers,
-                      uint32_t server_count)
-{
-    struct in_addr id;
-    bool found = false;
-    int iter = 0;
-
-    for ( ; iter < server_count; iter++)
-    {
-        if (!(inet_aton (servers[iter], &id)) ||
-            (id.s_addr == 0))
-        {
-            continue;
-        }
-
-        if (server_ip == (id.s_addr))
-        {
-            found = true;
-            break;
-        }
-    }
-
-    return found;
-}
-
-/*
- * Function      : udpfwd_handle_udp_bcast_forwarder_row_delete
- * Responsiblity : Process delete event for one or more ports records from
- *                 UDP_Bcast_forwarder table
- * Parameters    : idl - idl reference
- * Return        : none
- */
-void udpfwd_handle_udp_bcast_forwarder_row_delete(struct ovsdb_idl *idl)
-{
-    const struct ovsrec_udp_bcast_forwarder_server *rec = NULL;
-    UDPFWD_INTERFACE_NODE_T *intf = NULL;
-    struct shash_node *node = NULL, *next = NULL;
-    int iter = 0;
-    UDPFWD_SERVER_T *server = NULL;
-    UDPFWD_SERVER_T servers[MAX_UDP_BCAST_SERVER_PER_INTERFACE];
-    UDPFWD_SERVER_T *arrayPtr = NULL;
-    bool found = false;
-
-    /* Walk the server configuration hash table per "port" to
-     * see if configuration related to an interface is completely deleted */
-    SHASH_FOR_EACH_SAFE(node, next, &udpfwd_ctrl_cb_p->intfHashTable)
-    {
-        intf = (UDPFWD_INTERFACE_NODE_T *)node->data;
-        memset(servers, 0, sizeof(servers));
-        arrayPtr = (UDPFWD_SERVER_T *)servers;
-
-        for (iter = 0; iter < intf->addrCount; iter++)
-        {
-            found = false;
-            server = intf->serverArray[iter];
-            if (DHCPS_PORT == server->udp_port)
-                continue;
-
-            /* Iterate through UDP_Bcast_forwarder table to find a match */
-            OVSREC_UDP_BCAST_FORWARDER_SERVER_FOR_EACH(rec, idl) {
-                /* Check if portname and udp_dport matches with rec entry */
-                if ((NULL != rec->src_port) &&
-                    (0 != strncmp(rec->src_port->name, intf->portName,
-                             strlen(rec->src_port->name)))) {
-                    continue;
-                }
-
-                if ((DHCPS_PORT == rec->udp_dport) ||
-                    (rec->udp_dport != server->udp_port)) {
-                    continue;
-                }
-
-                /* Check if server ip exists in the udp_bcast_forwarder_table
-                 * record */
-                if (false != server_ip_exists(server->ip_address,
-                                              rec->ipv4_ucast_server,
-                                              rec->n_ipv4_ucast_server)) {
-                    found = true;
-                    break;
-                }
-            }
-
-            if (false == found) {
-                *arrayPtr = *server;
-                arrayPtr++;
-            }
-        }
-
-        /* Delete the servers maked for removal */
-        for (iter = 0; (servers[iter].ip_address) != 0; iter++)
-        {
-            udpfwd_remove_address(intf, servers[iter].ip_address,
-                                  servers[iter].udp_port);
-        }
-    }
-
-    return;
-}
-
 /*
  * Function      : udpfwd_handle_udp_bcast_forwarder_config_change
- * Responsiblity : Handle a record change in UDP-Bcast-Forwarder table
+ * Responsiblity : Handle a record insert or change in UDP-Bcast-Forwarder
+ *                 table. Nothing is done unless the servers changed.
  * Parameters    : rec - UDP broadcast forwarder OVSDB table record
  * Return        : none
  */
 void udpfwd_handle_udp_bcast_forwarder_config_change(
               const struct ovsrec_udp_bcast_forwarder_server *rec)
 {
-    struct in_addr id;
     char *portName = NULL;
-    int iter, iter1;
     struct shash_node *node;
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
-    UDPFWD_SERVER_T *server;
-    UDPFWD_SERVER_T servers[MAX_UDP_BCAST_SERVER_PER_INTERFACE];
-    UDPFWD_SERVER_T *arrayPtr;
-    int retVal;
-    bool found;
+    bool fresh;
 
     if ((NULL == rec) ||
         (NULL == rec->src_port) ||
         (NULL == rec->dest_vrf)) {
+        /* A record without an interface configures nothing */
+        if (NULL != rec)
+            udpfwd_handle_row_delete(&rec->header_.uuid);
         return;
     }
 
     portName = rec->src_port->name;
 
+    if (NULL == udpfwd_row_ref_bind(&rec->header_.uuid, portName,
+                                    rec->udp_dport, &fresh)) {
+        return;
+    }
+
+    if (!fresh &&
+        !ovsrec_udp_bcast_forwarder_server_is_updated(rec,
+                    OVSREC_UDP_BCAST_FORWARDER_SERVER_COL_IPV4_UCAST_SERVER)) {
+        /* if no change in server ip column */
+        return;
+    }
+
     /* Do lookup for the interface entry in hash table */
     node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, portName);
     if (NULL == node)
@@ -866,87 +1242,9 @@ void udpfwd_handle_udp_bcast_forwarder_config_change(
         intfNode = (UDPFWD_INTERFACE_NODE_T *) node->data;
     }
 
-    memset(servers, 0, sizeof(servers));
-
-    arrayPtr = (UDPFWD_SERVER_T *)servers;
-    /* Collect the servers that are removed from the list */
-    for (iter = 0; iter < intfNode->addrCount; iter++)
-    {
-        found = false;
-        server = intfNode->serverArray[iter];
-
-        for (iter1 = 0; iter1 < rec->n_ipv4_ucast_server; iter1++)
-        {
-            retVal = inet_aton (rec->ipv4_ucast_server[iter1], &id);
-            if (!retVal || (id.s_addr == 0))
-            {
-                VLOG_ERR("Invalid IP seen during server update : %s",
-                        rec->ipv4_ucast_server[iter1]);
-                continue;
-            }
-            if ((server->ip_address == (id.s_addr))
-                && (server->udp_port== rec->udp_dport))
-            {
-                found = true;
-                break;
-            }
-        }
-
-        if ((false == found)
-            && (server->udp_port== rec->udp_dport))
-        {
-            *arrayPtr = *server;
-            arrayPtr++;
-        }
-    }
-
-    /* Delete the servers that were removed in the config update */
-    for (iter = 0; (servers[iter].ip_address) != 0; iter++)
-    {
-        udpfwd_remove_address(intfNode, servers[iter].ip_address,
-                              servers[iter].udp_port);
-    }
-
-    memset(servers, 0, sizeof(servers));
-    /* Collect the servers that are newly added */
-    arrayPtr = (UDPFWD_SERVER_T *)servers;
-    for (iter = 0; iter < rec->n_ipv4_ucast_server; iter++)
-    {
-        found = false;
-        retVal = inet_aton(rec->ipv4_ucast_server[iter], &id);
-        if (!retVal || (id.s_addr == 0))
-        {
-            VLOG_ERR("Invalid IP seen during server update : %s",
-                    rec->ipv4_ucast_server[iter]);
-            continue;
-        }
-
-        for (iter1 = 0; iter1 < intfNode->addrCount; iter1++)
-        {
-            server = intfNode->serverArray[iter1];
-            if ((server->ip_address == id.s_addr)
-                 && (server->udp_port== rec->udp_dport))
-            {
-                found = true;
-                break;
-            }
-        }
-
-        if (false == found)
-        {
-            arrayPtr->ip_address = id.s_addr;
-            arrayPtr->udp_port = rec->udp_dport;
-            arrayPtr++;
-        }
-    }
-
-    /* Create the newly added servers */
-    for (iter = 0; (servers[iter].ip_address) != 0; iter++)
-    {
-        udpfwd_store_address(intfNode, servers[iter].ip_address,
-                             servers[iter].udp_port);
-    }
-
+    udpfwd_update_port_servers(intfNode, rec->udp_dport,
+                               rec->ipv4_ucast_server,
+                               rec->n_ipv4_ucast_server);
     return;
 }
 #endif /* FTR_UDP_BCAST_FWD */
@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_csum.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - One's complement partial sums, scalar and SSE2/AVX2.
+ * - Selection of the fastest implementation at startup.
+ * - UDP checksum over the pseudo header and the packet in place.
+ *
+ * Partial sums are 32 bit accumulators of the 16 bit words of a buffer as
+ * stored in memory. Partial sums of buffers which start at even offsets of
+ * a packet add up, so a payload shared by several destinations is summed
+ * once and only the headers are summed per destination.
+ */
+
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "udpfwd_util.h"
+
+VLOG_DEFINE_THIS_MODULE(udpfwd_csum);
+
+/*
+ * Function      : csum_fold64
+ * Responsiblity : Fold a 64 bit accumulator into a 32 bit partial sum
+ * Parameters    : sum - accumulator
+ * Return        : partial sum
+ */
+static uint32_t csum_fold64(uint64_t sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    return (uint32_t) sum;
+}
+
+/*
+ * Function      : csum_partial_tail
+ * Responsiblity : Add the bytes of a buffer shorter than 8 bytes
+ * Parameters    : buf - data pointer
+ *                 len - data length
+ *                 sum - accumulator
+ * Return        : accumulator
+ */
+static uint64_t csum_partial_tail(const uint8_t *buf, size_t len, uint64_t sum)
+{
+    uint16_t word;
+
+    while (len > 1) {
+        memcpy(&word, buf, sizeof(word));
+        sum += word;
+        buf += 2;
+        len -= 2;
+    }
+
+    /* Odd byte, padded with zero as in the packet */
+    if (len) {
+        word = 0;
+        memcpy(&word, buf, 1);
+        sum += word;
+    }
+
+    return sum;
+}
+
+/*
+ * Function      : csum_partial_scalar
+ * Responsiblity : Partial sum of a buffer, 32 bit words into a 64 bit
+ *                 accumulator
+ * Parameters    : buf - data pointer
+ *                 len - data length
+ *                 sum - previous partial sum
+ * Return        : partial sum
+ */
+static uint32_t csum_partial_scalar(const void *buf, size_t len, uint32_t sum)
+{
+    const uint8_t *ptr = buf;
+    uint64_t acc = sum;
+    uint32_t word;
+
+    while (len >= 8) {
+        memcpy(&word, ptr, sizeof(word));
+        acc += word;
+        memcpy(&word, ptr + 4, sizeof(word));
+        acc += word;
+        ptr += 8;
+        len -= 8;
+    }
+
+    return csum_fold64(csum_partial_tail(ptr, len, acc));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * Function      : csum_partial_sse2
+ * Responsiblity : Partial sum of a buffer, 32 bytes per iteration. The 32
+ *                 bit words are widened into 64 bit lanes, which cannot
+ *                 overflow.
+ * Parameters    : buf - data pointer
+ *                 len - data length
+ *                 sum - previous partial sum
+ * Return        : partial sum
+ */
+__attribute__((target("sse2")))
+static uint32_t csum_partial_sse2(const void *buf, size_t len, uint32_t sum)
+{
+    const uint8_t *ptr = buf;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = zero, hi = zero, data;
+    uint64_t lanes[2];
+
+    while (len >= 32) {
+        data = _mm_loadu_si128((const __m128i *) ptr);
+        lo = _mm_add_epi64(lo, _mm_unpacklo_epi32(data, zero));
+        hi = _mm_add_epi64(hi, _mm_unpackhi_epi32(data, zero));
+        data = _mm_loadu_si128((const __m128i *) (ptr + 16));
+        lo = _mm_add_epi64(lo, _mm_unpacklo_epi32(data, zero));
+        hi = _mm_add_epi64(hi, _mm_unpackhi_epi32(data, zero));
+        ptr += 32;
+        len -= 32;
+    }
+
+    _mm_storeu_si128((__m128i *) lanes, _mm_add_epi64(lo, hi));
+
+    return csum_fold64((uint64_t) csum_partial_scalar(ptr, len, sum) +
+                       csum_fold64(lanes[0]) + csum_fold64(lanes[1]));
+}
+
+/*
+ * Function      : csum_partial_avx2
+ * Responsiblity : Partial sum of a buffer, 64 bytes per iteration
+ * Parameters    : buf - data pointer
+ *                 len - data length
+ *                 sum - previous partial sum
+ * Return        : partial sum
+ */
+__attribute__((target("avx2")))
+static uint32_t csum_partial_avx2(const void *buf, size_t len, uint32_t sum)
+{
+    const uint8_t *ptr = buf;
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = zero, hi = zero, data;
+    uint64_t lanes[4];
+
+    while (len >= 64) {
+        data = _mm256_loadu_si256((const __m256i *) ptr);
+        lo = _mm256_add_epi64(lo, _mm256_unpacklo_epi32(data, zero));
+        hi = _mm256_add_epi64(hi, _mm256_unpackhi_epi32(data, zero));
+        data = _mm256_loadu_si256((const __m256i *) (ptr + 32));
+        lo = _mm256_add_epi64(lo, _mm256_unpacklo_epi32(data, zero));
+        hi = _mm256_add_epi64(hi, _mm256_unpackhi_epi32(data, zero));
+        ptr += 64;
+        len -= 64;
+    }
+
+    _mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(lo, hi));
+
+    return csum_fold64((uint64_t) csum_partial_scalar(ptr, len, sum) +
+                       csum_fold64(lanes[0]) + csum_fold64(lanes[1]) +
+                       csum_fold64(lanes[2]) + csum_fold64(lanes[3]));
+}
+#endif /* __x86_64__ || __i386__ */
+
+/* Implementation selected by udpfwd_csum_select() */
+static uint32_t (*csum_partial_impl)(const void *, size_t, uint32_t) =
+                                                        csum_partial_scalar;
+
+/*
+ * Function      : udpfwd_csum_select
+ * Responsiblity : Select a partial sum implementation by name
+ * Parameters    : name - "scalar", "sse2" or "avx2"
+ * Return        : true, if the CPU supports the implementation
+ *                 false, otherwise, the selection is unchanged
+ */
+bool udpfwd_csum_select(const char *name)
+{
+    if (!strcmp(name, "scalar")) {
+        csum_partial_impl = csum_partial_scalar;
+        return true;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+        csum_partial_impl = csum_partial_avx2;
+        return true;
+    }
+    if (!strcmp(name, "sse2") && __builtin_cpu_supports("sse2")) {
+        csum_partial_impl = csum_partial_sse2;
+        return true;
+    }
+#endif /* __x86_64__ || __i386__ */
+
+    return false;
+}
+
+/*
+ * Function      : udpfwd_csum_init
+ * Responsiblity : Select the fastest partial sum implementation supported
+ *                 by the CPU
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_csum_init(void)
+{
+    static const char *const names[] = { "avx2", "sse2", "scalar" };
+    uint32_t iter;
+
+    for (iter = 0; iter < ARRAY_SIZE(names); iter++) {
+        if (udpfwd_csum_select(names[iter]))
+            break;
+    }
+
+    VLOG_INFO("Using %s UDP checksum", names[iter]);
+}
+
+/*
+ * Function      : udpfwd_csum_partial
+ * Responsiblity : One's complement partial sum of a buffer
+ * Parameters    : buf - data pointer
+ *                 len - data length
+ *                 sum - previous partial sum
+ * Return        : partial sum
+ */
+uint32_t udpfwd_csum_partial(const void *buf, size_t len, uint32_t sum)
+{
+    return csum_partial_impl(buf, len, sum);
+}
+
+/*
+ * Function      : udpfwd_csum_partial_iov
+ * Responsiblity : One's complement partial sum of the segments of a
+ *                 gathered buffer. The sum of a segment which starts at an
+ *                 odd offset has its bytes swapped.
+ * Parameters    : iov - segments
+ *                 iovcnt - number of segments
+ *                 sum - previous partial sum
+ * Return        : partial sum
+ */
+uint32_t udpfwd_csum_partial_iov(const struct iovec *iov, size_t iovcnt,
+                                 uint32_t sum)
+{
+    uint64_t acc = sum;
+    uint32_t part;
+    bool odd = false;
+    size_t iter;
+
+    for (iter = 0; iter < iovcnt; iter++) {
+        part = csum_partial_impl(iov[iter].iov_base, iov[iter].iov_len, 0);
+        if (odd) {
+            part = (part & 0xffff) + (part >> 16);
+            part = (part & 0xffff) + (part >> 16);
+            part = ((part & 0xff) << 8) | (part >> 8);
+        }
+        acc += part;
+        odd ^= iov[iter].iov_len & 1;
+    }
+
+    return csum_fold64(acc);
+}
+
+/*
+ * Function      : udpfwd_csum_fold
+ * Responsiblity : Fold a partial sum into a checksum
+ * Parameters    : sum - partial sum
+ * Return        : checksum value
+ */
+uint16_t udpfwd_csum_fold(uint32_t sum)
+{
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t) ~sum;
+}
+
+/*
+ * Function      : udpfwd_udp_cksum_finish
+ * Responsiblity : UDP checksum from the pseudo header, the UDP header and
+ *                 the partial sum of the payload
+ * Parameters    : iph - IP header
+ *                 udph - UDP header, the checksum field is ignored
+ *                 payload_sum - partial sum of the UDP payload
+ * Return        : checksum value, 0xffff for a computed 0. 0 (no checksum)
+ *                 when the source address is left for the kernel to fill.
+ */
+uint16_t udpfwd_udp_cksum_finish(const struct ip *iph,
+                                 const struct udphdr *udph,
+                                 uint32_t payload_sum)
+{
+    struct pseudoheader pshd;
+    uint64_t sum = payload_sum;
+    uint16_t csum;
+
+    /* IP_HDRINCL fills a zero source address after the checksum is set */
+    if (INADDR_ANY == iph->ip_src.s_addr)
+        return 0;
+
+    pshd.src_addr = iph->ip_src.s_addr;
+    pshd.dst_addr = iph->ip_dst.s_addr;
+    pshd.padding = 0;
+    pshd.proto = IPPROTO_UDP;
+    pshd.length = udph->uh_ulen;
+
+    sum += csum_partial_scalar(&pshd, sizeof(pshd), 0);
+    sum += (uint32_t) udph->uh_sport + udph->uh_dport + udph->uh_ulen;
+
+    csum = udpfwd_csum_fold(csum_fold64(sum));
+    return csum ? csum : 0xffff;
+}
+
+/*
+ * Function      : udpfwd_udp_cksum
+ * Responsiblity : UDP checksum of a packet, computed in place
+ * Parameters    : iph - IP header followed by the UDP datagram
+ *                 len - bytes of the UDP datagram available in the buffer
+ * Return        : checksum value
+ */
+uint16_t udpfwd_udp_cksum(const struct ip *iph, size_t len)
+{
+    const struct udphdr *udph =
+        (const struct udphdr *) ((const char *) iph + (iph->ip_hl * 4));
+    size_t ulen = ntohs(udph->uh_ulen);
+
+    if (ulen > len)
+        ulen = len;
+
+    return udpfwd_udp_cksum_finish(iph, udph,
+               ulen > UDPHDR_LENGTH ?
+               udpfwd_csum_partial(udph + 1, ulen - UDPHDR_LENGTH, 0) : 0);
+}
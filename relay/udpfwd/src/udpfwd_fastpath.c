@@ -0,0 +1,821 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_fastpath.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Generate the TC ingress program forwarding UDP broadcasts in the kernel.
+ * - Keep its forwarding map, keyed on interface index and UDP port, in
+ *   step with the published forwarding snapshots and interface addresses.
+ * - Attach the program to the interfaces with forward-protocol servers.
+ * - Dump the per entry counters of the program.
+ *
+ * The program handles what user space would do with the datagram for the
+ * common case: an Ethernet and IPv4 limited broadcast, without IP options
+ * nor fragmentation, with a source address, on an interface with an
+ * address. It looks up the route and neighbor of every server first, as
+ * the forwarding plane would for a datagram received on the interface, and
+ * only when they are all resolved rewrites the destination address, the
+ * checksums and the Ethernet header and sends a clone to each server. The
+ * datagram is then restored, marked and continues up the stack for the
+ * local listeners. Anything else, including a server without a resolved
+ * neighbor, is left unmarked to the raw sockets of the workers, which also
+ * resolves the neighbor for the following datagrams. The route lookup
+ * fails on an interface without IP forwarding, which leaves its datagrams
+ * to user space as well.
+ */
+
+#ifdef FTR_UDP_BCAST_FWD
+#include <inttypes.h>
+#include <stddef.h>
+#include <linux/bpf.h>
+#include <linux/if_packet.h>
+#include <linux/pkt_cls.h>
+#include "udpfwd_util.h"
+#include "udpfwd_filter.h"
+#include "udpfwd_intf_cache.h"
+#include "udpfwd_fastpath.h"
+
+VLOG_DEFINE_THIS_MODULE(udpfwd_fastpath);
+
+/* BPF_TCX_INGRESS, attach type of linux 6.6 missing in older headers */
+#define FASTPATH_TCX_INGRESS 46
+
+/* Bytes the program reads: Ethernet, IP without options, UDP */
+#define FASTPATH_HDRS_LEN (ETH_HLEN + 20 + UDPHDR_LENGTH)
+
+/* Offsets in the packet */
+#define FASTPATH_IP_CSUM   (ETH_HLEN + 10)
+#define FASTPATH_IP_DST    (ETH_HLEN + 16)
+#define FASTPATH_UDP_CSUM  (ETH_HLEN + 20 + 6)
+
+/* Stack of the program. The copy of the headers puts the IP header on a
+ * 4 byte boundary, the route of server i is at FASTPATH_RES + 16 * i as
+ * interface index, destination and source MAC addresses */
+#define FASTPATH_FIB  (-64)
+#define FASTPATH_KEY  (-72)
+#define FASTPATH_PREV (-80)
+#define FASTPATH_HDRS (-122)
+#define FASTPATH_RES  (FASTPATH_HDRS - 6 - 16 * UDPFWD_FASTPATH_SERVERS_MAX)
+
+/* Length of the instruction sequence of the program */
+#define FASTPATH_PROG_MAX (80 + 80 * UDPFWD_FASTPATH_SERVERS_MAX)
+
+/* Fast path control block */
+static UDPFWD_FASTPATH fastpath = { .progFd = -1, .mapFd = -1,
+                                   .addrSeq = UINT64_MAX };
+
+/*
+ * Function      : fastpath_emit_call
+ * Responsiblity : Append a helper call taking the skb and four arguments,
+ *                 r3 and r4 are loaded by the caller
+ * Parameters    : insns, len - program
+ *                 helper - helper function
+ *                 off - second argument, packet offset
+ *                 flags - fifth argument
+ * Return        : none
+ */
+static void fastpath_emit_call(struct bpf_insn *insns, uint32_t *len,
+                               int32_t helper, int32_t off, int32_t flags)
+{
+    udpfwd_ebpf_emit(insns, len, BPF_ALU64 | BPF_MOV | BPF_X, 1, 6, 0, 0);
+    udpfwd_ebpf_emit(insns, len, BPF_ALU64 | BPF_MOV | BPF_K, 2, 0, 0, off);
+    udpfwd_ebpf_emit(insns, len, BPF_ALU64 | BPF_MOV | BPF_K, 5, 0, 0, flags);
+    udpfwd_ebpf_emit(insns, len, BPF_JMP | BPF_CALL, 0, 0, 0, helper);
+}
+
+/*
+ * Function      : fastpath_emit_rewrite
+ * Responsiblity : Append the instructions replacing the destination
+ *                 address at FASTPATH_PREV by the one r8 points to, with
+ *                 the IP and UDP checksums, and storing it at
+ *                 FASTPATH_PREV
+ * Parameters    : insns, len - program
+ * Return        : none
+ */
+static void fastpath_emit_rewrite(struct bpf_insn *insns, uint32_t *len)
+{
+    udpfwd_ebpf_emit(insns, len, BPF_LDX | BPF_MEM | BPF_W, 3, 10,
+                     FASTPATH_PREV, 0);
+    udpfwd_ebpf_emit(insns, len, BPF_LDX | BPF_MEM | BPF_W, 4, 8, 0, 0);
+    fastpath_emit_call(insns, len, BPF_FUNC_l3_csum_replace,
+                       FASTPATH_IP_CSUM, sizeof(IP_ADDRESS));
+    udpfwd_ebpf_emit(insns, len, BPF_LDX | BPF_MEM | BPF_W, 3, 10,
+                     FASTPATH_PREV, 0);
+    udpfwd_ebpf_emit(insns, len, BPF_LDX | BPF_MEM | BPF_W, 4, 8, 0, 0);
+    fastpath_emit_call(insns, len, BPF_FUNC_l4_csum_replace,
+                       FASTPATH_UDP_CSUM, BPF_F_PSEUDO_HDR |
+                       BPF_F_MARK_MANGLED_0 | sizeof(IP_ADDRESS));
+    udpfwd_ebpf_emit(insns, len, BPF_ALU64 | BPF_MOV | BPF_X, 3, 8, 0, 0);
+    udpfwd_ebpf_emit(insns, len, BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0,
+                     sizeof(IP_ADDRESS));
+    fastpath_emit_call(insns, len, BPF_FUNC_skb_store_bytes,
+                       FASTPATH_IP_DST, 0);
+    udpfwd_ebpf_emit(insns, len, BPF_LDX | BPF_MEM | BPF_W, 3, 8, 0, 0);
+    udpfwd_ebpf_emit(insns, len, BPF_STX | BPF_MEM | BPF_W, 10, 3,
+                     FASTPATH_PREV, 0);
+}
+
+/*
+ * Function      : fastpath_emit_copy16
+ * Responsiblity : Append the instructions copying bytes between two stack
+ *                 areas on 2 byte boundaries
+ * Parameters    : insns, len - program
+ *                 dst, src - stack offsets
+ *                 size - number of bytes, even
+ * Return        : none
+ */
+static void fastpath_emit_copy16(struct bpf_insn *insns, uint32_t *len,
+                                 int16_t dst, int16_t src, uint32_t size)
+{
+    uint32_t iter;
+
+    for (iter = 0; iter < size; iter += 2) {
+        udpfwd_ebpf_emit(insns, len, BPF_LDX | BPF_MEM | BPF_H, 0, 10,
+                         src + iter, 0);
+        udpfwd_ebpf_emit(insns, len, BPF_STX | BPF_MEM | BPF_H, 10, 0,
+                         dst + iter, 0);
+    }
+}
+
+/*
+ * Function      : fastpath_prog_load
+ * Responsiblity : Generate and load the TC ingress program. The server
+ *                 loops are unrolled, one block per possible server.
+ *                   r6 = skb, r7 = map entry, r8 = server address,
+ *                   r9 = IP total length
+ * Parameters    : none
+ * Return        : program file descriptor, -1 on failure
+ */
+static int32_t fastpath_prog_load(void)
+{
+    struct bpf_insn insns[FASTPATH_PROG_MAX];
+    uint32_t toPass[16], passCount = 0;
+    uint32_t toPunt[UDPFWD_FASTPATH_SERVERS_MAX + 1], puntCount = 0;
+    uint32_t toNext[UDPFWD_FASTPATH_SERVERS_MAX], nextCount = 0;
+    uint32_t len = 0, iter, server;
+    int32_t fib, res;
+    union bpf_attr attr;
+    int32_t fd;
+
+    memset(insns, 0, sizeof(insns));
+
+    /* r6 = skb, Ethernet broadcast only */
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 6,
+                     offsetof(struct __sk_buff, pkt_type), 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0, 0,
+                     PACKET_BROADCAST);
+
+    /* Copy the headers to the stack */
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 3, 10, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 3, 0, 0,
+                     FASTPATH_HDRS);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0,
+                     FASTPATH_HDRS_LEN);
+    fastpath_emit_call(insns, &len, BPF_FUNC_skb_load_bytes, 0, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0, 0, 0);
+
+    /* IPv4 without options, UDP, not a fragment, limited broadcast */
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_H, 0, 10,
+                     FASTPATH_HDRS + 12, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0, 0,
+                     htons(ETH_P_IP));
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_B, 0, 10,
+                     FASTPATH_HDRS + ETH_HLEN, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0, 0, 0x45);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_B, 0, 10,
+                     FASTPATH_HDRS + ETH_HLEN + 9, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0, 0,
+                     IPPROTO_UDP);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_H, 0, 10,
+                     FASTPATH_HDRS + ETH_HLEN + 6, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JSET | BPF_K, 0, 0, 0,
+                     htons(IP_MF | IP_OFFMASK));
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 10,
+                     FASTPATH_HDRS + FASTPATH_IP_DST, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP32 | BPF_JNE | BPF_K, 0, 0, 0, -1);
+
+    /* r7 = entry of the input interface and UDP destination port */
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 6,
+                     offsetof(struct __sk_buff, ingress_ifindex), 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 10, 0,
+                     FASTPATH_KEY, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_H, 0, 10,
+                     FASTPATH_HDRS + ETH_HLEN + 20 + 2, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU | BPF_END | BPF_TO_BE, 0, 0, 0, 16);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_H, 10, 0,
+                     FASTPATH_KEY + 4, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ST | BPF_MEM | BPF_H, 10, 0,
+                     FASTPATH_KEY + 6, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0,
+                     FASTPATH_KEY);
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_IMM | BPF_DW, 1,
+                     BPF_PSEUDO_MAP_FD, 0, fastpath.mapFd);
+    udpfwd_ebpf_emit(insns, &len, 0, 0, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_CALL, 0, 0, 0,
+                     BPF_FUNC_map_lookup_elem);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 7, 0, 0, 0);
+
+    /* A zero source address is replaced in user space */
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 10,
+                     FASTPATH_HDRS + ETH_HLEN + 12, 0);
+    toPunt[puntCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 0, 0);
+
+    /* Route lookup parameters common to every server */
+    fib = FASTPATH_FIB;
+    for (iter = 0; iter < sizeof(struct bpf_fib_lookup); iter += 8) {
+        udpfwd_ebpf_emit(insns, &len, BPF_ST | BPF_MEM | BPF_DW, 10, 0,
+                         fib + iter, 0);
+    }
+    udpfwd_ebpf_emit(insns, &len, BPF_ST | BPF_MEM | BPF_B, 10, 0,
+                     fib + offsetof(struct bpf_fib_lookup, family), AF_INET);
+    udpfwd_ebpf_emit(insns, &len, BPF_ST | BPF_MEM | BPF_B, 10, 0,
+                     fib + offsetof(struct bpf_fib_lookup, l4_protocol),
+                     IPPROTO_UDP);
+    fastpath_emit_copy16(insns, &len,
+                         fib + offsetof(struct bpf_fib_lookup, sport),
+                         FASTPATH_HDRS + ETH_HLEN + 20, 4);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 10,
+                     FASTPATH_HDRS + ETH_HLEN + 12, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 10, 0,
+                     fib + offsetof(struct bpf_fib_lookup, ipv4_src), 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_H, 9, 10,
+                     FASTPATH_HDRS + ETH_HLEN + 2, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU | BPF_END | BPF_TO_BE, 9, 0, 0, 16);
+
+    /* Resolve every server before sending anything, with the forwarding
+     * lookup of a datagram received on the input interface. The lookup
+     * resets the interface, tos and length fields, they are set again */
+    for (server = 0; server < UDPFWD_FASTPATH_SERVERS_MAX; server++) {
+        res = FASTPATH_RES + 16 * server;
+        udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 7,
+                         offsetof(UDPFWD_FASTPATH_ENTRY, serverCount), 0);
+        toNext[nextCount++] = len;
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JLE | BPF_K, 0, 0, 0,
+                         server);
+        udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 6,
+                         offsetof(struct __sk_buff, ingress_ifindex), 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 10, 0,
+                         fib + offsetof(struct bpf_fib_lookup, ifindex), 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_H, 10, 9,
+                         fib + offsetof(struct bpf_fib_lookup, tot_len), 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_B, 0, 10,
+                         FASTPATH_HDRS + ETH_HLEN + 1, 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_B, 10, 0,
+                         fib + offsetof(struct bpf_fib_lookup, tos), 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 7,
+                         offsetof(UDPFWD_FASTPATH_ENTRY, servers) +
+                         server * sizeof(IP_ADDRESS), 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 10, 0,
+                         fib + offsetof(struct bpf_fib_lookup, ipv4_dst), 0);
+
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 1, 6, 0, 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0,
+                         0);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0,
+                         fib);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0,
+                         sizeof(struct bpf_fib_lookup));
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0,
+                         0);
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_CALL, 0, 0, 0,
+                         BPF_FUNC_fib_lookup);
+        toPunt[puntCount++] = len;
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0, 0,
+                         BPF_FIB_LKUP_RET_SUCCESS);
+
+        udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 10,
+                         fib + offsetof(struct bpf_fib_lookup, ifindex), 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 10, 0,
+                         res, 0);
+        fastpath_emit_copy16(insns, &len, res + 4,
+                             fib + offsetof(struct bpf_fib_lookup, dmac),
+                             ETH_ALEN);
+        fastpath_emit_copy16(insns, &len, res + 4 + ETH_ALEN,
+                             fib + offsetof(struct bpf_fib_lookup, smac),
+                             ETH_ALEN);
+    }
+    for (iter = 0; iter < nextCount; iter++)
+        insns[toNext[iter]].off = len - toNext[iter] - 1;
+    nextCount = 0;
+
+    /* Send a copy to every server, from the previous destination */
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 10,
+                     FASTPATH_HDRS + FASTPATH_IP_DST, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 10, 0,
+                     FASTPATH_PREV, 0);
+    for (server = 0; server < UDPFWD_FASTPATH_SERVERS_MAX; server++) {
+        res = FASTPATH_RES + 16 * server;
+        udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 7,
+                         offsetof(UDPFWD_FASTPATH_ENTRY, serverCount), 0);
+        toNext[nextCount++] = len;
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JLE | BPF_K, 0, 0, 0,
+                         server);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 8, 7, 0, 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 8, 0, 0,
+                         offsetof(UDPFWD_FASTPATH_ENTRY, servers) +
+                         server * sizeof(IP_ADDRESS));
+        fastpath_emit_rewrite(insns, &len);
+
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 3, 10, 0,
+                         0);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 3, 0, 0,
+                         res + 4);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0,
+                         2 * ETH_ALEN);
+        fastpath_emit_call(insns, &len, BPF_FUNC_skb_store_bytes, 0, 0);
+
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 1, 6, 0, 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 2, 10,
+                         res, 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0,
+                         0);
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_CALL, 0, 0, 0,
+                         BPF_FUNC_clone_redirect);
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0, 2, 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 1, 0, 0, 1);
+        udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_XADD | BPF_DW, 7, 1,
+                         offsetof(UDPFWD_FASTPATH_ENTRY, copies), 0);
+    }
+    for (iter = 0; iter < nextCount; iter++)
+        insns[toNext[iter]].off = len - toNext[iter] - 1;
+
+    /* Restore the datagram for the local stack and mark it */
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 8, 10, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 8, 0, 0,
+                     FASTPATH_HDRS + FASTPATH_IP_DST);
+    fastpath_emit_rewrite(insns, &len);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 3, 10, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 3, 0, 0,
+                     FASTPATH_HDRS);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0,
+                     2 * ETH_ALEN);
+    fastpath_emit_call(insns, &len, BPF_FUNC_skb_store_bytes, 0, 0);
+
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 6,
+                     offsetof(struct __sk_buff, mark), 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU | BPF_OR | BPF_K, 0, 0, 0,
+                     UDPFWD_FASTPATH_MARK);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 6, 0,
+                     offsetof(struct __sk_buff, mark), 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 1, 0, 0, 1);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_XADD | BPF_DW, 7, 1,
+                     offsetof(UDPFWD_FASTPATH_ENTRY, packets), 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JA, 0, 0, 0, 0);
+
+    /* Count the datagram left to user space */
+    for (iter = 0; iter < puntCount; iter++)
+        insns[toPunt[iter]].off = len - toPunt[iter] - 1;
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 1, 0, 0, 1);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_XADD | BPF_DW, 7, 1,
+                     offsetof(UDPFWD_FASTPATH_ENTRY, punts), 0);
+
+    /* return TC_ACT_OK */
+    for (iter = 0; iter < passCount; iter++)
+        insns[toPass[iter]].off = len - toPass[iter] - 1;
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0,
+                     TC_ACT_OK);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_SCHED_CLS;
+    attr.insns = (uintptr_t) insns;
+    attr.insn_cnt = len;
+    attr.license = (uintptr_t) "GPL";
+
+    fd = udpfwd_bpf_sys(BPF_PROG_LOAD, &attr);
+    if (fd < 0) {
+        VLOG_ERR("Failed to load UDP forwarding program, errno : %d", errno);
+    }
+
+    return fd;
+}
+
+/*
+ * Function      : fastpath_map_set
+ * Responsiblity : Set the servers of an interface and port in the
+ *                 forwarding map. The counters of an existing entry are
+ *                 carried over, the increments made meanwhile are lost.
+ * Parameters    : ifIndex - input interface
+ *                 port - installed port and its servers
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool fastpath_map_set(uint32_t ifIndex,
+                             const UDPFWD_FASTPATH_PORT *port)
+{
+    UDPFWD_FASTPATH_KEY key = { .ifIndex = ifIndex, .port = port->port };
+    UDPFWD_FASTPATH_ENTRY entry;
+    union bpf_attr attr;
+
+    memset(&entry, 0, sizeof(entry));
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = fastpath.mapFd;
+    attr.key = (uintptr_t) &key;
+    attr.value = (uintptr_t) &entry;
+    udpfwd_bpf_sys(BPF_MAP_LOOKUP_ELEM, &attr);
+
+    entry.serverCount = port->serverCount;
+    memcpy(entry.servers, port->servers,
+           port->serverCount * sizeof(IP_ADDRESS));
+    attr.flags = BPF_ANY;
+
+    return (0 == udpfwd_bpf_sys(BPF_MAP_UPDATE_ELEM, &attr));
+}
+
+/*
+ * Function      : fastpath_map_delete
+ * Responsiblity : Remove an interface and port from the forwarding map
+ * Parameters    : ifIndex - input interface
+ *                 port - UDP destination port
+ * Return        : none
+ */
+static void fastpath_map_delete(uint32_t ifIndex, uint16_t port)
+{
+    UDPFWD_FASTPATH_KEY key = { .ifIndex = ifIndex, .port = port };
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = fastpath.mapFd;
+    attr.key = (uintptr_t) &key;
+    udpfwd_bpf_sys(BPF_MAP_DELETE_ELEM, &attr);
+}
+
+/*
+ * Function      : fastpath_intf_find
+ * Responsiblity : Find the interface entry of an interface index
+ * Parameters    : ifIndex - interface index
+ * Return        : interface entry, NULL if the program is not attached
+ */
+static UDPFWD_FASTPATH_INTF *fastpath_intf_find(uint32_t ifIndex)
+{
+    uint32_t iter;
+
+    for (iter = 0; iter < fastpath.intfCount; iter++) {
+        if (fastpath.intfs[iter].ifIndex == ifIndex)
+            return &fastpath.intfs[iter];
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : fastpath_intf_add
+ * Responsiblity : Attach the program to an interface. The program is
+ *                 detached when the link is closed, also on a crash.
+ * Parameters    : ifIndex - interface index
+ * Return        : interface entry, NULL on failure
+ */
+static UDPFWD_FASTPATH_INTF *fastpath_intf_add(uint32_t ifIndex)
+{
+    UDPFWD_FASTPATH_INTF *intfs, *intf;
+    union bpf_attr attr;
+    int32_t linkFd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = fastpath.progFd;
+    attr.link_create.target_ifindex = ifIndex;
+    attr.link_create.attach_type = FASTPATH_TCX_INGRESS;
+
+    linkFd = udpfwd_bpf_sys(BPF_LINK_CREATE, &attr);
+    if (linkFd < 0) {
+        fastpath.attachFailures++;
+        VLOG_ERR("Failed to attach UDP forwarding program to ifindex %d, "
+                 "errno : %d", ifIndex, errno);
+        return NULL;
+    }
+
+    if (fastpath.intfCount == fastpath.intfMax) {
+        intfs = (UDPFWD_FASTPATH_INTF *) realloc(fastpath.intfs,
+                    (2 * fastpath.intfMax + 8) *
+                    sizeof(UDPFWD_FASTPATH_INTF));
+        if (NULL == intfs) {
+            VLOG_ERR("Failed to allocate fast path interface : %d",
+                     ifIndex);
+            close(linkFd);
+            return NULL;
+        }
+        fastpath.intfs = intfs;
+        fastpath.intfMax = 2 * fastpath.intfMax + 8;
+    }
+
+    intf = &fastpath.intfs[fastpath.intfCount++];
+    memset(intf, 0, sizeof(UDPFWD_FASTPATH_INTF));
+    intf->ifIndex = ifIndex;
+    intf->linkFd = linkFd;
+
+    return intf;
+}
+
+/*
+ * Function      : fastpath_intf_sync
+ * Responsiblity : Bring the forwarding map entries of an interface in
+ *                 line with its ports. New and changed ports are set
+ *                 before stale ones are removed.
+ * Parameters    : intf - interface entry
+ *                 ports - configured ports and servers
+ *                 portCount - number of ports
+ * Return        : none
+ */
+static void fastpath_intf_sync(UDPFWD_FASTPATH_INTF *intf,
+                               const UDPFWD_FASTPATH_PORT *ports,
+                               uint32_t portCount)
+{
+    const UDPFWD_FASTPATH_PORT *installed;
+    uint32_t iter, cur;
+    bool found;
+
+    for (iter = 0; iter < portCount; iter++) {
+        for (installed = NULL, cur = 0; cur < intf->portCount; cur++) {
+            if (intf->ports[cur].port == ports[iter].port)
+                installed = &intf->ports[cur];
+        }
+        if ((NULL != installed) &&
+            (installed->serverCount == ports[iter].serverCount) &&
+            !memcmp(installed->servers, ports[iter].servers,
+                    installed->serverCount * sizeof(IP_ADDRESS)))
+            continue;
+
+        if (true != fastpath_map_set(intf->ifIndex, &ports[iter])) {
+            VLOG_ERR("Failed to set UDP forwarding of port %d on ifindex "
+                     "%d, errno : %d", ports[iter].port, intf->ifIndex,
+                     errno);
+        }
+    }
+
+    for (cur = 0; cur < intf->portCount; cur++) {
+        for (found = false, iter = 0; !found && (iter < portCount); iter++)
+            found = (intf->ports[cur].port == ports[iter].port);
+        if (!found)
+            fastpath_map_delete(intf->ifIndex, intf->ports[cur].port);
+    }
+
+    if (portCount)
+        memcpy(intf->ports, ports, portCount * sizeof(UDPFWD_FASTPATH_PORT));
+    intf->portCount = portCount;
+}
+
+/*
+ * Function      : fastpath_snapshot_ports
+ * Responsiblity : Copy the port table of a forwarding snapshot. The DHCP
+ *                 ports are relayed, not forwarded. A port with more
+ *                 servers than the program handles, or beyond
+ *                 UDPFWD_FASTPATH_PORTS_MAX, stays in user space.
+ * Parameters    : snapshot - forwarding snapshot
+ *                 ports - filled with the ports and their servers
+ * Return        : number of ports
+ */
+static uint32_t fastpath_snapshot_ports(const UDPFWD_FWD_SNAPSHOT *snapshot,
+                                        UDPFWD_FASTPATH_PORT *ports)
+{
+    const UDPFWD_FWD_PORT *port;
+    uint32_t portCount = 0, iter;
+
+    for (iter = 0; (iter < snapshot->portCount) &&
+                   (portCount < UDPFWD_FASTPATH_PORTS_MAX); iter++) {
+        port = &snapshot->ports[iter];
+        if ((DHCPS_PORT == port->udp_port) ||
+            (DHCPC_PORT == port->udp_port) ||
+            (UDPFWD_FASTPATH_SERVERS_MAX < port->count))
+            continue;
+
+        memset(&ports[portCount], 0, sizeof(UDPFWD_FASTPATH_PORT));
+        ports[portCount].port = port->udp_port;
+        ports[portCount].serverCount = port->count;
+        memcpy(ports[portCount].servers, &snapshot->servers[port->first],
+               port->count * sizeof(IP_ADDRESS));
+        portCount++;
+    }
+
+    return portCount;
+}
+
+/*
+ * Function      : udpfwd_fastpath_set_enabled
+ * Responsiblity : Forward UDP broadcasts in the kernel when possible. Must
+ *                 be called before udpfwd_init().
+ * Parameters    : enable - true to enable the fast path
+ * Return        : none
+ */
+void udpfwd_fastpath_set_enabled(bool enable)
+{
+    fastpath.enabled = enable;
+}
+
+/*
+ * Function      : udpfwd_fastpath_init
+ * Responsiblity : Create the forwarding map and load the program, and
+ *                 make the receive filter skip the datagrams it marks.
+ *                 Called before the worker sockets get their filter. The
+ *                 packet sockets of the TPACKET backend see the datagrams
+ *                 before TC ingress, and the XDP backend redirects them
+ *                 before, so the fast path needs the socket backend.
+ * Parameters    : none
+ * Return        : true, if the fast path is ready
+ *                 false, otherwise, everything is forwarded in user space
+ */
+bool udpfwd_fastpath_init(void)
+{
+    union bpf_attr attr;
+
+    if (!fastpath.enabled)
+        return false;
+
+    if (UDPFWD_RX_BACKEND_SOCKET != udpfwd_ctrl_cb_p->rx_backend) {
+        VLOG_ERR("The UDP forwarding fast path needs the socket receive "
+                 "backend");
+        return false;
+    }
+
+    /* Entries are freed after a grace period, the program reads the
+     * servers of a replaced entry consistently */
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_HASH;
+    attr.key_size = sizeof(UDPFWD_FASTPATH_KEY);
+    attr.value_size = sizeof(UDPFWD_FASTPATH_ENTRY);
+    attr.max_entries = UDPFWD_FASTPATH_ENTRIES_MAX;
+    attr.map_flags = BPF_F_NO_PREALLOC;
+    fastpath.mapFd = udpfwd_bpf_sys(BPF_MAP_CREATE, &attr);
+    if (fastpath.mapFd < 0) {
+        VLOG_ERR("Failed to create UDP forwarding map, errno : %d", errno);
+        return false;
+    }
+
+    fastpath.progFd = fastpath_prog_load();
+    if (fastpath.progFd < 0) {
+        udpfwd_fastpath_exit();
+        return false;
+    }
+
+    udpfwd_filter_set_skip_mark(UDPFWD_FASTPATH_MARK);
+
+    VLOG_INFO("UDP broadcast forwarding fast path enabled");
+    return true;
+}
+
+/*
+ * Function      : udpfwd_fastpath_update
+ * Responsiblity : Load the published forwarding snapshots in the
+ *                 forwarding map, attaching the program to the interfaces
+ *                 which got servers and detaching it from the others. An
+ *                 interface without address gets no entry, user space
+ *                 drops its datagrams.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_fastpath_update(void)
+{
+    UDPFWD_FASTPATH_PORT ports[UDPFWD_FASTPATH_PORTS_MAX];
+    const UDPFWD_FWD_SNAPSHOT *snapshot;
+    UDPFWD_FASTPATH_INTF *intf;
+    uint32_t portCount, iter;
+
+    if (fastpath.progFd < 0)
+        return;
+
+    for (iter = 0; iter < fastpath.intfCount; iter++)
+        fastpath.intfs[iter].seen = false;
+
+    if (ENABLE == get_feature_status(udpfwd_ctrl_cb_p->feature_config.config,
+                                     UDP_BCAST_FORWARDER)) {
+        CMAP_FOR_EACH(snapshot, cmap_node, &udpfwd_ctrl_cb_p->fwdMap) {
+            if (0 == udpfwd_intf_cache_lowest_ip(snapshot->ifIndex))
+                continue;
+
+            portCount = fastpath_snapshot_ports(snapshot, ports);
+            if (0 == portCount)
+                continue;
+
+            intf = fastpath_intf_find(snapshot->ifIndex);
+            if ((NULL == intf) &&
+                (NULL == (intf = fastpath_intf_add(snapshot->ifIndex))))
+                continue;
+
+            fastpath_intf_sync(intf, ports, portCount);
+            intf->seen = true;
+        }
+    }
+
+    for (iter = 0; iter < fastpath.intfCount; ) {
+        intf = &fastpath.intfs[iter];
+        if (intf->seen) {
+            iter++;
+            continue;
+        }
+
+        fastpath_intf_sync(intf, NULL, 0);
+        close(intf->linkFd);
+        *intf = fastpath.intfs[--fastpath.intfCount];
+    }
+
+    fastpath.addrSeq = udpfwd_intf_cache_addr_seq();
+}
+
+/*
+ * Function      : udpfwd_fastpath_run
+ * Responsiblity : Reload the forwarding map when interface addresses
+ *                 changed, an interface losing its last address goes back
+ *                 to user space
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_fastpath_run(void)
+{
+    if ((0 <= fastpath.progFd) &&
+        (fastpath.addrSeq != udpfwd_intf_cache_addr_seq()))
+        udpfwd_fastpath_update();
+}
+
+/*
+ * Function      : udpfwd_fastpath_exit
+ * Responsiblity : Detach the program and release it with its map
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_fastpath_exit(void)
+{
+    uint32_t iter;
+
+    for (iter = 0; iter < fastpath.intfCount; iter++)
+        close(fastpath.intfs[iter].linkFd);
+    free(fastpath.intfs);
+    fastpath.intfs = NULL;
+    fastpath.intfCount = fastpath.intfMax = 0;
+
+    if (0 <= fastpath.progFd)
+        close(fastpath.progFd);
+    if (0 <= fastpath.mapFd)
+        close(fastpath.mapFd);
+    fastpath.progFd = fastpath.mapFd = -1;
+}
+
+/*
+ * Function      : udpfwd_fastpath_dump
+ * Responsiblity : Dump the counters of the forwarding map entries of an
+ *                 interface
+ * Parameters    : ds - output buffer
+ *                 ifIndex - interface index
+ *                 port - UDP destination port, 0 for every port
+ * Return        : none
+ */
+void udpfwd_fastpath_dump(struct ds *ds, uint32_t ifIndex, uint16_t port)
+{
+    UDPFWD_FASTPATH_INTF *intf;
+    UDPFWD_FASTPATH_KEY key;
+    UDPFWD_FASTPATH_ENTRY entry;
+    union bpf_attr attr;
+    uint32_t iter;
+
+    if ((fastpath.progFd < 0) ||
+        (NULL == (intf = fastpath_intf_find(ifIndex))))
+        return;
+
+    for (iter = 0; iter < intf->portCount; iter++) {
+        if (port && (port != intf->ports[iter].port))
+            continue;
+
+        memset(&key, 0, sizeof(key));
+        key.ifIndex = ifIndex;
+        key.port = intf->ports[iter].port;
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = fastpath.mapFd;
+        attr.key = (uintptr_t) &key;
+        attr.value = (uintptr_t) &entry;
+        if (0 != udpfwd_bpf_sys(BPF_MAP_LOOKUP_ELEM, &attr))
+            continue;
+
+        ds_put_format(ds, "Fast path port %d - forwarded %"PRIu64", "
+                      "copies %"PRIu64", to user space %"PRIu64"\n",
+                      key.port, entry.packets, entry.copies, entry.punts);
+    }
+}
+#endif /* FTR_UDP_BCAST_FWD */
@@ -0,0 +1,546 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_filter.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Generate the kernel socket filter of the receive workers.
+ * - Regenerate the filter when the set of forwarded ports changes.
+ * - Count the datagrams rejected by the filter.
+ *
+ * Raw sockets get a copy of every UDP datagram received by the host, the
+ * filter keeps the ones the daemon does not serve out of the socket queue.
+ * Packet sockets of the TPACKET receive backend see every IPv4 packet
+ * before reassembly, so the filter also drops other protocols and
+ * fragments.
+ * A new filter is swapped in with SO_ATTACH_FILTER/SO_ATTACH_BPF, which
+ * replace the filter of a socket atomically.
+ */
+
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <linux/filter.h>
+#include <linux/bpf.h>
+#include "udpfwd_util.h"
+#include "udpfwd_filter.h"
+
+VLOG_DEFINE_THIS_MODULE(udpfwd_filter);
+
+#ifndef SO_ATTACH_BPF
+#define SO_ATTACH_BPF 50
+#endif
+
+/* Longest eBPF program, every forwarded port is one instruction */
+#define EBPF_PROG_MAX (UDPFWD_FILTER_PORTS_MAX + 40)
+
+/* eBPF instructions counting a rejected datagram */
+#define EBPF_COUNT_LEN 9
+
+/* Receive filter */
+static UDPFWD_FILTER filter = { .mapFd = -1 };
+
+/*
+ * Function      : udpfwd_bpf_sys
+ * Responsiblity : Invoke the bpf() system call
+ * Parameters    : cmd - bpf command
+ *                 attr - command attributes
+ * Return        : syscall return value
+ */
+int32_t udpfwd_bpf_sys(int32_t cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(union bpf_attr));
+}
+
+/*
+ * Function      : udpfwd_ebpf_emit
+ * Responsiblity : Append an instruction to an eBPF program
+ * Parameters    : insns - program
+ *                 len - program length, incremented
+ *                 code - opcode
+ *                 dst, src - registers
+ *                 off - offset
+ *                 imm - immediate
+ * Return        : none
+ */
+void udpfwd_ebpf_emit(struct bpf_insn *insns, uint32_t *len, uint8_t code,
+                      uint8_t dst, uint8_t src, int16_t off, int32_t imm)
+{
+    struct bpf_insn *insn = &insns[(*len)++];
+
+    memset(insn, 0, sizeof(struct bpf_insn));
+    insn->code = code;
+    insn->dst_reg = dst;
+    insn->src_reg = src;
+    insn->off = off;
+    insn->imm = imm;
+}
+
+/*
+ * Function      : ebpf_load
+ * Responsiblity : Generate and load the eBPF filter of a worker. The
+ *                 program of shard 0 adds the datagrams it rejects on the
+ *                 port check to the counter map, the other shards reject
+ *                 the same datagrams and do not count them again.
+ *                   Datagrams marked as forwarded by the fast path, non
+ *                   UDP packets and fragments are dropped first.
+ *                   r7 = IP header length, r0 = UDP destination port
+ *                   DHCP ports shard on the transaction id, forwarded
+ *                   ports on source address ^ source port.
+ * Parameters    : shard - shard accepted by the socket
+ *                 n_shards - number of shards
+ * Return        : program fd, on success
+ *                 -1, on failure
+ */
+static int32_t ebpf_load(uint32_t shard, uint32_t n_shards)
+{
+    struct bpf_insn insns[EBPF_PROG_MAX];
+    union bpf_attr attr;
+    uint32_t len = 0, ports, reject, other, dhcp, shard_pc, drop, iter;
+    uint32_t skip;
+    int32_t fd;
+
+    skip = filter.skipMark ? 2 : 0;
+    ports = filter.acceptAll ? 0 : filter.portCount;
+    reject = filter.acceptAll ? 0 : (0 == shard ? EBPF_COUNT_LEN : 0) + 1;
+    other = 12 + skip + ports + reject;
+    dhcp = other + 5;
+    shard_pc = dhcp + 1;
+    drop = shard_pc + 4;
+
+    /* r6 = skb, UDP datagrams which are not fragments only */
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0);
+    if (skip) {
+        udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 0, 6,
+                         offsetof(struct __sk_buff, mark), 0);
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JSET | BPF_K, 0, 0,
+                         drop - len - 1, filter.skipMark);
+    }
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, 9);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0,
+                     drop - len - 1, IPPROTO_UDP);
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_ABS | BPF_H, 0, 0, 0, 6);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JSET | BPF_K, 0, 0,
+                     drop - len - 1, IP_MF | IP_OFFMASK);
+
+    /* r7 = IP header length, r0 = UDP destination port */
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_AND | BPF_K, 0, 0, 0, 0x0f);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_LSH | BPF_K, 0, 0, 0, 2);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 7, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_IND | BPF_H, 0, 7, 0, 2);
+
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 0, 0,
+                     dhcp - len - 1, DHCPS_PORT);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 0, 0,
+                     dhcp - len - 1, DHCPC_PORT);
+    for (iter = 0; iter < ports; iter++) {
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 0, 0,
+                         other - len - 1, filter.ports[iter]);
+    }
+
+    if (reject) {
+        if (0 == shard) {
+            /* rejected[0] += 1 */
+            udpfwd_ebpf_emit(insns, &len, BPF_ST | BPF_MEM | BPF_W,
+                             10, 0, -4, 0);
+            udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X,
+                             2, 10, 0, 0);
+            udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K,
+                             2, 0, 0, -4);
+            udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_IMM | BPF_DW, 1,
+                             BPF_PSEUDO_MAP_FD, 0, filter.mapFd);
+            udpfwd_ebpf_emit(insns, &len, 0, 0, 0, 0, 0);
+            udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_CALL, 0, 0, 0,
+                             BPF_FUNC_map_lookup_elem);
+            udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 0, 0,
+                             drop - len - 1, 0);
+            udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K,
+                             1, 0, 0, 1);
+            udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_XADD | BPF_DW,
+                             0, 1, 0, 0);
+        }
+        udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JA, 0, 0,
+                         drop - len - 1, 0);
+    }
+
+    /* r0 = source address ^ UDP source port */
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_IND | BPF_H, 0, 7, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 8, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_ABS | BPF_W, 0, 0, 0, 12);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_XOR | BPF_X, 0, 8, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JA, 0, 0,
+                     shard_pc - len - 1, 0);
+
+    /* r0 = DHCP transaction id */
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_IND | BPF_W, 0, 7, 0,
+                     UDPHDR_LENGTH + 4);
+
+    /* Accept the datagram if r0 % n_shards is the worker shard */
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU | BPF_MOD | BPF_K, 0, 0, 0,
+                     n_shards);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 0, 0,
+                     drop - len - 1, shard);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU | BPF_MOV | BPF_K, 0, 0, 0, -1);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+    attr.insns = (uintptr_t) insns;
+    attr.insn_cnt = len;
+    attr.license = (uintptr_t) "GPL";
+
+    fd = udpfwd_bpf_sys(BPF_PROG_LOAD, &attr);
+    if (fd < 0) {
+        VLOG_ERR("Failed to load eBPF receive filter, errno : %d", errno);
+    }
+
+    return fd;
+}
+
+/*
+ * Function      : cbpf_attach
+ * Responsiblity : Generate and attach the classic BPF filter of a worker.
+ *                 Same checks as the eBPF program, without the counter.
+ * Parameters    : sock - worker socket
+ *                 shard - shard accepted by the socket
+ *                 n_shards - number of shards
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool cbpf_attach(int32_t sock, uint32_t shard, uint32_t n_shards)
+{
+    struct sock_filter code[UDPFWD_FILTER_PORTS_MAX + 28];
+    struct sock_fprog prog = { .filter = code };
+    uint32_t len = 0, ports, iter;
+
+    ports = filter.acceptAll ? 0 : filter.portCount;
+
+    /* Not forwarded by the fast path already */
+    if (filter.skipMark) {
+        code[len++] = (struct sock_filter)
+                      BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                               SKF_AD_OFF + SKF_AD_MARK);
+        code[len++] = (struct sock_filter)
+                      BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, filter.skipMark,
+                               0, 1);
+        code[len++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+    }
+
+    /* UDP datagrams which are not fragments only */
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9);
+    code[len++] = (struct sock_filter)
+                  BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 1, 0);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6);
+    code[len++] = (struct sock_filter)
+                  BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, IP_MF | IP_OFFMASK,
+                           0, 1);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+
+    /* X = IP header length, A = UDP destination port */
+    code[len++] = (struct sock_filter)
+                  BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0);
+    code[len++] = (struct sock_filter)
+                  BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2);
+    code[len++] = (struct sock_filter)
+                  BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, DHCPS_PORT,
+                           ports + 7, 0);
+    code[len++] = (struct sock_filter)
+                  BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, DHCPC_PORT,
+                           ports + 6, 0);
+    for (iter = 0; iter < ports; iter++) {
+        code[len++] = (struct sock_filter)
+                      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, filter.ports[iter],
+                               ports - iter, 0);
+    }
+
+    /* Port not forwarded */
+    if (filter.acceptAll)
+        code[len++] = (struct sock_filter) BPF_STMT(BPF_JMP | BPF_JA, 0);
+    else
+        code[len++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+
+    /* A = source address ^ UDP source port */
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_H | BPF_IND, 0);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 12);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_JMP | BPF_JA, 1);
+
+    /* A = DHCP transaction id */
+    code[len++] = (struct sock_filter)
+                  BPF_STMT(BPF_LD | BPF_W | BPF_IND, UDPHDR_LENGTH + 4);
+
+    /* Accept the datagram if A % n_shards is the worker shard */
+    code[len++] = (struct sock_filter)
+                  BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, n_shards);
+    code[len++] = (struct sock_filter)
+                  BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, shard, 0, 1);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+
+    prog.len = len;
+    if (0 != setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER,
+                        &prog, sizeof(prog))) {
+        VLOG_ERR("Failed to attach receive filter, errno : %d", errno);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_filter_attach
+ * Responsiblity : Attach the receive filter of a worker socket for the
+ *                 current set of forwarded ports. Raw sockets all get a
+ *                 copy of every datagram and neither SO_REUSEPORT nor
+ *                 PACKET_FANOUT apply to them, so each worker filters its
+ *                 own shard in the kernel. DHCP packets are sharded on the
+ *                 transaction id, because the requests of all clients
+ *                 share the same addresses and ports. Other datagrams are
+ *                 sharded on source address and port. Replaces the filter
+ *                 already attached to the socket, if any.
+ * Parameters    : sock - worker socket
+ *                 shard - shard accepted by the socket
+ *                 n_shards - number of shards
+ * Return        : true, on success
+ *                 false, on failure
+ */
+bool udpfwd_filter_attach(int32_t sock, uint32_t shard, uint32_t n_shards)
+{
+    int32_t progFd;
+    int32_t retVal;
+
+    if (filter.ebpf) {
+        progFd = ebpf_load(shard, n_shards);
+        if (0 <= progFd) {
+            retVal = setsockopt(sock, SOL_SOCKET, SO_ATTACH_BPF,
+                                &progFd, sizeof(progFd));
+            /* The socket holds its own reference to the program */
+            close(progFd);
+            if (0 == retVal)
+                return true;
+            VLOG_ERR("Failed to attach eBPF receive filter, errno : %d",
+                     errno);
+        }
+    }
+
+    return cbpf_attach(sock, shard, n_shards);
+}
+
+/*
+ * Function      : udpfwd_filter_attach_reject
+ * Responsiblity : Attach a filter which rejects every datagram. Used on the
+ *                 worker sockets which only send, so that the raw socket
+ *                 does not queue a copy of the received traffic.
+ * Parameters    : sock - worker socket
+ * Return        : true, on success
+ *                 false, on failure
+ */
+bool udpfwd_filter_attach_reject(int32_t sock)
+{
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct sock_fprog prog = { .len = ARRAY_SIZE(code), .filter = code };
+
+    if (0 != setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER,
+                        &prog, sizeof(prog))) {
+        VLOG_ERR("Failed to attach reject filter, errno : %d", errno);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_filter_set_skip_mark
+ * Responsiblity : Reject the datagrams carrying a packet mark bit, set by
+ *                 the fast path on the datagrams it forwarded. Must be
+ *                 called before the worker sockets get their filter.
+ * Parameters    : mark - mark bits, 0 to accept every mark
+ * Return        : none
+ */
+void udpfwd_filter_set_skip_mark(uint32_t mark)
+{
+    filter.skipMark = mark;
+}
+
+/*
+ * Function      : udpfwd_filter_update
+ * Responsiblity : Collect the UDP ports of the configured servers and swap
+ *                 the filter of every worker socket when they changed.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_filter_update(void)
+{
+    UDPFWD_SERVER_T *server;
+    uint16_t ports[UDPFWD_FILTER_PORTS_MAX];
+    uint32_t count = 0, iter, pos;
+    bool acceptAll = false;
+    UDPFWD_RX_WORKER *worker;
+
+    CMAP_FOR_EACH(server, cmap_node, &udpfwd_ctrl_cb_p->serverHashMap) {
+        if ((DHCPS_PORT == server->udp_port) ||
+            (DHCPC_PORT == server->udp_port))
+            continue;
+
+        /* Insert sorted, skip duplicates */
+        for (pos = 0; (pos < count) && (ports[pos] < server->udp_port); pos++);
+        if ((pos < count) && (ports[pos] == server->udp_port))
+            continue;
+
+        if (UDPFWD_FILTER_PORTS_MAX == count) {
+            acceptAll = true;
+            break;
+        }
+
+        memmove(&ports[pos + 1], &ports[pos],
+                (count - pos) * sizeof(uint16_t));
+        ports[pos] = server->udp_port;
+        count++;
+    }
+
+    if (acceptAll)
+        count = 0;
+
+    if ((acceptAll == filter.acceptAll) && (count == filter.portCount) &&
+        !memcmp(ports, filter.ports, count * sizeof(uint16_t)))
+        return;
+
+    filter.acceptAll = acceptAll;
+    filter.portCount = count;
+    memcpy(filter.ports, ports, count * sizeof(uint16_t));
+    filter.updates++;
+
+    if (acceptAll) {
+        VLOG_INFO("More than %d forwarded ports, receive filter accepts "
+                  "every UDP port", UDPFWD_FILTER_PORTS_MAX);
+    }
+
+    for (iter = 0; iter < udpfwd_ctrl_cb_p->n_workers; iter++) {
+        worker = &udpfwd_ctrl_cb_p->workers[iter];
+        if (true != udpfwd_filter_attach(worker->rxFd, iter,
+                                         udpfwd_ctrl_cb_p->n_workers)) {
+            VLOG_ERR("Failed to update receive filter of worker %d", iter);
+        }
+    }
+}
+
+/*
+ * Function      : udpfwd_filter_rejected
+ * Responsiblity : Read the number of datagrams rejected by the filter
+ * Parameters    : count - rejected datagrams
+ * Return        : true, if the counter is available
+ *                 false, otherwise
+ */
+static bool udpfwd_filter_rejected(uint64_t *count)
+{
+    union bpf_attr attr;
+    uint32_t key = 0;
+
+    if (!filter.ebpf)
+        return false;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = filter.mapFd;
+    attr.key = (uintptr_t) &key;
+    attr.value = (uintptr_t) count;
+
+    return (0 == udpfwd_bpf_sys(BPF_MAP_LOOKUP_ELEM, &attr));
+}
+
+/*
+ * Function      : udpfwd_filter_dump
+ * Responsiblity : Dump the receive filter state and rejected datagrams
+ * Parameters    : ds - output buffer
+ * Return        : none
+ */
+void udpfwd_filter_dump(struct ds *ds)
+{
+    uint64_t rejected;
+    uint32_t iter;
+
+    ds_put_format(ds, "Receive filter : %s\n",
+                  filter.ebpf ? "eBPF" : "classic BPF");
+    ds_put_format(ds, "Filter updates : %"PRIu64"\n", filter.updates);
+
+    ds_put_format(ds, "Filter ports : %d %d", DHCPS_PORT, DHCPC_PORT);
+    if (filter.acceptAll) {
+        ds_put_format(ds, " all");
+    }
+    for (iter = 0; iter < filter.portCount; iter++) {
+        ds_put_format(ds, " %d", filter.ports[iter]);
+    }
+    ds_put_format(ds, "\n");
+
+    if (udpfwd_filter_rejected(&rejected))
+        ds_put_format(ds, "Filter rejected : %"PRIu64"\n", rejected);
+    else
+        ds_put_format(ds, "Filter rejected : unavailable\n");
+}
+
+/*
+ * Function      : udpfwd_filter_init
+ * Responsiblity : Create the rejected datagram counter. Filters fall back
+ *                 to classic BPF when the kernel does not allow eBPF.
+ * Parameters    : none
+ * Return        : true
+ */
+bool udpfwd_filter_init(void)
+{
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_ARRAY;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint64_t);
+    attr.max_entries = 1;
+
+    filter.mapFd = udpfwd_bpf_sys(BPF_MAP_CREATE, &attr);
+    if (filter.mapFd < 0) {
+        VLOG_INFO("eBPF not available, errno : %d. Rejected datagrams "
+                  "are not counted", errno);
+        filter.ebpf = false;
+        return true;
+    }
+
+    filter.ebpf = true;
+    return true;
+}
+
+/*
+ * Function      : udpfwd_filter_exit
+ * Responsiblity : Release the rejected datagram counter
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_filter_exit(void)
+{
+    if (0 <= filter.mapFd)
+        close(filter.mapFd);
+    filter.mapFd = -1;
+    filter.ebpf = false;
+}
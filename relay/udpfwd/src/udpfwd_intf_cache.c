@@ -0,0 +1,812 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_intf_cache.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Load the kernel interfaces and their IPv4 addresses from netlink.
+ * - Track RTNLGRP_LINK and RTNLGRP_IPV4_IFADDR notifications.
+ * - Serve ifindex based lookups to the packet receiver thread.
+ * - Index the local IPv4 addresses to resolve the interface of a giaddr.
+ *
+ * Only the main thread updates the cache. Entries are published with
+ * cmap and freed with ovsrcu_postpone(), so readers never take a lock.
+ */
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "hash.h"
+#include "ovs-rcu.h"
+#include "poll-loop.h"
+#include "udpfwd_util.h"
+#include "udpfwd_intf_cache.h"
+
+VLOG_DEFINE_THIS_MODULE(udpfwd_intf_cache);
+
+/* Netlink receive buffer size */
+#define NL_RECV_BUFFER_SIZE 32768
+
+/* Interface cache */
+static UDPFWD_INTF_CACHE intf_cache = { .nlSockFd = -1 };
+
+/* Netlink receive buffer, aligned for nlmsghdr access */
+static uint32_t nl_buffer[NL_RECV_BUFFER_SIZE / sizeof(uint32_t)];
+
+/* Sequence number of the netlink dump requests */
+static uint32_t nl_dump_seq;
+
+/*
+ * Function      : intf_entry_find
+ * Responsiblity : Lookup the interface cache for an ifindex
+ * Parameters    : ifIndex - interface index
+ * Return        : UDPFWD_INTF_ENTRY* - interface entry if found
+ *                 NULL - otherwise
+ */
+static UDPFWD_INTF_ENTRY *intf_entry_find(uint32_t ifIndex)
+{
+    UDPFWD_INTF_ENTRY *entry;
+
+    CMAP_FOR_EACH_WITH_HASH(entry, cmap_node, hash_int(ifIndex, 0),
+                            &intf_cache.intfMap) {
+        if (entry->ifIndex == ifIndex) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : addr_entry_find
+ * Responsiblity : Lookup the address index for an IPv4 address
+ * Parameters    : ip - ip address
+ *                 ifIndex - owning interface, -1 for any interface
+ * Return        : UDPFWD_ADDR_ENTRY* - address entry if found
+ *                 NULL - otherwise
+ */
+static UDPFWD_ADDR_ENTRY *addr_entry_find(IP_ADDRESS ip, uint32_t ifIndex)
+{
+    UDPFWD_ADDR_ENTRY *entry;
+
+    CMAP_FOR_EACH_WITH_HASH(entry, cmap_node, hash_int(ip, 0),
+                            &intf_cache.addrMap) {
+        if ((entry->ip == ip) &&
+            ((-1 == ifIndex) || (entry->ifIndex == ifIndex))) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : addr_index_diff
+ * Responsiblity : Insert or remove the addresses of 'from' which are not
+ *                 part of 'to' in the address index
+ * Parameters    : from - interface entry to take the addresses from
+ *                 to - interface entry to compare with, if any
+ *                 add - true to insert, false to remove
+ * Return        : none
+ */
+static void addr_index_diff(const UDPFWD_INTF_ENTRY *from,
+                            const UDPFWD_INTF_ENTRY *to, bool add)
+{
+    UDPFWD_ADDR_ENTRY *entry;
+    uint32_t iter, iter2;
+    bool found;
+
+    if (NULL == from)
+        return;
+
+    for (iter = 0; iter < from->addrCount; iter++) {
+        found = false;
+        for (iter2 = 0; to && (iter2 < to->addrCount); iter2++) {
+            if (to->addrs[iter2] == from->addrs[iter]) {
+                found = true;
+                break;
+            }
+        }
+        if (found)
+            continue;
+
+        if (add) {
+            entry = (UDPFWD_ADDR_ENTRY *) malloc(sizeof(UDPFWD_ADDR_ENTRY));
+            if (NULL == entry) {
+                VLOG_ERR("Failed to allocate address index entry");
+                continue;
+            }
+            entry->ip = from->addrs[iter];
+            entry->ifIndex = from->ifIndex;
+            cmap_insert(&intf_cache.addrMap, &entry->cmap_node,
+                        hash_int(entry->ip, 0));
+            intf_cache.addrSeq++;
+        } else {
+            entry = addr_entry_find(from->addrs[iter], from->ifIndex);
+            if (NULL != entry) {
+                cmap_remove(&intf_cache.addrMap, &entry->cmap_node,
+                            hash_int(entry->ip, 0));
+                ovsrcu_postpone(free, entry);
+                intf_cache.addrSeq++;
+            }
+        }
+    }
+}
+
+/*
+ * Function      : intf_entry_alloc
+ * Responsiblity : Allocate a new version of an interface entry. The name
+ *                 and MAC address are inherited from the old version.
+ * Parameters    : old - current version of the entry, if any
+ *                 ifIndex - interface index
+ *                 addrCount - number of IPv4 addresses of the new version
+ * Return        : UDPFWD_INTF_ENTRY* - new entry
+ *                 NULL - on allocation failure
+ */
+static UDPFWD_INTF_ENTRY *intf_entry_alloc(const UDPFWD_INTF_ENTRY *old,
+                                           uint32_t ifIndex,
+                                           uint32_t addrCount)
+{
+    UDPFWD_INTF_ENTRY *entry;
+
+    entry = (UDPFWD_INTF_ENTRY *) calloc(1, sizeof(UDPFWD_INTF_ENTRY) +
+                                            addrCount * sizeof(IP_ADDRESS));
+    if (NULL == entry) {
+        VLOG_ERR("Failed to allocate interface cache entry for ifindex : %d",
+                 ifIndex);
+        return NULL;
+    }
+
+    entry->ifIndex = ifIndex;
+    entry->addrCount = addrCount;
+    if (NULL != old) {
+        memcpy(entry->ifName, old->ifName, IF_NAMESIZE);
+        memcpy(entry->mac, old->mac, sizeof(MAC_ADDRESS));
+    }
+
+    return entry;
+}
+
+/*
+ * Function      : intf_entry_publish
+ * Responsiblity : Make a new version of an interface entry visible to the
+ *                 readers and release the old one after a grace period.
+ * Parameters    : old - current version of the entry, if any
+ *                 entry - new version of the entry
+ * Return        : none
+ */
+static void intf_entry_publish(UDPFWD_INTF_ENTRY *old,
+                               UDPFWD_INTF_ENTRY *entry)
+{
+    IP_ADDRESS lowest_ip = MAX_UINT32;
+    uint32_t iter;
+
+    for (iter = 0; iter < entry->addrCount; iter++) {
+        if (lowest_ip > entry->addrs[iter])
+            lowest_ip = entry->addrs[iter];
+    }
+    entry->lowest_ip = (lowest_ip != MAX_UINT32) ? lowest_ip : 0;
+
+#ifdef FTR_DHCP_RELAY
+    /* Both remote-id types are encoded, a change of r_id needs no update */
+    dhcp_relay_option82_template(&entry->option82[REMOTE_ID_MAC],
+                                 entry->ifIndex, REMOTE_ID_MAC, entry->mac);
+    dhcp_relay_option82_template(&entry->option82[REMOTE_ID_IP],
+                                 entry->ifIndex, REMOTE_ID_IP,
+                                 entry->lowest_ip ? &entry->lowest_ip : NULL);
+#endif /* FTR_DHCP_RELAY */
+
+    /* Keep the address index in step with the interface */
+    addr_index_diff(old, entry, false);
+    addr_index_diff(entry, old, true);
+
+    if ((NULL != old) && !strcmp(old->ifName, entry->ifName)) {
+        cmap_replace(&intf_cache.nameMap, &old->name_node, &entry->name_node,
+                     hash_string(entry->ifName, 0));
+    } else {
+        if (NULL != old)
+            cmap_remove(&intf_cache.nameMap, &old->name_node,
+                        hash_string(old->ifName, 0));
+        cmap_insert(&intf_cache.nameMap, &entry->name_node,
+                    hash_string(entry->ifName, 0));
+        intf_cache.linksChanged = true;
+    }
+
+    if (NULL != old) {
+        cmap_replace(&intf_cache.intfMap, &old->cmap_node, &entry->cmap_node,
+                     hash_int(entry->ifIndex, 0));
+        ovsrcu_postpone(free, old);
+    } else {
+        cmap_insert(&intf_cache.intfMap, &entry->cmap_node,
+                    hash_int(entry->ifIndex, 0));
+    }
+}
+
+/*
+ * Function      : intf_entry_remove
+ * Responsiblity : Remove an interface entry from the cache
+ * Parameters    : entry - interface entry
+ * Return        : none
+ */
+static void intf_entry_remove(UDPFWD_INTF_ENTRY *entry)
+{
+    addr_index_diff(entry, NULL, false);
+    cmap_remove(&intf_cache.nameMap, &entry->name_node,
+                hash_string(entry->ifName, 0));
+    cmap_remove(&intf_cache.intfMap, &entry->cmap_node,
+                hash_int(entry->ifIndex, 0));
+    intf_cache.linksChanged = true;
+    ovsrcu_postpone(free, entry);
+}
+
+/*
+ * Function      : intf_cache_handle_link
+ * Responsiblity : Process a RTM_NEWLINK/RTM_DELLINK message
+ * Parameters    : nlh - netlink message
+ *                 reset_addrs - drop the known addresses of the interface,
+ *                               they are reloaded by an address dump
+ * Return        : none
+ */
+static void intf_cache_handle_link(struct nlmsghdr *nlh, bool reset_addrs)
+{
+    struct ifinfomsg *ifi = (struct ifinfomsg *) NLMSG_DATA(nlh);
+    struct rtattr *rta;
+    int32_t len = IFLA_PAYLOAD(nlh);
+    const char *name = NULL;
+    const uint8_t *mac = NULL;
+    uint32_t mac_len = 0;
+    uint32_t addrCount = 0;
+    UDPFWD_INTF_ENTRY *old, *entry;
+
+    old = intf_entry_find(ifi->ifi_index);
+
+    if (RTM_DELLINK == nlh->nlmsg_type) {
+        if (NULL != old) {
+            VLOG_DBG("Interface removed from cache : %s", old->ifName);
+            intf_entry_remove(old);
+        }
+        return;
+    }
+
+    for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (IFLA_IFNAME == rta->rta_type) {
+            name = (const char *) RTA_DATA(rta);
+        } else if (IFLA_ADDRESS == rta->rta_type) {
+            mac = (const uint8_t *) RTA_DATA(rta);
+            mac_len = RTA_PAYLOAD(rta);
+        }
+    }
+
+    if ((NULL != old) && !reset_addrs)
+        addrCount = old->addrCount;
+
+    entry = intf_entry_alloc(old, ifi->ifi_index, addrCount);
+    if (NULL == entry)
+        return;
+
+    if (addrCount)
+        memcpy(entry->addrs, old->addrs, addrCount * sizeof(IP_ADDRESS));
+
+    if (NULL != name)
+        strncpy(entry->ifName, name, IF_NAMESIZE - 1);
+
+    if (NULL != mac) {
+        memset(entry->mac, 0, sizeof(MAC_ADDRESS));
+        memcpy(entry->mac, mac, (mac_len < sizeof(MAC_ADDRESS)) ?
+                                 mac_len : sizeof(MAC_ADDRESS));
+    }
+
+    intf_entry_publish(old, entry);
+}
+
+/*
+ * Function      : intf_cache_handle_addr
+ * Responsiblity : Process a RTM_NEWADDR/RTM_DELADDR message
+ * Parameters    : nlh - netlink message
+ * Return        : none
+ */
+static void intf_cache_handle_addr(struct nlmsghdr *nlh)
+{
+    struct ifaddrmsg *ifa = (struct ifaddrmsg *) NLMSG_DATA(nlh);
+    struct rtattr *rta;
+    int32_t len = IFA_PAYLOAD(nlh);
+    IP_ADDRESS ip = 0, local = 0, address = 0;
+    uint32_t iter, count = 0;
+    bool exists = false;
+    UDPFWD_INTF_ENTRY *old, *entry;
+
+    if (AF_INET != ifa->ifa_family)
+        return;
+
+    for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (IFA_LOCAL == rta->rta_type) {
+            memcpy(&local, RTA_DATA(rta), sizeof(IP_ADDRESS));
+        } else if (IFA_ADDRESS == rta->rta_type) {
+            memcpy(&address, RTA_DATA(rta), sizeof(IP_ADDRESS));
+        }
+    }
+
+    /* Same address selection as getifaddrs() */
+    ip = local ? local : address;
+    if (0 == ip)
+        return;
+
+    old = intf_entry_find(ifa->ifa_index);
+    if (NULL != old) {
+        for (iter = 0; iter < old->addrCount; iter++) {
+            if (old->addrs[iter] == ip) {
+                exists = true;
+                break;
+            }
+        }
+    }
+
+    if (RTM_DELADDR == nlh->nlmsg_type) {
+        if (!exists)
+            return;
+
+        entry = intf_entry_alloc(old, ifa->ifa_index, old->addrCount - 1);
+        if (NULL == entry)
+            return;
+
+        for (iter = 0; iter < old->addrCount; iter++) {
+            if (old->addrs[iter] != ip)
+                entry->addrs[count++] = old->addrs[iter];
+        }
+    } else {
+        if (exists)
+            return;
+
+        entry = intf_entry_alloc(old, ifa->ifa_index,
+                                 (old ? old->addrCount : 0) + 1);
+        if (NULL == entry)
+            return;
+
+        if (NULL != old) {
+            memcpy(entry->addrs, old->addrs,
+                   old->addrCount * sizeof(IP_ADDRESS));
+            count = old->addrCount;
+        } else if (NULL == if_indextoname(ifa->ifa_index, entry->ifName)) {
+            /* Address seen before its link, name follows with RTM_NEWLINK */
+            memset(entry->ifName, 0, IF_NAMESIZE);
+        }
+        entry->addrs[count] = ip;
+    }
+
+    intf_entry_publish(old, entry);
+}
+
+/*
+ * Function      : intf_cache_parse
+ * Responsiblity : Process a buffer of netlink messages
+ * Parameters    : buf - received buffer
+ *                 len - length of the buffer
+ *                 reset_addrs - drop known addresses on link messages
+ * Return        : true - if the end of a dump is reached
+ *                 false - otherwise
+ */
+static bool intf_cache_parse(void *buf, int32_t len, bool reset_addrs)
+{
+    struct nlmsghdr *nlh;
+    struct nlmsgerr *err;
+
+    for (nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, len);
+         nlh = NLMSG_NEXT(nlh, len)) {
+        switch (nlh->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+            intf_cache_handle_link(nlh, reset_addrs);
+            break;
+
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+            intf_cache_handle_addr(nlh);
+            break;
+
+        case NLMSG_DONE:
+            return true;
+
+        case NLMSG_ERROR:
+            err = (struct nlmsgerr *) NLMSG_DATA(nlh);
+            VLOG_ERR("Netlink error message received, error : %d",
+                     err->error);
+            return true;
+
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Function      : intf_cache_dump
+ * Responsiblity : Request a full dump of the links or the IPv4 addresses
+ *                 and load it into the cache.
+ * Parameters    : type - RTM_GETLINK or RTM_GETADDR
+ *                 reset_addrs - drop known addresses on link messages
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+static bool intf_cache_dump(uint16_t type, bool reset_addrs)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct rtgenmsg gen;
+    } req;
+    struct sockaddr_nl addr;
+    int32_t sock, len;
+    bool done = false;
+
+    sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (-1 == sock) {
+        VLOG_ERR("Failed to create netlink dump socket, errno : %d", errno);
+        return false;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+    req.nlh.nlmsg_type = type;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++nl_dump_seq;
+    req.gen.rtgen_family = (RTM_GETADDR == type) ? AF_INET : AF_UNSPEC;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+
+    if (sendto(sock, &req, req.nlh.nlmsg_len, 0,
+               (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        VLOG_ERR("Failed to send netlink dump request, errno : %d", errno);
+        close(sock);
+        return false;
+    }
+
+    while (!done) {
+        len = recv(sock, nl_buffer, sizeof(nl_buffer), 0);
+        if (len < 0) {
+            if (EINTR == errno)
+                continue;
+            VLOG_ERR("Failed to receive netlink dump, errno : %d", errno);
+            break;
+        }
+        done = intf_cache_parse(nl_buffer, len, reset_addrs);
+    }
+
+    close(sock);
+    return done;
+}
+
+/*
+ * Function      : intf_cache_resync
+ * Responsiblity : Reload the whole cache from the kernel. Used at startup
+ *                 and when notifications were lost.
+ * Parameters    : none
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+static bool intf_cache_resync(void)
+{
+    UDPFWD_INTF_ENTRY *entry;
+    UDPFWD_INTF_ENTRY **stale;
+    uint32_t n_stale = 0, iter;
+
+    /* Every interface of the link dump gets a new entry. An entry which
+     * survives the dump unchanged belongs to a deleted interface. The old
+     * entries are not freed before the main thread quiesces, so comparing
+     * the pointers is safe */
+    stale = (UDPFWD_INTF_ENTRY **) calloc(cmap_count(&intf_cache.intfMap) + 1,
+                                          sizeof(UDPFWD_INTF_ENTRY *));
+    if (NULL == stale) {
+        VLOG_ERR("Failed to allocate memory for interface cache resync");
+        return false;
+    }
+
+    CMAP_FOR_EACH(entry, cmap_node, &intf_cache.intfMap) {
+        stale[n_stale++] = entry;
+    }
+
+    if (!intf_cache_dump(RTM_GETLINK, true)) {
+        free(stale);
+        return false;
+    }
+
+    for (iter = 0; iter < n_stale; iter++) {
+        if (intf_entry_find(stale[iter]->ifIndex) == stale[iter])
+            intf_entry_remove(stale[iter]);
+    }
+    free(stale);
+
+    return intf_cache_dump(RTM_GETADDR, false);
+}
+
+/*
+ * Function      : udpfwd_intf_cache_init
+ * Responsiblity : Subscribe to link and IPv4 address notifications and
+ *                 load the current state of the kernel interfaces.
+ * Parameters    : none
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+bool udpfwd_intf_cache_init(void)
+{
+    struct sockaddr_nl addr;
+    int32_t sock;
+    int32_t groups[] = { RTNLGRP_LINK, RTNLGRP_IPV4_IFADDR };
+    uint32_t iter;
+
+    cmap_init(&intf_cache.intfMap);
+    cmap_init(&intf_cache.nameMap);
+    cmap_init(&intf_cache.addrMap);
+
+    sock = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_ROUTE);
+    if (-1 == sock) {
+        VLOG_ERR("Failed to create netlink socket, errno : %d", errno);
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        VLOG_ERR("Failed to bind netlink socket, errno : %d", errno);
+        close(sock);
+        return false;
+    }
+
+    for (iter = 0; iter < ARRAY_SIZE(groups); iter++) {
+        if (setsockopt(sock, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+                       &groups[iter], sizeof(groups[iter])) < 0) {
+            VLOG_ERR("Failed to join netlink group %d, errno : %d",
+                     groups[iter], errno);
+            close(sock);
+            return false;
+        }
+    }
+
+    intf_cache.nlSockFd = sock;
+
+    /* Subscribe first, so that no change is missed while loading. Replayed
+     * notifications are harmless */
+    if (!intf_cache_resync()) {
+        VLOG_ERR("Failed to load interface cache");
+        udpfwd_intf_cache_exit();
+        return false;
+    }
+
+    VLOG_INFO("Interface cache loaded with %zu interfaces",
+              cmap_count(&intf_cache.intfMap));
+    return true;
+}
+
+/*
+ * Function      : udpfwd_intf_cache_run
+ * Responsiblity : Process pending link and address notifications
+ * Parameters    : none
+ * Return        : true - if interfaces were added, removed or renamed
+ *                 false - otherwise
+ */
+bool udpfwd_intf_cache_run(void)
+{
+    bool linksChanged;
+    int32_t len;
+
+    if (-1 == intf_cache.nlSockFd)
+        return false;
+
+    while (true) {
+        len = recv(intf_cache.nlSockFd, nl_buffer, sizeof(nl_buffer), 0);
+        if (len < 0) {
+            if (EINTR == errno)
+                continue;
+
+            if (ENOBUFS == errno) {
+                /* Socket overrun, notifications were lost */
+                VLOG_WARN("Netlink notifications lost, reloading interface "
+                          "cache");
+                intf_cache_resync();
+                continue;
+            }
+
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+                VLOG_ERR("Failed to receive netlink message, errno : %d",
+                         errno);
+            break;
+        }
+
+        intf_cache_parse(nl_buffer, len, false);
+    }
+
+    linksChanged = intf_cache.linksChanged;
+    intf_cache.linksChanged = false;
+    return linksChanged;
+}
+
+/*
+ * Function      : udpfwd_intf_cache_wait
+ * Responsiblity : Wake up the main loop on a netlink notification
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_intf_cache_wait(void)
+{
+    if (-1 != intf_cache.nlSockFd)
+        poll_fd_wait(intf_cache.nlSockFd, POLLIN);
+}
+
+/*
+ * Function      : udpfwd_intf_cache_exit
+ * Responsiblity : Stop tracking the kernel interfaces
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_intf_cache_exit(void)
+{
+    if (-1 != intf_cache.nlSockFd) {
+        close(intf_cache.nlSockFd);
+        intf_cache.nlSockFd = -1;
+    }
+}
+
+/*
+ * Function      : udpfwd_intf_cache_addr_seq
+ * Responsiblity : Get the address index sequence number, which changes
+ *                 whenever a local address is added or removed
+ * Parameters    : none
+ * Return        : sequence number
+ */
+uint64_t udpfwd_intf_cache_addr_seq(void)
+{
+    return intf_cache.addrSeq;
+}
+
+/*
+ * Function      : udpfwd_intf_cache_addrs
+ * Responsiblity : Copy the local IPv4 addresses. Main thread only.
+ * Parameters    : addrs - output array
+ *                 max - size of the output array
+ * Return        : number of addresses copied
+ */
+uint32_t udpfwd_intf_cache_addrs(IP_ADDRESS *addrs, uint32_t max)
+{
+    const UDPFWD_ADDR_ENTRY *entry;
+    uint32_t count = 0;
+
+    CMAP_FOR_EACH(entry, cmap_node, &intf_cache.addrMap) {
+        if (count == max)
+            break;
+        addrs[count++] = entry->ip;
+    }
+
+    return count;
+}
+
+/*
+ * Function      : udpfwd_intf_cache_lookup
+ * Responsiblity : Get the cache entry of an interface. The entry stays
+ *                 valid until the calling thread quiesces.
+ * Parameters    : ifIndex - interface index
+ * Return        : UDPFWD_INTF_ENTRY* - interface entry if found
+ *                 NULL - otherwise
+ */
+const UDPFWD_INTF_ENTRY *udpfwd_intf_cache_lookup(uint32_t ifIndex)
+{
+    return intf_entry_find(ifIndex);
+}
+
+/*
+ * Function      : udpfwd_intf_cache_lowest_ip
+ * Responsiblity : Get the lowest IP address of an interface
+ * Parameters    : ifIndex - interface index
+ * Return        : ip address if found otherwise 0
+ */
+IP_ADDRESS udpfwd_intf_cache_lowest_ip(uint32_t ifIndex)
+{
+    const UDPFWD_INTF_ENTRY *entry = intf_entry_find(ifIndex);
+
+    return entry ? entry->lowest_ip : 0;
+}
+
+/*
+ * Function      : udpfwd_intf_cache_ip_exists
+ * Responsiblity : Check if an IP address exists on an interface
+ * Parameters    : ifIndex - interface index
+ *                 ip - ip address
+ * Return        : true if ip address exists else false.
+ */
+bool udpfwd_intf_cache_ip_exists(uint32_t ifIndex, IP_ADDRESS ip)
+{
+    const UDPFWD_INTF_ENTRY *entry = intf_entry_find(ifIndex);
+    uint32_t iter;
+
+    if (NULL == entry)
+        return false;
+
+    for (iter = 0; iter < entry->addrCount; iter++) {
+        if (entry->addrs[iter] == ip)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Function      : udpfwd_intf_cache_ifindex_by_ip
+ * Responsiblity : Get the interface owning a local IPv4 address
+ * Parameters    : ip - ip address
+ * Return        : ifindex if found otherwise -1
+ */
+uint32_t udpfwd_intf_cache_ifindex_by_ip(IP_ADDRESS ip)
+{
+    const UDPFWD_ADDR_ENTRY *entry = addr_entry_find(ip, -1);
+
+    if (NULL == entry) {
+        intf_cache.addrStats.misses++;
+        return -1;
+    }
+
+    intf_cache.addrStats.hits++;
+    return entry->ifIndex;
+}
+
+/*
+ * Function      : udpfwd_intf_cache_ifindex_by_name
+ * Responsiblity : Get the index of an interface from its name
+ * Parameters    : ifName - interface name
+ * Return        : ifindex if found otherwise 0
+ */
+uint32_t udpfwd_intf_cache_ifindex_by_name(const char *ifName)
+{
+    const UDPFWD_INTF_ENTRY *entry;
+
+    CMAP_FOR_EACH_WITH_HASH(entry, name_node, hash_string(ifName, 0),
+                            &intf_cache.nameMap) {
+        if (!strcmp(entry->ifName, ifName)) {
+            return entry->ifIndex;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Function      : udpfwd_intf_cache_addr_index_dump
+ * Responsiblity : Dump the address index and its lookup counters
+ * Parameters    : ds - output buffer
+ * Return        : none
+ */
+void udpfwd_intf_cache_addr_index_dump(struct ds *ds)
+{
+    const UDPFWD_ADDR_ENTRY *entry;
+    const UDPFWD_INTF_ENTRY *intf;
+    struct in_addr addr;
+
+    ds_put_format(ds, "Addresses : %zu\n", cmap_count(&intf_cache.addrMap));
+    ds_put_format(ds, "Hits : %"PRIu64"\n", intf_cache.addrStats.hits);
+    ds_put_format(ds, "Misses : %"PRIu64"\n", intf_cache.addrStats.misses);
+
+    CMAP_FOR_EACH(entry, cmap_node, &intf_cache.addrMap) {
+        addr.s_addr = entry->ip;
+        intf = intf_entry_find(entry->ifIndex);
+        ds_put_format(ds, "  %-15s : %s (%d)\n", inet_ntoa(addr),
+                      intf ? intf->ifName : "", entry->ifIndex);
+    }
+}
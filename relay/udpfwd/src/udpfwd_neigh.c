@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_neigh.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Cache the client neighbors programmed by each receive worker.
+ * - Batch new neighbors into one RTM_NEWNEIGH netlink datagram.
+ * - Age the cache in step with the kernel reachable time.
+ *
+ * The cache of a worker is only touched by that worker. A slot holds the
+ * last neighbor hashed to it, so a collision costs one extra kernel write.
+ */
+
+#include <sys/socket.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+#include "hash.h"
+#include "ovs-atomic.h"
+#include "timeval.h"
+#include "udpfwd_util.h"
+#include "udpfwd_neigh.h"
+
+VLOG_DEFINE_THIS_MODULE(udpfwd_neigh);
+
+/* Kernel base reachable time, default of all interfaces */
+#define NEIGH_REACHABLE_TIME_PATH \
+        "/proc/sys/net/ipv4/neigh/default/base_reachable_time_ms"
+
+/* Base reachable time used when the sysctl cannot be read */
+#define NEIGH_REACHABLE_TIME_DEFAULT 30000
+
+/* Interval between two reads of the reachable time sysctl */
+#define NEIGH_REACHABLE_TIME_REFRESH 30000
+
+/* Neighbor programming state of each receive worker */
+static UDPFWD_NEIGH_WORKER *neigh_workers[UDPFWD_RX_WORKERS_MAX];
+static uint32_t neigh_n_workers;
+
+/* Lifetime of a cache entry in ms. The kernel keeps a confirmed neighbor
+ * reachable for a random time of at least half the base reachable time */
+static atomic_uint32_t neigh_lifetime;
+
+/*
+ * Function      : neigh_read_lifetime
+ * Responsiblity : Derive the cache entry lifetime from the kernel base
+ *                 reachable time
+ * Parameters    : none
+ * Return        : none
+ */
+static void neigh_read_lifetime(void)
+{
+    uint32_t base = NEIGH_REACHABLE_TIME_DEFAULT;
+    FILE *fp;
+
+    fp = fopen(NEIGH_REACHABLE_TIME_PATH, "r");
+    if (NULL != fp) {
+        if ((1 != fscanf(fp, "%u", &base)) || (0 == base))
+            base = NEIGH_REACHABLE_TIME_DEFAULT;
+        fclose(fp);
+    }
+
+    atomic_store_relaxed(&neigh_lifetime, base / 2);
+}
+
+/*
+ * Function      : neigh_add_attr
+ * Responsiblity : Append a route attribute to a netlink message
+ * Parameters    : nlh - netlink message
+ *                 type - attribute type
+ *                 data - attribute payload
+ *                 len - payload length
+ * Return        : none
+ */
+static void neigh_add_attr(struct nlmsghdr *nlh, uint16_t type,
+                           const void *data, uint16_t len)
+{
+    struct rtattr *rta;
+
+    rta = (struct rtattr *) ((char *) nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(rta), data, len);
+    nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+}
+
+/*
+ * Function      : udpfwd_neigh_update
+ * Responsiblity : Make sure the kernel resolves a client to the link layer
+ *                 address of its DHCP request. Nothing is done when the
+ *                 worker already programmed the same address and it did
+ *                 not age out yet, otherwise an RTM_NEWNEIGH message is
+ *                 queued for udpfwd_neigh_flush().
+ * Parameters    : ifIndex - interface of the client
+ *                 ip - client IPv4 address
+ *                 lladdr - client link layer address
+ *                 hlen - link layer address length
+ * Return        : none
+ */
+void udpfwd_neigh_update(uint32_t ifIndex, IP_ADDRESS ip,
+                         const uint8_t *lladdr, uint8_t hlen)
+{
+    UDPFWD_NEIGH_WORKER *neigh = neigh_workers[udpfwd_worker_id];
+    UDPFWD_NEIGH_ENTRY *entry;
+    struct nlmsghdr *nlh;
+    struct ndmsg *ndm;
+    long long int now;
+    uint32_t slot, lifetime;
+
+    if ((NULL == neigh) || (0 == hlen) || (UDPFWD_NEIGH_LLADDR_MAX < hlen))
+        return;
+
+    slot = hash_int(ip, ifIndex) & (UDPFWD_NEIGH_CACHE_SIZE - 1);
+    entry = &neigh->cache[slot];
+    now = time_msec();
+
+    if ((entry->ifIndex == ifIndex) && (entry->ip == ip) &&
+        (entry->hlen == hlen) && !memcmp(entry->lladdr, lladdr, hlen) &&
+        (now < entry->expires)) {
+        relay_counter_add(&neigh->stats.skipped, 1);
+        return;
+    }
+
+    if (UDPFWD_NEIGH_BATCH_MAX == neigh->pendingCount)
+        udpfwd_neigh_flush();
+
+    atomic_read_relaxed(&neigh_lifetime, &lifetime);
+    entry->ifIndex = ifIndex;
+    entry->ip = ip;
+    entry->hlen = hlen;
+    memcpy(entry->lladdr, lladdr, hlen);
+    entry->expires = now + lifetime;
+
+    nlh = (struct nlmsghdr *) ((char *) neigh->buffer + neigh->pendingLen);
+    memset(nlh, 0, NLMSG_SPACE(sizeof(struct ndmsg)));
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct ndmsg));
+    nlh->nlmsg_type = RTM_NEWNEIGH;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_REPLACE;
+    nlh->nlmsg_seq = neigh->seq++;
+
+    ndm = NLMSG_DATA(nlh);
+    ndm->ndm_family = AF_INET;
+    ndm->ndm_ifindex = ifIndex;
+    ndm->ndm_state = NUD_REACHABLE;
+
+    neigh_add_attr(nlh, NDA_DST, &ip, sizeof(ip));
+    neigh_add_attr(nlh, NDA_LLADDR, lladdr, hlen);
+
+    neigh->pendingSlots[neigh->pendingCount++] = slot;
+    neigh->pendingLen += NLMSG_ALIGN(nlh->nlmsg_len);
+}
+
+/*
+ * Function      : udpfwd_neigh_flush
+ * Responsiblity : Send the queued neighbors of the worker to the kernel in
+ *                 one netlink datagram. rtnetlink handles the messages in
+ *                 the context of the sender, so the errors are queued on
+ *                 the socket when sendto() returns. The cache entry of a
+ *                 refused message is invalidated.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_neigh_flush(void)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    UDPFWD_NEIGH_WORKER *neigh = neigh_workers[udpfwd_worker_id];
+    struct sockaddr_nl kernel = { .nl_family = AF_NETLINK };
+    uint32_t reply[2048];
+    struct nlmsghdr *nlh;
+    struct nlmsgerr *err;
+    uint32_t first_seq, index;
+    int32_t len;
+
+    if ((NULL == neigh) || (0 == neigh->pendingCount))
+        return;
+
+    first_seq = neigh->seq - neigh->pendingCount;
+
+    if (sendto(neigh->nlSockFd, neigh->buffer, neigh->pendingLen, 0,
+               (struct sockaddr *) &kernel, sizeof(kernel)) < 0) {
+        VLOG_ERR_RL(&rl, "Failed to program %d neighbors, errno : %d",
+                    neigh->pendingCount, errno);
+        for (index = 0; index < neigh->pendingCount; index++)
+            neigh->cache[neigh->pendingSlots[index]].expires = 0;
+        relay_counter_add(&neigh->stats.errors, neigh->pendingCount);
+        neigh->pendingCount = 0;
+        neigh->pendingLen = 0;
+        return;
+    }
+
+    relay_counter_add(&neigh->stats.datagrams, 1);
+    relay_counter_add(&neigh->stats.programmed, neigh->pendingCount);
+
+    while ((len = recv(neigh->nlSockFd, reply, sizeof(reply),
+                       MSG_DONTWAIT)) > 0) {
+        for (nlh = (struct nlmsghdr *) reply; NLMSG_OK(nlh, len);
+             nlh = NLMSG_NEXT(nlh, len)) {
+            if (NLMSG_ERROR != nlh->nlmsg_type)
+                continue;
+
+            err = NLMSG_DATA(nlh);
+            if (0 == err->error)
+                continue;
+
+            index = nlh->nlmsg_seq - first_seq;
+            if (index < neigh->pendingCount)
+                neigh->cache[neigh->pendingSlots[index]].expires = 0;
+            relay_counter_add(&neigh->stats.errors, 1);
+            VLOG_ERR_RL(&rl, "Kernel refused neighbor entry, error : %d",
+                        err->error);
+        }
+    }
+
+    neigh->pendingCount = 0;
+    neigh->pendingLen = 0;
+}
+
+/*
+ * Function      : udpfwd_neigh_dump
+ * Responsiblity : Dump the neighbor programming counters of all workers
+ * Parameters    : ds - output buffer
+ * Return        : none
+ */
+void udpfwd_neigh_dump(struct ds *ds)
+{
+    UDPFWD_NEIGH_STATS *stats;
+    uint64_t skipped = 0, programmed = 0, datagrams = 0, errors = 0;
+    uint32_t iter, lifetime;
+
+    for (iter = 0; iter < neigh_n_workers; iter++) {
+        stats = &neigh_workers[iter]->stats;
+        skipped += relay_counter_read(&stats->skipped);
+        programmed += relay_counter_read(&stats->programmed);
+        datagrams += relay_counter_read(&stats->datagrams);
+        errors += relay_counter_read(&stats->errors);
+    }
+
+    atomic_read_relaxed(&neigh_lifetime, &lifetime);
+    ds_put_format(ds, "Neighbor lifetime : %d ms\n", lifetime);
+    ds_put_format(ds, "Neighbors skipped : %"PRIu64"\n", skipped);
+    ds_put_format(ds, "Neighbors programmed : %"PRIu64"\n", programmed);
+    ds_put_format(ds, "Neighbor datagrams : %"PRIu64"\n", datagrams);
+    ds_put_format(ds, "Neighbor errors : %"PRIu64"\n", errors);
+}
+
+/*
+ * Function      : udpfwd_neigh_run
+ * Responsiblity : Follow changes of the kernel reachable time
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_neigh_run(void)
+{
+    static long long int next_read = LLONG_MIN;
+
+    if (time_msec() >= next_read) {
+        neigh_read_lifetime();
+        next_read = time_msec() + NEIGH_REACHABLE_TIME_REFRESH;
+    }
+}
+
+/*
+ * Function      : udpfwd_neigh_init
+ * Responsiblity : Allocate the neighbor cache and the netlink socket of
+ *                 each receive worker
+ * Parameters    : n_workers - number of receive workers
+ * Return        : true, on success
+ *                 false, on failure
+ */
+bool udpfwd_neigh_init(uint32_t n_workers)
+{
+    UDPFWD_NEIGH_WORKER *neigh;
+    uint32_t iter;
+
+    neigh_read_lifetime();
+
+    for (iter = 0; iter < n_workers; iter++) {
+        neigh = (UDPFWD_NEIGH_WORKER *) calloc(1, sizeof(UDPFWD_NEIGH_WORKER));
+        if (NULL == neigh) {
+            VLOG_ERR("Memory allocation for neighbor cache of worker %d "
+                     "failed", iter);
+            udpfwd_neigh_exit();
+            return false;
+        }
+
+        neigh->nlSockFd = -1;
+        neigh_workers[iter] = neigh;
+        neigh_n_workers = iter + 1;
+
+        neigh->nlSockFd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC,
+                                 NETLINK_ROUTE);
+        if (neigh->nlSockFd < 0) {
+            VLOG_ERR("Failed to create neighbor netlink socket, errno : %d",
+                     errno);
+            udpfwd_neigh_exit();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_neigh_exit
+ * Responsiblity : Release the neighbor caches and netlink sockets
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_neigh_exit(void)
+{
+    uint32_t iter;
+
+    for (iter = 0; iter < neigh_n_workers; iter++) {
+        if (0 <= neigh_workers[iter]->nlSockFd)
+            close(neigh_workers[iter]->nlSockFd);
+        free(neigh_workers[iter]);
+        neigh_workers[iter] = NULL;
+    }
+
+    neigh_n_workers = 0;
+}
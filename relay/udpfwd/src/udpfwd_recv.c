@@ -23,19 +23,118 @@
  * - Receive UDP packet from client/server.
  * - Decode the packet.
  * - Pass it on to the right handler.
+ *
+ * Packets are received with recvmmsg() on the raw UDP socket of a worker,
+ * or from a TPACKET_V3 ring of a packet socket which hands packets over in
+ * blocks and lets the handlers work on them in place.
  */
 
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <net/if.h>
+#include <net/ethernet.h>
+#include <linux/if_packet.h>
+#include <poll.h>
 #include <sys/select.h>
+#include "ovs-rcu.h"
 #include "udpfwd_util.h"
+#include "udpfwd_intf_cache.h"
+#include "udpfwd_filter.h"
+#include "udpfwd_xsk.h"
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23
+#endif
 
 VLOG_DEFINE_THIS_MODULE(udpfwd_recv);
 
+/* Index of the receive worker running the calling thread */
+__thread uint32_t udpfwd_worker_id;
+
+#ifdef FTR_DHCP_RELAY
+/*
+ * Function      : udpfwd_ignore_dhcp
+ * Responsiblity : DHCP handler used while DHCP relay is disabled.
+ * Parameters    : see UDPFWD_RELAY_HANDLER
+ * Return        : none
+ */
+static void udpfwd_ignore_dhcp(const UDPFWD_HANDLERS *handlers OVS_UNUSED,
+                               void *pkt OVS_UNUSED,
+                               int32_t size OVS_UNUSED,
+                               struct in_pktinfo *pktInfo OVS_UNUSED)
+{
+}
+#endif /* FTR_DHCP_RELAY */
+
+#ifdef FTR_UDP_BCAST_FWD
+/*
+ * Function      : udpfwd_ignore_broadcast
+ * Responsiblity : Forwarding handler used while the UDP broadcast
+ *                 forwarder is disabled.
+ * Parameters    : see UDPFWD_FORWARD_HANDLER
+ * Return        : none
+ */
+static void udpfwd_ignore_broadcast(void *pkt OVS_UNUSED,
+                                    uint16_t udp_dport OVS_UNUSED,
+                                    int32_t size OVS_UNUSED,
+                                    struct in_pktinfo *pktInfo OVS_UNUSED)
+{
+}
+#endif /* FTR_UDP_BCAST_FWD */
+
+/*
+ * Function      : udpfwd_select_handlers
+ * Responsiblity : Select the packet handlers of the current feature
+ *                 configuration and make them visible to the workers.
+ *                 Called on every global configuration change.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_select_handlers(void)
+{
+    const FEATURE_CONFIG *config = &udpfwd_ctrl_cb_p->feature_config;
+    UDPFWD_HANDLERS *handlers, *old;
+
+    handlers = (UDPFWD_HANDLERS *) calloc(1, sizeof(UDPFWD_HANDLERS));
+    if (NULL == handlers) {
+        /* Keep the previous handlers, selected again on next change */
+        VLOG_ERR("Failed to allocate the packet handlers");
+        return;
+    }
+
+#ifdef FTR_DHCP_RELAY
+    if (ENABLE == get_feature_status(config->config, DHCP_RELAY)) {
+        handlers->request = (ENABLE == get_feature_status(config->config,
+                                         DHCP_RELAY_HOP_COUNT_INCREMENT)) ?
+                            udpfwd_relay_to_dhcp_server :
+                            udpfwd_relay_to_dhcp_server_no_hops;
+        handlers->reply = udpfwd_relay_to_dhcp_client;
+    } else {
+        handlers->request = udpfwd_ignore_dhcp;
+        handlers->reply = udpfwd_ignore_dhcp;
+    }
+    handlers->option82 = dhcp_relay_option82_handler(config);
+    handlers->option82Gather = dhcp_relay_option82_gather_handler(config);
+#endif /* FTR_DHCP_RELAY */
+
+#ifdef FTR_UDP_BCAST_FWD
+    handlers->forward = (ENABLE == get_feature_status(config->config,
+                                                   UDP_BCAST_FORWARDER)) ?
+                        udpfwd_forward_packet : udpfwd_ignore_broadcast;
+#endif /* FTR_UDP_BCAST_FWD */
+
+    old = ovsrcu_get_protected(UDPFWD_HANDLERS *,
+                               &udpfwd_ctrl_cb_p->handlers);
+    ovsrcu_set(&udpfwd_ctrl_cb_p->handlers, handlers);
+    if (NULL != old)
+        ovsrcu_postpone(free, old);
+}
+
 /*
  * Function      : udpfwd_ctrl
  * Responsiblity : Depending on type of request(BOOTP REQUEST/BOOTP REPLY),
- *                 this function relays packet to client/server.
+ *                 this function relays packet to client/server, with the
+ *                 handlers of the current configuration.
  * Parameters    : pkt  - raw ip packet
  *                 size - size of payload
  *                 pktInfo - pktInfo
@@ -46,6 +145,7 @@ void udpfwd_ctrl(void *pkt, int32_t size,
 {
     struct ip *iph;              /* ip header */
     struct udphdr *udph;            /* udp header */
+    const UDPFWD_HANDLERS *handlers;
 #ifdef FTR_DHCP_RELAY
     struct dhcp_packet *dhcp;       /* dhcp header */
 #endif /* FTR_DHCP_RELAY */
@@ -61,27 +161,29 @@ void udpfwd_ctrl(void *pkt, int32_t size,
     iph  = (struct ip *) pkt;
     udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
 
+    /* Drop datagrams to ports no interface is configured for */
+    if (!udpfwd_port_of_interest(ntohs(udph->dest))) {
+        return;
+    }
+
+    handlers = ovsrcu_get(UDPFWD_HANDLERS *, &udpfwd_ctrl_cb_p->handlers);
+
     switch (ntohs(udph->dest)) {
 #ifdef FTR_DHCP_RELAY
     case DHCPS_PORT:
     case DHCPC_PORT:
         {
-            if (ENABLE != get_feature_status(udpfwd_ctrl_cb_p->feature_config.config,
-                          DHCP_RELAY)) {
-                return;
-            }
-
             dhcp = (struct dhcp_packet *)
                         ((char *)iph + (iph->ip_hl * 4) + UDPHDR_LENGTH);
 
             /* Packet must be relayed to DHCP servers. */
             if(dhcp->op == BOOTREQUEST) {
-                udpfwd_relay_to_dhcp_server(pkt, size, pktInfo);
+                handlers->request(handlers, pkt, size, pktInfo);
             } else if(dhcp->op == BOOTREPLY) {
                 if ( iph->ip_dst.s_addr != IP_ADDRESS_BCAST) {
                     /* Process only unicast packets */
                     /* Packet must be relayed to DHCP client. */
-                    udpfwd_relay_to_dhcp_client(pkt, size, pktInfo);
+                    handlers->reply(handlers, pkt, size, pktInfo);
                 }
             } else {
                 VLOG_ERR("\n udpf_ctrl: Invalid DHCP operation type : %p", dhcp);
@@ -94,12 +196,7 @@ void udpfwd_ctrl(void *pkt, int32_t size,
         {
 #ifdef FTR_UDP_BCAST_FWD
             /* UDP Broadcast forwarding case. */
-            if (ENABLE != get_feature_status
-                          (udpfwd_ctrl_cb_p->feature_config.config,
-                           UDP_BCAST_FORWARDER)) {
-                return;
-            }
-            udpfwd_forward_packet(pkt, ntohs(udph->dest), size, pktInfo);
+            handlers->forward(pkt, ntohs(udph->dest), size, pktInfo);
 #endif /* FTR_UDP_BCAST_FWD */
             break;
         }
@@ -107,78 +204,512 @@ void udpfwd_ctrl(void *pkt, int32_t size,
 }
 
 /*
- * Function      : udp_packet_recv
- * Responsiblity : Thread to receive UDP packets to a
- *                 specified destination port.
- * Parameters    : args - arguments
+ * Function      : udpfwd_rx_ring_init
+ * Responsiblity : Allocate the receive ring used by recvmmsg(). Every slot
+ *                 owns a packet buffer and an IP_PKTINFO control area.
+ * Parameters    : ring - receive ring
+ *                 size - number of slots in the ring
+ * Return        : true, on success
+ *                 false, on failure
+ */
+bool udpfwd_rx_ring_init(UDPFWD_RX_RING *ring, uint32_t size)
+{
+    uint32_t iter;
+
+    memset(ring, 0, sizeof(UDPFWD_RX_RING));
+
+    ring->msgs = (struct mmsghdr *) calloc(size, sizeof(struct mmsghdr));
+    ring->iovs = (struct iovec *) calloc(size, sizeof(struct iovec));
+    ring->ctrls = (union control_u *) calloc(size, sizeof(union control_u));
+    ring->addrs = (struct sockaddr_in *) calloc(size,
+                                                sizeof(struct sockaddr_in));
+    ring->buffers = (char *) calloc(size, RECV_BUFFER_SIZE);
+
+    if ((NULL == ring->msgs) || (NULL == ring->iovs) ||
+        (NULL == ring->ctrls) || (NULL == ring->addrs) ||
+        (NULL == ring->buffers)) {
+        VLOG_ERR("Memory allocation for receive ring of size %d failed", size);
+        udpfwd_rx_ring_destroy(ring);
+        return false;
+    }
+
+    ring->size = size;
+    ring->filled = size;
+    for (iter = 0; iter < size; iter++) {
+        ring->iovs[iter].iov_base = ring->buffers + (iter * RECV_BUFFER_SIZE);
+        ring->iovs[iter].iov_len = RECV_BUFFER_SIZE - 1;
+        ring->msgs[iter].msg_hdr.msg_iov = &ring->iovs[iter];
+        ring->msgs[iter].msg_hdr.msg_iovlen = 1;
+        ring->msgs[iter].msg_hdr.msg_name = &ring->addrs[iter];
+        ring->msgs[iter].msg_hdr.msg_control = ring->ctrls[iter].control;
+    }
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_rx_ring_destroy
+ * Responsiblity : Free the memory held by a receive ring
+ * Parameters    : ring - receive ring
  * Return        : none
  */
-void * udp_packet_recv(void *args)
+void udpfwd_rx_ring_destroy(UDPFWD_RX_RING *ring)
+{
+    free(ring->msgs);
+    free(ring->iovs);
+    free(ring->ctrls);
+    free(ring->addrs);
+    free(ring->buffers);
+    memset(ring, 0, sizeof(UDPFWD_RX_RING));
+}
+
+/*
+ * Function      : udpfwd_rx_tpacket_init
+ * Responsiblity : Create the packet socket of a worker and map its
+ *                 TPACKET_V3 receive ring. The socket gets the receive
+ *                 filter before it is bound to IPv4, so that it never
+ *                 queues a packet of another shard.
+ * Parameters    : tpacket - receive ring
+ *                 shard - shard accepted by the socket
+ *                 n_shards - number of shards
+ * Return        : true, on success
+ *                 false, on failure
+ */
+bool udpfwd_rx_tpacket_init(UDPFWD_RX_TPACKET *tpacket, uint32_t shard,
+                            uint32_t n_shards)
+{
+    struct tpacket_req3 req;
+    struct sockaddr_ll addr;
+    int32_t version = TPACKET_V3;
+    int32_t val = 1;
+
+    memset(tpacket, 0, sizeof(UDPFWD_RX_TPACKET));
+
+    /* Protocol 0 until bound, nothing is received yet */
+    tpacket->sockFd = socket(AF_PACKET, SOCK_DGRAM, 0);
+    if (tpacket->sockFd < 0) {
+        VLOG_ERR("Failed to create packet socket, errno : %d", errno);
+        return false;
+    }
+
+    if (true != udpfwd_filter_attach(tpacket->sockFd, shard, n_shards)) {
+        goto fail;
+    }
+
+    if (0 != setsockopt(tpacket->sockFd, SOL_PACKET, PACKET_VERSION,
+                        &version, sizeof(version))) {
+        VLOG_ERR("TPACKET_V3 is not supported, errno : %d", errno);
+        goto fail;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = UDPFWD_TPACKET_BLOCK_SIZE;
+    req.tp_block_nr = UDPFWD_TPACKET_BLOCK_COUNT;
+    req.tp_frame_size = UDPFWD_TPACKET_FRAME_SIZE;
+    req.tp_frame_nr = (UDPFWD_TPACKET_BLOCK_SIZE / UDPFWD_TPACKET_FRAME_SIZE) *
+                      UDPFWD_TPACKET_BLOCK_COUNT;
+    req.tp_retire_blk_tov = UDPFWD_TPACKET_RETIRE_MS;
+    if (0 != setsockopt(tpacket->sockFd, SOL_PACKET, PACKET_RX_RING,
+                        &req, sizeof(req))) {
+        VLOG_ERR("Failed to set up the receive ring, errno : %d", errno);
+        goto fail;
+    }
+
+    tpacket->mapLen = (size_t) req.tp_block_size * req.tp_block_nr;
+    tpacket->map = mmap(NULL, tpacket->mapLen, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, tpacket->sockFd, 0);
+    if (MAP_FAILED == tpacket->map) {
+        tpacket->map = NULL;
+        VLOG_ERR("Failed to map the receive ring, errno : %d", errno);
+        goto fail;
+    }
+
+    /* Not available before Linux 4.20, outgoing packets are also skipped
+     * when the ring is read */
+    setsockopt(tpacket->sockFd, SOL_PACKET, PACKET_IGNORE_OUTGOING,
+               &val, sizeof(val));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_IP);
+    if (0 != bind(tpacket->sockFd, (struct sockaddr *) &addr, sizeof(addr))) {
+        VLOG_ERR("Failed to bind packet socket, errno : %d", errno);
+        goto fail;
+    }
+
+    return true;
+
+fail:
+    udpfwd_rx_tpacket_destroy(tpacket);
+    return false;
+}
+
+/*
+ * Function      : udpfwd_rx_tpacket_destroy
+ * Responsiblity : Unmap the receive ring and close its packet socket
+ * Parameters    : tpacket - receive ring
+ * Return        : none
+ */
+void udpfwd_rx_tpacket_destroy(UDPFWD_RX_TPACKET *tpacket)
+{
+    if (NULL != tpacket->map)
+        munmap(tpacket->map, tpacket->mapLen);
+    if (0 < tpacket->sockFd)
+        close(tpacket->sockFd);
+
+    memset(tpacket, 0, sizeof(UDPFWD_RX_TPACKET));
+    tpacket->sockFd = -1;
+}
+
+/*
+ * Function      : udpfwd_rx_ring_rearm
+ * Responsiblity : Restore the lengths which recvmmsg() overwrote in the
+ *                 slots filled by the previous batch.
+ * Parameters    : ring - receive ring
+ *                 count - number of slots used by the previous batch
+ * Return        : none
+ */
+static void udpfwd_rx_ring_rearm(UDPFWD_RX_RING *ring, uint32_t count)
+{
+    uint32_t iter;
+
+    for (iter = 0; iter < count; iter++) {
+        ring->msgs[iter].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        ring->msgs[iter].msg_hdr.msg_controllen = sizeof(union control_u);
+        ring->msgs[iter].msg_hdr.msg_flags = 0;
+        ring->msgs[iter].msg_len = 0;
+    }
+}
+
+/*
+ * Function      : udpfwd_rx_batch_stats_update
+ * Responsiblity : Account a received batch in the fill statistics
+ * Parameters    : stats - receive batch statistics
+ *                 count - number of packets in the batch
+ *                 full - true, if the batch filled the whole ring or
+ *                        block
+ * Return        : none
+ */
+void udpfwd_rx_batch_stats_update(UDPFWD_RX_BATCH_STATS *stats,
+                                  uint32_t count, bool full)
+{
+    uint32_t bucket = 0;
+
+    relay_counter_add(&stats->batches, 1);
+    relay_counter_add(&stats->packets, count);
+
+    if (full)
+        relay_counter_add(&stats->full_batches, 1);
+
+    relay_counter_max(&stats->max_fill, count);
+
+    while ((count >>= 1) && (bucket < UDPFWD_RX_BATCH_HIST_SIZE - 1))
+        bucket++;
+
+    relay_counter_add(&stats->fill_hist[bucket], 1);
+}
+
+/*
+ * Function      : udpfwd_rx_pktinfo
+ * Responsiblity : Extract IP_PKTINFO meta data of a received packet
+ * Parameters    : msg - message header filled by the kernel
+ * Return        : pktInfo, if present
+ *                 NULL, otherwise
+ */
+static struct in_pktinfo *udpfwd_rx_pktinfo(struct msghdr *msg)
 {
-    struct msghdr msg;
-    struct sockaddr_in dest;
     struct cmsghdr *cmptr; /* pointer to ancillary data structure. */
-    struct iovec iov;
-    int32_t size;
-    uint32_t ifinput = -1;
     union packet_info pinfo;
-    union control_u ctrl;
-    char ifName[IF_NAMESIZE];
 
-    VLOG_INFO("UDP Broadcast packet receiver thread started");
+    if (msg->msg_controllen < sizeof(struct cmsghdr)) {
+        return NULL;
+    }
+
+    /*
+     * Iterate throught the control msg header
+     * and extract UDP packets.
+     */
+    for (cmptr = CMSG_FIRSTHDR(msg); cmptr;
+        cmptr = CMSG_NXTHDR(msg, cmptr)) {
+        if (cmptr->cmsg_level == IPPROTO_IP
+            && cmptr->cmsg_type == IP_PKTINFO)
+        {
+            pinfo.c = CMSG_DATA(cmptr);
+            return pinfo.pktInfo;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : udpfwd_rx_ip_packet
+ * Responsiblity : Validate an IP packet read below the IP stack, from a
+ *                 TPACKET ring or an XDP socket, and hand it over to
+ *                 udpfwd_ctrl(). Such packets include what the IP stack
+ *                 would have dropped or routed, so only well formed
+ *                 datagrams addressed to this host are accepted. Packets
+ *                 are handled in place, DHCP requests are not grown in
+ *                 the frame but sent as segments with option 82.
+ * Parameters    : iph - IP header
+ *                 caplen - bytes available from the IP header on
+ *                 ifIndex - input interface
+ *                 unicast - frame addressed to the interface MAC address
+ * Return        : none
+ */
+void udpfwd_rx_ip_packet(struct ip *iph, uint32_t caplen, uint32_t ifIndex,
+                         bool unicast)
+{
+    struct in_pktinfo pktInfo;
+    const UDPFWD_INTF_ENTRY *intf;
+    struct udphdr *udph;
+    uint32_t hlen, len;
+
+    if (caplen < sizeof(struct ip))
+        return;
+
+    hlen = iph->ip_hl * 4;
+    len = ntohs(iph->ip_len);
+    if ((hlen < sizeof(struct ip)) || (len < hlen + UDPHDR_LENGTH) ||
+        (len > caplen) || (len >= RECV_BUFFER_SIZE))
+        return;
+
+    if (0 != udpfwd_csum_fold(udpfwd_csum_partial(iph, hlen, 0)))
+        return;
 
-    pinfo.c = NULL; /*To Supress cmake error */
-    iov.iov_base = (void *) udpfwd_ctrl_cb_p->rcvbuff; /* buffer to store udp packet payload */
-    iov.iov_len = RECV_BUFFER_SIZE - 1; /* length of buffer */
-    msg.msg_controllen = sizeof(union control_u); /* ancillary data buffer len */
-    msg.msg_control = ctrl.control;  /* ancillary data length */
-    msg.msg_name = &dest;
-    msg.msg_namelen = sizeof(dest);
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
+    /* The datagram is read in the frame, up to its UDP length */
+    udph = (struct udphdr *) ((char *) iph + hlen);
+    if ((ntohs(udph->uh_ulen) < UDPHDR_LENGTH) ||
+        (ntohs(udph->uh_ulen) > len - hlen))
+        return;
+
+    intf = udpfwd_intf_cache_lookup(ifIndex);
+    if (NULL == intf) {
+        VLOG_ERR("Received packet on unknown interface : %d", ifIndex);
+        return;
+    }
+
+    /* Same meta data as IP_PKTINFO on the raw socket */
+    pktInfo.ipi_ifindex = ifIndex;
+    pktInfo.ipi_addr = iph->ip_dst;
+    if (unicast) {
+        /* Unicast to another host is routed, not delivered */
+        if (-1 == udpfwd_intf_cache_ifindex_by_ip(iph->ip_dst.s_addr))
+            return;
+        pktInfo.ipi_spec_dst = iph->ip_dst;
+    } else {
+        pktInfo.ipi_spec_dst.s_addr = intf->lowest_ip;
+    }
+
+    udpfwd_ctrl(iph, len, &pktInfo);
+}
+
+/*
+ * Function      : udpfwd_rx_tpacket_frame
+ * Responsiblity : Hand a packet of the TPACKET ring over, unless it was
+ *                 sent by this host or is addressed to another one
+ * Parameters    : hdr - packet header in the ring
+ * Return        : none
+ */
+static void udpfwd_rx_tpacket_frame(struct tpacket3_hdr *hdr)
+{
+    struct sockaddr_ll *sll;
+
+    sll = (struct sockaddr_ll *)
+          ((uint8_t *) hdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+
+    if ((PACKET_OUTGOING == sll->sll_pkttype) ||
+        (PACKET_OTHERHOST == sll->sll_pkttype) ||
+        (PACKET_LOOPBACK == sll->sll_pkttype))
+        return;
+
+    udpfwd_rx_ip_packet((struct ip *) ((uint8_t *) hdr + hdr->tp_net),
+                        hdr->tp_snaplen, sll->sll_ifindex,
+                        PACKET_HOST == sll->sll_pkttype);
+}
+
+/*
+ * Function      : udpfwd_rx_tpacket_loop
+ * Responsiblity : Receive loop of the TPACKET backend. Every block handed
+ *                 over by the kernel is one receive batch: its packets are
+ *                 handled in place, the replies queued for them are sent,
+ *                 then the block is returned to the kernel.
+ * Parameters    : worker - receive worker
+ * Return        : none
+ */
+static void udpfwd_rx_tpacket_loop(UDPFWD_RX_WORKER *worker)
+{
+    UDPFWD_RX_TPACKET *tpacket = &worker->tpacket;
+    struct tpacket_block_desc *block;
+    struct tpacket3_hdr *hdr;
+    struct pollfd pfd;
+    uint32_t count, iter;
 
-    assert(udpfwd_ctrl_cb_p->udpSockFd);
+    pfd.fd = tpacket->sockFd;
+    pfd.events = POLLIN | POLLERR;
 
-    VLOG_INFO("\nListening for udp packets");
+    VLOG_INFO("\nListening for udp packets, block size : %d, blocks : %d",
+              UDPFWD_TPACKET_BLOCK_SIZE, UDPFWD_TPACKET_BLOCK_COUNT);
     while (true)
     {
-        size = recvmsg(udpfwd_ctrl_cb_p->udpSockFd, &msg, 0);
-        if (size < 0) {
-            VLOG_FATAL("Failed to recvmsg :%d, errno:%d", size, errno);
-            return NULL;
-        }
+        block = (struct tpacket_block_desc *)
+                (tpacket->map + (size_t) tpacket->block *
+                                UDPFWD_TPACKET_BLOCK_SIZE);
 
-        if (msg.msg_controllen < sizeof(struct cmsghdr)) {
+        if (!(__atomic_load_n(&block->hdr.bh1.block_status,
+                              __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            /* Nothing handed over, do not hold back RCU while blocked */
+            ovsrcu_quiesce_start();
+            pfd.revents = 0;
+            if ((poll(&pfd, 1, -1) < 0) && (EINTR != errno)) {
+                VLOG_FATAL("Failed to poll receive ring, errno:%d", errno);
+            }
+            ovsrcu_quiesce_end();
             continue;
         }
 
-        ifinput = -1;
-        /*
-         * Iterate throught the control msg header
-         * and extract UDP packets.
-         */
-        for (cmptr = CMSG_FIRSTHDR(&msg); cmptr;
-            cmptr = CMSG_NXTHDR(&msg, cmptr)) {
-            if (cmptr->cmsg_level == IPPROTO_IP
-                && cmptr->cmsg_type == IP_PKTINFO)
-            {
-              pinfo.c = CMSG_DATA(cmptr);
-              ifinput = pinfo.pktInfo->ipi_ifindex;
-              break;
-            }
+        count = block->hdr.bh1.num_pkts;
+
+        /* A block retired by the timer counts as a partial batch */
+        udpfwd_rx_batch_stats_update(&worker->rx_stats, count,
+                !(block->hdr.bh1.block_status & TP_STATUS_BLK_TMO));
+
+        hdr = (struct tpacket3_hdr *)
+              ((uint8_t *) block + block->hdr.bh1.offset_to_first_pkt);
+        for (iter = 0; iter < count; iter++)
+        {
+            udpfwd_rx_tpacket_frame(hdr);
+            hdr = (struct tpacket3_hdr *)
+                  ((uint8_t *) hdr + hdr->tp_next_offset);
         }
-        if (-1 == ifinput)
+
+        /* Send what the block queued, before the kernel reuses it */
+        udpfwd_xmit_flush();
+
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                         __ATOMIC_RELEASE);
+        tpacket->block = (tpacket->block + 1) % UDPFWD_TPACKET_BLOCK_COUNT;
+
+        /* Interface cache entries seen in this block may be released */
+        ovsrcu_quiesce();
+    }
+}
+
+/*
+ * Function      : udpfwd_rx_socket_batch
+ * Responsiblity : Receive a batch of up to rx_ring.size datagrams from the
+ *                 worker socket with one recvmmsg() call and hand them over
+ *                 to udpfwd_ctrl() one by one, then send what they queued.
+ * Parameters    : worker - receive worker
+ *                 wait - block until a datagram arrives
+ * Return        : number of datagrams received
+ */
+uint32_t udpfwd_rx_socket_batch(UDPFWD_RX_WORKER *worker, bool wait)
+{
+    UDPFWD_RX_RING *ring = &worker->rx_ring;
+    struct msghdr *msg;
+    struct in_pktinfo *pktInfo;
+    int32_t count = 0;
+    int32_t iter;
+    uint32_t ifinput = -1;
+
+    udpfwd_rx_ring_rearm(ring, ring->filled);
+    ring->filled = 0;
+
+    count = recvmmsg(worker->sockFd, ring->msgs, ring->size,
+                     MSG_DONTWAIT, NULL);
+    if ((count < 0) && wait &&
+        ((EAGAIN == errno) || (EWOULDBLOCK == errno))) {
+        /* Nothing pending, do not hold back RCU while blocked */
+        ovsrcu_quiesce_start();
+        count = recvmmsg(worker->sockFd, ring->msgs,
+                         ring->size, MSG_WAITFORONE, NULL);
+        ovsrcu_quiesce_end();
+    }
+
+    if (count < 0) {
+        if ((EINTR == errno) || (EAGAIN == errno) || (EWOULDBLOCK == errno))
+            return 0;
+        VLOG_FATAL("Failed to recvmmsg :%d, errno:%d", count, errno);
+        return 0;
+    }
+
+    ring->filled = count;
+    udpfwd_rx_batch_stats_update(&worker->rx_stats, count,
+                                 count == ring->size);
+
+    for (iter = 0; iter < count; iter++)
+    {
+        msg = &ring->msgs[iter].msg_hdr;
+
+        pktInfo = udpfwd_rx_pktinfo(msg);
+        if (NULL == pktInfo)
         {
-           VLOG_ERR("Received packet input interface is invalid");
-           continue;
+            VLOG_ERR("Received packet input interface is invalid");
+            continue;
         }
-        else if (NULL == if_indextoname(ifinput, ifName)) {
-            VLOG_ERR("Failed to convert ifindex to ifname : %d", ifinput);
+
+        ifinput = pktInfo->ipi_ifindex;
+        if (NULL == udpfwd_intf_cache_lookup(ifinput)) {
+            VLOG_ERR("Received packet on unknown interface : %d",
+                     ifinput);
             continue;
         }
 
         /* process the udp packets */
-        udpfwd_ctrl((void*)msg.msg_iov->iov_base, size, pinfo.pktInfo);
+        udpfwd_ctrl((void*)msg->msg_iov->iov_base,
+                    ring->msgs[iter].msg_len, pktInfo);
+    }
+
+    /* Send what the batch queued, before its packets are reused */
+    udpfwd_xmit_flush();
+
+    return count;
+}
+
+/*
+ * Function      : udp_packet_recv
+ * Responsiblity : Receive worker thread, receives the UDP packets of the
+ *                 shard accepted by the worker socket. Packets are pulled
+ *                 in batches of up to rx_ring.size datagrams per recvmmsg()
+ *                 call. The thread reads RCU protected data and quiesces
+ *                 once per batch and while it is blocked in the kernel.
+ *                 With the TPACKET or XDP backend the thread runs the loop
+ *                 of the backend instead.
+ * Parameters    : args - receive worker
+ * Return        : none
+ */
+void * udp_packet_recv(void *args)
+{
+    UDPFWD_RX_WORKER *worker = (UDPFWD_RX_WORKER *) args;
+
+    udpfwd_worker_id = worker->id;
+    VLOG_INFO("UDP Broadcast packet receiver thread %d started", worker->id);
+
+    assert(0 < worker->sockFd);
+    assert(worker->rx_ring.size);
+
+    /* Register as RCU reader of the interface cache */
+    ovsrcu_quiesce_end();
+
+    if (UDPFWD_RX_BACKEND_TPACKET == udpfwd_ctrl_cb_p->rx_backend) {
+        udpfwd_rx_tpacket_loop(worker);
+        return NULL;
+    }
+
+    if (UDPFWD_RX_BACKEND_XDP == udpfwd_ctrl_cb_p->rx_backend) {
+        udpfwd_xsk_rx_loop(worker);
+        return NULL;
+    }
+
+    VLOG_INFO("\nListening for udp packets, batch size : %d",
+              worker->rx_ring.size);
+    while (true)
+    {
+        if (0 < udpfwd_rx_socket_batch(worker, true)) {
+            /* Interface cache entries seen in this batch may be released */
+            ovsrcu_quiesce();
+        }
     }
     return NULL;
 }
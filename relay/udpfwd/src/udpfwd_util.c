@@ -20,8 +20,7 @@
 
 /*
  * This file has all the utility functions
- * related to DHCP relay functionality and also functions
- * to get ifIndex from IP address, getIpAddress from ifName.
+ * related to DHCP relay functionality.
  */
 
 #include <sys/ioctl.h>
@@ -29,20 +28,8 @@
 #include <net/if.h>
 #include <unistd.h>
 #include <netdb.h>
-#include <ifaddrs.h>
-#include <linux/if_packet.h>
 #include "udpfwd_util.h"
 
-/* Macros to iterate through ifaddrs structure */
-
-#define GET_NEXT_IP_ON_INTERFACE(IFA_ITER, IFADDR, IFNAME) \
-    for ((IFA_ITER) = IFADDR; \
-        (IFA_ITER); \
-        (IFA_ITER) = IFA_ITER->ifa_next) \
-            if (IFA_ITER->ifa_addr \
-                && IFA_ITER->ifa_addr->sa_family == AF_INET) \
-                if (strncmp(IFNAME, IFA_ITER->ifa_name, IF_NAMESIZE) == 0)
-
 /* Feature to name mapping. There should be exact one-to-one mapping
  * between UDPFWD_FEATURE enum and feature_name array */
 char *feature_name[] =
@@ -184,162 +171,6 @@ void set_feature_status(feature_bmap *value, UDPFWD_FEATURE feature,
     return;
 }
 
-/*
- * Function      : getIfIndexfromIpAddress
- * Responsiblity : This function is used to get ifIndex associated
- *                 with a IP address.
- * Parameters    : ip - IP Address
- * Return        : ifindex if found otherwise -1
- */
-uint32_t getIfIndexfromIpAddress(IP_ADDRESS ip)
-{
-    struct ifaddrs *ifaddr, *ifaddr_iter;
-    struct sockaddr_in *res;
-    IP_ADDRESS ipaddr;
-    struct if_nameindex *if_ni, *i;
-    uint32_t ifIndex = -1;
-
-    if_ni = if_nameindex();
-
-    if (if_ni == NULL)
-        return -1;
-
-    if (getifaddrs(&ifaddr) == -1)
-        return -1;
-
-    /* Iterate through the linked list. */
-    for (ifaddr_iter = ifaddr; ifaddr_iter;
-        (ifaddr_iter = ifaddr_iter->ifa_next))
-    {
-        if (ifaddr_iter->ifa_addr
-        && ifaddr_iter->ifa_addr->sa_family == AF_INET)
-        {
-            res = (struct sockaddr_in *)ifaddr_iter->ifa_addr;
-            ipaddr = res->sin_addr.s_addr;
-            /* For matching ip address, extract ifname and then ifindex. */
-            if( ipaddr == ip )
-            {
-                for (i = if_ni;
-                    !(i->if_index == 0 && i->if_name == NULL); i++)
-                {
-                    if (strncmp(i->if_name, ifaddr_iter->ifa_name,
-                                IF_NAMESIZE) == 0)
-                    {
-                        ifIndex = i->if_index;
-                        if_freenameindex(if_ni);
-                        freeifaddrs(ifaddr);
-                        return ifIndex;
-                    }
-                }
-            }
-        }
-    }
-
-    freeifaddrs(ifaddr);
-    if_freenameindex(if_ni);
-    return -1; /* Failure case. */
-}
-
-/*
- * Function      : getMacfromIfname
- * Responsiblity : This function is used to get MAC address associated
- *                 with a interface.
- * Parameters    : mac - variable to store mac address.
- *                 ifName - interface name
- * Return        : void
- */
-void getMacfromIfname(MAC_ADDRESS mac, char * ifName)
-{
-    struct ifaddrs *ifaddr = NULL, *ifa = NULL;
-    int32_t i = 0;
-    struct sockaddr_ll *s = NULL;
-
-    if (getifaddrs(&ifaddr) == -1)
-        return;
-
-    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next)
-    {
-        if ((ifa->ifa_addr) && (ifa->ifa_addr->sa_family == AF_PACKET))
-        {
-            s = (struct sockaddr_ll*)ifa->ifa_addr;
-            if (strncmp(ifName, ifa->ifa_name, IF_NAMESIZE) == 0)
-            {
-                for (i = 0; i < s->sll_halen; i++)
-                {
-                  mac[i] = s->sll_addr[i];
-                }
-                break;
-            }
-        }
-    }
-    freeifaddrs(ifaddr);
-}
-
-/*
- * Function      : getLowestIpOnInterface
- * Responsiblity : This function is used to get lowest IP address
- *                 associated with a interface.
- * Parameters    : ifName - interface name
- * Return        : ip address if found otherwise 0
- */
-IP_ADDRESS getLowestIpOnInterface(char *ifName)
-{
-    struct ifaddrs *ifaddr_iter = NULL, *ifaddr = NULL;
-    struct sockaddr_in *res;
-    IP_ADDRESS ip;
-    IP_ADDRESS lowest_ip = MAX_UINT32; /*255.255.255.255.255 */
-
-    if (getifaddrs(&ifaddr) == -1)
-        return 0;
-
-    GET_NEXT_IP_ON_INTERFACE(ifaddr_iter, ifaddr, ifName)
-    {
-        res = (struct sockaddr_in *)ifaddr_iter->ifa_addr;
-        ip = res->sin_addr.s_addr;
-        if (lowest_ip > ip)
-            lowest_ip = ip;
-    }
-
-    freeifaddrs(ifaddr);
-
-    if (lowest_ip != MAX_UINT32)
-        return lowest_ip;
-    else
-        return 0; /* Failure case. */
-}
-
-/*
- * Function      : ipExistsOnInterface
- * Responsiblity : This function is used to check if IP address
- *                 exists on an interface.
- * Parameters    : ifName - interface name
- *                 address - ip address
- * Return        : true if ip address exists else false.
- */
-bool ipExistsOnInterface(char *ifName, IP_ADDRESS address)
-{
-    struct ifaddrs *ifaddr_iter = NULL, *ifaddr = NULL;
-    struct sockaddr_in *res;
-    IP_ADDRESS ip;
-
-    if (getifaddrs(&ifaddr) == -1)
-        return false;
-
-    GET_NEXT_IP_ON_INTERFACE(ifaddr_iter, ifaddr, ifName)
-    {
-        res = (struct sockaddr_in *)ifaddr_iter->ifa_addr;
-        ip = res->sin_addr.s_addr;
-        if (ip == address)
-        {
-            freeifaddrs(ifaddr);
-            return true;
-        }
-    }
-
-    freeifaddrs(ifaddr);
-    return false;
-}
-
 /*
  * Function      : in_cksum
  * Responsiblity : Checksum computation function
@@ -26,80 +26,483 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <net/ethernet.h>
 #include <net/if_arp.h>
-#include <sys/ioctl.h>
+#include <netpacket/packet.h>
 #include "udpfwd_util.h"
+#include "udpfwd_intf_cache.h"
+#include "udpfwd_neigh.h"
+#include "udpfwd_xsk.h"
 
 VLOG_DEFINE_THIS_MODULE(udpfwd_xmit);
 
 #if defined(FTR_DHCP_RELAY) || defined(FTR_UDP_BCAST_FWD)
+/* Largest IP header (with options) followed by the UDP header */
+#define UDPFWD_MAX_IP_UDP_HDR_LEN (60 + UDPHDR_LENGTH)
+
+/* Number of destinations sent per sendmmsg() call, a larger fan-out takes
+ * several calls */
+#define UDPFWD_XMIT_BATCH_MAX 16
+
+/* Segments of a payload, a DHCP request may be gathered */
+#ifdef FTR_DHCP_RELAY
+#define UDPFWD_XMIT_PAYLOAD_IOV DHCP_OPTION82_GATHER_IOV
+#else
+#define UDPFWD_XMIT_PAYLOAD_IOV 1
+#endif /* FTR_DHCP_RELAY */
+
+/* One destination of a fan-out transmit batch */
+typedef struct UDPFWD_XMIT_ENTRY
+{
+    char hdr[UDPFWD_MAX_IP_UDP_HDR_LEN]; /* Per destination IP/UDP header */
+    struct iovec iov[1 + UDPFWD_XMIT_PAYLOAD_IOV]; /* Header copy followed
+                                                 by the shared payload */
+    struct sockaddr_in to;    /* Destination address and port */
+    union control_u ctrl;     /* IP_PKTINFO control area */
+} UDPFWD_XMIT_ENTRY;
+
+/* Fan-out transmit batch. Every destination of a packet gets its own
+ * header copy, the payload is shared and the whole vector is sent with
+ * a single sendmmsg() call */
+typedef struct UDPFWD_XMIT_BATCH
+{
+    char *pkt;                /* Packet to be sent */
+    int32_t size;             /* Size of the packet */
+    uint32_t hdr_len;         /* Length of IP and UDP headers */
+    uint32_t payload_sum;     /* Checksum partial sum of the payload */
+    struct iovec payload[UDPFWD_XMIT_PAYLOAD_IOV]; /* Payload segments */
+    uint32_t payload_cnt;     /* Number of payload segments */
+    struct in_pktinfo pktInfo; /* pktInfo used for every destination */
+    uint32_t count;           /* Number of queued destinations */
+    uint32_t n_sent;          /* Destinations sent successfully */
+    uint32_t n_failed;        /* Destinations which could not be sent */
+    struct mmsghdr msgs[UDPFWD_XMIT_BATCH_MAX];
+    UDPFWD_XMIT_ENTRY entries[UDPFWD_XMIT_BATCH_MAX];
+} UDPFWD_XMIT_BATCH;
+
+/*
+ * Function : udpfwd_xmit_batch_init
+ * Responsiblity : Prepare a fan-out transmit batch for a packet.
+ * Parameters : batch - transmit batch
+ *              pkt - IP packet
+ *              size - size of the packet
+ *              pktInfo - pktInfo used for every destination
+ * Returns: void
+ */
+static void udpfwd_xmit_batch_init(UDPFWD_XMIT_BATCH *batch, void *pkt,
+                                   int32_t size, struct in_pktinfo *pktInfo)
+{
+    struct ip *iph = (struct ip *) pkt;
+    struct udphdr *udph;
+    int32_t payload_len;
+
+    batch->pkt = (char *) pkt;
+    batch->size = size;
+    batch->hdr_len = (iph->ip_hl * 4) + UDPHDR_LENGTH;
+    udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
+
+    /* Sum the shared payload once for all the destinations */
+    payload_len = size - (int32_t) batch->hdr_len;
+    if (payload_len > ntohs(udph->uh_ulen) - UDPHDR_LENGTH)
+        payload_len = ntohs(udph->uh_ulen) - UDPHDR_LENGTH;
+    batch->payload_sum = (payload_len > 0) ?
+        udpfwd_csum_partial(batch->pkt + batch->hdr_len, payload_len, 0) : 0;
+    batch->payload[0].iov_base = batch->pkt + batch->hdr_len;
+    batch->payload[0].iov_len = size - batch->hdr_len;
+    batch->payload_cnt = 1;
+    batch->pktInfo = *pktInfo;
+    batch->count = 0;
+    batch->n_sent = 0;
+    batch->n_failed = 0;
+}
+
+#ifdef FTR_DHCP_RELAY
+/*
+ * Function : udpfwd_xmit_batch_init_gather
+ * Responsiblity : Prepare a fan-out transmit batch for a packet whose UDP
+ *                 payload is gathered from segments.
+ * Parameters : batch - transmit batch
+ *              pkt - IP packet, its IP and UDP headers are sent
+ *              gather - segments of the UDP payload
+ *              pktInfo - pktInfo used for every destination
+ * Returns: void
+ */
+static void udpfwd_xmit_batch_init_gather(UDPFWD_XMIT_BATCH *batch,
+                        void *pkt, const DHCP_OPTION82_GATHER *gather,
+                        struct in_pktinfo *pktInfo)
+{
+    struct ip *iph = (struct ip *) pkt;
+
+    batch->pkt = (char *) pkt;
+    batch->hdr_len = (iph->ip_hl * 4) + UDPHDR_LENGTH;
+    batch->size = batch->hdr_len + gather->length;
+
+    /* Segments at odd offsets are summed with their bytes swapped */
+    memcpy(batch->payload, gather->iov,
+           gather->iovcnt * sizeof(struct iovec));
+    batch->payload_cnt = gather->iovcnt;
+    batch->payload_sum = udpfwd_csum_partial_iov(gather->iov,
+                                                 gather->iovcnt, 0);
+    batch->pktInfo = *pktInfo;
+    batch->count = 0;
+    batch->n_sent = 0;
+    batch->n_failed = 0;
+}
+#endif /* FTR_DHCP_RELAY */
+
+/*
+ * Function : udpfwd_xmit_batch_send
+ * Responsiblity : Send all the queued destinations of a batch with
+ *                 sendmmsg(). A destination which the kernel refuses is
+ *                 accounted as failed and the rest of the vector is retried.
+ * Parameters : batch - transmit batch
+ * Returns: void
+ */
+static void udpfwd_xmit_batch_send(UDPFWD_XMIT_BATCH *batch)
+{
+    uint32_t offset = 0;
+    int32_t retVal;
+
+    assert(0 < UDPFWD_WORKER_SOCK_FD);
+
+    while (offset < batch->count)
+    {
+        retVal = sendmmsg(UDPFWD_WORKER_SOCK_FD, &batch->msgs[offset],
+                          batch->count - offset, 0);
+        if (retVal < 0 && EINTR == errno)
+            continue;
+
+        if (retVal <= 0)
+        {
+            VLOG_ERR("errno = %d, sending packet to %s failed", errno,
+                     inet_ntoa(batch->entries[offset].to.sin_addr));
+            batch->n_failed++;
+            offset++;
+            continue;
+        }
+
+        batch->n_sent += retVal;
+        offset += retVal;
+    }
+
+    batch->count = 0;
+}
+
+/*
+ * Function : udpfwd_xmit_batch_add
+ * Responsiblity : Queue a destination in a fan-out transmit batch. The IP
+ *                 and UDP headers are copied and rewritten for the
+ *                 destination, the payload is shared with the other entries.
+ *                 A full batch is sent before the destination is queued.
+ * Parameters : batch - transmit batch
+ *              ip_address - destination IP address
+ *              udp_port - destination udp port (network byte order)
+ * Returns: void
+ */
+static void udpfwd_xmit_batch_add(UDPFWD_XMIT_BATCH *batch,
+                                  IP_ADDRESS ip_address, uint16_t udp_port)
+{
+    UDPFWD_XMIT_ENTRY *entry;
+    struct msghdr *msg;
+    struct cmsghdr *cmptr;
+    struct ip *iph;
+    struct udphdr *udph;
+
+    /* Truncated packet, nothing to send */
+    if (batch->size < (int32_t) batch->hdr_len) {
+        batch->n_failed++;
+        return;
+    }
+
+    if (batch->count == UDPFWD_XMIT_BATCH_MAX)
+        udpfwd_xmit_batch_send(batch);
+
+    entry = &batch->entries[batch->count];
+    msg = &batch->msgs[batch->count].msg_hdr;
+
+    /* Per destination copy of the IP and UDP headers */
+    memcpy(entry->hdr, batch->pkt, batch->hdr_len);
+    iph = (struct ip *) entry->hdr;
+    udph = (struct udphdr *) (entry->hdr + (iph->ip_hl * 4));
+
+    /* Set destination ip and udp port number in the packet */
+    udpfwd_ip_set_dst(iph, ip_address);
+    udph->uh_dport = udp_port;
+    udph->check = udpfwd_udp_cksum_finish(iph, udph, batch->payload_sum);
+
+    entry->to.sin_family = AF_INET;
+    entry->to.sin_addr.s_addr = ip_address;
+    entry->to.sin_port = udp_port;
+
+    entry->iov[0].iov_base = entry->hdr;
+    entry->iov[0].iov_len = batch->hdr_len;
+    memcpy(&entry->iov[1], batch->payload,
+           batch->payload_cnt * sizeof(struct iovec));
+
+    msg->msg_name = &entry->to;
+    msg->msg_namelen = sizeof(struct sockaddr_in);
+    msg->msg_iov = entry->iov;
+    msg->msg_iovlen = 1 + batch->payload_cnt;
+    msg->msg_flags = 0;
+
+    msg->msg_control = &entry->ctrl;
+    msg->msg_controllen = sizeof(union control_u);
+    cmptr = CMSG_FIRSTHDR(msg);
+    memcpy(CMSG_DATA(cmptr), &batch->pktInfo, sizeof(struct in_pktinfo));
+    msg->msg_controllen = cmptr->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+    cmptr->cmsg_level = IPPROTO_IP;
+    cmptr->cmsg_type = IP_PKTINFO;
+
+    batch->count++;
+}
+#endif /* (FTR_DHCP_RELAY | FTR_UDP_BCAST_FWD) */
+
+#ifdef FTR_DHCP_RELAY
+/* Client replies queued per receive worker */
+#define UDPFWD_REPLY_QUEUE_MAX 32
+
+/* Replies to DHCP clients. Replies are held until the end of the receive
+ * batch, so that the client neighbors are programmed with a single netlink
+ * datagram before the replies leave with a single sendmmsg() call. The
+ * packets stay in the receive ring until then.
+ * The same layout queues L2 replies, which carry their own Ethernet header
+ * and leave on the packet socket of the worker without a neighbor entry. */
+typedef struct UDPFWD_REPLY_QUEUE
+{
+    uint32_t count;           /* Number of queued replies */
+    struct mmsghdr msgs[UDPFWD_REPLY_QUEUE_MAX];
+    struct iovec iovs[UDPFWD_REPLY_QUEUE_MAX][2]; /* Ethernet header (L2 only)
+                                                     and IP packet */
+    struct sockaddr_in to[UDPFWD_REPLY_QUEUE_MAX];
+    union control_u ctrls[UDPFWD_REPLY_QUEUE_MAX];  /* IP replies only */
+    struct sockaddr_ll llTo[UDPFWD_REPLY_QUEUE_MAX]; /* L2 replies only */
+    struct ether_header ethHdrs[UDPFWD_REPLY_QUEUE_MAX]; /* L2 replies only */
+    DHCP_RELAY_PKT_COUNTER_SLOT *pktCounters[UDPFWD_REPLY_QUEUE_MAX];
+                              /* Counters of the interface of each reply */
+} UDPFWD_REPLY_QUEUE;
+
+/* Reply queues of the calling receive worker */
+static __thread UDPFWD_REPLY_QUEUE reply_queue;
+static __thread UDPFWD_REPLY_QUEUE l2_reply_queue;
+
+/* Ethernet broadcast and unset hardware addresses */
+static const MAC_ADDRESS broadcast_mac = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+static const MAC_ADDRESS zero_mac;
+
 /*
- * Function : udpf_send_pkt_through_socket
- * Responsiblity : To send a unicast packet to a known server address.
+ * Function : udpfwd_reply_queue_send
+ * Responsiblity : Send the queued client replies with sendmmsg() and
+ *                 account them in the interface counters.
+ * Parameters : queue - reply queue
+ *              sockFd - socket the replies are sent on
+ * Returns: void
+ */
+static void udpfwd_reply_queue_send(UDPFWD_REPLY_QUEUE *queue, int32_t sockFd)
+{
+    uint32_t offset = 0;
+    int32_t retVal;
+
+    if (0 == queue->count)
+        return;
+
+    assert(0 < sockFd);
+
+    while (offset < queue->count)
+    {
+        retVal = sendmmsg(sockFd, &queue->msgs[offset],
+                          queue->count - offset, 0);
+        if (retVal < 0 && EINTR == errno)
+            continue;
+
+        if (retVal <= 0)
+        {
+            VLOG_ERR("errno = %d, sending packet to dhcp-client %s failed",
+                     errno, inet_ntoa(queue->to[offset].sin_addr));
+            INC_UDPF_DHCPR_SERVER_DROPS(queue->pktCounters[offset]);
+            offset++;
+            continue;
+        }
+
+        for (; retVal > 0; retVal--, offset++)
+            INC_UDPF_DHCPR_SERVER_SENT(queue->pktCounters[offset]);
+    }
+
+    queue->count = 0;
+}
+
+/*
+ * Function : udpfwd_reply_rewrite
+ * Responsiblity : Rewrite a reply in place for its client.
  * Parameters : pkt - IP packet
- *              size - size of udp payload
- *              in_pktinfo - pktInfo
+ *              size - size of the packet
  *              to - it has destination address and port number
- * Returns: true - packet is sent successfully.
- *          false - any failures.
+ * Returns: void
  */
-static bool udpfwd_send_pkt_through_socket(void *pkt,
-                 int32_t size, struct in_pktinfo *pktInfo, struct sockaddr_in* to)
+static void udpfwd_reply_rewrite(void *pkt, int32_t size,
+                                 struct sockaddr_in *to)
 {
-    struct msghdr msg;
-    struct iovec iov[1];
-    struct cmsghdr *cmptr;
-    struct in_pktinfo p = *pktInfo;
     struct ip  *iph;
     struct udphdr *udph;
-    union control_u ctrl;
-    char result = false;
 
-    /* Update IP and UDP header checksum fields */
     iph  = (struct ip *) pkt;
     udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
 
     /* Set destination ip and udp port number in the packet */
-    iph->ip_dst.s_addr = to->sin_addr.s_addr;
+    udpfwd_ip_set_dst(iph, to->sin_addr.s_addr);
     udph->uh_dport = to->sin_port;
+    udph->check = udpfwd_udp_cksum(iph, size - (iph->ip_hl * 4));
+}
+
+/*
+ * Function : udpfwd_reply_queue_slot
+ * Responsiblity : Take the next slot of a reply queue for a rewritten
+ *                 reply. The caller fills the message and commits the slot
+ *                 by incrementing the queue count.
+ * Parameters : queue - reply queue
+ *              to - it has destination address and port number
+ *              pktCounters - interface counters of the reply
+ * Returns: index of the slot
+ */
+static uint32_t udpfwd_reply_queue_slot(UDPFWD_REPLY_QUEUE *queue,
+                 struct sockaddr_in *to,
+                 DHCP_RELAY_PKT_COUNTER_SLOT *pktCounters)
+{
+    uint32_t slot;
+
+    if (UDPFWD_REPLY_QUEUE_MAX == queue->count)
+        udpfwd_xmit_flush();
+
+    slot = queue->count;
+    queue->to[slot] = *to;
+    queue->pktCounters[slot] = pktCounters;
+    memset(&queue->msgs[slot].msg_hdr, 0, sizeof(struct msghdr));
+
+    return slot;
+}
 
-    iph->ip_sum = in_cksum((uint16_t *) pkt, iph->ip_len, 0);
-    /* FIXME: Add udp checksum calculation function */
-    udph->check = 0;
-
-    iov[0].iov_base = pkt;
-    iov[0].iov_len = size;
-
-    msg.msg_control = NULL;
-    msg.msg_controllen = 0;
-    msg.msg_flags = 0;
-    msg.msg_name = to;
-    msg.msg_namelen = sizeof(struct sockaddr_in);
-    msg.msg_iov = iov;
-    msg.msg_iovlen = 1;
-
-    msg.msg_control = &ctrl;
-    msg.msg_controllen = sizeof(union control_u);
-    cmptr = CMSG_FIRSTHDR(&msg);
-    memcpy(CMSG_DATA(cmptr), &p, sizeof(p));
-    msg.msg_controllen = cmptr->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+/*
+ * Function : udpfwd_reply_queue_add
+ * Responsiblity : Rewrite a reply for its client and queue it for the IP
+ *                 stack.
+ * Parameters : pkt - IP packet
+ *              size - size of the packet
+ *              pktInfo - pktInfo
+ *              to - it has destination address and port number
+ *              pktCounters - interface counters of the reply
+ * Returns: void
+ */
+static void udpfwd_reply_queue_add(void *pkt, int32_t size,
+                 struct in_pktinfo *pktInfo, struct sockaddr_in *to,
+                 DHCP_RELAY_PKT_COUNTER_SLOT *pktCounters)
+{
+    UDPFWD_REPLY_QUEUE *queue = &reply_queue;
+    struct msghdr *msg;
+    struct cmsghdr *cmptr;
+    uint32_t slot;
+
+    udpfwd_reply_rewrite(pkt, size, to);
+    slot = udpfwd_reply_queue_slot(queue, to, pktCounters);
+
+    queue->iovs[slot][0].iov_base = pkt;
+    queue->iovs[slot][0].iov_len = size;
+
+    msg = &queue->msgs[slot].msg_hdr;
+    msg->msg_name = &queue->to[slot];
+    msg->msg_namelen = sizeof(struct sockaddr_in);
+    msg->msg_iov = queue->iovs[slot];
+    msg->msg_iovlen = 1;
+
+    msg->msg_control = &queue->ctrls[slot];
+    msg->msg_controllen = sizeof(union control_u);
+    cmptr = CMSG_FIRSTHDR(msg);
+    memcpy(CMSG_DATA(cmptr), pktInfo, sizeof(struct in_pktinfo));
+    msg->msg_controllen = cmptr->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
     cmptr->cmsg_level = IPPROTO_IP;
     cmptr->cmsg_type = IP_PKTINFO;
 
-    assert(udpfwd_ctrl_cb_p->udpSockFd);
+    queue->count++;
+}
 
-    if (sendmsg(udpfwd_ctrl_cb_p->udpSockFd, &msg, 0) < 0 )
-    {
-        VLOG_ERR("errno = %d, sending packet failed", errno);
-    }
-    else
-    {
-        result = true;
+/*
+ * Function : udpfwd_l2_reply_queue_add
+ * Responsiblity : Rewrite a reply for its client and queue it as an
+ *                 Ethernet frame on the client interface. Neither the
+ *                 routing table nor the neighbor table is consulted. With
+ *                 the XDP backend the frame goes on an AF_XDP TX ring.
+ * Parameters : pkt - IP packet
+ *              size - size of the packet
+ *              to - it has destination address and port number
+ *              intf - client interface
+ *              dstMac - destination hardware address
+ *              pktCounters - interface counters of the reply
+ * Returns: void
+ */
+static void udpfwd_l2_reply_queue_add(void *pkt, int32_t size,
+                 struct sockaddr_in *to, const UDPFWD_INTF_ENTRY *intf,
+                 const uint8_t *dstMac,
+                 DHCP_RELAY_PKT_COUNTER_SLOT *pktCounters)
+{
+    UDPFWD_REPLY_QUEUE *queue = &l2_reply_queue;
+    struct ether_header *eth;
+    struct sockaddr_ll *ll;
+    struct msghdr *msg;
+    uint32_t slot;
+
+    udpfwd_reply_rewrite(pkt, size, to);
+
+    /* An AF_XDP socket of the interface sends it from the UMEM */
+    if (udpfwd_xsk_xmit(intf->ifIndex, pkt, size, intf->mac, dstMac)) {
+        INC_UDPF_DHCPR_SERVER_SENT(pktCounters);
+        return;
     }
 
-    return result;
+    slot = udpfwd_reply_queue_slot(queue, to, pktCounters);
+
+    eth = &queue->ethHdrs[slot];
+    memcpy(eth->ether_dhost, dstMac, ETH_ALEN);
+    memcpy(eth->ether_shost, intf->mac, ETH_ALEN);
+    eth->ether_type = htons(ETHERTYPE_IP);
+
+    ll = &queue->llTo[slot];
+    memset(ll, 0, sizeof(struct sockaddr_ll));
+    ll->sll_family = AF_PACKET;
+    ll->sll_protocol = htons(ETH_P_IP);
+    ll->sll_ifindex = intf->ifIndex;
+    ll->sll_halen = ETH_ALEN;
+    memcpy(ll->sll_addr, dstMac, ETH_ALEN);
+
+    queue->iovs[slot][0].iov_base = eth;
+    queue->iovs[slot][0].iov_len = sizeof(struct ether_header);
+    queue->iovs[slot][1].iov_base = pkt;
+    queue->iovs[slot][1].iov_len = size;
+
+    msg = &queue->msgs[slot].msg_hdr;
+    msg->msg_name = ll;
+    msg->msg_namelen = sizeof(struct sockaddr_ll);
+    msg->msg_iov = queue->iovs[slot];
+    msg->msg_iovlen = 2;
+
+    queue->count++;
+}
+#endif /* FTR_DHCP_RELAY */
+
+/*
+ * Function : udpfwd_xmit_flush
+ * Responsiblity : End of a receive batch. Program the client neighbors
+ *                 learnt from the batch, then send the client replies which
+ *                 depend on them and kick the AF_XDP TX rings.
+ * Parameters : none
+ * Returns: void
+ */
+void udpfwd_xmit_flush(void)
+{
+#ifdef FTR_DHCP_RELAY
+    udpfwd_neigh_flush();
+    udpfwd_reply_queue_send(&reply_queue, UDPFWD_WORKER_SOCK_FD);
+    udpfwd_reply_queue_send(&l2_reply_queue, UDPFWD_WORKER_L2_SOCK_FD);
+    udpfwd_xsk_flush();
+#endif /* FTR_DHCP_RELAY */
 }
-#endif /* (FTR_DHCP_RELAY | FTR_UDP_BCAST_FWD) */
 
 #ifdef FTR_UDP_BCAST_FWD
 /*
@@ -120,23 +523,21 @@ void udpfwd_forward_packet (void *pkt, uint16_t udp_dport, int32_t size,
     IP_ADDRESS interface_ip;
     uint32_t iter = 0;
     uint32_t ifIndex = -1;
-    char ifName[IF_NAMESIZE + 1];
-    struct sockaddr_in to;
-    struct shash_node *node;
-    UDPFWD_SERVER_T *server = NULL;
-    UDPFWD_SERVER_T **serverArray = NULL;
-    UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
+    const UDPFWD_INTF_ENTRY *intf = NULL;
+    const UDPFWD_FWD_SNAPSHOT *snapshot = NULL;
+    const UDPFWD_FWD_PORT *port = NULL;
+    UDPFWD_XMIT_BATCH batch;
 
     ifIndex = pktInfo->ipi_ifindex;
 
     if ((-1 == ifIndex) ||
-        (NULL == if_indextoname(ifIndex, ifName))) {
+        (NULL == (intf = udpfwd_intf_cache_lookup(ifIndex)))) {
         VLOG_ERR("Failed to read input interface : %d", ifIndex);
         return;
     }
 
     /* Get IP address associated with the Interface. */
-    interface_ip = getLowestIpOnInterface(ifName);
+    interface_ip = intf->lowest_ip;
 
     /* If there is no IP address on the input interface do not proceed. */
     if(interface_ip == 0) {
@@ -144,55 +545,56 @@ void udpfwd_forward_packet (void *pkt, uint16_t udp_dport, int32_t size,
         return;
     }
 
-    /* Acquire db lock */
-    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
-    node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, ifName);
-    if (NULL == node) {
+    snapshot = udpfwd_get_fwd_snapshot(ifIndex);
+    if (NULL == snapshot) {
         VLOG_DBG("packet from client on interface %s without "
-                 "UDP forward-protocol address\n", ifName);
-        /* Release db lock */
-        sem_post(&udpfwd_ctrl_cb_p->waitSem);
+                 "UDP forward-protocol address\n", intf->ifName);
         return;
     }
 
-    intfNode = (UDPFWD_INTERFACE_NODE_T *)node->data;
-    serverArray = intfNode->serverArray;
+    port = udpfwd_get_fwd_port(snapshot, udp_dport);
+    if (NULL == port) {
+        VLOG_DBG("packet from client on interface %s without "
+                 "UDP forward-protocol address for port %d\n",
+                 intf->ifName, udp_dport);
+        return;
+    }
 
-    /* UDP Broadcast Forwarder request to each of the configured server. */
-    for(iter = 0; iter < intfNode->addrCount; iter++) {
-        server = serverArray[iter];
-        if (server->udp_port != udp_dport) {
-            continue;
-        }
+    if ( pktInfo->ipi_addr.s_addr == INADDR_ANY) {
+        /* If the source IP address is 0, then replace the ip address with
+         * IP addresss of the interface on which the packet is received.
+         */
+        pktInfo->ipi_spec_dst.s_addr = interface_ip;
+    }
 
-        if ( pktInfo->ipi_addr.s_addr == INADDR_ANY) {
-            /* If the source IP address is 0, then replace the ip address with
-             * IP addresss of the interface on which the packet is received.
-             */
-            pktInfo->ipi_spec_dst.s_addr = interface_ip;
-        }
+    pktInfo->ipi_ifindex = 0;
 
-        pktInfo->ipi_ifindex = 0;
+    udpfwd_xmit_batch_init(&batch, pkt, size, pktInfo);
 
-        to.sin_family = AF_INET;
-        to.sin_addr.s_addr = server->ip_address;
-        to.sin_port = htons(udp_dport);
+    /* UDP Broadcast Forwarder request to each server of the port. */
+    for(iter = 0; iter < port->count; iter++) {
+        udpfwd_xmit_batch_add(&batch, snapshot->servers[port->first + iter],
+                              htons(udp_dport));
+    }
 
-        if (udpfwd_send_pkt_through_socket(pkt, size,
-                                           pktInfo, &to) == true) {
-            VLOG_INFO("packet sent to server successfully\n\n");
-        }
+    /* Send the packet to all the servers at once */
+    udpfwd_xmit_batch_send(&batch);
+    if (batch.n_sent) {
+        VLOG_INFO("packet sent to %d server(s) successfully\n\n",
+                  batch.n_sent);
     }
-    /* Release db lock */
-    sem_post(&udpfwd_ctrl_cb_p->waitSem);
 
     return;
 }
 #endif /* FTR_UDP_BCAST_FWD */
 
 #ifdef FTR_DHCP_RELAY
+/* Requests whose options are rewritten in place, room for option 82 */
+static __thread char request_bounce[UDPFWD_MAX_IP_UDP_HDR_LEN +
+                                    RECV_BUFFER_SIZE];
+
 /*
- * Function: udpfwd_relay_to_dhcp_server
+ * Function: dhcp_relay_to_server
  * Responsibilty : Send incoming DHCP message to client port.
  *                 This routine relays a DHCP message to the client port of
  *                 every DHCP server or relay agent whose IP address is
@@ -203,14 +605,19 @@ void udpfwd_forward_packet (void *pkt, uint16_t udp_dport, int32_t size,
  *                 this routine is called. They will only be received by this
  *                 routine if the user ignores the instructions in the
  *                 manual and sets the value of DHCP_MAX_HOPS higher than 16.
- * Parameters : pkt  - ip packet
+ *                 Always inlined with a constant hop count setting.
+ * Parameters : handlers - packet handlers of the configuration
+ *              pkt  - ip packet
  *              size - size of udp payload
  *              pktInfo - pktInfo structure
+ *              hop_incr - increment the hop count
  * Returns: void
  *
  */
-void udpfwd_relay_to_dhcp_server(void* pkt, int32_t size,
-                                 struct in_pktinfo *pktInfo)
+static inline UDPFWD_ALWAYS_INLINE void
+dhcp_relay_to_server(const UDPFWD_HANDLERS *handlers, void* pkt,
+                     int32_t size, struct in_pktinfo *pktInfo,
+                     const bool hop_incr)
 {
     struct ip *iph;              /* ip header */
     struct udphdr *udph;            /* udp header */
@@ -218,29 +625,31 @@ void udpfwd_relay_to_dhcp_server(void* pkt, int32_t size,
     IP_ADDRESS interface_ip;
     int32_t iter = 0;
     uint32_t ifIndex = -1;
-    struct sockaddr_in to;
-    struct shash_node *node;
-    UDPFWD_SERVER_T *server = NULL;
-    UDPFWD_SERVER_T **serverArray = NULL;
-    UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
-    char ifName[IF_NAMESIZE + 1];
+    const UDPFWD_FWD_SNAPSHOT *snapshot = NULL;
+    const UDPFWD_FWD_PORT *port = NULL;
+    DHCP_RELAY_PKT_COUNTER_SLOT *pktCounters = NULL;
+    const UDPFWD_INTF_ENTRY *intf = NULL;
     DHCP_OPTION_82_OPTIONS  option82_info;
+    DHCP_OPTION_INDEX option_index;
+    DHCP_OPTION82_GATHER gather;
     OPTION82_RESULT_t option82_result;
+    UDPFWD_XMIT_BATCH batch;
 
     ifIndex = pktInfo->ipi_ifindex;
 
     if ((-1 == ifIndex) ||
-        (NULL == if_indextoname(ifIndex, ifName))) {
+        (NULL == (intf = udpfwd_intf_cache_lookup(ifIndex)))) {
         VLOG_ERR("Failed to read input interface : %d", ifIndex);
         return;
     }
 
     /* Get IP address associated with the Interface. */
-    interface_ip = getLowestIpOnInterface(ifName);
+    interface_ip = intf->lowest_ip;
 
     /* If there is no IP address on the input interface do not proceed. */
     if(interface_ip == 0) {
-        VLOG_ERR("%s: Interface IP address is 0. Discard packet", ifName);
+        VLOG_ERR("%s: Interface IP address is 0. Discard packet",
+                 intf->ifName);
         return;
     }
 
@@ -277,43 +686,61 @@ void udpfwd_relay_to_dhcp_server(void* pkt, int32_t size,
     if (udph->uh_sport == DHCPC_PORT)
          udph->uh_sport = DHCPS_PORT;
 
-    /* Acquire db lock */
-    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
-    node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, ifName);
-    if (NULL == node) {
-        /* Release db lock */
-        sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    snapshot = udpfwd_get_fwd_snapshot(ifIndex);
+    if (NULL == snapshot) {
+        return;
+    }
+
+    /* No DHCP server on this interface, only forward-protocol servers */
+    port = udpfwd_get_fwd_port(snapshot, DHCPS_PORT);
+    if (NULL == port) {
         return;
     }
 
-    if (ENABLE == get_feature_status(udpfwd_ctrl_cb_p->feature_config.config,
-                  DHCP_RELAY_HOP_COUNT_INCREMENT)) {
+    if (hop_incr) {
         dhcp->hops++;
     }
 
     /* RFC prefers to decrement time to live */
-    iph->ip_ttl--;
+    udpfwd_ip_dec_ttl(iph);
 
-    intfNode = (UDPFWD_INTERFACE_NODE_T *)node->data;
+    pktCounters = snapshot->pktCounters;
 
+    /* Our option 82 is encoded ahead of time for the interface */
     memset(&option82_info, 0, sizeof(option82_info));
-    option82_info.ip_addr = interface_ip;
-
-    option82_result = process_dhcp_relay_option82_message(pkt, &option82_info,
-                                         ifIndex, ifName, intfNode->bootp_gw);
+    option82_info.option82 = intf->option82;
+    if (snapshot->bootpGwOption82.len)
+        option82_info.bootpGwOption82 = &snapshot->bootpGwOption82;
+
+    /* Only option 82 looks at the options of a request, its encoder
+     * indexes them. The received options are sent as segments around our
+     * option 82 */
+    dhcp_option_index_init(dhcp, DHCP_PKTLEN(udph), &option_index);
+    option82_result = handlers->option82Gather(pkt, &option_index,
+                                               &option82_info, &gather);
+    if (option_index.irregular) {
+        /* Repeated or truncated options are compacted in a copy */
+        memcpy(request_bounce, pkt, ntohs(iph->ip_len));
+        pkt = request_bounce;
+        iph  = (struct ip *) pkt;
+        udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
+        dhcp = (struct dhcp_packet *) ((char *)udph + UDPHDR_LENGTH);
+
+        dhcp_option_index_init(dhcp, DHCP_PKTLEN(udph), &option_index);
+        option82_result = handlers->option82(pkt, &option_index,
+                                             &option82_info, ifIndex);
+        dhcp_relay_option82_gather_all(pkt, &gather);
+    }
     if (option82_result == DROPPED)
     {
         VLOG_ERR("Option 82 check failed when relaying packet to server."
                  "Drop packet");
-        INC_UDPF_DHCPR_OPT82_CLIENT_DROPS(intfNode);
-
-        /* Release the semaphore and return */
-        sem_post(&udpfwd_ctrl_cb_p->waitSem);
+        INC_UDPF_DHCPR_OPT82_CLIENT_DROPS(pktCounters);
         return;
 
     }
     else if (option82_result == VALID)
-        INC_UDPF_DHCPR_OPT82_CLIENT_SENT(intfNode);
+        INC_UDPF_DHCPR_OPT82_CLIENT_SENT(pktCounters);
 
     /*
      * we need to preserve the giaddr in case of multi hop relays
@@ -326,56 +753,76 @@ void udpfwd_relay_to_dhcp_server(void* pkt, int32_t size,
          * and if yes, use this for stamping the DHCP requests
          */
 
-        if (intfNode->bootp_gw &&
-            (ipExistsOnInterface(ifName, intfNode->bootp_gw))) {
-                dhcp->giaddr.s_addr = intfNode->bootp_gw;
+        if (snapshot->bootp_gw &&
+            (udpfwd_intf_cache_ip_exists(ifIndex, snapshot->bootp_gw))) {
+                dhcp->giaddr.s_addr = snapshot->bootp_gw;
         }
         else
             dhcp->giaddr.s_addr = interface_ip;
     }
 
-    /* update value of size */
-    size = ntohs(iph->ip_len);
-    serverArray = intfNode->serverArray;
+    if ( iph->ip_src.s_addr == INADDR_ANY) {
+        /*
+         * If the source IP address is 0, then replace the ip address with
+         * IP addresss of the interface on which the packet is received.
+         */
+        udpfwd_ip_set_src(iph, interface_ip);
+    }
 
-    /* Relay DHCP-Request to each of the configured server. */
-    for(iter = 0; iter < intfNode->addrCount; iter++) {
-        server = serverArray[iter];
-        if (server->udp_port != DHCPS_PORT) {
-            continue;
-        }
+    pktInfo->ipi_ifindex = 0;
 
-        if ( iph->ip_src.s_addr == INADDR_ANY) {
-            /*
-             * If the source IP address is 0, then replace the ip address with
-             * IP addresss of the interface on which the packet is received.
-             */
-            iph->ip_src.s_addr = interface_ip;
-        }
+    udpfwd_xmit_batch_init_gather(&batch, pkt, &gather, pktInfo);
 
-        pktInfo->ipi_ifindex = 0;
+    /* Relay DHCP-Request to each of the configured server. */
+    for(iter = 0; iter < port->count; iter++) {
+        udpfwd_xmit_batch_add(&batch, snapshot->servers[port->first + iter],
+                              htons(DHCPS_PORT));
+    }
 
-        to.sin_family = AF_INET;
-        to.sin_addr.s_addr = server->ip_address;
-        to.sin_port = htons(DHCPS_PORT);
+    /* Send the request to all the servers at once */
+    udpfwd_xmit_batch_send(&batch);
 
-        if (udpfwd_send_pkt_through_socket((void*)pkt, size,
-                                         pktInfo, &to) == true) {
-            INC_UDPF_DHCPR_CLIENT_SENT(intfNode);
-            VLOG_INFO("packet sent to server successfully\n\n");
-        }
-        else
-        {
-            VLOG_ERR("failed to send packet to server\n\n");
-            INC_UDPF_DHCPR_CLIENT_DROPS(intfNode);
-        }
+    if (batch.n_sent) {
+        ADD_UDPF_DHCPR_CLIENT_SENT(pktCounters, batch.n_sent);
+        VLOG_INFO("packet sent to %d server(s) successfully\n\n",
+                  batch.n_sent);
+    }
+
+    if (batch.n_failed) {
+        VLOG_ERR("failed to send packet to %d server(s)\n\n",
+                 batch.n_failed);
+        ADD_UDPF_DHCPR_CLIENT_DROPS(pktCounters, batch.n_failed);
     }
 
-    /* Release db lock */
-    sem_post(&udpfwd_ctrl_cb_p->waitSem);
     return;
 }
 
+/*
+ * Function: udpfwd_relay_to_dhcp_server
+ * Responsibilty : Relay a DHCP request, incrementing its hop count.
+ * Parameters : see dhcp_relay_to_server
+ * Returns: void
+ */
+void udpfwd_relay_to_dhcp_server(const UDPFWD_HANDLERS *handlers,
+                                 void* pkt, int32_t size,
+                                 struct in_pktinfo *pktInfo)
+{
+    dhcp_relay_to_server(handlers, pkt, size, pktInfo, true);
+}
+
+/*
+ * Function: udpfwd_relay_to_dhcp_server_no_hops
+ * Responsibilty : Relay a DHCP request, keeping its hop count.
+ * Parameters : see dhcp_relay_to_server
+ * Returns: void
+ */
+void udpfwd_relay_to_dhcp_server_no_hops(const UDPFWD_HANDLERS *handlers,
+                                         void* pkt, int32_t size,
+                                         struct in_pktinfo *pktInfo)
+{
+    dhcp_relay_to_server(handlers, pkt, size, pktInfo, false);
+}
+
 /*
  * Function :  udpfwd_relay_to_dhcp_client
  * Responsibilty : Send DHCP replies to client.
@@ -389,29 +836,32 @@ void udpfwd_relay_to_dhcp_server(void* pkt, int32_t size,
  *                 this routine if the user ignores the instructions
  *                 in the manual and sets the value of DHCP_MAX_HOPS higher than 16.
  *
- * Params: void* pkt - packet
+ * Params: handlers - packet handlers of the configuration
+ *         void* pkt - packet
  *         size - size of udp payload
  *         in_pktinfo *pktInfo - pktInfo structure
  *
  * Returns: void
  */
-void udpfwd_relay_to_dhcp_client(void* pkt, int32_t size,
+void udpfwd_relay_to_dhcp_client(const UDPFWD_HANDLERS *handlers,
+                                 void* pkt, int32_t size,
                                  struct in_pktinfo *pktInfo)
 {
     struct ip *iph;              /* ip header */
     struct udphdr *udph;            /* udp header */
     struct dhcp_packet *dhcp;       /* dhcp header */
-    struct arpreq arp_req;
     unsigned char *option = NULL; /* Dhcp options. */
     bool NAKReply = false;  /* Whether this is a NAK. */
     struct sockaddr_in dest;
     uint32_t ifIndex = -1;
-    char ifName[IF_NAMESIZE + 1];
+    const UDPFWD_INTF_ENTRY *intf = NULL;
     struct in_addr interface_ip_address; /* Interface IP address. */
     DHCP_OPTION_82_OPTIONS  option82_info;
-    struct shash_node *node;
-    UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
+    DHCP_OPTION_INDEX option_index;
+    const UDPFWD_FWD_SNAPSHOT *snapshot = NULL;
+    DHCP_RELAY_PKT_COUNTER_SLOT *pktCounters = NULL;
     OPTION82_RESULT_t option82_result;
+    const uint8_t *dstMac = NULL; /* Frame destination in L2 reply mode */
 
     iph  = (struct ip *) pkt;
     udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
@@ -421,47 +871,43 @@ void udpfwd_relay_to_dhcp_client(void* pkt, int32_t size,
     interface_ip_address.s_addr = dhcp->giaddr.s_addr;
 
     /* Get ifIndex associated with this Interface IP address. */
-    ifIndex = getIfIndexfromIpAddress(interface_ip_address.s_addr);
+    ifIndex = udpfwd_intf_cache_ifindex_by_ip(interface_ip_address.s_addr);
 
     /* Get ifname from ifindex */
     if ((-1 == ifIndex) ||
-        (NULL == if_indextoname(ifIndex, ifName))) {
+        (NULL == (intf = udpfwd_intf_cache_lookup(ifIndex)))) {
         VLOG_ERR("Failed to read input interface : %d", ifIndex);
         return;
     }
 
-    iph->ip_ttl--;
-
-    /* Acquire db lock */
-    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
-    node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, ifName);
+    udpfwd_ip_dec_ttl(iph);
 
-    if (NULL == node) {
-        /* Release db lock */
-        sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    snapshot = udpfwd_get_fwd_snapshot(ifIndex);
+    if (NULL == snapshot) {
         return;
     }
-    intfNode = (UDPFWD_INTERFACE_NODE_T *)node->data;
+    pktCounters = snapshot->pktCounters;
 
     /* initialize option82_info struct */
     memset(&option82_info, 0, sizeof(option82_info));
+    option82_info.option82 = intf->option82;
 
-    option82_result = process_dhcp_relay_option82_message(pkt, &option82_info,
-                                         ifIndex, ifName, 0);
+    /* Option 82 indexes the options as it walks them */
+    dhcp_option_index_init(dhcp, DHCP_PKTLEN(udph), &option_index);
+    option82_result = handlers->option82(pkt, &option_index, &option82_info,
+                                         ifIndex);
     if (option82_result == DROPPED)
     {
         VLOG_ERR("Option 82 check failed when relaying packet to client."
                  "Drop packet");
-        INC_UDPF_DHCPR_OPT82_SERVER_DROPS(intfNode);
-        /* Release the semaphore and return */
-        sem_post(&udpfwd_ctrl_cb_p->waitSem);
+        INC_UDPF_DHCPR_OPT82_SERVER_DROPS(pktCounters);
         return;
     }
     else if (option82_result == VALID)
-        INC_UDPF_DHCPR_OPT82_SERVER_SENT(intfNode);
+        INC_UDPF_DHCPR_OPT82_SERVER_SENT(pktCounters);
 
     /* Check whether this packet is a NAK. */
-    option = dhcpPickupOpt(dhcp, DHCP_PKTLEN(udph), DHCP_MSGTYPE);
+    option = dhcp_option_index_find(dhcp, &option_index, DHCP_MSGTYPE);
     if (option != NULL)
         NAKReply = (*OPTBODY (option) == DHCPNAK);
 
@@ -473,6 +919,7 @@ void udpfwd_relay_to_dhcp_client(void* pkt, int32_t size,
         dest.sin_addr.s_addr = IP_ADDRESS_BCAST;
         dest.sin_port = htons(DHCPC_PORT);
         dest.sin_family = AF_INET;
+        dstMac = broadcast_mac;
     }
     else
     {
@@ -503,39 +950,43 @@ void udpfwd_relay_to_dhcp_client(void* pkt, int32_t size,
                 else
                 {
                     /* ciaddr is 0.0.0.0, don't relay to client. */
-                    INC_UDPF_DHCPR_SERVER_DROPS(intfNode);
-                    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+                    INC_UDPF_DHCPR_SERVER_DROPS(pktCounters);
                     return;
                 }
             }
         }
 
-        strncpy(arp_req.arp_dev, ifName, IF_NAMESIZE);
-        memcpy(&arp_req.arp_pa, &dest, sizeof(struct sockaddr_in));
-        arp_req.arp_ha.sa_family = dhcp->htype;
-        memcpy(arp_req.arp_ha.sa_data, dhcp->chaddr, dhcp->hlen);
-        arp_req.arp_flags = ATF_COM;
-        if (ioctl(udpfwd_ctrl_cb_p->udpSockFd, SIOCSARP, &arp_req) == -1)
-            VLOG_ERR("ARP Failed, errno value = %d", errno);
-    }
+        /* Frames go straight to an Ethernet client hardware address */
+        if ((ARPHRD_ETHER == dhcp->htype) && (ETH_ALEN == dhcp->hlen) &&
+            memcmp(dhcp->chaddr, broadcast_mac, ETH_ALEN) &&
+            memcmp(dhcp->chaddr, zero_mac, ETH_ALEN))
+            dstMac = dhcp->chaddr;
 
-    pktInfo->ipi_ifindex = ifIndex;
-    pktInfo->ipi_spec_dst.s_addr = 0;
+        /* The client cannot answer ARP before it has its address */
+        if (!udpfwd_ctrl_cb_p->l2_replies || (NULL == dstMac))
+            udpfwd_neigh_update(ifIndex, dest.sin_addr.s_addr,
+                                dhcp->chaddr, dhcp->hlen);
+    }
 
     /* update value of size */
     size = ntohs(iph->ip_len);
 
-    if (udpfwd_send_pkt_through_socket((void*)pkt, size,
-                                pktInfo, &dest) != true) {
-        VLOG_ERR("Failed to send packet dhcp-client");
-        INC_UDPF_DHCPR_SERVER_DROPS(intfNode);
-    }
-    else
+    if (udpfwd_ctrl_cb_p->l2_replies && (NULL != dstMac))
     {
-        INC_UDPF_DHCPR_SERVER_SENT(intfNode);
+        /* Nothing fills the source address below the IP stack */
+        if (INADDR_ANY == iph->ip_src.s_addr)
+            udpfwd_ip_set_src(iph, interface_ip_address.s_addr);
+
+        udpfwd_l2_reply_queue_add(pkt, size, &dest, intf, dstMac, pktCounters);
+        return;
     }
 
-    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    pktInfo->ipi_ifindex = ifIndex;
+    pktInfo->ipi_spec_dst.s_addr = 0;
+
+    /* Sent with the other replies of the receive batch */
+    udpfwd_reply_queue_add(pkt, size, pktInfo, &dest, pktCounters);
+
     return;
 }
 #endif /* FTR_DHCP_RELAY */
@@ -0,0 +1,1174 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_xsk.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - XDP program steering the forwarded UDP ports to AF_XDP sockets.
+ * - Port and local address maps of the program, kept in step with the
+ *   configuration and the interface cache.
+ * - AF_XDP sockets, UMEM and rings of each receive worker.
+ * - Receive loop handing the frames to udpfwd_ctrl() in place.
+ * - DHCP client replies sent from the UMEM on the TX ring.
+ *
+ * Queue q of every interface belongs to worker q % n_workers, the sockets
+ * of a worker share its UMEM and are only touched by that worker. Frames
+ * of a receive batch go back to the fill rings once the replies queued for
+ * them are sent, frames on a TX ring once the kernel completes them.
+ */
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <linux/if_link.h>
+#include "udpfwd_util.h"
+#include "udpfwd_filter.h"
+#include "udpfwd_intf_cache.h"
+#include "udpfwd_xsk.h"
+
+VLOG_DEFINE_THIS_MODULE(udpfwd_xsk);
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+/* Length of the instruction sequence of the XDP program */
+#define XSK_PROG_MAX 64
+
+/* Bytes the XDP program reads: Ethernet, IP without options, UDP */
+#define XSK_HDRS_LEN (ETH_HLEN + 20 + UDPHDR_LENGTH)
+
+/* Headroom which puts the IP header of a received frame on a 4 byte
+ * boundary, as the packet path reads it in place */
+#define XSK_IP_ALIGN 2
+
+/* Time to wait for TX completions while frames are in flight, in ms */
+#define XSK_TX_WAIT_MS 10
+
+/* AF_XDP control block */
+static UDPFWD_XSK xsk = { .portMapFd = -1, .addrMapFd = -1,
+                          .addrSeq = UINT64_MAX };
+
+/* AF_XDP state of each receive worker */
+static UDPFWD_XSK_WORKER *xsk_workers[UDPFWD_RX_WORKERS_MAX];
+static uint32_t xsk_n_workers;
+
+/*
+ * Function      : xsk_map_create
+ * Responsiblity : Create a BPF map
+ * Parameters    : type - map type
+ *                 keySize - key size
+ *                 valueSize - value size
+ *                 maxEntries - number of entries
+ * Return        : map file descriptor, -1 on failure
+ */
+static int32_t xsk_map_create(uint32_t type, uint32_t keySize,
+                              uint32_t valueSize, uint32_t maxEntries)
+{
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = type;
+    attr.key_size = keySize;
+    attr.value_size = valueSize;
+    attr.max_entries = maxEntries;
+
+    return udpfwd_bpf_sys(BPF_MAP_CREATE, &attr);
+}
+
+/*
+ * Function      : xsk_map_update
+ * Responsiblity : Set a BPF map entry
+ * Parameters    : fd - map
+ *                 key, value - entry
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool xsk_map_update(int32_t fd, const void *key, const void *value)
+{
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = fd;
+    attr.key = (uintptr_t) key;
+    attr.value = (uintptr_t) value;
+    attr.flags = BPF_ANY;
+
+    return (0 == udpfwd_bpf_sys(BPF_MAP_UPDATE_ELEM, &attr));
+}
+
+/*
+ * Function      : xsk_prog_load
+ * Responsiblity : Generate and load the XDP program of an interface. It
+ *                 redirects to the socket of the receive queue the IPv4
+ *                 UDP datagrams, not fragmented and without IP options,
+ *                 whose destination port is in the port map and which are
+ *                 either Ethernet broadcast or addressed to an address in
+ *                 the local address map. Every other frame is passed to
+ *                 the IP stack.
+ * Parameters    : intf - interface, with its socket map
+ * Return        : program file descriptor, -1 on failure
+ */
+static int32_t xsk_prog_load(const UDPFWD_XSK_INTF *intf)
+{
+    struct bpf_insn insns[XSK_PROG_MAX];
+    uint32_t toPass[16], passCount = 0;
+    uint32_t len = 0, iter, toRedirect;
+    union bpf_attr attr;
+    int32_t fd;
+
+    memset(insns, 0, sizeof(insns));
+
+    /* r6 = ctx, r2 = data, r3 = data_end */
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 2, 6, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 3, 6, 4, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0,
+                     XSK_HDRS_LEN);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JGT | BPF_X, 4, 3, 0, 0);
+
+    /* IPv4 without options, UDP, not a fragment */
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_H, 5, 2, 12, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0,
+                     htons(ETH_P_IP));
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_B, 5, 2,
+                     ETH_HLEN, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0, 0x45);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_B, 5, 2,
+                     ETH_HLEN + 9, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0,
+                     IPPROTO_UDP);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_H, 5, 2,
+                     ETH_HLEN + 6, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JSET | BPF_K, 5, 0, 0,
+                     htons(IP_MF | IP_OFFMASK));
+
+    /* ports[UDP destination port] != 0 */
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_H, 5, 2,
+                     ETH_HLEN + 20 + 2, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU | BPF_END | BPF_TO_BE, 5, 0, 0, 16);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 10, 5, -4, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -4);
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_IMM | BPF_DW, 1,
+                     BPF_PSEUDO_MAP_FD, 0, xsk.portMapFd);
+    udpfwd_ebpf_emit(insns, &len, 0, 0, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_CALL, 0, 0, 0,
+                     BPF_FUNC_map_lookup_elem);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 5, 0, 0, 0);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 5, 0, 0, 0);
+
+    /* The helper call clobbered the packet pointers */
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 2, 6, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 3, 6, 4, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0,
+                     XSK_HDRS_LEN);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JGT | BPF_X, 4, 3, 0, 0);
+
+    /* Ethernet broadcast, or an IP destination in the address map */
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 5, 2, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP32 | BPF_JNE | BPF_K, 5, 0, 2, -1);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_H, 5, 2, 4, 0);
+    toRedirect = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 5, 0, 0,
+                     0xffff);
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 5, 2,
+                     ETH_HLEN + 16, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_STX | BPF_MEM | BPF_W, 10, 5, -8, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -8);
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_IMM | BPF_DW, 1,
+                     BPF_PSEUDO_MAP_FD, 0, xsk.addrMapFd);
+    udpfwd_ebpf_emit(insns, &len, 0, 0, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_CALL, 0, 0, 0,
+                     BPF_FUNC_map_lookup_elem);
+    toPass[passCount++] = len;
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 0, 0);
+
+    /* return bpf_redirect_map(sockets, rx_queue_index, XDP_PASS) */
+    insns[toRedirect].off = len - toRedirect - 1;
+    udpfwd_ebpf_emit(insns, &len, BPF_LDX | BPF_MEM | BPF_W, 2, 6, 16, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_LD | BPF_IMM | BPF_DW, 1,
+                     BPF_PSEUDO_MAP_FD, 0, intf->xskMapFd);
+    udpfwd_ebpf_emit(insns, &len, 0, 0, 0, 0, 0);
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0,
+                     XDP_PASS);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_CALL, 0, 0, 0,
+                     BPF_FUNC_redirect_map);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    /* return XDP_PASS */
+    for (iter = 0; iter < passCount; iter++)
+        insns[toPass[iter]].off = len - toPass[iter] - 1;
+    udpfwd_ebpf_emit(insns, &len, BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0,
+                     XDP_PASS);
+    udpfwd_ebpf_emit(insns, &len, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.expected_attach_type = BPF_XDP;
+    attr.insns = (uintptr_t) insns;
+    attr.insn_cnt = len;
+    attr.license = (uintptr_t) "GPL";
+
+    fd = udpfwd_bpf_sys(BPF_PROG_LOAD, &attr);
+    if (fd < 0) {
+        VLOG_ERR("Failed to load XDP program of %s, errno : %d",
+                 intf->ifName, errno);
+    }
+
+    return fd;
+}
+
+/*
+ * Function      : xsk_queue_count
+ * Responsiblity : Count the receive queues of an interface
+ * Parameters    : ifName - interface name
+ * Return        : number of receive queues, at least 1
+ */
+static uint32_t xsk_queue_count(const char *ifName)
+{
+    char path[64 + IF_NAMESIZE];
+    struct dirent *entry;
+    uint32_t count = 0;
+    DIR *dir;
+
+    snprintf(path, sizeof(path), "/sys/class/net/%s/queues", ifName);
+    dir = opendir(path);
+    if (NULL == dir)
+        return 1;
+
+    while (NULL != (entry = readdir(dir))) {
+        if (!strncmp(entry->d_name, "rx-", 3))
+            count++;
+    }
+    closedir(dir);
+
+    return count ? count : 1;
+}
+
+/*
+ * Function      : xsk_ring_map
+ * Responsiblity : Map a ring of an AF_XDP socket
+ * Parameters    : ring - ring
+ *                 fd - AF_XDP socket
+ *                 off - ring offsets
+ *                 size - number of descriptors
+ *                 descSize - descriptor size
+ *                 pgoff - mmap offset of the ring
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool xsk_ring_map(UDPFWD_XSK_RING *ring, int32_t fd,
+                         const struct xdp_ring_offset *off, uint32_t size,
+                         size_t descSize, off_t pgoff)
+{
+    uint8_t *map;
+
+    ring->mapLen = off->desc + size * descSize;
+    map = mmap(NULL, ring->mapLen, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, fd, pgoff);
+    if (MAP_FAILED == map) {
+        VLOG_ERR("Failed to map AF_XDP ring, errno : %d", errno);
+        ring->map = NULL;
+        return false;
+    }
+
+    ring->map = map;
+    ring->producer = (uint32_t *) (map + off->producer);
+    ring->consumer = (uint32_t *) (map + off->consumer);
+    ring->flags = (uint32_t *) (map + off->flags);
+    ring->descs = map + off->desc;
+    ring->mask = size - 1;
+    ring->cached = 0;
+
+    return true;
+}
+
+/*
+ * Function      : xsk_ring_unmap
+ * Responsiblity : Unmap a ring of an AF_XDP socket
+ * Parameters    : ring - ring
+ * Return        : none
+ */
+static void xsk_ring_unmap(UDPFWD_XSK_RING *ring)
+{
+    if (NULL != ring->map)
+        munmap(ring->map, ring->mapLen);
+    ring->map = NULL;
+}
+
+/*
+ * Function      : xsk_socket_create
+ * Responsiblity : Create the AF_XDP socket of a queue and bind it. The
+ *                 first socket of a worker registers the UMEM, the others
+ *                 share it with their own fill and completion rings.
+ * Parameters    : xw - worker AF_XDP state
+ *                 sock - socket to set up
+ *                 ifIndex - interface index
+ *                 queue - queue index
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool xsk_socket_create(UDPFWD_XSK_WORKER *xw, UDPFWD_XSK_SOCKET *sock,
+                              uint32_t ifIndex, uint32_t queue)
+{
+    struct xdp_umem_reg reg;
+    struct xdp_mmap_offsets off;
+    struct sockaddr_xdp sxdp;
+    socklen_t optlen = sizeof(off);
+    uint32_t size;
+
+    sock->ifIndex = ifIndex;
+    sock->queue = queue;
+    sock->fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (sock->fd < 0) {
+        VLOG_ERR("Failed to create AF_XDP socket, errno : %d", errno);
+        return false;
+    }
+
+    if (0 == xw->sockCount) {
+        memset(&reg, 0, sizeof(reg));
+        reg.addr = (uintptr_t) xw->umem;
+        reg.len = xw->umemLen;
+        reg.chunk_size = UDPFWD_XSK_FRAME_SIZE;
+        reg.headroom = XSK_IP_ALIGN;
+        if (0 > setsockopt(sock->fd, SOL_XDP, XDP_UMEM_REG, &reg,
+                           sizeof(reg))) {
+            VLOG_ERR("Failed to register UMEM, errno : %d", errno);
+            return false;
+        }
+    }
+
+    size = UDPFWD_XSK_FILL_SIZE;
+    if (0 > setsockopt(sock->fd, SOL_XDP, XDP_UMEM_FILL_RING, &size,
+                       sizeof(size)))
+        goto ring_error;
+    size = UDPFWD_XSK_COMP_SIZE;
+    if (0 > setsockopt(sock->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &size,
+                       sizeof(size)))
+        goto ring_error;
+    size = UDPFWD_XSK_RX_SIZE;
+    if (0 > setsockopt(sock->fd, SOL_XDP, XDP_RX_RING, &size, sizeof(size)))
+        goto ring_error;
+    size = UDPFWD_XSK_TX_SIZE;
+    if (0 > setsockopt(sock->fd, SOL_XDP, XDP_TX_RING, &size, sizeof(size)))
+        goto ring_error;
+    if (0 > getsockopt(sock->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen))
+        goto ring_error;
+
+    if ((true != xsk_ring_map(&sock->rx, sock->fd, &off.rx,
+                              UDPFWD_XSK_RX_SIZE, sizeof(struct xdp_desc),
+                              XDP_PGOFF_RX_RING)) ||
+        (true != xsk_ring_map(&sock->tx, sock->fd, &off.tx,
+                              UDPFWD_XSK_TX_SIZE, sizeof(struct xdp_desc),
+                              XDP_PGOFF_TX_RING)) ||
+        (true != xsk_ring_map(&sock->fill, sock->fd, &off.fr,
+                              UDPFWD_XSK_FILL_SIZE, sizeof(uint64_t),
+                              XDP_UMEM_PGOFF_FILL_RING)) ||
+        (true != xsk_ring_map(&sock->comp, sock->fd, &off.cr,
+                              UDPFWD_XSK_COMP_SIZE, sizeof(uint64_t),
+                              XDP_UMEM_PGOFF_COMPLETION_RING)))
+        return false;
+
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = ifIndex;
+    sxdp.sxdp_queue_id = queue;
+    if (0 == xw->sockCount) {
+        sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | (xsk.generic ? XDP_COPY : 0);
+    } else {
+        /* Shared sockets inherit the mode of the UMEM owner */
+        sxdp.sxdp_flags = XDP_SHARED_UMEM;
+        sxdp.sxdp_shared_umem_fd = xw->socks[0].fd;
+    }
+
+    if (0 > bind(sock->fd, (struct sockaddr *) &sxdp, sizeof(sxdp))) {
+        VLOG_ERR("Failed to bind AF_XDP socket to queue %d of interface %d, "
+                 "errno : %d", queue, ifIndex, errno);
+        return false;
+    }
+
+    return true;
+
+ring_error:
+    VLOG_ERR("Failed to set up AF_XDP rings, errno : %d", errno);
+    return false;
+}
+
+/*
+ * Function      : xsk_socket_destroy
+ * Responsiblity : Unmap the rings of an AF_XDP socket and close it
+ * Parameters    : sock - socket
+ * Return        : none
+ */
+static void xsk_socket_destroy(UDPFWD_XSK_SOCKET *sock)
+{
+    xsk_ring_unmap(&sock->rx);
+    xsk_ring_unmap(&sock->tx);
+    xsk_ring_unmap(&sock->fill);
+    xsk_ring_unmap(&sock->comp);
+    if (0 <= sock->fd)
+        close(sock->fd);
+    sock->fd = -1;
+}
+
+/*
+ * Function      : xsk_refill
+ * Responsiblity : Give free frames to the fill rings of the sockets
+ * Parameters    : xw - worker AF_XDP state
+ * Return        : none
+ */
+static void xsk_refill(UDPFWD_XSK_WORKER *xw)
+{
+    UDPFWD_XSK_SOCKET *sock;
+    uint64_t *addrs;
+    uint32_t iter, room, count;
+
+    for (iter = 0; iter < xw->sockCount; iter++) {
+        sock = &xw->socks[iter];
+        addrs = sock->fill.descs;
+
+        room = UDPFWD_XSK_FILL_SIZE - (sock->fill.cached -
+               __atomic_load_n(sock->fill.consumer, __ATOMIC_ACQUIRE));
+        if (0 == room)
+            continue;
+
+        if (room > xw->freeCount)
+            xw->stats.noFrames++;
+
+        for (count = 0; (count < room) && xw->freeCount; count++) {
+            addrs[sock->fill.cached++ & sock->fill.mask] =
+                xw->freeFrames[--xw->freeCount];
+        }
+        if (0 == count)
+            continue;
+
+        __atomic_store_n(sock->fill.producer, sock->fill.cached,
+                         __ATOMIC_RELEASE);
+
+        if (*sock->fill.flags & XDP_RING_NEED_WAKEUP)
+            recvfrom(sock->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+    }
+}
+
+/*
+ * Function      : xsk_complete
+ * Responsiblity : Take back the frames the kernel has sent
+ * Parameters    : xw - worker AF_XDP state
+ * Return        : none
+ */
+static void xsk_complete(UDPFWD_XSK_WORKER *xw)
+{
+    UDPFWD_XSK_SOCKET *sock;
+    const uint64_t *addrs;
+    uint32_t iter, count, frame;
+
+    if (0 == xw->txInFlight)
+        return;
+
+    for (iter = 0; iter < xw->sockCount; iter++) {
+        sock = &xw->socks[iter];
+        addrs = sock->comp.descs;
+
+        count = __atomic_load_n(sock->comp.producer, __ATOMIC_ACQUIRE) -
+                sock->comp.cached;
+        for (; count; count--) {
+            frame = addrs[sock->comp.cached++ & sock->comp.mask] /
+                    UDPFWD_XSK_FRAME_SIZE;
+            xw->txHeld[frame] = false;
+            xw->freeFrames[xw->freeCount++] =
+                (uint64_t) frame * UDPFWD_XSK_FRAME_SIZE;
+            xw->txInFlight--;
+            xw->stats.txPackets++;
+        }
+
+        __atomic_store_n(sock->comp.consumer, sock->comp.cached,
+                         __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * Function      : xsk_rx_batch
+ * Responsiblity : Hand over up to UDPFWD_XSK_BATCH frames of a socket. The
+ *                 frames are recorded in the worker batch and recycled
+ *                 once the batch is sent.
+ * Parameters    : worker - receive worker
+ *                 xw - worker AF_XDP state
+ *                 sock - socket
+ * Return        : number of frames received
+ */
+static uint32_t xsk_rx_batch(UDPFWD_RX_WORKER *worker, UDPFWD_XSK_WORKER *xw,
+                             UDPFWD_XSK_SOCKET *sock)
+{
+    const struct xdp_desc *descs = sock->rx.descs;
+    const struct xdp_desc *desc;
+    uint8_t *frame;
+    uint32_t count, iter;
+
+    count = __atomic_load_n(sock->rx.producer, __ATOMIC_ACQUIRE) -
+            sock->rx.cached;
+    if (count > UDPFWD_XSK_BATCH)
+        count = UDPFWD_XSK_BATCH;
+    if (0 == count)
+        return 0;
+
+    for (iter = 0; iter < count; iter++) {
+        desc = &descs[sock->rx.cached++ & sock->rx.mask];
+        xw->rxFrames[xw->rxCount++] =
+            desc->addr & ~((uint64_t) UDPFWD_XSK_FRAME_SIZE - 1);
+
+        if (desc->len <= ETH_HLEN)
+            continue;
+
+        frame = xw->umem + desc->addr;
+        udpfwd_rx_ip_packet((struct ip *) (frame + ETH_HLEN),
+                            desc->len - ETH_HLEN, sock->ifIndex,
+                            !(frame[0] & 0x01));
+    }
+
+    __atomic_store_n(sock->rx.consumer, sock->rx.cached, __ATOMIC_RELEASE);
+
+    xw->stats.rxPackets += count;
+    udpfwd_rx_batch_stats_update(&worker->rx_stats, count,
+                                 count == UDPFWD_XSK_BATCH);
+
+    return count;
+}
+
+/*
+ * Function      : xsk_recycle
+ * Responsiblity : Free the frames of the receive batch, except those
+ *                 which left on a TX ring. Must run before completions are
+ *                 taken, which free the latter.
+ * Parameters    : xw - worker AF_XDP state
+ * Return        : none
+ */
+static void xsk_recycle(UDPFWD_XSK_WORKER *xw)
+{
+    uint32_t iter;
+
+    for (iter = 0; iter < xw->rxCount; iter++) {
+        if (!xw->txHeld[xw->rxFrames[iter] / UDPFWD_XSK_FRAME_SIZE])
+            xw->freeFrames[xw->freeCount++] = xw->rxFrames[iter];
+    }
+    xw->rxCount = 0;
+}
+
+/*
+ * Function      : udpfwd_xsk_rx_loop
+ * Responsiblity : Receive loop of the XDP backend. Every pass takes a
+ *                 batch from each AF_XDP socket, sends what it queued and
+ *                 recycles its frames, then takes a batch from the raw
+ *                 socket, which gets everything the XDP program passes.
+ *                 The worker blocks in poll() on all of them when idle.
+ * Parameters    : worker - receive worker
+ * Return        : none
+ */
+void udpfwd_xsk_rx_loop(UDPFWD_RX_WORKER *worker)
+{
+    UDPFWD_XSK_WORKER *xw = xsk_workers[worker->id];
+    struct pollfd pfds[1 + UDPFWD_XSK_SOCKETS_MAX];
+    uint32_t count, iter;
+
+    pfds[0].fd = worker->sockFd;
+    pfds[0].events = POLLIN;
+    for (iter = 0; iter < xw->sockCount; iter++) {
+        pfds[1 + iter].fd = xw->socks[iter].fd;
+        pfds[1 + iter].events = POLLIN;
+    }
+
+    VLOG_INFO("\nListening for udp packets, AF_XDP sockets : %d",
+              xw->sockCount);
+    while (true)
+    {
+        xsk_complete(xw);
+
+        count = 0;
+        for (iter = 0; iter < xw->sockCount; iter++)
+            count += xsk_rx_batch(worker, xw, &xw->socks[iter]);
+
+        if (count) {
+            /* Send what the batch queued, before its frames are reused */
+            udpfwd_xmit_flush();
+            xsk_recycle(xw);
+            xsk_complete(xw);
+        }
+        xsk_refill(xw);
+
+        count += udpfwd_rx_socket_batch(worker, false);
+        if (count) {
+            /* Interface cache entries seen in this pass may be released */
+            ovsrcu_quiesce();
+            continue;
+        }
+
+        /* Nothing pending, do not hold back RCU while blocked */
+        ovsrcu_quiesce_start();
+        if ((poll(pfds, 1 + xw->sockCount,
+                  xw->txInFlight ? XSK_TX_WAIT_MS : -1) < 0) &&
+            (EINTR != errno)) {
+            VLOG_FATAL("Failed to poll AF_XDP sockets, errno:%d", errno);
+        }
+        ovsrcu_quiesce_end();
+    }
+}
+
+/*
+ * Function      : udpfwd_xsk_xmit
+ * Responsiblity : Put a client reply on the TX ring of a socket of the
+ *                 client interface owned by the calling worker. A reply
+ *                 still in the frame it was received in is sent from
+ *                 there, the Ethernet header written over the received
+ *                 one. Other replies are copied into a free frame. The
+ *                 ring is kicked by udpfwd_xsk_flush().
+ * Parameters    : ifIndex - client interface
+ *                 pkt - IP packet
+ *                 size - size of the packet
+ *                 srcMac - interface hardware address
+ *                 dstMac - client hardware address
+ * Return        : true, if the reply is on a TX ring
+ *                 false, if the caller has to send it
+ */
+bool udpfwd_xsk_xmit(uint32_t ifIndex, void *pkt, int32_t size,
+                     const uint8_t *srcMac, const uint8_t *dstMac)
+{
+    UDPFWD_XSK_WORKER *xw;
+    UDPFWD_XSK_SOCKET *sock = NULL;
+    struct ether_header *eth;
+    struct xdp_desc *desc;
+    uint8_t *ptr = pkt;
+    uint64_t addr;
+    uint32_t iter;
+
+    if (udpfwd_worker_id >= xsk_n_workers)
+        return false;
+    xw = xsk_workers[udpfwd_worker_id];
+
+    for (iter = 0; iter < xw->sockCount; iter++) {
+        if (ifIndex == xw->socks[iter].ifIndex) {
+            sock = &xw->socks[iter];
+            break;
+        }
+    }
+    if ((NULL == sock) ||
+        (size + ETH_HLEN + XDP_PACKET_HEADROOM + XSK_IP_ALIGN >
+         UDPFWD_XSK_FRAME_SIZE))
+        return false;
+
+    if (UDPFWD_XSK_TX_SIZE == sock->tx.cached -
+        __atomic_load_n(sock->tx.consumer, __ATOMIC_ACQUIRE)) {
+        xw->stats.txRingFull++;
+        return false;
+    }
+
+    if ((ptr >= xw->umem) && (ptr < xw->umem + xw->umemLen) &&
+        ((ptr - xw->umem) % UDPFWD_XSK_FRAME_SIZE >= ETH_HLEN)) {
+        addr = ptr - xw->umem - ETH_HLEN;
+    } else {
+        if (0 == xw->freeCount) {
+            xw->stats.noFrames++;
+            return false;
+        }
+        addr = xw->freeFrames[--xw->freeCount] + XDP_PACKET_HEADROOM +
+               XSK_IP_ALIGN;
+        memcpy(xw->umem + addr + ETH_HLEN, pkt, size);
+        xw->stats.txCopies++;
+    }
+
+    eth = (struct ether_header *) (xw->umem + addr);
+    memcpy(eth->ether_dhost, dstMac, ETH_ALEN);
+    memcpy(eth->ether_shost, srcMac, ETH_ALEN);
+    eth->ether_type = htons(ETHERTYPE_IP);
+
+    desc = &((struct xdp_desc *) sock->tx.descs)[sock->tx.cached++ &
+                                                 sock->tx.mask];
+    desc->addr = addr;
+    desc->len = size + ETH_HLEN;
+    desc->options = 0;
+    sock->txPending++;
+
+    xw->txHeld[addr / UDPFWD_XSK_FRAME_SIZE] = true;
+    xw->txInFlight++;
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_xsk_flush
+ * Responsiblity : End of a receive batch. Publish the replies put on the
+ *                 TX rings of the calling worker and kick the kernel.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_xsk_flush(void)
+{
+    UDPFWD_XSK_WORKER *xw;
+    UDPFWD_XSK_SOCKET *sock;
+    uint32_t iter;
+
+    if (udpfwd_worker_id >= xsk_n_workers)
+        return;
+    xw = xsk_workers[udpfwd_worker_id];
+
+    for (iter = 0; iter < xw->sockCount; iter++) {
+        sock = &xw->socks[iter];
+        if (0 == sock->txPending)
+            continue;
+
+        __atomic_store_n(sock->tx.producer, sock->tx.cached,
+                         __ATOMIC_RELEASE);
+        sock->txPending = 0;
+
+        if ((*sock->tx.flags & XDP_RING_NEED_WAKEUP) &&
+            (0 > sendto(sock->fd, NULL, 0, MSG_DONTWAIT, NULL, 0)) &&
+            (EAGAIN != errno) && (EBUSY != errno) && (ENOBUFS != errno)) {
+            VLOG_ERR("Failed to kick AF_XDP TX ring, errno : %d", errno);
+        }
+    }
+}
+
+/*
+ * Function      : xsk_worker_init
+ * Responsiblity : Allocate the UMEM of a worker and create a socket for
+ *                 each queue it owns
+ * Parameters    : id - worker index
+ *                 n_workers - number of receive workers
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool xsk_worker_init(uint32_t id, uint32_t n_workers)
+{
+    UDPFWD_XSK_WORKER *xw;
+    UDPFWD_XSK_INTF *intf;
+    uint32_t iter, queue, frame;
+
+    xw = (UDPFWD_XSK_WORKER *) calloc(1, sizeof(UDPFWD_XSK_WORKER));
+    if (NULL == xw) {
+        VLOG_ERR("Memory allocation for AF_XDP state of worker %d failed",
+                 id);
+        return false;
+    }
+    xsk_workers[id] = xw;
+    xsk_n_workers = id + 1;
+
+    xw->umemLen = (size_t) UDPFWD_XSK_FRAME_SIZE * UDPFWD_XSK_FRAME_COUNT;
+    xw->umem = mmap(NULL, xw->umemLen, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == xw->umem) {
+        VLOG_ERR("Failed to allocate UMEM of worker %d, errno : %d", id,
+                 errno);
+        xw->umem = NULL;
+        return false;
+    }
+
+    for (frame = 0; frame < UDPFWD_XSK_FRAME_COUNT; frame++) {
+        xw->freeFrames[xw->freeCount++] =
+            (uint64_t) (UDPFWD_XSK_FRAME_COUNT - frame - 1) *
+            UDPFWD_XSK_FRAME_SIZE;
+    }
+
+    for (iter = 0; iter < xsk.intfCount; iter++) {
+        intf = &xsk.intfs[iter];
+        for (queue = id; queue < intf->queues; queue += n_workers) {
+            if (UDPFWD_XSK_SOCKETS_MAX == xw->sockCount) {
+                VLOG_ERR("Worker %d owns more than %d queues", id,
+                         UDPFWD_XSK_SOCKETS_MAX);
+                return false;
+            }
+
+            if (true != xsk_socket_create(xw, &xw->socks[xw->sockCount],
+                                          intf->ifIndex, queue)) {
+                xsk_socket_destroy(&xw->socks[xw->sockCount]);
+                return false;
+            }
+
+            if (true != xsk_map_update(intf->xskMapFd, &queue,
+                                       &xw->socks[xw->sockCount].fd)) {
+                VLOG_ERR("Failed to register AF_XDP socket of queue %d of "
+                         "%s, errno : %d", queue, intf->ifName, errno);
+                xsk_socket_destroy(&xw->socks[xw->sockCount]);
+                return false;
+            }
+            xw->sockCount++;
+        }
+    }
+
+    xsk_refill(xw);
+
+    return true;
+}
+
+/*
+ * Function      : xsk_intf_init
+ * Responsiblity : Create the socket map and load the XDP program of an
+ *                 interface
+ * Parameters    : intf - interface
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool xsk_intf_init(UDPFWD_XSK_INTF *intf)
+{
+    intf->ifIndex = if_nametoindex(intf->ifName);
+    if (0 == intf->ifIndex) {
+        VLOG_ERR("Unknown XDP interface %s", intf->ifName);
+        return false;
+    }
+
+    intf->queues = xsk_queue_count(intf->ifName);
+    intf->xskMapFd = xsk_map_create(BPF_MAP_TYPE_XSKMAP, sizeof(uint32_t),
+                                    sizeof(int32_t), intf->queues);
+    if (intf->xskMapFd < 0) {
+        VLOG_ERR("Failed to create AF_XDP socket map of %s, errno : %d",
+                 intf->ifName, errno);
+        return false;
+    }
+
+    intf->progFd = xsk_prog_load(intf);
+    return (0 <= intf->progFd);
+}
+
+/*
+ * Function      : xsk_intf_attach
+ * Responsiblity : Attach the XDP program to its interface. The program is
+ *                 detached when the link is closed, also on a crash.
+ * Parameters    : intf - interface
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool xsk_intf_attach(UDPFWD_XSK_INTF *intf)
+{
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = intf->progFd;
+    attr.link_create.target_ifindex = intf->ifIndex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = xsk.generic ? XDP_FLAGS_SKB_MODE : 0;
+
+    intf->linkFd = udpfwd_bpf_sys(BPF_LINK_CREATE, &attr);
+    if (intf->linkFd < 0) {
+        VLOG_ERR("Failed to attach XDP program to %s in %s mode, "
+                 "errno : %d", intf->ifName,
+                 xsk.generic ? "generic" : "native", errno);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_xsk_set_interfaces
+ * Responsiblity : Set the interfaces which get the XDP program, as a
+ *                 comma separated list of names. Must be called before
+ *                 udpfwd_init().
+ * Parameters    : list - interface names
+ * Return        : true, if the list is valid
+ *                 false, otherwise
+ */
+bool udpfwd_xsk_set_interfaces(const char *list)
+{
+    char *names, *name, *save = NULL;
+    UDPFWD_XSK_INTF *intf;
+    bool valid = true;
+
+    names = xstrdup(list);
+    xsk.intfCount = 0;
+    for (name = strtok_r(names, ",", &save); NULL != name;
+         name = strtok_r(NULL, ",", &save)) {
+        if ((UDPFWD_XSK_INTF_MAX == xsk.intfCount) ||
+            (strlen(name) >= IF_NAMESIZE)) {
+            VLOG_ERR("Invalid XDP interface list %s", list);
+            valid = false;
+            break;
+        }
+        intf = &xsk.intfs[xsk.intfCount++];
+        strcpy(intf->ifName, name);
+        intf->xskMapFd = intf->progFd = intf->linkFd = -1;
+    }
+    free(names);
+
+    return valid && xsk.intfCount;
+}
+
+/*
+ * Function      : udpfwd_xsk_set_generic
+ * Responsiblity : Attach the XDP programs in generic (SKB) mode, for
+ *                 drivers without native XDP. Must be called before
+ *                 udpfwd_init().
+ * Parameters    : enable - true for generic mode
+ * Return        : none
+ */
+void udpfwd_xsk_set_generic(bool enable)
+{
+    xsk.generic = enable;
+}
+
+/*
+ * Function      : udpfwd_xsk_init
+ * Responsiblity : Set up the XDP programs, their maps and the AF_XDP
+ *                 sockets of the workers. The programs are attached last,
+ *                 once every queue has its socket.
+ * Parameters    : n_workers - number of receive workers
+ * Return        : true, on success
+ *                 false, on failure
+ */
+bool udpfwd_xsk_init(uint32_t n_workers)
+{
+    uint32_t iter;
+
+    if (0 == xsk.intfCount) {
+        VLOG_ERR("The XDP receive backend needs --xdp-interfaces");
+        return false;
+    }
+
+    xsk.portMapFd = xsk_map_create(BPF_MAP_TYPE_ARRAY, sizeof(uint32_t),
+                                   sizeof(uint32_t), 65536);
+    xsk.addrMapFd = xsk_map_create(BPF_MAP_TYPE_HASH, sizeof(IP_ADDRESS),
+                                   sizeof(uint32_t), UDPFWD_XSK_ADDRS_MAX);
+    if ((xsk.portMapFd < 0) || (xsk.addrMapFd < 0)) {
+        VLOG_ERR("Failed to create XDP maps, errno : %d", errno);
+        udpfwd_xsk_exit();
+        return false;
+    }
+
+    for (iter = 0; iter < xsk.intfCount; iter++) {
+        if (true != xsk_intf_init(&xsk.intfs[iter])) {
+            udpfwd_xsk_exit();
+            return false;
+        }
+    }
+
+    for (iter = 0; iter < n_workers; iter++) {
+        if (true != xsk_worker_init(iter, n_workers)) {
+            VLOG_ERR("Failed to create AF_XDP sockets of worker %d", iter);
+            udpfwd_xsk_exit();
+            return false;
+        }
+    }
+
+    /* Steer the DHCP ports and the local addresses from the start */
+    udpfwd_xsk_update();
+    udpfwd_xsk_run();
+
+    for (iter = 0; iter < xsk.intfCount; iter++) {
+        if (true != xsk_intf_attach(&xsk.intfs[iter])) {
+            udpfwd_xsk_exit();
+            return false;
+        }
+        VLOG_INFO("XDP program attached to %s, %d queue(s)",
+                  xsk.intfs[iter].ifName, xsk.intfs[iter].queues);
+    }
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_xsk_update
+ * Responsiblity : Set the DHCP ports and the UDP ports of the configured
+ *                 servers in the port map of the XDP programs
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_xsk_update(void)
+{
+    UDPFWD_SERVER_T *server;
+    uint8_t ports[sizeof(xsk.ports)];
+    uint32_t port, value;
+
+    if (xsk.portMapFd < 0)
+        return;
+
+    memset(ports, 0, sizeof(ports));
+    ports[DHCPS_PORT / 8] |= 1 << (DHCPS_PORT % 8);
+    ports[DHCPC_PORT / 8] |= 1 << (DHCPC_PORT % 8);
+    CMAP_FOR_EACH(server, cmap_node, &udpfwd_ctrl_cb_p->serverHashMap) {
+        ports[server->udp_port / 8] |= 1 << (server->udp_port % 8);
+    }
+
+    for (port = 0; port < 65536; port++) {
+        if (!((ports[port / 8] ^ xsk.ports[port / 8]) & (1 << (port % 8))))
+            continue;
+
+        value = (ports[port / 8] >> (port % 8)) & 1;
+        if (true != xsk_map_update(xsk.portMapFd, &port, &value)) {
+            VLOG_ERR("Failed to update XDP port %d, errno : %d", port, errno);
+            continue;
+        }
+        xsk.ports[port / 8] ^= 1 << (port % 8);
+    }
+}
+
+/*
+ * Function      : udpfwd_xsk_run
+ * Responsiblity : Load the local addresses of the interface cache in the
+ *                 address map of the XDP programs when they changed. New
+ *                 addresses are added before stale ones are removed, a
+ *                 datagram missed meanwhile goes to the raw socket.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_xsk_run(void)
+{
+    IP_ADDRESS addrs[UDPFWD_XSK_ADDRS_MAX];
+    IP_ADDRESS stale[UDPFWD_XSK_ADDRS_MAX];
+    IP_ADDRESS key, next;
+    union bpf_attr attr;
+    uint32_t count, staleCount = 0, iter, value = 1;
+    uint64_t seq;
+    bool found;
+
+    seq = udpfwd_intf_cache_addr_seq();
+    if ((xsk.addrMapFd < 0) || (seq == xsk.addrSeq))
+        return;
+
+    count = udpfwd_intf_cache_addrs(addrs, UDPFWD_XSK_ADDRS_MAX);
+    if (UDPFWD_XSK_ADDRS_MAX == count) {
+        VLOG_ERR("More than %d local addresses, the others are not "
+                 "steered to AF_XDP sockets", UDPFWD_XSK_ADDRS_MAX);
+    }
+
+    for (iter = 0; iter < count; iter++) {
+        if (true != xsk_map_update(xsk.addrMapFd, &addrs[iter], &value)) {
+            VLOG_ERR("Failed to add XDP address, errno : %d", errno);
+        }
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = xsk.addrMapFd;
+    attr.key = 0;
+    attr.next_key = (uintptr_t) &next;
+    while ((0 == udpfwd_bpf_sys(BPF_MAP_GET_NEXT_KEY, &attr)) &&
+           (staleCount < UDPFWD_XSK_ADDRS_MAX)) {
+        for (found = false, iter = 0; !found && (iter < count); iter++)
+            found = (next == addrs[iter]);
+        if (!found)
+            stale[staleCount++] = next;
+        key = next;
+        attr.key = (uintptr_t) &key;
+    }
+
+    for (iter = 0; iter < staleCount; iter++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = xsk.addrMapFd;
+        attr.key = (uintptr_t) &stale[iter];
+        udpfwd_bpf_sys(BPF_MAP_DELETE_ELEM, &attr);
+    }
+
+    xsk.addrSeq = seq;
+    xsk.addrCount = count;
+}
+
+/*
+ * Function      : udpfwd_xsk_exit
+ * Responsiblity : Detach the XDP programs, release the AF_XDP sockets,
+ *                 the UMEMs and the maps
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_xsk_exit(void)
+{
+    UDPFWD_XSK_WORKER *xw;
+    UDPFWD_XSK_INTF *intf;
+    uint32_t iter, sock;
+
+    for (iter = 0; iter < xsk.intfCount; iter++) {
+        intf = &xsk.intfs[iter];
+        if (0 <= intf->linkFd)
+            close(intf->linkFd);
+        if (0 <= intf->progFd)
+            close(intf->progFd);
+        if (0 <= intf->xskMapFd)
+            close(intf->xskMapFd);
+        intf->linkFd = intf->progFd = intf->xskMapFd = -1;
+    }
+
+    for (iter = 0; iter < xsk_n_workers; iter++) {
+        xw = xsk_workers[iter];
+        for (sock = 0; sock < xw->sockCount; sock++)
+            xsk_socket_destroy(&xw->socks[sock]);
+        if (NULL != xw->umem)
+            munmap(xw->umem, xw->umemLen);
+        free(xw);
+        xsk_workers[iter] = NULL;
+    }
+    xsk_n_workers = 0;
+
+    if (0 <= xsk.portMapFd)
+        close(xsk.portMapFd);
+    if (0 <= xsk.addrMapFd)
+        close(xsk.addrMapFd);
+    xsk.portMapFd = xsk.addrMapFd = -1;
+}
+
+/*
+ * Function      : udpfwd_xsk_dump
+ * Responsiblity : Dump the XDP interfaces and the AF_XDP counters
+ * Parameters    : ds - output buffer
+ * Return        : none
+ */
+void udpfwd_xsk_dump(struct ds *ds)
+{
+    UDPFWD_XSK_STATS total;
+    UDPFWD_XSK_STATS *stats;
+    uint32_t iter, sockCount = 0;
+
+    if (0 == xsk_n_workers)
+        return;
+
+    memset(&total, 0, sizeof(total));
+    for (iter = 0; iter < xsk_n_workers; iter++) {
+        stats = &xsk_workers[iter]->stats;
+        sockCount += xsk_workers[iter]->sockCount;
+        total.rxPackets += stats->rxPackets;
+        total.txPackets += stats->txPackets;
+        total.txCopies += stats->txCopies;
+        total.txRingFull += stats->txRingFull;
+        total.noFrames += stats->noFrames;
+    }
+
+    ds_put_format(ds, "XDP mode : %s\n", xsk.generic ? "generic" : "native");
+    ds_put_format(ds, "XDP interfaces :");
+    for (iter = 0; iter < xsk.intfCount; iter++) {
+        ds_put_format(ds, " %s(%d)", xsk.intfs[iter].ifName,
+                      xsk.intfs[iter].queues);
+    }
+    ds_put_format(ds, "\n");
+    ds_put_format(ds, "XDP addresses : %d\n", xsk.addrCount);
+    ds_put_format(ds, "AF_XDP sockets : %d\n", sockCount);
+    ds_put_format(ds, "AF_XDP received : %"PRIu64"\n", total.rxPackets);
+    ds_put_format(ds, "AF_XDP sent : %"PRIu64"\n", total.txPackets);
+    ds_put_format(ds, "AF_XDP sent by copy : %"PRIu64"\n", total.txCopies);
+    ds_put_format(ds, "AF_XDP TX ring full : %"PRIu64"\n", total.txRingFull);
+    ds_put_format(ds, "AF_XDP out of frames : %"PRIu64"\n", total.noFrames);
+}